@@ -68,17 +68,37 @@
 #include <arm_neon.h>
 #include <arm_acle.h>
 #endif
+#if defined(__SSSE3__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
 #include <string.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
+#include <math.h>
+#include <errno.h>
 #include <pthread.h>
 
 #if defined(__unix__) || defined(__APPLE__) || defined(__linux__) || defined(__MINGW32__) || defined(__MINGW64__)
 #include <unistd.h>
 #endif
+#if defined(__unix__) || defined(__APPLE__) || defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <poll.h>
+#include <sys/resource.h>
+#endif
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <dirent.h>
+#include <linux/userfaultfd.h>
+#endif
 #include <sched.h>
 
 // 函数前向声明
@@ -1848,298 +1868,7672 @@ void aes_sm3_integrity_batch(const uint8_t** inputs, uint8_t** outputs, int batc
 }
 
 // ============================================================================
-// SHA256实现（用于性能对比）
+// 域分离版本：按上下文预计算SM3中间状态（零额外压缩开销）
 // ============================================================================
+/*
+ * 单块版本直接从SM3_IV压缩64字节折叠结果，标签与块地址、卷、用途无关，
+ * 误写到错误LBA的有效页仍能通过校验。
+ *
+ * 域分离方案：
+ * 1. 每个上下文（卷/文件/用途）预先计算一次 midstate = CF(SM3_IV, 域块)
+ * 2. 每页仍只做1次SM3压缩，但从 midstate 而不是 SM3_IV 开始
+ * 3. LBA作为廉价调整值异或进折叠块的最后两个字（2条XOR指令）
+ *
+ * 约定：midstate == NULL 表示使用SM3_IV，lba == 0 时不做调整，
+ * 此时输出与规范行折叠（hyper软件路径的折叠定义）的标签一致。
+ */
 
-static const uint32_t SHA256_K[64] = {
-    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
-    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
-    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
-    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
-    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
-    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
-    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
-    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+// 域块魔数（16字节，不足部分补0）
+static const uint8_t SM3_DOMAIN_MAGIC[16] = {
+    'A', 'E', 'S', '-', 'S', 'M', '3', '-', 'D', 'O', 'M', 'A', 'I', 'N', 0, 0
 };
 
-static inline uint32_t rotr(uint32_t x, int n) {
-    return (x >> n) | (x << (32 - n));
-}
+// 规范行折叠：fold[k] = XOR(row[r][k])，row为64字节行，rows为行数
+// 与NEON/软件路径完全一致，保证跨平台输出相同
+static inline void xor_fold_rows(const uint8_t* input, size_t rows, uint8_t* folded) {
+#if defined(__ARM_FEATURE_CRYPTO) && defined(__aarch64__)
+    // 8个累加器：每次处理2行（128字节），两组累加器交错减少依赖链
+    uint8x16_t a0 = vdupq_n_u8(0), a1 = vdupq_n_u8(0);
+    uint8x16_t a2 = vdupq_n_u8(0), a3 = vdupq_n_u8(0);
+    uint8x16_t b0 = vdupq_n_u8(0), b1 = vdupq_n_u8(0);
+    uint8x16_t b2 = vdupq_n_u8(0), b3 = vdupq_n_u8(0);
 
-static inline uint32_t ch(uint32_t x, uint32_t y, uint32_t z) {
-    return (x & y) ^ (~x & z);
-}
+    const uint8_t* ptr = input;
+    size_t r = 0;
+    for (; r + 2 <= rows; r += 2) {
+        __builtin_prefetch(ptr + 512, 0, 3);
+        a0 = veorq_u8(a0, vld1q_u8(ptr));
+        a1 = veorq_u8(a1, vld1q_u8(ptr + 16));
+        a2 = veorq_u8(a2, vld1q_u8(ptr + 32));
+        a3 = veorq_u8(a3, vld1q_u8(ptr + 48));
+        b0 = veorq_u8(b0, vld1q_u8(ptr + 64));
+        b1 = veorq_u8(b1, vld1q_u8(ptr + 80));
+        b2 = veorq_u8(b2, vld1q_u8(ptr + 96));
+        b3 = veorq_u8(b3, vld1q_u8(ptr + 112));
+        ptr += 128;
+    }
+    if (r < rows) {
+        a0 = veorq_u8(a0, vld1q_u8(ptr));
+        a1 = veorq_u8(a1, vld1q_u8(ptr + 16));
+        a2 = veorq_u8(a2, vld1q_u8(ptr + 32));
+        a3 = veorq_u8(a3, vld1q_u8(ptr + 48));
+    }
 
-static inline uint32_t maj(uint32_t x, uint32_t y, uint32_t z) {
-    return (x & y) ^ (x & z) ^ (y & z);
-}
+    vst1q_u8(folded,      veorq_u8(a0, b0));
+    vst1q_u8(folded + 16, veorq_u8(a1, b1));
+    vst1q_u8(folded + 32, veorq_u8(a2, b2));
+    vst1q_u8(folded + 48, veorq_u8(a3, b3));
+#else
+    uint64_t acc[8] __attribute__((aligned(64))) = {0};
+    const uint64_t* ptr64 = (const uint64_t*)input;
 
-static inline uint32_t sigma0(uint32_t x) {
-    return rotr(x, 2) ^ rotr(x, 13) ^ rotr(x, 22);
-}
+    for (size_t i = 0; i < rows * 8; i += 8) {
+        __builtin_prefetch(ptr64 + i + 64, 0, 3);
+        acc[0] ^= ptr64[i];
+        acc[1] ^= ptr64[i+1];
+        acc[2] ^= ptr64[i+2];
+        acc[3] ^= ptr64[i+3];
+        acc[4] ^= ptr64[i+4];
+        acc[5] ^= ptr64[i+5];
+        acc[6] ^= ptr64[i+6];
+        acc[7] ^= ptr64[i+7];
+    }
 
-static inline uint32_t sigma1(uint32_t x) {
-    return rotr(x, 6) ^ rotr(x, 11) ^ rotr(x, 25);
+    memcpy(folded, acc, 64);
+#endif
 }
 
-static inline uint32_t gamma0(uint32_t x) {
-    return rotr(x, 7) ^ rotr(x, 18) ^ (x >> 3);
-}
+// 从给定中间状态压缩64字节折叠结果（调整值异或进最后两个字）
+static inline void sm3_tag_from_fold(const uint32_t* midstate, const uint8_t* folded,
+                                     uint64_t tweak, uint8_t* output) {
+    uint32_t sm3_state[8] __attribute__((aligned(64)));
+    memcpy(sm3_state, midstate ? midstate : SM3_IV, sizeof(sm3_state));
 
-static inline uint32_t gamma1(uint32_t x) {
-    return rotr(x, 17) ^ rotr(x, 19) ^ (x >> 10);
+    uint32_t sm3_block[16] __attribute__((aligned(64)));
+#if defined(__ARM_FEATURE_CRYPTO) && defined(__aarch64__)
+    vst1q_u32(sm3_block,      vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(folded))));
+    vst1q_u32(sm3_block + 4,  vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(folded + 16))));
+    vst1q_u32(sm3_block + 8,  vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(folded + 32))));
+    vst1q_u32(sm3_block + 12, vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(folded + 48))));
+#else
+    const uint32_t* src = (const uint32_t*)folded;
+    for (int i = 0; i < 16; i++) {
+        sm3_block[i] = __builtin_bswap32(src[i]);
+    }
+#endif
+
+    // 廉价调整：2条XOR，不增加SM3压缩次数
+    sm3_block[14] ^= (uint32_t)(tweak >> 32);
+    sm3_block[15] ^= (uint32_t)tweak;
+
+    sm3_compress_hw_inline_full(sm3_state, sm3_block);
+
+    uint32_t* out32 = (uint32_t*)output;
+    for (int i = 0; i < 8; i++) {
+        out32[i] = __builtin_bswap32(sm3_state[i]);
+    }
 }
 
-// SHA256硬件加速版本（使用ARMv8 SHA2指令集）
-#if (defined(__ARM_FEATURE_SHA2) || defined(__aarch64__)) && defined(__aarch64__)
-static void sha256_compress(uint32_t* state, const uint8_t* block) {
-    // 使用ARMv8 SHA2硬件指令
-    uint32x4_t STATE0, STATE1, ABEF_SAVE, CDGH_SAVE;
-    uint32x4_t MSG0, MSG1, MSG2, MSG3;
-    uint32x4_t TMP0, TMP1, TMP2;
-    
-    // 加载状态
-    STATE0 = vld1q_u32(&state[0]);  // ABCD
-    STATE1 = vld1q_u32(&state[4]);  // EFGH
-    
-    ABEF_SAVE = STATE0;
-    CDGH_SAVE = STATE1;
-    
-    // 加载消息（大端序）
-    MSG0 = vld1q_u32((const uint32_t*)(block + 0));
-    MSG1 = vld1q_u32((const uint32_t*)(block + 16));
-    MSG2 = vld1q_u32((const uint32_t*)(block + 32));
-    MSG3 = vld1q_u32((const uint32_t*)(block + 48));
-    
-    MSG0 = vreinterpretq_u32_u8(vrev32q_u8(vreinterpretq_u8_u32(MSG0)));
-    MSG1 = vreinterpretq_u32_u8(vrev32q_u8(vreinterpretq_u8_u32(MSG1)));
-    MSG2 = vreinterpretq_u32_u8(vrev32q_u8(vreinterpretq_u8_u32(MSG2)));
-    MSG3 = vreinterpretq_u32_u8(vrev32q_u8(vreinterpretq_u8_u32(MSG3)));
-    
-    // 轮0-3
-    TMP0 = vaddq_u32(MSG0, vld1q_u32(&SHA256_K[0]));
-    TMP2 = STATE0;
-    TMP1 = vaddq_u32(STATE1, TMP0);
-    STATE0 = vsha256hq_u32(STATE0, STATE1, TMP1);
-    STATE1 = vsha256h2q_u32(STATE1, TMP2, TMP1);
-    MSG0 = vsha256su0q_u32(MSG0, MSG1);
-    MSG0 = vsha256su1q_u32(MSG0, MSG2, MSG3);
-    
-    // 轮4-7
-    TMP0 = vaddq_u32(MSG1, vld1q_u32(&SHA256_K[4]));
-    TMP2 = STATE0;
-    TMP1 = vaddq_u32(STATE1, TMP0);
-    STATE0 = vsha256hq_u32(STATE0, STATE1, TMP1);
-    STATE1 = vsha256h2q_u32(STATE1, TMP2, TMP1);
-    MSG1 = vsha256su0q_u32(MSG1, MSG2);
-    MSG1 = vsha256su1q_u32(MSG1, MSG3, MSG0);
-    
-    // 轮8-11
-    TMP0 = vaddq_u32(MSG2, vld1q_u32(&SHA256_K[8]));
-    TMP2 = STATE0;
-    TMP1 = vaddq_u32(STATE1, TMP0);
-    STATE0 = vsha256hq_u32(STATE0, STATE1, TMP1);
-    STATE1 = vsha256h2q_u32(STATE1, TMP2, TMP1);
-    MSG2 = vsha256su0q_u32(MSG2, MSG3);
-    MSG2 = vsha256su1q_u32(MSG2, MSG0, MSG1);
-    
-    // 轮12-15
-    TMP0 = vaddq_u32(MSG3, vld1q_u32(&SHA256_K[12]));
-    TMP2 = STATE0;
-    TMP1 = vaddq_u32(STATE1, TMP0);
-    STATE0 = vsha256hq_u32(STATE0, STATE1, TMP1);
-    STATE1 = vsha256h2q_u32(STATE1, TMP2, TMP1);
-    MSG3 = vsha256su0q_u32(MSG3, MSG0);
-    MSG3 = vsha256su1q_u32(MSG3, MSG1, MSG2);
-    
-    // 继续剩余轮次（16-63），展开4轮一组
-    for (int i = 16; i < 64; i += 16) {
-        // 4轮一组，共12组
-        TMP0 = vaddq_u32(MSG0, vld1q_u32(&SHA256_K[i]));
-        TMP2 = STATE0;
-        TMP1 = vaddq_u32(STATE1, TMP0);
-        STATE0 = vsha256hq_u32(STATE0, STATE1, TMP1);
-        STATE1 = vsha256h2q_u32(STATE1, TMP2, TMP1);
-        MSG0 = vsha256su0q_u32(MSG0, MSG1);
-        MSG0 = vsha256su1q_u32(MSG0, MSG2, MSG3);
-        
-        TMP0 = vaddq_u32(MSG1, vld1q_u32(&SHA256_K[i+4]));
-        TMP2 = STATE0;
-        TMP1 = vaddq_u32(STATE1, TMP0);
-        STATE0 = vsha256hq_u32(STATE0, STATE1, TMP1);
-        STATE1 = vsha256h2q_u32(STATE1, TMP2, TMP1);
-        MSG1 = vsha256su0q_u32(MSG1, MSG2);
-        MSG1 = vsha256su1q_u32(MSG1, MSG3, MSG0);
-        
-        TMP0 = vaddq_u32(MSG2, vld1q_u32(&SHA256_K[i+8]));
-        TMP2 = STATE0;
-        TMP1 = vaddq_u32(STATE1, TMP0);
-        STATE0 = vsha256hq_u32(STATE0, STATE1, TMP1);
-        STATE1 = vsha256h2q_u32(STATE1, TMP2, TMP1);
-        MSG2 = vsha256su0q_u32(MSG2, MSG3);
-        MSG2 = vsha256su1q_u32(MSG2, MSG0, MSG1);
-        
-        TMP0 = vaddq_u32(MSG3, vld1q_u32(&SHA256_K[i+12]));
-        TMP2 = STATE0;
-        TMP1 = vaddq_u32(STATE1, TMP0);
-        STATE0 = vsha256hq_u32(STATE0, STATE1, TMP1);
-        STATE1 = vsha256h2q_u32(STATE1, TMP2, TMP1);
-        MSG3 = vsha256su0q_u32(MSG3, MSG0);
-        MSG3 = vsha256su1q_u32(MSG3, MSG1, MSG2);
+// 预计算上下文中间状态：midstate = CF(SM3_IV, 域块)
+// 域块布局：魔数(16) | volume_id大端(8) | file_id大端(8) | purpose(32, 补0截断)
+void aes_sm3_domain_init(uint32_t* midstate, uint64_t volume_id, uint64_t file_id,
+                         const char* purpose) {
+    uint8_t domain_block[64] __attribute__((aligned(16)));
+    memset(domain_block, 0, sizeof(domain_block));
+    memcpy(domain_block, SM3_DOMAIN_MAGIC, 16);
+
+    for (int i = 0; i < 8; i++) {
+        domain_block[16 + i] = (uint8_t)(volume_id >> (56 - 8 * i));
+        domain_block[24 + i] = (uint8_t)(file_id >> (56 - 8 * i));
     }
-    
-    // 累加到状态
-    STATE0 = vaddq_u32(STATE0, ABEF_SAVE);
-    STATE1 = vaddq_u32(STATE1, CDGH_SAVE);
-    
-    // 保存状态
-    vst1q_u32(&state[0], STATE0);
-    vst1q_u32(&state[4], STATE1);
+    if (purpose) {
+        size_t len = strlen(purpose);
+        memcpy(domain_block + 32, purpose, len < 32 ? len : 32);
+    }
+
+    uint32_t sm3_block[16];
+    const uint32_t* src = (const uint32_t*)domain_block;
+    for (int i = 0; i < 16; i++) {
+        sm3_block[i] = __builtin_bswap32(src[i]);
+    }
+
+    memcpy(midstate, SM3_IV, sizeof(SM3_IV));
+    sm3_compress_hw(midstate, sm3_block);
 }
-#else
-// 如果不支持SHA2硬件指令，编译时报错
-#error "SHA2硬件加速不可用！请使用 -march=armv8.2-a+crypto+sha2 编译选项，或在支持SHA2指令的ARM平台上编译。"
-#endif
 
-void sha256_4kb(const uint8_t* input, uint8_t* output) {
-    uint32_t state[8] = {
-        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
-        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
-    };
-    
-    // 循环展开：每次处理4个块
-    for (int i = 0; i < 64; i += 4) {
-        sha256_compress(state, input + i * 64);
-        sha256_compress(state, input + (i+1) * 64);
-        sha256_compress(state, input + (i+2) * 64);
-        sha256_compress(state, input + (i+3) * 64);
+// 域分离单块版本：4KB -> 64B行折叠 -> 从midstate压缩1次（含LBA调整）
+void aes_sm3_integrity_256bit_domain(const uint32_t* midstate, uint64_t lba,
+                                     const uint8_t* input, uint8_t* output) {
+    uint8_t folded[64] __attribute__((aligned(64)));
+    xor_fold_rows(input, 64, folded);
+    sm3_tag_from_fold(midstate, folded, lba, output);
+}
+
+// 域分离批处理版本：同一上下文下每页使用各自的LBA
+void aes_sm3_integrity_batch_domain(const uint32_t* midstate, const uint64_t* lbas,
+                                    const uint8_t** inputs, uint8_t** outputs, int batch_size) {
+    uint8_t folded[64] __attribute__((aligned(64)));
+
+    for (int i = 0; i < batch_size; i++) {
+        // 预取下一页的前几个缓存行
+        if (i + 1 < batch_size) {
+            __builtin_prefetch(inputs[i + 1], 0, 3);
+            __builtin_prefetch(inputs[i + 1] + 64, 0, 3);
+            __builtin_prefetch(inputs[i + 1] + 128, 0, 3);
+            __builtin_prefetch(inputs[i + 1] + 192, 0, 3);
+        }
+
+        xor_fold_rows(inputs[i], 64, folded);
+        sm3_tag_from_fold(midstate, folded, lbas ? lbas[i] : 0, outputs[i]);
     }
-    
-    // 直接输出（减少循环）
-    uint32_t* out32 = (uint32_t*)output;
-    out32[0] = __builtin_bswap32(state[0]);
-    out32[1] = __builtin_bswap32(state[1]);
-    out32[2] = __builtin_bswap32(state[2]);
-    out32[3] = __builtin_bswap32(state[3]);
-    out32[4] = __builtin_bswap32(state[4]);
-    out32[5] = __builtin_bswap32(state[5]);
-    out32[6] = __builtin_bswap32(state[6]);
-    out32[7] = __builtin_bswap32(state[7]);
 }
 
 // ============================================================================
-// 纯SM3实现（用于对比）
+// 乱序分段累加：折叠结果按片段任意顺序、任意线程累加
 // ============================================================================
+/*
+ * 行折叠 fold[k] = XOR(page[64r + k]) 对各片段可交换：偏移o处的字节只贡献到
+ * fold[o % 64]。RDMA/多路径接收时页面片段乱序到达，可以边到达边累加，
+ * 4096字节全部覆盖后再做1次SM3压缩，无需等待重组。
+ *
+ * - 覆盖位图：4096位（64个uint64），每个字恰好对应一个64字节行
+ * - 并发安全：位图用原子fetch_or声明区间，折叠用原子fetch_xor合入
+ * - 重叠检测：重复覆盖会使XOR抵消，因此声明冲突时回滚并返回-1
+ * - 合并：各线程私有累加器可合并到同一目标（源累加器需已停止写入）
+ */
 
-void sm3_4kb(const uint8_t* input, uint8_t* output) {
-    uint32_t state[8];
-    memcpy(state, SM3_IV, sizeof(SM3_IV));
-    
-    // 循环展开：每次处理2个块
-    for (int i = 0; i < 64; i += 2) {
-        uint32_t block[16];
-        
-        // 第一个块
-        const uint32_t* src = (const uint32_t*)(input + i * 64);
-        for (int j = 0; j < 16; j++) {
-            block[j] = __builtin_bswap32(src[j]);
+struct aes_sm3_fold_acc {
+    uint64_t fold[8];          // 64字节折叠结果（原子XOR）
+    uint64_t coverage[64];     // 4096位覆盖位图（原子OR）
+    uint32_t covered;          // 已覆盖字节数（原子加）
+    uint8_t  pad[60];          // 补齐到缓存行整数倍
+} __attribute__((aligned(64)));
+
+typedef struct aes_sm3_fold_acc aes_sm3_fold_acc_t;
+
+// 计算[offset, offset+len)在覆盖字w内的位掩码
+static inline uint64_t fold_acc_range_mask(size_t offset, size_t len, int w) {
+    size_t word_lo = (size_t)w * 64;
+    size_t lo = offset > word_lo ? offset - word_lo : 0;
+    size_t hi = offset + len < word_lo + 64 ? offset + len - word_lo : 64;
+    size_t bits = hi - lo;
+    return (bits == 64 ? ~0ULL : ((1ULL << bits) - 1)) << lo;
+}
+
+// 声明覆盖区间：任一位已被覆盖则回滚本次声明并返回-1
+static int fold_acc_claim(aes_sm3_fold_acc_t* acc, const uint64_t* masks,
+                          int first_word, int last_word) {
+    for (int w = first_word; w <= last_word; w++) {
+        uint64_t mask = masks[w - first_word];
+        if (mask == 0) {
+            continue;
         }
-        sm3_compress_hw(state, block);
-        
-        // 第二个块
-        src = (const uint32_t*)(input + (i+1) * 64);
-        for (int j = 0; j < 16; j++) {
-            block[j] = __builtin_bswap32(src[j]);
+        uint64_t old = __atomic_fetch_or(&acc->coverage[w], mask, __ATOMIC_ACQ_REL);
+        if (old & mask) {
+            // 回滚：本字中新置位的部分 + 之前已完整声明的字
+            __atomic_fetch_and(&acc->coverage[w], ~(mask & ~old), __ATOMIC_ACQ_REL);
+            for (int u = first_word; u < w; u++) {
+                __atomic_fetch_and(&acc->coverage[u], ~masks[u - first_word], __ATOMIC_ACQ_REL);
+            }
+            return -1;
         }
-        sm3_compress_hw(state, block);
     }
-    
-    // 直接输出（减少循环）
-    uint32_t* out32 = (uint32_t*)output;
-    out32[0] = __builtin_bswap32(state[0]);
-    out32[1] = __builtin_bswap32(state[1]);
-    out32[2] = __builtin_bswap32(state[2]);
-    out32[3] = __builtin_bswap32(state[3]);
-    out32[4] = __builtin_bswap32(state[4]);
-    out32[5] = __builtin_bswap32(state[5]);
-    out32[6] = __builtin_bswap32(state[6]);
-    out32[7] = __builtin_bswap32(state[7]);
+    return 0;
 }
 
-// ============================================================================
-// 多线程并行处理
-// ============================================================================
+// 合入局部折叠结果并累计覆盖字节数（release保证折叠先于计数可见）
+static inline void fold_acc_publish(aes_sm3_fold_acc_t* acc, const uint64_t* local, uint32_t bytes) {
+    for (int i = 0; i < 8; i++) {
+        if (local[i]) {
+            __atomic_fetch_xor(&acc->fold[i], local[i], __ATOMIC_RELAXED);
+        }
+    }
+    __atomic_fetch_add(&acc->covered, bytes, __ATOMIC_RELEASE);
+}
+
+aes_sm3_fold_acc_t* aes_sm3_fold_acc_create(void) {
+    aes_sm3_fold_acc_t* acc = (aes_sm3_fold_acc_t*)aligned_alloc(64, sizeof(aes_sm3_fold_acc_t));
+    if (acc) {
+        memset(acc, 0, sizeof(*acc));
+    }
+    return acc;
+}
+
+void aes_sm3_fold_acc_reset(aes_sm3_fold_acc_t* acc) {
+    memset(acc, 0, sizeof(*acc));
+}
+
+void aes_sm3_fold_acc_free(aes_sm3_fold_acc_t* acc) {
+    free(acc);
+}
+
+// 累加一个片段：page[offset .. offset+len) = data
+// 返回0成功；越界或与已累加片段重叠返回-1（累加器保持不变）
+int aes_sm3_fold_acc_add(aes_sm3_fold_acc_t* acc, size_t offset, const uint8_t* data, size_t len) {
+    if (len == 0) {
+        return 0;
+    }
+    if (offset >= 4096 || len > 4096 - offset) {
+        return -1;
+    }
+
+    int first_word = (int)(offset / 64);
+    int last_word = (int)((offset + len - 1) / 64);
+    uint64_t masks[64];
+    for (int w = first_word; w <= last_word; w++) {
+        masks[w - first_word] = fold_acc_range_mask(offset, len, w);
+    }
+    if (fold_acc_claim(acc, masks, first_word, last_word) != 0) {
+        return -1;
+    }
+
+    // 局部折叠：头部不对齐字节 -> 整行（行折叠内核）-> 尾部字节
+    uint8_t local[64] __attribute__((aligned(64)));
+    memset(local, 0, sizeof(local));
+
+    size_t pos = 0;
+    while (pos < len && ((offset + pos) & 63) != 0) {
+        local[(offset + pos) & 63] ^= data[pos];
+        pos++;
+    }
+
+    size_t rows = (len - pos) / 64;
+    if (rows > 0) {
+        uint8_t row_fold[64] __attribute__((aligned(64)));
+        xor_fold_rows(data + pos, rows, row_fold);
+        for (int k = 0; k < 64; k++) {
+            local[k] ^= row_fold[k];
+        }
+        pos += rows * 64;
+    }
+
+    while (pos < len) {
+        local[(offset + pos) & 63] ^= data[pos];
+        pos++;
+    }
+
+    uint64_t local64[8];
+    memcpy(local64, local, sizeof(local64));
+    fold_acc_publish(acc, local64, (uint32_t)len);
+    return 0;
+}
+
+// 合并：dst += src（src需已停止写入）；覆盖区间重叠返回-1（dst保持不变）
+int aes_sm3_fold_acc_merge(aes_sm3_fold_acc_t* dst, const aes_sm3_fold_acc_t* src) {
+    uint64_t masks[64];
+    for (int w = 0; w < 64; w++) {
+        masks[w] = __atomic_load_n(&src->coverage[w], __ATOMIC_ACQUIRE);
+    }
+    if (fold_acc_claim(dst, masks, 0, 63) != 0) {
+        return -1;
+    }
+
+    uint64_t local64[8];
+    for (int i = 0; i < 8; i++) {
+        local64[i] = __atomic_load_n(&src->fold[i], __ATOMIC_RELAXED);
+    }
+    fold_acc_publish(dst, local64, __atomic_load_n(&src->covered, __ATOMIC_ACQUIRE));
+    return 0;
+}
+
+// 4096字节是否已全部覆盖
+int aes_sm3_fold_acc_complete(const aes_sm3_fold_acc_t* acc) {
+    return __atomic_load_n(&acc->covered, __ATOMIC_ACQUIRE) == 4096;
+}
+
+// 读出当前64字节折叠结果（可作为页元数据保存）
+void aes_sm3_fold_acc_get_fold(const aes_sm3_fold_acc_t* acc, uint8_t* folded) {
+    uint64_t local64[8];
+    for (int i = 0; i < 8; i++) {
+        local64[i] = __atomic_load_n(&acc->fold[i], __ATOMIC_RELAXED);
+    }
+    memcpy(folded, local64, sizeof(local64));
+}
+
+// 完成：全部覆盖后做1次SM3压缩，结果与aes_sm3_integrity_256bit_domain一致
+// 未完全覆盖返回-1
+int aes_sm3_fold_acc_finalize(const aes_sm3_fold_acc_t* acc, const uint32_t* midstate,
+                              uint64_t lba, uint8_t* output) {
+    if (!aes_sm3_fold_acc_complete(acc)) {
+        return -1;
+    }
+
+    uint8_t folded[64] __attribute__((aligned(64)));
+    aes_sm3_fold_acc_get_fold(acc, folded);
+    sm3_tag_from_fold(midstate, folded, lba, output);
+    return 0;
+}
+
+// ============================================================================
+// 区段标签：由已保存的页折叠结果组合，无需重读数据
+// ============================================================================
+/*
+ * 行折叠是线性的，多页区段（如64KB对象=16页）的中间结果可由各页64字节
+ * 折叠结果推导，最后只需2次SM3压缩（与页数无关）。
+ *
+ * 组合定义（无歧义且与位置绑定）：
+ *   将64字节折叠视为8个GF(2^64)元素（模多项式 x^64 + x^4 + x^3 + x + 1）
+ *   acc = Σ fold_i · x^(n-1-i)      （Horner：acc = acc·x ⊕ fold_i）
+ *   - 不同位置的乘子互不相同，交换两页会改变结果
+ *   - 区段魔数与页数n单独占一个压缩块：区段中间状态 = CF(midstate, 区段块)，
+ *     acc再从区段中间状态压缩，起始LBA作为调整值（同域分离）
+ *     因此前缀补零页、不同长度、不同起点以及单页标签互不混淆；
+ *     魔数与页数不与acc混合，构造不出与某个页标签相同的区段标签
+ */
+
+// 区段块魔数（16字节，不足部分补0）
+static const uint8_t SM3_EXTENT_MAGIC[16] = {
+    'A', 'E', 'S', '-', 'S', 'M', '3', '-', 'E', 'X', 'T', 'E', 'N', 'T', 0, 0
+};
+
+// GF(2^64)乘x：左移1位，溢出时异或约简多项式低位 0x1B
+static inline uint64_t gf64_xtime(uint64_t v) {
+    return (v << 1) ^ ((0 - (v >> 63)) & 0x1BULL);
+}
+
+// 单页64字节行折叠（供调用方作为页元数据保存）
+void aes_sm3_fold_4kb(const uint8_t* input, uint8_t* folded) {
+    xor_fold_rows(input, 64, folded);
+}
+
+// 由保存的折叠结果重新计算页标签（与aes_sm3_integrity_256bit_domain一致）
+void aes_sm3_tag_from_fold(const uint32_t* midstate, const uint8_t* folded,
+                           uint64_t lba, uint8_t* output) {
+    sm3_tag_from_fold(midstate, folded, lba, output);
+}
+
+// Horner一步：acc = acc·x ⊕ fold
+static inline void extent_horner_step(uint64_t* acc, const uint8_t* fold) {
+#if defined(__ARM_FEATURE_CRYPTO) && defined(__aarch64__)
+    const uint64x2_t poly = vdupq_n_u64(0x1BULL);
+    for (int i = 0; i < 8; i += 2) {
+        uint64x2_t v = vld1q_u64(acc + i);
+        uint64x2_t carry = vreinterpretq_u64_s64(vshrq_n_s64(vreinterpretq_s64_u64(v), 63));
+        v = veorq_u64(vshlq_n_u64(v, 1), vandq_u64(carry, poly));
+        v = veorq_u64(v, vreinterpretq_u64_u8(vld1q_u8(fold + i * 8)));
+        vst1q_u64(acc + i, v);
+    }
+#else
+    uint64_t f[8];
+    memcpy(f, fold, sizeof(f));
+    for (int i = 0; i < 8; i++) {
+        acc[i] = gf64_xtime(acc[i]) ^ f[i];
+    }
+#endif
+}
+
+// 组合完成：区段中间状态 = CF(midstate, 魔数(16) | 页数大端(8) | 补0)，
+// 再从区段中间状态压缩acc（起始LBA作为调整值）
+static void extent_finalize(const uint32_t* midstate, uint64_t start_lba, const uint64_t* acc,
+                            uint32_t page_count, uint8_t* output) {
+    uint8_t extent_block[64] __attribute__((aligned(16)));
+    memset(extent_block, 0, sizeof(extent_block));
+    memcpy(extent_block, SM3_EXTENT_MAGIC, 16);
+    for (int i = 0; i < 8; i++) {
+        extent_block[16 + i] = (uint8_t)((uint64_t)page_count >> (56 - 8 * i));
+    }
+
+    uint32_t sm3_block[16];
+    const uint32_t* src = (const uint32_t*)extent_block;
+    for (int i = 0; i < 16; i++) {
+        sm3_block[i] = __builtin_bswap32(src[i]);
+    }
+    uint32_t extent_state[8];
+    memcpy(extent_state, midstate ? midstate : SM3_IV, sizeof(extent_state));
+    sm3_compress_hw(extent_state, sm3_block);
+
+    uint8_t folded[64] __attribute__((aligned(64)));
+    memcpy(folded, acc, 64);
+    sm3_tag_from_fold(extent_state, folded, start_lba, output);
+}
+
+// 由连续保存的page_count个64字节折叠结果计算区段标签（不读取页数据）
+void aes_sm3_extent_tag_from_folds(const uint32_t* midstate, uint64_t start_lba,
+                                   const uint8_t* folds, int page_count, uint8_t* output) {
+    uint64_t acc[8] __attribute__((aligned(64))) = {0};
+
+    for (int i = 0; i < page_count; i++) {
+        __builtin_prefetch(folds + (i + 4) * 64, 0, 3);
+        extent_horner_step(acc, folds + i * 64);
+    }
+
+    extent_finalize(midstate, start_lba, acc, (uint32_t)page_count, output);
+}
+
+// 由页数据直接计算区段标签（参考路径，结果与 *_from_folds 一致）
+void aes_sm3_extent_tag(const uint32_t* midstate, uint64_t start_lba,
+                        const uint8_t* data, int page_count, uint8_t* output) {
+    uint64_t acc[8] __attribute__((aligned(64))) = {0};
+    uint8_t folded[64] __attribute__((aligned(64)));
+
+    for (int i = 0; i < page_count; i++) {
+        xor_fold_rows(data + (size_t)i * 4096, 64, folded);
+        extent_horner_step(acc, folded);
+    }
+
+    extent_finalize(midstate, start_lba, acc, (uint32_t)page_count, output);
+}
+
+// ============================================================================
+// 融合RAID校验：一次内存遍历同时生成XOR校验页(P)、GF(2^8)校验页(Q)和标签
+// ============================================================================
+/*
+ * 纠删层计算条带的XOR校验，标签又单独扫描一次，每个字节被加载两次。
+ * 融合模式在折叠每一行时同时更新P/Q（共8KB，常驻L1），数据只读一遍：
+ *   P = XOR(D_i)
+ *   Q = Σ g^i · D_i   （g = 2，模多项式 0x11D，与Linux RAID6一致；Horner倒序累加）
+ * 校验页自身的标签无需再读P/Q：折叠是线性的
+ *   fold(P) = XOR(fold(D_i))，fold(Q) = Σ g^i · fold(D_i)
+ */
+
+// GF(2^8)乘2（NEON：算术右移得到高位掩码）
+#if defined(__ARM_FEATURE_CRYPTO) && defined(__aarch64__)
+static inline uint8x16_t gf8_mul2_neon(uint8x16_t v) {
+    uint8x16_t mask = vreinterpretq_u8_s8(vshrq_n_s8(vreinterpretq_s8_u8(v), 7));
+    return veorq_u8(vshlq_n_u8(v, 1), vandq_u8(mask, vdupq_n_u8(0x1d)));
+}
+#endif
+
+// GF(2^8)乘2（64位SWAR，每字节独立）
+static inline uint64_t gf8_mul2_swar(uint64_t v) {
+    uint64_t hi = v & 0x8080808080808080ULL;
+    uint64_t mask = (hi << 1) - (hi >> 7);  // 高位为1的字节得到0xFF
+    return ((v << 1) & 0xFEFEFEFEFEFEFEFEULL) ^ (mask & 0x1D1D1D1D1D1D1D1DULL);
+}
+
+// 单页融合处理：行折叠 + 更新P/Q
+// first: 条带中第一个被处理的页（直接写入P/Q，省去清零遍历）
+static inline void fused_parity_page(const uint8_t* page, uint8_t* p, uint8_t* q,
+                                     int first, uint8_t* folded) {
+#if defined(__ARM_FEATURE_CRYPTO) && defined(__aarch64__)
+    uint8x16_t a0 = vdupq_n_u8(0), a1 = vdupq_n_u8(0);
+    uint8x16_t a2 = vdupq_n_u8(0), a3 = vdupq_n_u8(0);
+
+    for (int r = 0; r < 64; r++) {
+        const uint8_t* row = page + r * 64;
+        uint8_t* prow = p + r * 64;
+        __builtin_prefetch(row + 512, 0, 3);
+
+        uint8x16_t d0 = vld1q_u8(row);
+        uint8x16_t d1 = vld1q_u8(row + 16);
+        uint8x16_t d2 = vld1q_u8(row + 32);
+        uint8x16_t d3 = vld1q_u8(row + 48);
+
+        a0 = veorq_u8(a0, d0);
+        a1 = veorq_u8(a1, d1);
+        a2 = veorq_u8(a2, d2);
+        a3 = veorq_u8(a3, d3);
+
+        if (first) {
+            vst1q_u8(prow,      d0);
+            vst1q_u8(prow + 16, d1);
+            vst1q_u8(prow + 32, d2);
+            vst1q_u8(prow + 48, d3);
+        } else {
+            vst1q_u8(prow,      veorq_u8(vld1q_u8(prow),      d0));
+            vst1q_u8(prow + 16, veorq_u8(vld1q_u8(prow + 16), d1));
+            vst1q_u8(prow + 32, veorq_u8(vld1q_u8(prow + 32), d2));
+            vst1q_u8(prow + 48, veorq_u8(vld1q_u8(prow + 48), d3));
+        }
+
+        if (q) {
+            uint8_t* qrow = q + r * 64;
+            if (first) {
+                vst1q_u8(qrow,      d0);
+                vst1q_u8(qrow + 16, d1);
+                vst1q_u8(qrow + 32, d2);
+                vst1q_u8(qrow + 48, d3);
+            } else {
+                vst1q_u8(qrow,      veorq_u8(gf8_mul2_neon(vld1q_u8(qrow)),      d0));
+                vst1q_u8(qrow + 16, veorq_u8(gf8_mul2_neon(vld1q_u8(qrow + 16)), d1));
+                vst1q_u8(qrow + 32, veorq_u8(gf8_mul2_neon(vld1q_u8(qrow + 32)), d2));
+                vst1q_u8(qrow + 48, veorq_u8(gf8_mul2_neon(vld1q_u8(qrow + 48)), d3));
+            }
+        }
+    }
+
+    vst1q_u8(folded,      a0);
+    vst1q_u8(folded + 16, a1);
+    vst1q_u8(folded + 32, a2);
+    vst1q_u8(folded + 48, a3);
+#else
+    uint64_t acc[8] __attribute__((aligned(64))) = {0};
+    const uint64_t* src64 = (const uint64_t*)page;
+    uint64_t* p64 = (uint64_t*)p;
+    uint64_t* q64 = (uint64_t*)q;
+
+    for (int i = 0; i < 512; i += 8) {
+        __builtin_prefetch(src64 + i + 64, 0, 3);
+        for (int k = 0; k < 8; k++) {
+            uint64_t d = src64[i + k];
+            acc[k] ^= d;
+            p64[i + k] = first ? d : (p64[i + k] ^ d);
+            if (q64) {
+                q64[i + k] = first ? d : (gf8_mul2_swar(q64[i + k]) ^ d);
+            }
+        }
+    }
+
+    memcpy(folded, acc, 64);
+#endif
+}
+
+// 融合批处理：每页标签 + P校验页（+可选Q校验页）+ 校验页标签
+// lbas / parity_lbas 可为NULL（调整值为0）；parity_tags需32字节（仅P）或64字节（P+Q）
+// 返回0成功；batch_size非法（<1，或需要Q时>255）返回-1
+int aes_sm3_integrity_batch_parity(const uint32_t* midstate, const uint64_t* lbas,
+                                   const uint8_t** inputs, uint8_t** outputs, int batch_size,
+                                   uint8_t* parity_p, uint8_t* parity_q,
+                                   const uint64_t* parity_lbas, uint8_t* parity_tags) {
+    if (batch_size < 1 || (parity_q && batch_size > 255)) {
+        return -1;
+    }
+
+    uint8_t folded[64] __attribute__((aligned(64)));
+    uint64_t fold_p[8] __attribute__((aligned(64))) = {0};
+    uint64_t fold_q[8] __attribute__((aligned(64))) = {0};
+
+    // 倒序处理：Q的Horner累加 Q = Q·g ⊕ D_i 要求从最高下标开始
+    for (int i = batch_size - 1; i >= 0; i--) {
+        if (i > 0) {
+            __builtin_prefetch(inputs[i - 1], 0, 3);
+            __builtin_prefetch(inputs[i - 1] + 64, 0, 3);
+            __builtin_prefetch(inputs[i - 1] + 128, 0, 3);
+            __builtin_prefetch(inputs[i - 1] + 192, 0, 3);
+        }
+
+        int first = (i == batch_size - 1);
+        fused_parity_page(inputs[i], parity_p, parity_q, first, folded);
+        sm3_tag_from_fold(midstate, folded, lbas ? lbas[i] : 0, outputs[i]);
+
+        // 校验页折叠结果由页折叠结果线性推导
+        uint64_t f[8];
+        memcpy(f, folded, sizeof(f));
+        for (int k = 0; k < 8; k++) {
+            fold_p[k] ^= f[k];
+            fold_q[k] = gf8_mul2_swar(fold_q[k]) ^ f[k];
+        }
+    }
+
+    sm3_tag_from_fold(midstate, (const uint8_t*)fold_p,
+                      parity_lbas ? parity_lbas[0] : 0, parity_tags);
+    if (parity_q) {
+        sm3_tag_from_fold(midstate, (const uint8_t*)fold_q,
+                          parity_lbas ? parity_lbas[1] : 0, parity_tags + 32);
+    }
+    return 0;
+}
+
+// ============================================================================
+// 掩码区域标签：排除页内校验和/LSN字段（无需拷贝清零）
+// ============================================================================
+/*
+ * 数据库页内嵌自己的校验和与LSN字段，原做法是拷贝整页、清零这些字段再计算标签。
+ * 掩码版本在折叠过程中直接用向量掩码屏蔽排除字节，不增加内存遍历：
+ *   - 未触及的行走普通行折叠内核
+ *   - 被完全排除的行直接跳过
+ *   - 部分排除的行与64字节掩码按位与后再异或
+ * 结果与"拷贝清零后计算"完全一致，支持4KB以外的页大小（64字节整数倍）。
+ *
+ * 预置特化：
+ *   - PostgreSQL 8KB：pd_lsn [0,8)、pd_checksum [8,10)
+ *   - InnoDB 16KB：FIL_PAGE_SPACE_OR_CHKSUM [0,4)、FIL_PAGE_LSN [16,24)、
+ *                  FIL_PAGE_END_LSN_OLD_CHKSUM [16376,16384)
+ */
+
+#define AES_SM3_MASK_MAX_RANGES   16
+#define AES_SM3_MASK_MAX_PAGE     65536
+
+// 部分排除行：acc ^= row & mask
+static inline void xor_masked_row(uint8_t* acc, const uint8_t* row, const uint8_t* mask) {
+#if defined(__ARM_FEATURE_CRYPTO) && defined(__aarch64__)
+    for (int i = 0; i < 64; i += 16) {
+        uint8x16_t v = vandq_u8(vld1q_u8(row + i), vld1q_u8(mask + i));
+        vst1q_u8(acc + i, veorq_u8(vld1q_u8(acc + i), v));
+    }
+#else
+    uint64_t a[8], r[8], m[8];
+    memcpy(a, acc, 64);
+    memcpy(r, row, 64);
+    memcpy(m, mask, 64);
+    for (int i = 0; i < 8; i++) {
+        a[i] ^= r[i] & m[i];
+    }
+    memcpy(acc, a, 64);
+#endif
+}
+
+static inline void xor_fold_into(uint8_t* acc, const uint8_t* input, size_t rows) {
+    uint8_t part[64] __attribute__((aligned(64)));
+    xor_fold_rows(input, rows, part);
+    uint64_t a[8], p[8];
+    memcpy(a, acc, 64);
+    memcpy(p, part, 64);
+    for (int i = 0; i < 8; i++) {
+        a[i] ^= p[i];
+    }
+    memcpy(acc, a, 64);
+}
+
+// 编译期掩码：只有首行/末行被部分排除（常见数据库页格式）
+static inline void fold_with_edge_masks(const uint8_t* input, size_t rows,
+                                        const uint8_t* first_mask, const uint8_t* last_mask,
+                                        uint8_t* folded) {
+    uint8_t acc[64] __attribute__((aligned(64)));
+    memset(acc, 0, sizeof(acc));
+
+    size_t begin = first_mask ? 1 : 0;
+    size_t end = last_mask ? rows - 1 : rows;
+
+    if (first_mask) {
+        xor_masked_row(acc, input, first_mask);
+    }
+    xor_fold_into(acc, input + begin * 64, end - begin);
+    if (last_mask) {
+        xor_masked_row(acc, input + (rows - 1) * 64, last_mask);
+    }
+
+    memcpy(folded, acc, 64);
+}
+
+// 运行期掩码：ranges为(offset, length)对，共range_count对
+// 返回0成功；页大小非64整数倍、超过上限、区间越界或区间过多返回-1
+int aes_sm3_integrity_masked(const uint32_t* midstate, uint64_t lba,
+                             const uint8_t* input, size_t page_size,
+                             const uint32_t* ranges, int range_count, uint8_t* output) {
+    if (page_size == 0 || page_size % 64 != 0 || page_size > AES_SM3_MASK_MAX_PAGE ||
+        range_count < 0 || range_count > AES_SM3_MASK_MAX_RANGES) {
+        return -1;
+    }
+
+    size_t rows = page_size / 64;
+    // 行状态：0=普通，1=完全排除，2+k=部分排除（使用第k个掩码）
+    uint8_t row_state[AES_SM3_MASK_MAX_PAGE / 64];
+    uint8_t masks[2 * AES_SM3_MASK_MAX_RANGES][64] __attribute__((aligned(64)));
+    int mask_count = 0;
+    memset(row_state, 0, rows);
+
+    for (int i = 0; i < range_count; i++) {
+        size_t offset = ranges[2 * i];
+        size_t len = ranges[2 * i + 1];
+        if (offset > page_size || len > page_size - offset) {
+            return -1;
+        }
+
+        while (len > 0) {
+            size_t row = offset / 64;
+            size_t lo = offset % 64;
+            size_t n = 64 - lo < len ? 64 - lo : len;
+
+            if (n == 64) {
+                row_state[row] = 1;
+            } else if (row_state[row] != 1) {
+                if (row_state[row] == 0) {
+                    memset(masks[mask_count], 0xFF, 64);
+                    row_state[row] = (uint8_t)(2 + mask_count++);
+                }
+                memset(masks[row_state[row] - 2] + lo, 0, n);
+            }
+
+            offset += n;
+            len -= n;
+        }
+    }
+
+    uint8_t acc[64] __attribute__((aligned(64)));
+    memset(acc, 0, sizeof(acc));
+
+    size_t r = 0;
+    while (r < rows) {
+        size_t e = r;
+        while (e < rows && row_state[e] == 0) {
+            e++;
+        }
+        if (e > r) {
+            xor_fold_into(acc, input + r * 64, e - r);
+        }
+        if (e < rows && row_state[e] >= 2) {
+            xor_masked_row(acc, input + e * 64, masks[row_state[e] - 2]);
+        }
+        r = e + 1;
+    }
+
+    sm3_tag_from_fold(midstate, acc, lba, output);
+    return 0;
+}
+
+// PostgreSQL 8KB页：排除pd_lsn与pd_checksum（首行字节0..9）
+void aes_sm3_integrity_8kb_pg(const uint32_t* midstate, uint64_t lba,
+                              const uint8_t* input, uint8_t* output) {
+    static const uint8_t first_mask[64] __attribute__((aligned(64))) = {
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+    };
+
+    uint8_t folded[64] __attribute__((aligned(64)));
+    fold_with_edge_masks(input, 8192 / 64, first_mask, NULL, folded);
+    sm3_tag_from_fold(midstate, folded, lba, output);
+}
+
+// InnoDB 16KB页：排除页头校验和、页头LSN与页尾（旧校验和+LSN低32位）
+void aes_sm3_integrity_16kb_innodb(const uint32_t* midstate, uint64_t lba,
+                                   const uint8_t* input, uint8_t* output) {
+    static const uint8_t first_mask[64] __attribute__((aligned(64))) = {
+        0, 0, 0, 0, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+    };
+    static const uint8_t last_mask[64] __attribute__((aligned(64))) = {
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0, 0, 0, 0, 0, 0, 0, 0
+    };
+
+    uint8_t folded[64] __attribute__((aligned(64)));
+    fold_with_edge_masks(input, 16384 / 64, first_mask, last_mask, folded);
+    sm3_tag_from_fold(midstate, folded, lba, output);
+}
+
+// ============================================================================
+// 已知标签过滤器：二元熔断过滤器（Binary Fuse 8）
+// ============================================================================
+/*
+ * 黄金镜像校验需要判断页标签是否属于5亿个已知标签，32字节标签的哈希集合放不进内存。
+ * 这里对截断标签（前8字节）构建3路二元熔断过滤器：
+ *   - 每个条目约9位（8位指纹 × ~1.125），假阳性率约1/256，无假阴性
+ *   - 查询固定访问3个字节，批量查询按距离预取，隐藏DRAM延迟
+ *   - 文件格式 = 64字节头 + 指纹数组，可直接mmap只读使用
+ * 构建算法参照 Graf & Lemire, "Binary Fuse Filters" (2022)。
+ */
+
+#define AES_SM3_FUSE_MAGIC        0x3845535546334D53ULL  // "SM3FUSE8"
+#define AES_SM3_FUSE_VERSION      1
+#define AES_SM3_FUSE_MAX_ITER     100
+#define AES_SM3_FUSE_PREFETCH     16
+
+typedef struct {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t seed;
+    uint64_t entry_count;
+    uint32_t segment_length;
+    uint32_t segment_length_mask;
+    uint32_t segment_count;
+    uint32_t reserved;
+    uint64_t segment_count_length;
+    uint64_t array_length;
+} aes_sm3_fuse_header_t;
+
+struct aes_sm3_tag_filter {
+    aes_sm3_fuse_header_t hdr;
+    const uint8_t* fingerprints;
+    uint8_t* owned;        // 内存构建时持有的指纹数组
+    void* map;             // mmap打开时的映射
+    size_t map_size;
+};
+
+typedef struct aes_sm3_tag_filter aes_sm3_tag_filter_t;
+
+// 单次查询的3个位置与指纹（先算位置并预取，稍后再比较）
+typedef struct {
+    uint64_t h0, h1, h2;
+    uint8_t fp;
+} fuse_probe_t;
+
+static inline uint64_t fuse_murmur64(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static inline uint64_t fuse_splitmix64(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t fuse_mulhi(uint64_t a, uint64_t b) {
+    return (uint64_t)(((__uint128_t)a * b) >> 64);
+}
+
+// 截断标签：前8字节（标签本身已均匀分布）
+static inline uint64_t fuse_tag_key(const uint8_t* tag) {
+    uint64_t key;
+    memcpy(&key, tag, sizeof(key));
+    return key;
+}
+
+static inline uint8_t fuse_fingerprint(uint64_t hash) {
+    return (uint8_t)(hash ^ (hash >> 32));
+}
+
+// 第index个位置（0..2）：段内偏移由哈希的不同比特段决定
+static inline uint64_t fuse_hash_at(const aes_sm3_fuse_header_t* h, int index, uint64_t hash) {
+    uint64_t pos = fuse_mulhi(hash, h->segment_count_length);
+    pos += (uint64_t)index * h->segment_length;
+    uint64_t hh = hash & ((1ULL << 36) - 1);
+    pos ^= (hh >> (36 - 18 * index)) & h->segment_length_mask;
+    return pos;
+}
+
+static inline void fuse_probe_prepare(const aes_sm3_tag_filter_t* f, const uint8_t* tag,
+                                      fuse_probe_t* p) {
+    uint64_t hash = fuse_murmur64(fuse_tag_key(tag) + f->hdr.seed);
+    p->fp = fuse_fingerprint(hash);
+    p->h0 = fuse_hash_at(&f->hdr, 0, hash);
+    p->h1 = fuse_hash_at(&f->hdr, 1, hash);
+    p->h2 = fuse_hash_at(&f->hdr, 2, hash);
+    __builtin_prefetch(f->fingerprints + p->h0, 0, 0);
+    __builtin_prefetch(f->fingerprints + p->h1, 0, 0);
+    __builtin_prefetch(f->fingerprints + p->h2, 0, 0);
+}
+
+static inline int fuse_probe_check(const aes_sm3_tag_filter_t* f, const fuse_probe_t* p) {
+    const uint8_t* fps = f->fingerprints;
+    return (uint8_t)(p->fp ^ fps[p->h0] ^ fps[p->h1] ^ fps[p->h2]) == 0;
+}
+
+// 按条目数确定段长度与数组长度（3路熔断图参数）
+static void fuse_layout(aes_sm3_fuse_header_t* h, uint64_t size) {
+    const uint32_t arity = 3;
+    uint32_t seg_len = size == 0 ? 4 : 1u << (int)floor(log((double)size) / log(3.33) + 2.25);
+    if (seg_len > 262144) {
+        seg_len = 262144;
+    }
+    double size_factor = size <= 1 ? 0 : fmax(1.125, 0.875 + 0.25 * log(1000000.0) / log((double)size));
+    uint64_t capacity = size <= 1 ? 0 : (uint64_t)round((double)size * size_factor);
+    uint64_t init_segments = (capacity + seg_len - 1) / seg_len;
+    init_segments = init_segments > arity - 1 ? init_segments - (arity - 1) : 0;
+    uint64_t array_len = (init_segments + arity - 1) * seg_len;
+    uint64_t seg_count = (array_len + seg_len - 1) / seg_len;
+    seg_count = seg_count <= arity - 1 ? 1 : seg_count - (arity - 1);
+
+    memset(h, 0, sizeof(*h));
+    h->magic = AES_SM3_FUSE_MAGIC;
+    h->version = AES_SM3_FUSE_VERSION;
+    h->header_size = sizeof(aes_sm3_fuse_header_t);
+    h->entry_count = size;
+    h->segment_length = seg_len;
+    h->segment_length_mask = seg_len - 1;
+    h->segment_count = (uint32_t)seg_count;
+    h->segment_count_length = seg_count * seg_len;
+    h->array_length = (seg_count + arity - 1) * seg_len;
+}
+
+static int fuse_cmp_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+// 剥离构建：keys会被去重改写；返回0成功
+static int fuse_populate(aes_sm3_fuse_header_t* h, uint8_t* fps, uint64_t* keys, uint64_t size) {
+    uint64_t capacity = h->array_length;
+    uint64_t* reverse_order = (uint64_t*)calloc(size + 1, sizeof(uint64_t));
+    uint8_t* reverse_h = (uint8_t*)malloc(size + 1);
+    uint64_t* alone = (uint64_t*)malloc((capacity + 1) * sizeof(uint64_t));
+    uint8_t* t2count = (uint8_t*)calloc(capacity + 1, 1);
+    uint64_t* t2hash = (uint64_t*)calloc(capacity + 1, sizeof(uint64_t));
+
+    uint32_t block_bits = 1;
+    while ((1ULL << block_bits) < h->segment_count) {
+        block_bits++;
+    }
+    uint64_t block = 1ULL << block_bits;
+    uint64_t* start_pos = (uint64_t*)malloc(block * sizeof(uint64_t));
+
+    int ret = -1;
+    if (!reverse_order || !reverse_h || !alone || !t2count || !t2hash || !start_pos) {
+        goto cleanup;
+    }
+
+    uint64_t rng = 0x726b2b9d438b9d4dULL;
+    h->seed = fuse_splitmix64(&rng);
+    reverse_order[size] = 1;
+
+    for (int loop = 0; loop < AES_SM3_FUSE_MAX_ITER; loop++) {
+        // 按哈希高位分桶，使同段的键相邻（提升剥离阶段的缓存命中）
+        for (uint64_t i = 0; i < block; i++) {
+            start_pos[i] = (uint64_t)(((__uint128_t)i * size) >> block_bits);
+        }
+        for (uint64_t i = 0; i < size; i++) {
+            uint64_t hash = fuse_murmur64(keys[i] + h->seed);
+            uint64_t seg = hash >> (64 - block_bits);
+            while (reverse_order[start_pos[seg]] != 0) {
+                seg = (seg + 1) & (block - 1);
+            }
+            reverse_order[start_pos[seg]] = hash;
+            start_pos[seg]++;
+        }
+
+        int error = 0;
+        uint64_t duplicates = 0;
+        for (uint64_t i = 0; i < size; i++) {
+            uint64_t hash = reverse_order[i];
+            uint64_t h0 = fuse_hash_at(h, 0, hash);
+            uint64_t h1 = fuse_hash_at(h, 1, hash);
+            uint64_t h2 = fuse_hash_at(h, 2, hash);
+            t2count[h0] += 4;
+            t2hash[h0] ^= hash;
+            t2count[h1] += 4;
+            t2count[h1] ^= 1;
+            t2hash[h1] ^= hash;
+            t2count[h2] += 4;
+            t2count[h2] ^= 2;
+            t2hash[h2] ^= hash;
+            // 重复键：两次XOR抵消，撤销第二次插入
+            if ((t2hash[h0] & t2hash[h1] & t2hash[h2]) == 0 &&
+                ((t2hash[h0] == 0 && t2count[h0] == 8) ||
+                 (t2hash[h1] == 0 && t2count[h1] == 8) ||
+                 (t2hash[h2] == 0 && t2count[h2] == 8))) {
+                duplicates++;
+                t2count[h0] -= 4;
+                t2hash[h0] ^= hash;
+                t2count[h1] -= 4;
+                t2count[h1] ^= 1;
+                t2hash[h1] ^= hash;
+                t2count[h2] -= 4;
+                t2count[h2] ^= 2;
+                t2hash[h2] ^= hash;
+            }
+            // 计数器（6位）溢出
+            error |= t2count[h0] < 4 || t2count[h1] < 4 || t2count[h2] < 4;
+        }
+
+        uint64_t stack_size = 0;
+        if (!error) {
+            uint64_t qsize = 0;
+            for (uint64_t i = 0; i < capacity; i++) {
+                alone[qsize] = i;
+                qsize += (t2count[i] >> 2) == 1;
+            }
+
+            while (qsize > 0) {
+                uint64_t index = alone[--qsize];
+                if ((t2count[index] >> 2) != 1) {
+                    continue;
+                }
+                uint64_t hash = t2hash[index];
+                uint8_t found = t2count[index] & 3;
+                reverse_h[stack_size] = found;
+                reverse_order[stack_size] = hash;
+                stack_size++;
+
+                uint64_t h012[5];
+                h012[0] = fuse_hash_at(h, 0, hash);
+                h012[1] = fuse_hash_at(h, 1, hash);
+                h012[2] = fuse_hash_at(h, 2, hash);
+                h012[3] = h012[0];
+                h012[4] = h012[1];
+
+                for (int k = 1; k <= 2; k++) {
+                    uint64_t other = h012[found + k];
+                    alone[qsize] = other;
+                    qsize += (t2count[other] >> 2) == 2;
+                    t2count[other] -= 4;
+                    t2count[other] ^= (uint8_t)((found + k) % 3);
+                    t2hash[other] ^= hash;
+                }
+            }
+
+            if (stack_size + duplicates == size) {
+                size = stack_size;
+                h->entry_count = size;
+                ret = 0;
+                break;
+            }
+        }
+
+        // 失败：存在重复键则先去重，换种子重试
+        if (duplicates > 0) {
+            qsort(keys, size, sizeof(uint64_t), fuse_cmp_u64);
+            uint64_t j = 0;
+            for (uint64_t i = 0; i < size; i++) {
+                if (j == 0 || keys[i] != keys[j - 1]) {
+                    keys[j++] = keys[i];
+                }
+            }
+            size = j;
+        }
+        memset(reverse_order, 0, size * sizeof(uint64_t));
+        reverse_order[size] = 1;
+        memset(t2count, 0, capacity);
+        memset(t2hash, 0, capacity * sizeof(uint64_t));
+        h->seed = fuse_splitmix64(&rng);
+    }
+
+    if (ret == 0) {
+        // 逆剥离顺序赋值：每个键的3个指纹XOR等于其指纹
+        for (uint64_t i = size; i-- > 0;) {
+            uint64_t hash = reverse_order[i];
+            uint8_t found = reverse_h[i];
+            uint64_t h012[5];
+            h012[0] = fuse_hash_at(h, 0, hash);
+            h012[1] = fuse_hash_at(h, 1, hash);
+            h012[2] = fuse_hash_at(h, 2, hash);
+            h012[3] = h012[0];
+            h012[4] = h012[1];
+            fps[h012[found]] = fuse_fingerprint(hash) ^ fps[h012[found + 1]] ^ fps[h012[found + 2]];
+        }
+    }
+
+cleanup:
+    free(reverse_order);
+    free(reverse_h);
+    free(alone);
+    free(t2count);
+    free(t2hash);
+    free(start_pos);
+    return ret;
+}
+
+// 由连续的32字节标签数组（清单）构建过滤器；失败返回NULL
+aes_sm3_tag_filter_t* aes_sm3_tag_filter_build(const uint8_t* tags, size_t count) {
+    aes_sm3_tag_filter_t* f = (aes_sm3_tag_filter_t*)calloc(1, sizeof(aes_sm3_tag_filter_t));
+    uint64_t* keys = (uint64_t*)malloc((count + 1) * sizeof(uint64_t));
+    if (!f || !keys) {
+        free(f);
+        free(keys);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        keys[i] = fuse_tag_key(tags + i * 32);
+    }
+
+    fuse_layout(&f->hdr, count);
+    f->owned = (uint8_t*)calloc(f->hdr.array_length + 1, 1);
+    if (!f->owned || fuse_populate(&f->hdr, f->owned, keys, count) != 0) {
+        free(f->owned);
+        free(f);
+        free(keys);
+        return NULL;
+    }
+    f->fingerprints = f->owned;
+
+    free(keys);
+    return f;
+}
+
+// 保存为 64字节头 + 指纹数组；返回0成功
+int aes_sm3_tag_filter_save(const aes_sm3_tag_filter_t* f, const char* path) {
+    FILE* fp = fopen(path, "wb");
+    if (!fp) {
+        return -1;
+    }
+    int ok = fwrite(&f->hdr, sizeof(f->hdr), 1, fp) == 1 &&
+             fwrite(f->fingerprints, 1, f->hdr.array_length, fp) == f->hdr.array_length;
+    return (fclose(fp) == 0 && ok) ? 0 : -1;
+}
+
+// 校验头中的几何参数：段长为2的幂、掩码与段长一致、数组恰好容纳segment_count + 2个段，
+// 保证fuse_hash_at算出的三个位置都落在指纹数组内
+static int fuse_header_valid(const aes_sm3_fuse_header_t* h, uint64_t avail) {
+    uint64_t seg_len = h->segment_length;
+    if (h->magic != AES_SM3_FUSE_MAGIC || h->version != AES_SM3_FUSE_VERSION ||
+        h->header_size != sizeof(aes_sm3_fuse_header_t) ||
+        seg_len == 0 || seg_len > 262144 || (seg_len & (seg_len - 1)) != 0 ||
+        h->segment_length_mask != seg_len - 1 || h->segment_count == 0) {
+        return 0;
+    }
+    // segment_count < 2^32、seg_len <= 2^18，乘积不会溢出
+    return h->segment_count_length == (uint64_t)h->segment_count * seg_len &&
+           h->array_length == ((uint64_t)h->segment_count + 2) * seg_len &&
+           h->array_length <= avail;
+}
+
+// mmap只读打开；头校验失败返回NULL
+aes_sm3_tag_filter_t* aes_sm3_tag_filter_open(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(aes_sm3_fuse_header_t)) {
+        close(fd);
+        return NULL;
+    }
+
+    void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+
+    const aes_sm3_fuse_header_t* hdr = (const aes_sm3_fuse_header_t*)map;
+    if (!fuse_header_valid(hdr, (uint64_t)st.st_size - sizeof(aes_sm3_fuse_header_t))) {
+        munmap(map, (size_t)st.st_size);
+        return NULL;
+    }
+
+    aes_sm3_tag_filter_t* f = (aes_sm3_tag_filter_t*)calloc(1, sizeof(aes_sm3_tag_filter_t));
+    if (!f) {
+        munmap(map, (size_t)st.st_size);
+        return NULL;
+    }
+    f->hdr = *hdr;
+    f->fingerprints = (const uint8_t*)map + sizeof(aes_sm3_fuse_header_t);
+    f->map = map;
+    f->map_size = (size_t)st.st_size;
+    madvise(map, f->map_size, MADV_RANDOM);
+    return f;
+}
+
+void aes_sm3_tag_filter_free(aes_sm3_tag_filter_t* f) {
+    if (!f) {
+        return;
+    }
+    if (f->map) {
+        munmap(f->map, f->map_size);
+    }
+    free(f->owned);
+    free(f);
+}
+
+// 每条目占用位数（约9）
+double aes_sm3_tag_filter_bits_per_entry(const aes_sm3_tag_filter_t* f) {
+    return f->hdr.entry_count ? 8.0 * (double)f->hdr.array_length / (double)f->hdr.entry_count : 0.0;
+}
+
+// 单个查询：1=可能已知（假阳性约1/256），0=一定未知
+int aes_sm3_tag_filter_contains(const aes_sm3_tag_filter_t* f, const uint8_t* tag) {
+    fuse_probe_t p;
+    fuse_probe_prepare(f, tag, &p);
+    return fuse_probe_check(f, &p);
+}
+
+// 批量查询：先计算位置并预取，AES_SM3_FUSE_PREFETCH个查询之后再比较
+// known_bitmap需 (count+63)/64 个字，第i位=1表示tags[i]已知
+void aes_sm3_tag_filter_query_batch(const aes_sm3_tag_filter_t* f, const uint8_t** tags,
+                                    int count, uint64_t* known_bitmap) {
+    fuse_probe_t ring[AES_SM3_FUSE_PREFETCH];
+    memset(known_bitmap, 0, (size_t)((count + 63) / 64) * sizeof(uint64_t));
+
+    for (int i = 0; i < count + AES_SM3_FUSE_PREFETCH; i++) {
+        int j = i - AES_SM3_FUSE_PREFETCH;
+        if (j >= 0 && fuse_probe_check(f, &ring[j % AES_SM3_FUSE_PREFETCH])) {
+            known_bitmap[j / 64] |= 1ULL << (j % 64);
+        }
+        if (i < count) {
+            fuse_probe_prepare(f, tags[i], &ring[i % AES_SM3_FUSE_PREFETCH]);
+        }
+    }
+}
+
+// 批量标签 + 已知判定：每页标签算完立即预取其过滤器位置，隔几页后再比较
+// outputs写入每页标签（与aes_sm3_integrity_256bit_domain一致），known_bitmap同上
+void aes_sm3_integrity_batch_known(const uint32_t* midstate, const uint64_t* lbas,
+                                   const uint8_t** inputs, uint8_t** outputs, int batch_size,
+                                   const aes_sm3_tag_filter_t* f, uint64_t* known_bitmap) {
+    const int delay = 4;  // 一页标签约需数百纳秒，延迟4页足以覆盖DRAM访问
+    fuse_probe_t ring[4];
+    memset(known_bitmap, 0, (size_t)((batch_size + 63) / 64) * sizeof(uint64_t));
+
+    for (int i = 0; i < batch_size + delay; i++) {
+        int j = i - delay;
+        if (j >= 0 && fuse_probe_check(f, &ring[j % delay])) {
+            known_bitmap[j / 64] |= 1ULL << (j % 64);
+        }
+        if (i < batch_size) {
+            if (i + 1 < batch_size) {
+                __builtin_prefetch(inputs[i + 1], 0, 3);
+                __builtin_prefetch(inputs[i + 1] + 64, 0, 3);
+            }
+            aes_sm3_integrity_256bit_domain(midstate, lbas ? lbas[i] : 0, inputs[i], outputs[i]);
+            fuse_probe_prepare(f, outputs[i], &ring[i % delay]);
+        }
+    }
+}
+
+// ============================================================================
+// 精确标签索引：静态隐式B+树（64字节节点）+ 批量预取查找
+// ============================================================================
+/*
+ * 标签 → 块位置的精确查找需要覆盖数十亿条目。有序数组二分每层一次缓存未命中，
+ * 这里构建静态隐式B+树：
+ *   - 叶层就是按截断标签（前8字节）排序后的键数组，每8个键一个64字节节点
+ *   - 内部节点8个键 = 8个子节点各自的最大键，子节点下标 = node*8 + i，无指针
+ *   - 节点内比较无分支（统计小于目标的键个数），每层恰好访问1条缓存行
+ *   - 批量查找按层交错处理一组查询，每步为下一层节点发出预取，隐藏DRAM延迟
+ *   - 叶层命中后用完整32字节标签确认；相同标签的多个位置在排序后连续，返回区间
+ * 文件格式 = 256字节头 + 节点数组 + 排序后标签数组 + 位置数组，可直接mmap。
+ * 两个索引都按（截断键, 完整标签）排序，可做批量归并连接。
+ */
+
+#define AES_SM3_TIDX_MAGIC        0x3158444954334D53ULL  // "SM3TIDX1"
+#define AES_SM3_TIDX_VERSION      1
+#define AES_SM3_TIDX_MAX_LEVELS   12                     // 8^12 ≈ 6.9e10 条目
+#define AES_SM3_TIDX_GROUP        16
+
+typedef struct {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t entry_count;
+    uint32_t level_count;                             // 层0为根，最后一层为叶
+    uint32_t reserved;
+    uint64_t total_nodes;
+    uint64_t level_offset[AES_SM3_TIDX_MAX_LEVELS];   // 各层首节点下标
+    uint64_t level_nodes[AES_SM3_TIDX_MAX_LEVELS];    // 各层节点数
+    uint64_t pad[3];
+} aes_sm3_tidx_header_t;
+
+struct aes_sm3_tag_index {
+    const aes_sm3_tidx_header_t* hdr;
+    const uint64_t* tree;        // 全部节点，每节点8个键
+    const uint64_t* keys;        // 叶层 = 排序后的截断键
+    const uint8_t* tags;         // 排序后的完整标签
+    const uint64_t* locations;   // 与标签对应的块位置
+    void* base;
+    size_t size;
+    int mapped;
+};
+
+typedef struct aes_sm3_tag_index aes_sm3_tag_index_t;
+
+// 归并连接回调：两个索引中同一标签的条目区间
+typedef void (*aes_sm3_tag_join_fn)(void* ctx, size_t a_first, size_t a_count,
+                                    size_t b_first, size_t b_count);
+
+typedef struct {
+    uint64_t key;
+    uint8_t tag[32];
+    uint64_t location;
+} tag_index_record_t;
+
+static inline int tag_index_cmp(uint64_t ka, const uint8_t* ta, uint64_t kb, const uint8_t* tb) {
+    if (ka != kb) {
+        return ka < kb ? -1 : 1;
+    }
+    return memcmp(ta, tb, 32);
+}
+
+static int tag_index_record_cmp(const void* a, const void* b) {
+    const tag_index_record_t* x = (const tag_index_record_t*)a;
+    const tag_index_record_t* y = (const tag_index_record_t*)b;
+    return tag_index_cmp(x->key, x->tag, y->key, y->tag);
+}
+
+// 节点内首个 >= key 的位置（8个有序键中小于key的个数，无分支）
+static inline size_t tag_index_node_rank(const uint64_t* node, uint64_t key) {
+#if defined(__ARM_FEATURE_CRYPTO) && defined(__aarch64__)
+    uint64x2_t k = vdupq_n_u64(key);
+    uint64x2_t c0 = vcltq_u64(vld1q_u64(node), k);
+    uint64x2_t c1 = vcltq_u64(vld1q_u64(node + 2), k);
+    uint64x2_t c2 = vcltq_u64(vld1q_u64(node + 4), k);
+    uint64x2_t c3 = vcltq_u64(vld1q_u64(node + 6), k);
+    // 比较结果为全1（即-1），求和取负得到个数
+    uint64x2_t s = vaddq_u64(vaddq_u64(c0, c1), vaddq_u64(c2, c3));
+    return (size_t)(0 - vaddvq_u64(s));
+#else
+    size_t n = 0;
+    for (int i = 0; i < 8; i++) {
+        n += node[i] < key;
+    }
+    return n;
+#endif
+}
+
+// 绑定内存布局（构建缓冲区或mmap文件），校验失败返回-1
+static int tag_index_bind(aes_sm3_tag_index_t* idx, void* base, size_t size) {
+    const aes_sm3_tidx_header_t* hdr = (const aes_sm3_tidx_header_t*)base;
+    if (size < sizeof(*hdr) || hdr->magic != AES_SM3_TIDX_MAGIC ||
+        hdr->version != AES_SM3_TIDX_VERSION || hdr->header_size != sizeof(*hdr) ||
+        hdr->level_count == 0 || hdr->level_count > AES_SM3_TIDX_MAX_LEVELS) {
+        return -1;
+    }
+    // 节点数组与条目数组必须在文件内（先除后比，避免乘法溢出）
+    size_t avail = size - sizeof(*hdr);
+    if (hdr->total_nodes > avail / 64 || hdr->entry_count > (avail - hdr->total_nodes * 64) / 40) {
+        return -1;
+    }
+    // 每层都在节点数组内；叶层足以容纳全部条目的键
+    for (uint32_t l = 0; l < hdr->level_count; l++) {
+        if (hdr->level_nodes[l] == 0 || hdr->level_offset[l] > hdr->total_nodes ||
+            hdr->level_nodes[l] > hdr->total_nodes - hdr->level_offset[l]) {
+            return -1;
+        }
+    }
+    if (hdr->entry_count > hdr->level_nodes[hdr->level_count - 1] * 8) {
+        return -1;
+    }
+
+    idx->hdr = hdr;
+    idx->tree = (const uint64_t*)((const uint8_t*)base + sizeof(*hdr));
+    idx->keys = idx->tree + hdr->level_offset[hdr->level_count - 1] * 8;
+    idx->tags = (const uint8_t*)(idx->tree + hdr->total_nodes * 8);
+    idx->locations = (const uint64_t*)(idx->tags + hdr->entry_count * 32);
+    idx->base = base;
+    idx->size = size;
+    return 0;
+}
+
+// 由标签数组与对应块位置构建索引（同一标签可出现多次）；失败返回NULL
+aes_sm3_tag_index_t* aes_sm3_tag_index_build(const uint8_t* tags, const uint64_t* locations,
+                                             size_t count) {
+    tag_index_record_t* recs = (tag_index_record_t*)malloc((count + 1) * sizeof(tag_index_record_t));
+    if (!recs) {
+        return NULL;
+    }
+    for (size_t i = 0; i < count; i++) {
+        memcpy(&recs[i].key, tags + i * 32, 8);
+        memcpy(recs[i].tag, tags + i * 32, 32);
+        recs[i].location = locations[i];
+    }
+    qsort(recs, count, sizeof(tag_index_record_t), tag_index_record_cmp);
+
+    // 自底向上确定各层节点数
+    uint64_t nodes[AES_SM3_TIDX_MAX_LEVELS];
+    uint32_t levels = 0;
+    uint64_t m = count == 0 ? 1 : (count + 7) / 8;
+    for (;;) {
+        if (levels == AES_SM3_TIDX_MAX_LEVELS) {
+            free(recs);
+            return NULL;
+        }
+        nodes[levels++] = m;
+        if (m == 1) {
+            break;
+        }
+        m = (m + 7) / 8;
+    }
+
+    aes_sm3_tidx_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = AES_SM3_TIDX_MAGIC;
+    hdr.version = AES_SM3_TIDX_VERSION;
+    hdr.header_size = sizeof(hdr);
+    hdr.entry_count = count;
+    hdr.level_count = levels;
+    for (uint32_t l = 0; l < levels; l++) {
+        hdr.level_nodes[l] = nodes[levels - 1 - l];
+        hdr.level_offset[l] = hdr.total_nodes;
+        hdr.total_nodes += hdr.level_nodes[l];
+    }
+
+    size_t size = sizeof(hdr) + hdr.total_nodes * 64 + count * 40;
+    size_t alloc_size = (size + 63) & ~(size_t)63;
+    uint8_t* base = (uint8_t*)aligned_alloc(64, alloc_size);
+    aes_sm3_tag_index_t* idx = (aes_sm3_tag_index_t*)calloc(1, sizeof(aes_sm3_tag_index_t));
+    if (!base || !idx) {
+        free(base);
+        free(idx);
+        free(recs);
+        return NULL;
+    }
+    memcpy(base, &hdr, sizeof(hdr));
+    tag_index_bind(idx, base, size);
+
+    uint64_t* tree = (uint64_t*)idx->tree;
+    uint8_t* out_tags = (uint8_t*)idx->tags;
+    uint64_t* out_locs = (uint64_t*)idx->locations;
+
+    // 叶层：排序后的键，末尾补UINT64_MAX
+    uint64_t* leaf = tree + hdr.level_offset[levels - 1] * 8;
+    for (uint64_t i = 0; i < hdr.level_nodes[levels - 1] * 8; i++) {
+        leaf[i] = i < count ? recs[i].key : UINT64_MAX;
+    }
+    for (size_t i = 0; i < count; i++) {
+        memcpy(out_tags + i * 32, recs[i].tag, 32);
+        out_locs[i] = recs[i].location;
+    }
+
+    // 内部层：每个键为对应子节点的最大键（子节点有序，即最后一个键）
+    for (int l = (int)levels - 2; l >= 0; l--) {
+        uint64_t* level = tree + hdr.level_offset[l] * 8;
+        const uint64_t* below = tree + hdr.level_offset[l + 1] * 8;
+        for (uint64_t j = 0; j < hdr.level_nodes[l] * 8; j++) {
+            level[j] = j < hdr.level_nodes[l + 1] ? below[j * 8 + 7] : UINT64_MAX;
+        }
+    }
+
+    free(recs);
+    return idx;
+}
+
+// 保存索引（构建缓冲区原样写出）；返回0成功
+int aes_sm3_tag_index_save(const aes_sm3_tag_index_t* idx, const char* path) {
+    FILE* fp = fopen(path, "wb");
+    if (!fp) {
+        return -1;
+    }
+    int ok = fwrite(idx->base, 1, idx->size, fp) == idx->size;
+    return (fclose(fp) == 0 && ok) ? 0 : -1;
+}
+
+// mmap只读打开；校验失败返回NULL
+aes_sm3_tag_index_t* aes_sm3_tag_index_open(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+    void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+
+    aes_sm3_tag_index_t* idx = (aes_sm3_tag_index_t*)calloc(1, sizeof(aes_sm3_tag_index_t));
+    if (!idx || tag_index_bind(idx, map, (size_t)st.st_size) != 0) {
+        free(idx);
+        munmap(map, (size_t)st.st_size);
+        return NULL;
+    }
+    idx->mapped = 1;
+    madvise(map, idx->size, MADV_RANDOM);
+    return idx;
+}
+
+void aes_sm3_tag_index_free(aes_sm3_tag_index_t* idx) {
+    if (!idx) {
+        return;
+    }
+    if (idx->mapped) {
+        munmap(idx->base, idx->size);
+    } else {
+        free(idx->base);
+    }
+    free(idx);
+}
+
+size_t aes_sm3_tag_index_count(const aes_sm3_tag_index_t* idx) {
+    return idx->hdr->entry_count;
+}
+
+const uint8_t* aes_sm3_tag_index_tag(const aes_sm3_tag_index_t* idx, size_t i) {
+    return idx->tags + i * 32;
+}
+
+uint64_t aes_sm3_tag_index_location(const aes_sm3_tag_index_t* idx, size_t i) {
+    return idx->locations[i];
+}
+
+// 叶层命中后用完整标签确认，返回匹配条目数，*first为首个匹配下标
+static size_t tag_index_match(const aes_sm3_tag_index_t* idx, size_t rank, uint64_t key,
+                              const uint8_t* tag, size_t* first) {
+    size_t n = idx->hdr->entry_count;
+    *first = n;
+    while (rank < n && idx->keys[rank] == key) {
+        int c = memcmp(idx->tags + rank * 32, tag, 32);
+        if (c == 0) {
+            size_t end = rank + 1;
+            while (end < n && memcmp(idx->tags + end * 32, tag, 32) == 0) {
+                end++;
+            }
+            *first = rank;
+            return end - rank;
+        }
+        if (c > 0) {
+            break;
+        }
+        rank++;
+    }
+    return 0;
+}
+
+// 单个查找：返回匹配条目数（0表示不存在），位置为 location(first .. first+count-1)
+size_t aes_sm3_tag_index_lookup(const aes_sm3_tag_index_t* idx, const uint8_t* tag, size_t* first) {
+    const aes_sm3_tidx_header_t* h = idx->hdr;
+    uint64_t key;
+    memcpy(&key, tag, 8);
+
+    size_t node = 0;
+    size_t rank = h->entry_count;
+    for (uint32_t l = 0; l < h->level_count; l++) {
+        size_t i = tag_index_node_rank(idx->tree + (h->level_offset[l] + node) * 8, key);
+        if (l + 1 == h->level_count) {
+            rank = node * 8 + i;
+        } else if (i == 8 || node * 8 + i >= h->level_nodes[l + 1]) {
+            break;  // 大于全部键
+        } else {
+            node = node * 8 + i;
+        }
+    }
+    return tag_index_match(idx, rank, key, tag, first);
+}
+
+// 批量查找：一组查询按层交错推进，每步为下一层节点发出预取
+void aes_sm3_tag_index_lookup_batch(const aes_sm3_tag_index_t* idx, const uint8_t** tags,
+                                    int count, size_t* firsts, size_t* counts) {
+    const aes_sm3_tidx_header_t* h = idx->hdr;
+    uint64_t keys[AES_SM3_TIDX_GROUP];
+    size_t node[AES_SM3_TIDX_GROUP];
+    size_t rank[AES_SM3_TIDX_GROUP];
+    int alive[AES_SM3_TIDX_GROUP];
+
+    for (int g = 0; g < count; g += AES_SM3_TIDX_GROUP) {
+        int m = count - g < AES_SM3_TIDX_GROUP ? count - g : AES_SM3_TIDX_GROUP;
+        for (int q = 0; q < m; q++) {
+            memcpy(&keys[q], tags[g + q], 8);
+            node[q] = 0;
+            rank[q] = h->entry_count;
+            alive[q] = 1;
+        }
+
+        for (uint32_t l = 0; l < h->level_count; l++) {
+            int leaf = (l + 1 == h->level_count);
+            for (int q = 0; q < m; q++) {
+                if (!alive[q]) {
+                    continue;
+                }
+                size_t i = tag_index_node_rank(idx->tree + (h->level_offset[l] + node[q]) * 8, keys[q]);
+                if (leaf) {
+                    rank[q] = node[q] * 8 + i;
+                    if (rank[q] < h->entry_count) {
+                        __builtin_prefetch(idx->tags + rank[q] * 32, 0, 0);
+                    }
+                } else if (i == 8 || node[q] * 8 + i >= h->level_nodes[l + 1]) {
+                    alive[q] = 0;
+                } else {
+                    node[q] = node[q] * 8 + i;
+                    __builtin_prefetch(idx->tree + (h->level_offset[l + 1] + node[q]) * 8, 0, 0);
+                }
+            }
+        }
+
+        for (int q = 0; q < m; q++) {
+            counts[g + q] = tag_index_match(idx, rank[q], keys[q], tags[g + q], &firsts[g + q]);
+        }
+    }
+}
+
+// 归并连接两个索引（均按截断键+完整标签排序），对每个共同标签回调一次
+// 返回共同标签个数
+size_t aes_sm3_tag_index_merge_join(const aes_sm3_tag_index_t* a, const aes_sm3_tag_index_t* b,
+                                    aes_sm3_tag_join_fn fn, void* ctx) {
+    size_t na = a->hdr->entry_count, nb = b->hdr->entry_count;
+    size_t i = 0, j = 0, matched = 0;
+
+    while (i < na && j < nb) {
+        __builtin_prefetch(a->tags + (i + 16) * 32, 0, 0);
+        __builtin_prefetch(b->tags + (j + 16) * 32, 0, 0);
+
+        int c = tag_index_cmp(a->keys[i], a->tags + i * 32, b->keys[j], b->tags + j * 32);
+        if (c < 0) {
+            i++;
+        } else if (c > 0) {
+            j++;
+        } else {
+            size_t ie = i + 1, je = j + 1;
+            while (ie < na && memcmp(a->tags + ie * 32, a->tags + i * 32, 32) == 0) {
+                ie++;
+            }
+            while (je < nb && memcmp(b->tags + je * 32, b->tags + j * 32, 32) == 0) {
+                je++;
+            }
+            if (fn) {
+                fn(ctx, i, ie - i, j, je - j);
+            }
+            matched++;
+            i = ie;
+            j = je;
+        }
+    }
+    return matched;
+}
+
+// ============================================================================
+// 标签清单与增量同步：由两侧清单计算差异页，只传输/写入变化的4KB块
+// ============================================================================
+/*
+ * 清单（manifest）= 128字节头 + 每页32字节标签（第p页以p为LBA调整值，末页不足4KB补零）。
+ * 同步流程中每一侧的数据只哈希一次：
+ *   1. 两侧各自生成清单（aes_sm3_manifest_build_file）
+ *   2. diff：逐页比较标签，得到目标侧需要改写的页区间
+ *   3. delta：只从源文件读取差异页，写出 区间 + 页标签 + 页数据
+ *   4. patch：目标侧逐页校验标签后写入，最后按源文件长度截断
+ * 两个清单必须使用同一midstate（同一域），否则比较没有意义。
+ * 当前清单只有一层页标签，没有Merkle上层节点，diff直接比较页标签数组。
+ */
+
+#define AES_SM3_MANIFEST_MAGIC    0x314E414D334D53ULL    // "SM3MAN1"
+#define AES_SM3_DELTA_MAGIC       0x31544C44334D53ULL    // "SM3DLT1"
+#define AES_SM3_SYNC_VERSION      1
+#define AES_SM3_SYNC_CHUNK_PAGES  64
+
+typedef struct {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t file_size;
+    uint64_t page_count;
+    uint32_t page_size;
+    uint32_t flags;
+    uint32_t midstate[8];
+    uint64_t reserved[7];
+} aes_sm3_manifest_header_t;
+
+struct aes_sm3_manifest {
+    const aes_sm3_manifest_header_t* hdr;
+    const uint8_t* tags;
+    void* base;
+    size_t size;
+    int mapped;
+};
+
+typedef struct aes_sm3_manifest aes_sm3_manifest_t;
+
+typedef struct {
+    uint64_t first_page;
+    uint64_t page_count;
+} aes_sm3_page_range_t;
+
+typedef struct {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t target_size;
+    uint64_t range_count;
+    uint32_t page_size;
+    uint32_t flags;
+    uint32_t midstate[8];
+} aes_sm3_delta_header_t;
+
+// 32字节标签相等比较
+static inline int tag_equal(const uint8_t* a, const uint8_t* b) {
+#if defined(__ARM_FEATURE_CRYPTO) && defined(__aarch64__)
+    uint8x16_t d = vorrq_u8(veorq_u8(vld1q_u8(a), vld1q_u8(b)),
+                            veorq_u8(vld1q_u8(a + 16), vld1q_u8(b + 16)));
+    return vmaxvq_u8(d) == 0;
+#else
+    uint64_t x[4], y[4];
+    memcpy(x, a, 32);
+    memcpy(y, b, 32);
+    return ((x[0] ^ y[0]) | (x[1] ^ y[1]) | (x[2] ^ y[2]) | (x[3] ^ y[3])) == 0;
+#endif
+}
+
+// 首个不同标签的下标（全部相同返回n）：每次比较8个标签（256字节），相同区域整块跳过
+static inline size_t tag_first_mismatch(const uint8_t* a, const uint8_t* b, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const uint8_t* x = a + i * 32;
+        const uint8_t* y = b + i * 32;
+        __builtin_prefetch(x + 1024, 0, 0);
+        __builtin_prefetch(y + 1024, 0, 0);
+#if defined(__ARM_FEATURE_CRYPTO) && defined(__aarch64__)
+        uint8x16_t d0 = veorq_u8(vld1q_u8(x), vld1q_u8(y));
+        uint8x16_t d1 = veorq_u8(vld1q_u8(x + 16), vld1q_u8(y + 16));
+        for (int k = 32; k < 256; k += 32) {
+            d0 = vorrq_u8(d0, veorq_u8(vld1q_u8(x + k), vld1q_u8(y + k)));
+            d1 = vorrq_u8(d1, veorq_u8(vld1q_u8(x + k + 16), vld1q_u8(y + k + 16)));
+        }
+        if (vmaxvq_u8(vorrq_u8(d0, d1)) != 0) {
+            break;
+        }
+#else
+        uint64_t xa[32], ya[32], d = 0;
+        memcpy(xa, x, 256);
+        memcpy(ya, y, 256);
+        for (int k = 0; k < 32; k++) {
+            d |= xa[k] ^ ya[k];
+        }
+        if (d != 0) {
+            break;
+        }
+#endif
+    }
+    while (i < n && tag_equal(a + i * 32, b + i * 32)) {
+        i++;
+    }
+    return i;
+}
+
+// 对连续数据逐页计算标签（第p页调整值为first_page+p，末页补零）
+static void sync_tag_pages(const uint32_t* midstate, const uint8_t* data, size_t size,
+                           uint64_t first_page, uint8_t* tags) {
+    size_t full = size / 4096;
+    const uint8_t* inputs[AES_SM3_SYNC_CHUNK_PAGES];
+    uint8_t* outputs[AES_SM3_SYNC_CHUNK_PAGES];
+    uint64_t lbas[AES_SM3_SYNC_CHUNK_PAGES];
+
+    for (size_t p = 0; p < full; p += AES_SM3_SYNC_CHUNK_PAGES) {
+        int n = (int)(full - p < AES_SM3_SYNC_CHUNK_PAGES ? full - p : AES_SM3_SYNC_CHUNK_PAGES);
+        for (int i = 0; i < n; i++) {
+            inputs[i] = data + (p + i) * 4096;
+            outputs[i] = tags + (p + i) * 32;
+            lbas[i] = first_page + p + i;
+        }
+        aes_sm3_integrity_batch_domain(midstate, lbas, inputs, outputs, n);
+    }
+
+    if (size % 4096) {
+        uint8_t tail[4096] __attribute__((aligned(64)));
+        memset(tail, 0, sizeof(tail));
+        memcpy(tail, data + full * 4096, size % 4096);
+        aes_sm3_integrity_256bit_domain(midstate, first_page + full, tail, tags + full * 32);
+    }
+}
+
+static int manifest_bind(aes_sm3_manifest_t* m, void* base, size_t size) {
+    const aes_sm3_manifest_header_t* hdr = (const aes_sm3_manifest_header_t*)base;
+    if (size < sizeof(*hdr) || hdr->magic != AES_SM3_MANIFEST_MAGIC ||
+        hdr->version != AES_SM3_SYNC_VERSION || hdr->header_size != sizeof(*hdr) ||
+        hdr->page_size != 4096 || hdr->page_count != (hdr->file_size + 4095) / 4096 ||
+        hdr->page_count > (size - sizeof(*hdr)) / 32) {
+        return -1;
+    }
+    m->hdr = hdr;
+    m->tags = (const uint8_t*)base + sizeof(*hdr);
+    m->base = base;
+    m->size = size;
+    return 0;
+}
+
+// 由内存数据生成清单；midstate为NULL时使用默认域
+// 分配清单并填写头部，标签区由调用方填写
+static aes_sm3_manifest_t* manifest_alloc(const uint32_t* midstate, size_t size) {
+    uint64_t pages = (size + 4095) / 4096;
+    size_t total = sizeof(aes_sm3_manifest_header_t) + pages * 32;
+    uint8_t* base = (uint8_t*)aligned_alloc(64, (total + 63) & ~(size_t)63);
+    aes_sm3_manifest_t* m = (aes_sm3_manifest_t*)calloc(1, sizeof(aes_sm3_manifest_t));
+    if (!base || !m) {
+        free(base);
+        free(m);
+        return NULL;
+    }
+
+    aes_sm3_manifest_header_t* hdr = (aes_sm3_manifest_header_t*)base;
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->magic = AES_SM3_MANIFEST_MAGIC;
+    hdr->version = AES_SM3_SYNC_VERSION;
+    hdr->header_size = sizeof(*hdr);
+    hdr->file_size = size;
+    hdr->page_count = pages;
+    hdr->page_size = 4096;
+    memcpy(hdr->midstate, midstate ? midstate : SM3_IV, sizeof(hdr->midstate));
+    manifest_bind(m, base, total);
+    return m;
+}
+
+aes_sm3_manifest_t* aes_sm3_manifest_build(const uint32_t* midstate, const uint8_t* data, size_t size) {
+    aes_sm3_manifest_t* m = manifest_alloc(midstate, size);
+    if (m) {
+        sync_tag_pages(m->hdr->midstate, data, size, 0, (uint8_t*)m->tags);
+    }
+    return m;
+}
+
+// 由文件生成清单（mmap顺序读取，每字节只哈希一次）
+aes_sm3_manifest_t* aes_sm3_manifest_build_file(const uint32_t* midstate, const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+
+    size_t size = (size_t)st.st_size;
+    const uint8_t* data = NULL;
+    if (size > 0) {
+        void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            close(fd);
+            return NULL;
+        }
+        madvise(map, size, MADV_SEQUENTIAL);
+        data = (const uint8_t*)map;
+    }
+    close(fd);
+
+    aes_sm3_manifest_t* m = aes_sm3_manifest_build(midstate, data, size);
+    if (size > 0) {
+        munmap((void*)data, size);
+    }
+    return m;
+}
+
+int aes_sm3_manifest_save(const aes_sm3_manifest_t* m, const char* path) {
+    FILE* fp = fopen(path, "wb");
+    if (!fp) {
+        return -1;
+    }
+    int ok = fwrite(m->base, 1, m->size, fp) == m->size;
+    return (fclose(fp) == 0 && ok) ? 0 : -1;
+}
+
+// mmap只读打开清单；校验失败返回NULL
+aes_sm3_manifest_t* aes_sm3_manifest_open(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(aes_sm3_manifest_header_t)) {
+        close(fd);
+        return NULL;
+    }
+    void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+
+    aes_sm3_manifest_t* m = (aes_sm3_manifest_t*)calloc(1, sizeof(aes_sm3_manifest_t));
+    if (!m || manifest_bind(m, map, (size_t)st.st_size) != 0) {
+        free(m);
+        munmap(map, (size_t)st.st_size);
+        return NULL;
+    }
+    m->mapped = 1;
+    madvise(map, m->size, MADV_SEQUENTIAL);
+    return m;
+}
+
+void aes_sm3_manifest_free(aes_sm3_manifest_t* m) {
+    if (!m) {
+        return;
+    }
+    if (m->mapped) {
+        munmap(m->base, m->size);
+    } else {
+        free(m->base);
+    }
+    free(m);
+}
+
+uint64_t aes_sm3_manifest_page_count(const aes_sm3_manifest_t* m) {
+    return m->hdr->page_count;
+}
+
+uint64_t aes_sm3_manifest_file_size(const aes_sm3_manifest_t* m) {
+    return m->hdr->file_size;
+}
+
+const uint8_t* aes_sm3_manifest_tag(const aes_sm3_manifest_t* m, uint64_t page) {
+    return m->tags + page * 32;
+}
+
+#define AES_SM3_DIFF_DOMAIN       (-1)     // 两个清单的域不同
+#define AES_SM3_DIFF_NOMEM        (-2)     // 区间数组扩容失败
+
+// 扫描差异区间：相同区域按块跳过，只在不同标签处逐个比较
+// *ranges可为NULL（仅计数）；grow非0时按需realloc扩容，否则最多写入*cap个
+// 返回区间数，或AES_SM3_DIFF_DOMAIN / AES_SM3_DIFF_NOMEM
+static int64_t manifest_diff_scan(const aes_sm3_manifest_t* src, const aes_sm3_manifest_t* dst,
+                                  aes_sm3_page_range_t** ranges, size_t* cap, int grow) {
+    if (memcmp(src->hdr->midstate, dst->hdr->midstate, sizeof(src->hdr->midstate)) != 0) {
+        return AES_SM3_DIFF_DOMAIN;
+    }
+
+    uint64_t n = src->hdr->page_count;
+    uint64_t common = n < dst->hdr->page_count ? n : dst->hdr->page_count;
+    int64_t count = 0;
+    uint64_t p = 0;
+
+    while (p < n) {
+        uint64_t start, end;
+        if (p < common) {
+            p += tag_first_mismatch(src->tags + p * 32, dst->tags + p * 32, common - p);
+            if (p == common) {
+                continue;
+            }
+            start = p;
+            while (p < common && !tag_equal(src->tags + p * 32, dst->tags + p * 32)) {
+                p++;
+            }
+            // 目标侧较短时，与尾部新增页合并为一个区间
+            end = p == common ? n : p;
+        } else {
+            start = common;
+            end = n;
+        }
+        p = end;
+
+        if (grow && (size_t)count == *cap) {
+            size_t new_cap = *cap ? *cap * 2 : 16;
+            aes_sm3_page_range_t* r = (aes_sm3_page_range_t*)realloc(*ranges, new_cap * sizeof(**ranges));
+            if (!r) {
+                return AES_SM3_DIFF_NOMEM;           // 不能返回-1：调用方会当作域不同
+            }
+            *ranges = r;
+            *cap = new_cap;
+        }
+        if (*ranges && (size_t)count < *cap) {
+            (*ranges)[count].first_page = start;
+            (*ranges)[count].page_count = end - start;
+        }
+        count++;
+    }
+    return count;
+}
+
+// 目标侧需要改写的页区间：源页标签不同，或目标侧没有该页
+// 最多写入max_ranges个区间，返回区间总数（可能大于max_ranges）；域不同返回AES_SM3_DIFF_DOMAIN(-1)
+int64_t aes_sm3_manifest_diff(const aes_sm3_manifest_t* src, const aes_sm3_manifest_t* dst,
+                              aes_sm3_page_range_t* ranges, size_t max_ranges) {
+    return manifest_diff_scan(src, dst, &ranges, &max_ranges, 0);
+}
+
+// 新清单相对旧清单的变化区间（扩容版本，供比较引擎与监视模式使用）：
+// 除标签不同与新增的页外，旧清单多出的页（文件变短）作为区间 [新页数, 旧页数) 报告；
+// 页数相同但文件长度不同（尾页补零后标签可能相同）时报告尾页，保证头部变化不会被当作无变化
+static int64_t manifest_change_scan(const aes_sm3_manifest_t* new_m, const aes_sm3_manifest_t* old_m,
+                                    aes_sm3_page_range_t** ranges, size_t* cap) {
+    int64_t count = manifest_diff_scan(new_m, old_m, ranges, cap, 1);
+    if (count < 0) {
+        return count;
+    }
+    uint64_t new_pages = new_m->hdr->page_count, old_pages = old_m->hdr->page_count;
+    uint64_t last_end = count > 0 ? (*ranges)[count - 1].first_page + (*ranges)[count - 1].page_count : 0;
+    uint64_t first, end;
+    if (old_pages > new_pages) {
+        first = new_pages;
+        end = old_pages;
+    } else if (new_m->hdr->file_size != old_m->hdr->file_size && new_pages > 0 && last_end < new_pages) {
+        first = new_pages - 1;
+        end = new_pages;
+    } else {
+        return count;
+    }
+
+    if (count > 0 && last_end == first) {
+        (*ranges)[count - 1].page_count += end - first;     // 与尾部的变化区间相连
+        return count;
+    }
+    if ((size_t)count == *cap) {
+        size_t new_cap = *cap ? *cap * 2 : 16;
+        aes_sm3_page_range_t* r = (aes_sm3_page_range_t*)realloc(*ranges, new_cap * sizeof(**ranges));
+        if (!r) {
+            return AES_SM3_DIFF_NOMEM;
+        }
+        *ranges = r;
+        *cap = new_cap;
+    }
+    (*ranges)[count].first_page = first;
+    (*ranges)[count].page_count = end - first;
+    return count + 1;
+}
+
+// 生成增量：只从源文件读取差异页，写出 头 + [区间, 页标签, 页数据]...
+// 返回写出的页数；失败返回-1（源文件比清单短，读不满时同样失败，不输出补零的页）
+int64_t aes_sm3_delta_emit(const char* src_path, const aes_sm3_manifest_t* src_m,
+                           const aes_sm3_manifest_t* dst_m, const char* delta_path) {
+    int64_t range_count = aes_sm3_manifest_diff(src_m, dst_m, NULL, 0);
+    if (range_count < 0) {
+        return -1;
+    }
+    aes_sm3_page_range_t* ranges = (aes_sm3_page_range_t*)malloc(
+        ((size_t)range_count + 1) * sizeof(aes_sm3_page_range_t));
+    uint8_t* buf = (uint8_t*)aligned_alloc(64, AES_SM3_SYNC_CHUNK_PAGES * 4096);
+    int fd = open(src_path, O_RDONLY);
+    FILE* out = fopen(delta_path, "wb");
+    int64_t pages = -1;
+
+    if (ranges && buf && fd >= 0 && out) {
+        aes_sm3_manifest_diff(src_m, dst_m, ranges, (size_t)range_count);
+
+        aes_sm3_delta_header_t hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.magic = AES_SM3_DELTA_MAGIC;
+        hdr.version = AES_SM3_SYNC_VERSION;
+        hdr.header_size = sizeof(hdr);
+        hdr.target_size = src_m->hdr->file_size;
+        hdr.range_count = (uint64_t)range_count;
+        hdr.page_size = 4096;
+        memcpy(hdr.midstate, src_m->hdr->midstate, sizeof(hdr.midstate));
+
+        int ok = fwrite(&hdr, sizeof(hdr), 1, out) == 1;
+        pages = 0;
+        for (int64_t r = 0; ok && r < range_count; r++) {
+            const aes_sm3_page_range_t* rg = &ranges[r];
+            ok = fwrite(rg, sizeof(*rg), 1, out) == 1 &&
+                 fwrite(src_m->tags + rg->first_page * 32, 32, rg->page_count, out) == rg->page_count;
+
+            for (uint64_t p = 0; ok && p < rg->page_count; p += AES_SM3_SYNC_CHUNK_PAGES) {
+                uint64_t n = rg->page_count - p < AES_SM3_SYNC_CHUNK_PAGES
+                           ? rg->page_count - p : AES_SM3_SYNC_CHUNK_PAGES;
+                uint64_t off = (rg->first_page + p) * 4096;
+                uint64_t expected = off + n * 4096 > src_m->hdr->file_size
+                                  ? src_m->hdr->file_size - off : n * 4096;
+                memset(buf, 0, n * 4096);                // 只有文件末页的尾部补零
+                ssize_t got = pread(fd, buf, (size_t)expected, (off_t)off);
+                ok = got == (ssize_t)expected && fwrite(buf, 4096, n, out) == n;
+            }
+            pages += (int64_t)rg->page_count;
+        }
+        if (!ok) {
+            pages = -1;
+        }
+    }
+
+    if (out && fclose(out) != 0) {
+        pages = -1;
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    free(ranges);
+    free(buf);
+    return pages;
+}
+
+// 遍历增量中的全部区间：fd<0时逐页校验标签（不写入），否则把页数据写入fd
+// 返回页数；格式错误、数据不完整、标签不符或IO错误返回-1
+static int64_t delta_apply_pass(FILE* in, const aes_sm3_delta_header_t* hdr, int fd, uint8_t* buf) {
+    uint8_t tags[AES_SM3_SYNC_CHUNK_PAGES * 32];
+    uint8_t check[AES_SM3_SYNC_CHUNK_PAGES * 32];
+    int ok = fseek(in, (long)sizeof(*hdr), SEEK_SET) == 0;
+    int64_t pages = 0;
+    for (uint64_t r = 0; ok && r < hdr->range_count; r++) {
+        aes_sm3_page_range_t rg;
+        ok = fread(&rg, sizeof(rg), 1, in) == 1;
+        long tag_pos = ftell(in);
+        long data_pos = tag_pos + (long)(rg.page_count * 32);
+
+        for (uint64_t p = 0; ok && p < rg.page_count; p += AES_SM3_SYNC_CHUNK_PAGES) {
+            uint64_t n = rg.page_count - p < AES_SM3_SYNC_CHUNK_PAGES
+                       ? rg.page_count - p : AES_SM3_SYNC_CHUNK_PAGES;
+            ok = fseek(in, data_pos + (long)(p * 4096), SEEK_SET) == 0 &&
+                 fread(buf, 4096, n, in) == n;
+            if (ok && fd < 0) {
+                ok = fseek(in, tag_pos + (long)(p * 32), SEEK_SET) == 0 &&
+                     fread(tags, 32, n, in) == n;
+                sync_tag_pages(hdr->midstate, buf, n * 4096, rg.first_page + p, check);
+                ok = ok && memcmp(tags, check, n * 32) == 0;
+            } else if (ok) {
+                off_t off = (off_t)((rg.first_page + p) * 4096);
+                ok = pwrite(fd, buf, n * 4096, off) == (ssize_t)(n * 4096);
+            }
+        }
+        ok = ok && fseek(in, data_pos + (long)(rg.page_count * 4096), SEEK_SET) == 0;
+        pages += (int64_t)rg.page_count;
+    }
+    return ok ? pages : -1;
+}
+
+// 应用增量：先校验整个增量的全部页标签，全部一致后才写入目标文件，最后截断到源文件长度
+// 返回写入的页数；格式错误、标签不符或IO错误返回-1（校验失败时目标文件不被修改）
+int64_t aes_sm3_delta_apply(const char* delta_path, const char* target_path) {
+    FILE* in = fopen(delta_path, "rb");
+    if (!in) {
+        return -1;
+    }
+    uint8_t* buf = (uint8_t*)aligned_alloc(64, AES_SM3_SYNC_CHUNK_PAGES * 4096);
+    int fd = -1;
+    int64_t pages = -1;
+
+    aes_sm3_delta_header_t hdr;
+    if (buf && fread(&hdr, sizeof(hdr), 1, in) == 1 &&
+        hdr.magic == AES_SM3_DELTA_MAGIC && hdr.version == AES_SM3_SYNC_VERSION &&
+        hdr.header_size == sizeof(hdr) && hdr.page_size == 4096 &&
+        delta_apply_pass(in, &hdr, -1, buf) >= 0 &&
+        (fd = open(target_path, O_RDWR | O_CREAT, 0644)) >= 0) {
+        pages = delta_apply_pass(in, &hdr, fd, buf);
+        if (pages >= 0 && ftruncate(fd, (off_t)hdr.target_size) != 0) {
+            pages = -1;
+        }
+    }
+
+    if (fd >= 0) {
+        close(fd);
+    }
+    fclose(in);
+    free(buf);
+    return pages;
+}
+
+// ============================================================================
+// 清单比较引擎：多文件并行mmap比较，输出变化页区间
+// ============================================================================
+/*
+ * 夜间任务要比较数百万个文件的新旧清单。每个任务mmap两个二进制清单，
+ * 用 tag_first_mismatch 按256字节块跳过相同区域（速度接近memcmp），
+ * 只在变化处逐标签比较。任务数远多于线程数且大小不一，线程通过原子计数器
+ * 动态领取任务，避免静态划分造成的负载不均。
+ */
+
+typedef struct {
+    const char* old_path;            // 旧清单
+    const char* new_path;            // 新清单
+    aes_sm3_page_range_t* ranges;    // 输出：新清单相对旧清单的变化页区间（调用方free；文件变短时含被截掉的页）
+    int64_t range_count;             // 输出：区间数；-1表示打开失败或域不同，-2表示内存不足
+    uint64_t changed_pages;          // 输出：变化页总数
+} aes_sm3_compare_job_t;
+
+typedef struct {
+    aes_sm3_compare_job_t* jobs;
+    int job_count;
+    int next;
+} compare_pool_t;
+
+static void compare_run_job(aes_sm3_compare_job_t* job) {
+    aes_sm3_manifest_t* old_m = aes_sm3_manifest_open(job->old_path);
+    aes_sm3_manifest_t* new_m = aes_sm3_manifest_open(job->new_path);
+    size_t cap = 0;
+
+    job->ranges = NULL;
+    job->range_count = -1;
+    job->changed_pages = 0;
+    if (old_m && new_m) {
+        job->range_count = manifest_change_scan(new_m, old_m, &job->ranges, &cap);
+        for (int64_t i = 0; i < job->range_count; i++) {
+            job->changed_pages += job->ranges[i].page_count;
+        }
+        if (job->range_count < 0) {
+            free(job->ranges);
+            job->ranges = NULL;
+        }
+    }
+
+    aes_sm3_manifest_free(old_m);
+    aes_sm3_manifest_free(new_m);
+}
+
+static void* compare_worker(void* arg) {
+    compare_pool_t* pool = (compare_pool_t*)arg;
+    for (;;) {
+        int i = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED);
+        if (i >= pool->job_count) {
+            break;
+        }
+        compare_run_job(&pool->jobs[i]);
+    }
+    return NULL;
+}
+
+// 并行比较job_count对清单；num_threads<=0时使用全部在线核心
+// 返回比较失败的任务数
+int aes_sm3_manifest_compare_parallel(aes_sm3_compare_job_t* jobs, int job_count, int num_threads) {
+    int available_cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_threads <= 0 || num_threads > available_cores) {
+        num_threads = available_cores;
+    }
+    if (num_threads > job_count) {
+        num_threads = job_count;
+    }
+
+    // 任务从共享计数器领取，只要有一个线程在跑就能完成全部任务：
+    // 线程数组分配失败或线程创建失败时，由已创建的线程或调用线程补上
+    compare_pool_t pool = {jobs, job_count, 0};
+    pthread_t* threads = num_threads > 1 ? (pthread_t*)malloc(num_threads * sizeof(pthread_t)) : NULL;
+    int created = 0;
+    for (int i = 0; threads && i < num_threads; i++) {
+        if (pthread_create(&threads[created], NULL, compare_worker, &pool) == 0) {
+            created++;
+        }
+    }
+    if (created == 0) {
+        compare_worker(&pool);
+    }
+    for (int i = 0; i < created; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+
+    int failed = 0;
+    for (int i = 0; i < job_count; i++) {
+        failed += jobs[i].range_count < 0;
+    }
+    return failed;
+}
+
+// ============================================================================
+// 追加跟踪模式：增长文件只标记新完成的4KB块
+// ============================================================================
+/*
+ * 预写日志持续增长，周期性全量重扫的代价与文件大小成正比。跟踪模式为每个文件
+ * 维护高水位（已标记的完整页数），每轮只读取 [高水位, 文件大小/4096) 的新完成页：
+ *   - Linux上用inotify IN_MODIFY只唤醒有写入的文件；NFS等不支持inotify时退化为轮询，
+ *     订阅失败的文件也在每轮轮询
+ *   - 不足4KB的尾块暂不标记，写满后在下一轮标记
+ *   - 清单只追加：先追加标签，再更新头部的页数/长度（头部长度 = 高水位 × 4096）
+ *     清单格式与 aes_sm3_manifest_open 兼容，重启后从清单页数继续
+ *   - 文件被截断时清空清单并从头开始；日志轮转（改名或删除后在原路径重建）时
+ *     按路径重新打开新文件，清单同样从头开始。原文件被移走后改为轮询，直到新文件出现
+ * 每轮代价 O(新数据)。
+ */
+
+#define AES_SM3_TAIL_MAX_FILES    256
+
+typedef struct {
+    char* data_path;
+    int data_fd;
+    int manifest_fd;
+    int wd;                  // inotify监视描述符（-1表示未监视，每轮轮询）
+    int dirty;               // 需要在本轮扫描
+    uint64_t high_water;     // 已标记的完整页数
+} tail_file_t;
+
+struct aes_sm3_tail {
+    uint32_t midstate[8];
+    int inotify_fd;          // -1表示轮询模式
+    int file_count;
+    tail_file_t files[AES_SM3_TAIL_MAX_FILES];
+};
+
+typedef struct aes_sm3_tail aes_sm3_tail_t;
+
+// 原地写入清单头（增量构建的清单：先追加标签，再更新头部）
+static int manifest_write_header(const uint32_t* midstate, int fd, uint64_t pages, uint64_t file_size) {
+    aes_sm3_manifest_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = AES_SM3_MANIFEST_MAGIC;
+    hdr.version = AES_SM3_SYNC_VERSION;
+    hdr.header_size = sizeof(hdr);
+    hdr.file_size = file_size;
+    hdr.page_count = pages;
+    hdr.page_size = 4096;
+    memcpy(hdr.midstate, midstate, sizeof(hdr.midstate));
+    return pwrite(fd, &hdr, sizeof(hdr), 0) == (ssize_t)sizeof(hdr) ? 0 : -1;
+}
+
+// 写入清单头（页数 = 高水位，文件长度 = 高水位 × 4096）
+static int tail_write_header(const aes_sm3_tail_t* t, int fd, uint64_t pages) {
+    return manifest_write_header(t->midstate, fd, pages, pages * 4096);
+}
+
+// 订阅文件的写入与移走事件；不可用时wd为-1（每轮轮询）
+static void tail_watch(aes_sm3_tail_t* t, tail_file_t* f) {
+    f->wd = -1;
+#if defined(__linux__)
+    if (t->inotify_fd >= 0) {
+        f->wd = inotify_add_watch(t->inotify_fd, f->data_path,
+                                  IN_MODIFY | IN_CLOSE_WRITE | IN_MOVE_SELF | IN_DELETE_SELF);
+    }
+#else
+    (void)t;
+#endif
+}
+
+// use_inotify为0时强制轮询（NFS等）；midstate为NULL时使用默认域
+aes_sm3_tail_t* aes_sm3_tail_create(const uint32_t* midstate, int use_inotify) {
+    aes_sm3_tail_t* t = (aes_sm3_tail_t*)calloc(1, sizeof(aes_sm3_tail_t));
+    if (!t) {
+        return NULL;
+    }
+    memcpy(t->midstate, midstate ? midstate : SM3_IV, sizeof(t->midstate));
+    t->inotify_fd = -1;
+#if defined(__linux__)
+    if (use_inotify) {
+        t->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    }
+#else
+    (void)use_inotify;
+#endif
+    return t;
+}
+
+void aes_sm3_tail_free(aes_sm3_tail_t* t) {
+    if (!t) {
+        return;
+    }
+    for (int i = 0; i < t->file_count; i++) {
+        close(t->files[i].data_fd);
+        close(t->files[i].manifest_fd);
+        free(t->files[i].data_path);
+    }
+    if (t->inotify_fd >= 0) {
+        close(t->inotify_fd);
+    }
+    free(t);
+}
+
+// 加入跟踪文件；清单已存在时从其页数继续（域必须一致）
+// 返回文件下标，失败返回-1
+int aes_sm3_tail_add(aes_sm3_tail_t* t, const char* data_path, const char* manifest_path) {
+    if (t->file_count == AES_SM3_TAIL_MAX_FILES) {
+        return -1;
+    }
+    int data_fd = open(data_path, O_RDONLY);
+    int man_fd = open(manifest_path, O_RDWR | O_CREAT, 0644);
+    uint64_t pages = 0;
+    int ok = data_fd >= 0 && man_fd >= 0;
+
+    char* path_copy = ok ? strdup(data_path) : NULL;
+    ok = ok && path_copy;
+
+    if (ok) {
+        aes_sm3_manifest_header_t hdr;
+        ssize_t got = pread(man_fd, &hdr, sizeof(hdr), 0);
+        if (got == (ssize_t)sizeof(hdr)) {
+            ok = hdr.magic == AES_SM3_MANIFEST_MAGIC && hdr.header_size == sizeof(hdr) &&
+                 memcmp(hdr.midstate, t->midstate, sizeof(hdr.midstate)) == 0;
+            pages = hdr.page_count;
+        } else {
+            ok = tail_write_header(t, man_fd, 0) == 0;
+        }
+        // 丢弃头部更新之前中断的半截追加
+        ok = ok && ftruncate(man_fd, (off_t)(sizeof(hdr) + pages * 32)) == 0;
+    }
+    if (!ok) {
+        if (data_fd >= 0) {
+            close(data_fd);
+        }
+        if (man_fd >= 0) {
+            close(man_fd);
+        }
+        free(path_copy);
+        return -1;
+    }
+
+    tail_file_t* f = &t->files[t->file_count];
+    f->data_path = path_copy;
+    f->data_fd = data_fd;
+    f->manifest_fd = man_fd;
+    f->high_water = pages;
+    f->dirty = 1;
+    tail_watch(t, f);
+    return t->file_count++;
+}
+
+uint64_t aes_sm3_tail_high_water(const aes_sm3_tail_t* t, int index) {
+    return t->files[index].high_water;
+}
+
+// 路径已指向另一个文件（日志轮转）时重新打开并订阅新文件；
+// 返回1表示已切换，0表示未轮转或新文件尚未出现（继续跟踪原文件）
+static int tail_follow_path(aes_sm3_tail_t* t, tail_file_t* f) {
+    struct stat cur, now;
+    if (stat(f->data_path, &now) != 0 || fstat(f->data_fd, &cur) != 0 ||
+        (now.st_ino == cur.st_ino && now.st_dev == cur.st_dev)) {
+        return 0;
+    }
+    int fd = open(f->data_path, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    close(f->data_fd);
+    f->data_fd = fd;
+#if defined(__linux__)
+    if (f->wd >= 0) {
+        inotify_rm_watch(t->inotify_fd, f->wd);
+    }
+#endif
+    tail_watch(t, f);
+    return 1;
+}
+
+// 标记单个文件的新完成页，返回新标记的页数，出错返回-1
+static int64_t tail_scan_file(aes_sm3_tail_t* t, tail_file_t* f) {
+    int rotated = tail_follow_path(t, f);
+    struct stat st;
+    if (fstat(f->data_fd, &st) != 0) {
+        return -1;
+    }
+    uint64_t complete = (uint64_t)st.st_size / 4096;
+
+    if (complete < f->high_water || (rotated && f->high_water > 0)) {
+        // 截断或轮转：清空清单后从头开始
+        if (ftruncate(f->manifest_fd, sizeof(aes_sm3_manifest_header_t)) != 0 ||
+            tail_write_header(t, f->manifest_fd, 0) != 0) {
+            return -1;
+        }
+        f->high_water = 0;
+    }
+    if (complete == f->high_water) {
+        return 0;
+    }
+
+    uint8_t* buf = (uint8_t*)aligned_alloc(64, AES_SM3_SYNC_CHUNK_PAGES * 4096);
+    uint8_t tags[AES_SM3_SYNC_CHUNK_PAGES * 32];
+    int64_t added = 0;
+    if (!buf) {
+        return -1;
+    }
+
+    while (f->high_water < complete) {
+        uint64_t n = complete - f->high_water;
+        if (n > AES_SM3_SYNC_CHUNK_PAGES) {
+            n = AES_SM3_SYNC_CHUNK_PAGES;
+        }
+        off_t off = (off_t)(f->high_water * 4096);
+        if (pread(f->data_fd, buf, n * 4096, off) != (ssize_t)(n * 4096)) {
+            added = -1;
+            break;
+        }
+
+        sync_tag_pages(t->midstate, buf, n * 4096, f->high_water, tags);
+        off_t tag_off = (off_t)(sizeof(aes_sm3_manifest_header_t) + f->high_water * 32);
+        if (pwrite(f->manifest_fd, tags, n * 32, tag_off) != (ssize_t)(n * 32) ||
+            tail_write_header(t, f->manifest_fd, f->high_water + n) != 0) {
+            added = -1;
+            break;
+        }
+        f->high_water += n;
+        added += (int64_t)n;
+    }
+
+    free(buf);
+    return added;
+}
+
+// 一轮跟踪：等待写入事件（或轮询间隔）后扫描有变化的文件
+// 返回本轮新标记的页数，出错返回-1
+int64_t aes_sm3_tail_tick(aes_sm3_tail_t* t, int timeout_ms) {
+    int pending = 0;
+    for (int i = 0; i < t->file_count; i++) {
+        pending |= t->files[i].dirty;
+    }
+
+#if defined(__linux__)
+    if (t->inotify_fd >= 0) {
+        struct pollfd pfd = {t->inotify_fd, POLLIN, 0};
+        if (poll(&pfd, 1, pending ? 0 : timeout_ms) > 0) {
+            char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+            ssize_t len;
+            while ((len = read(t->inotify_fd, events, sizeof(events))) > 0) {
+                for (char* p = events; p < events + len;) {
+                    const struct inotify_event* ev = (const struct inotify_event*)p;
+                    for (int i = 0; i < t->file_count; i++) {
+                        tail_file_t* f = &t->files[i];
+                        if (f->wd == ev->wd || (ev->mask & IN_Q_OVERFLOW)) {
+                            f->dirty = 1;
+                        }
+                        if (f->wd == ev->wd && (ev->mask & (IN_MOVE_SELF | IN_DELETE_SELF))) {
+                            // 原文件被移走：取消订阅，轮询原路径直到新文件出现
+                            inotify_rm_watch(t->inotify_fd, f->wd);
+                            f->wd = -1;
+                        }
+                    }
+                    p += sizeof(struct inotify_event) + ev->len;
+                }
+            }
+        }
+        for (int i = 0; i < t->file_count; i++) {
+            t->files[i].dirty |= t->files[i].wd < 0;   // 订阅失败或已移走的文件每轮轮询
+        }
+    } else
+#endif
+    {
+        if (!pending && timeout_ms > 0) {
+            usleep((useconds_t)timeout_ms * 1000);
+        }
+        for (int i = 0; i < t->file_count; i++) {
+            t->files[i].dirty = 1;
+        }
+    }
+
+    int64_t total = 0;
+    for (int i = 0; i < t->file_count; i++) {
+        tail_file_t* f = &t->files[i];
+        if (!f->dirty) {
+            continue;
+        }
+        f->dirty = 0;
+        int64_t n = tail_scan_file(t, f);
+        if (n < 0) {
+            return -1;
+        }
+        total += n;
+    }
+    return total;
+}
+
+// ============================================================================
+// 目录监视模式：变更事件驱动增量重标记（Linux inotify）
+// ============================================================================
+/*
+ * 配置/制品目录树需要标签持续保持最新，周期性全量重扫20TB不可接受。
+ * 监视模式递归订阅目录的inotify事件：
+ *   - 去抖：同一文件的连续事件合并，静默debounce_ms后才处理
+ *   - 待处理表有界（哈希去重）；溢出或内核队列溢出（IN_Q_OVERFLOW）时退化为一次全量扫描，
+ *     全量扫描（包括初始扫描）把文件直接提交到工作队列，不经过待处理表，因此文件数不受表容量限制
+ *   - 有界工作队列 + 工作线程：队列满时事件循环阻塞（背压），事件风暴不会耗尽内存
+ *   - 工作线程用批量内核重新生成文件清单，与旧清单按块比较得到脏页区间，
+ *     原子替换清单（临时文件 + rename）后回调
+ * inotify/fanotify都不提供写入的字节范围（fanotify还需要CAP_SYS_ADMIN），
+ * 因此脏块区间通过新旧清单的块级比较得到。
+ * 清单路径 = manifest_root/<相对路径>.sm3m；文件被删除时删除清单并以range_count=-1回调。
+ * 目录在树内改名时清单子树随之改名；移出树外时其下每个清单按文件删除处理。
+ */
+
+#if defined(__linux__)
+
+#define AES_SM3_WATCH_PENDING     8192      // 待处理表槽数（2的幂）
+#define AES_SM3_WATCH_QUEUE       1024      // 工作队列容量
+#define AES_SM3_WATCH_MAX_WORKERS 64
+
+// watch_add_dir对目录中文件的处理方式
+#define WATCH_DIR_SUBSCRIBE       0         // 只订阅目录
+#define WATCH_DIR_TOUCH           1         // 计入待处理表（去抖）
+#define WATCH_DIR_SUBMIT          2         // 直接提交到工作队列（全量扫描）
+
+// 回调在工作线程中调用；range_count = -1 表示文件已删除
+typedef void (*aes_sm3_watch_fn)(void* ctx, const char* path,
+                                 const aes_sm3_page_range_t* ranges, int64_t range_count);
+
+typedef struct {
+    char* path;
+    uint64_t last_ns;
+} watch_pending_t;
+
+typedef struct {
+    int wd;
+    char* path;
+} watch_dir_t;
+
+struct aes_sm3_watch {
+    char* root;
+    char* manifest_root;
+    int debounce_ms;
+    aes_sm3_watch_fn fn;
+    void* ctx;
+
+    int inotify_fd;
+    watch_dir_t* dirs;
+    int dir_count;
+    int dir_cap;
+
+    watch_pending_t pending[AES_SM3_WATCH_PENDING];
+    int pending_count;
+    int overflow;                          // 需要一次全量扫描
+    char* move_from;                       // 已移走、等待配对IN_MOVED_TO的目录
+    uint32_t move_cookie;
+
+    // 有界工作队列
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    pthread_cond_t idle;
+    char* queue[AES_SM3_WATCH_QUEUE];
+    int head;
+    int tail;
+    int queued;
+    int in_flight;
+    const char* active[AES_SM3_WATCH_MAX_WORKERS];   // 处理中的路径，同一路径不并发重标记
+    int stop;
+    pthread_t workers[AES_SM3_WATCH_MAX_WORKERS];
+    int worker_count;
+
+    uint64_t files_retagged;               // 统计（原子更新）
+    uint64_t pages_changed;
+};
+
+typedef struct aes_sm3_watch aes_sm3_watch_t;
+
+void aes_sm3_watch_free(aes_sm3_watch_t* w);
+
+static uint64_t watch_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static char* watch_join(const char* a, const char* b, const char* suffix) {
+    size_t la = strlen(a), lb = strlen(b), ls = strlen(suffix);
+    char* p = (char*)malloc(la + lb + ls + 2);
+    if (p) {
+        memcpy(p, a, la);
+        p[la] = '/';
+        memcpy(p + la + 1, b, lb);
+        memcpy(p + la + 1 + lb, suffix, ls + 1);
+    }
+    return p;
+}
+
+// 逐级创建path的父目录
+static void watch_mkdirs(const char* path) {
+    char* copy = strdup(path);
+    if (!copy) {
+        return;
+    }
+    for (char* p = copy + 1; *p; p++) {
+        if (*p == '/') {
+            *p = '\0';
+            mkdir(copy, 0755);
+            *p = '/';
+        }
+    }
+    free(copy);
+}
+
+// 数据路径对应的清单路径；suffix为""时得到目录对应的清单目录
+static char* watch_manifest_path(const aes_sm3_watch_t* w, const char* path, const char* suffix) {
+    const char* rel = path + strlen(w->root);
+    while (*rel == '/') {
+        rel++;
+    }
+    return watch_join(w->manifest_root, rel, suffix);
+}
+
+// 重新标记单个文件：新清单与旧清单按块比较，原子替换清单
+static void watch_retag(aes_sm3_watch_t* w, const char* path) {
+    char* man_path = watch_manifest_path(w, path, ".sm3m");
+    if (!man_path) {
+        return;
+    }
+
+    struct stat st;
+    aes_sm3_manifest_t* fresh = NULL;
+    if (stat(path, &st) == 0 && S_ISREG(st.st_mode)) {
+        fresh = aes_sm3_manifest_build_file(NULL, path);
+    }
+    if (!fresh) {
+        unlink(man_path);
+        if (w->fn) {
+            w->fn(w->ctx, path, NULL, -1);
+        }
+        free(man_path);
+        return;
+    }
+
+    aes_sm3_page_range_t* ranges = NULL;
+    size_t cap = 0;
+    int64_t count;
+    aes_sm3_manifest_t* old_m = aes_sm3_manifest_open(man_path);
+    int had_manifest = old_m != NULL;
+    if (old_m) {
+        // 文件变短时被截掉的页也作为区间报告；长度变化即使没有页变化也会重写清单头
+        count = manifest_change_scan(fresh, old_m, &ranges, &cap);
+        aes_sm3_manifest_free(old_m);
+        if (count < 0) {
+            // 旧清单域不同或内存不足：按整个文件变化处理（-1会被回调当作删除）
+            free(ranges);
+            ranges = NULL;
+            had_manifest = 0;
+        }
+    }
+    if (!had_manifest) {
+        count = 0;
+        if (aes_sm3_manifest_page_count(fresh) > 0) {
+            ranges = (aes_sm3_page_range_t*)malloc(sizeof(aes_sm3_page_range_t));
+            if (ranges) {
+                ranges[0].first_page = 0;
+                ranges[0].page_count = aes_sm3_manifest_page_count(fresh);
+                count = 1;
+            }
+        }
+    }
+
+    uint64_t pages = 0;
+    for (int64_t i = 0; i < count; i++) {
+        pages += ranges[i].page_count;
+    }
+    if (count != 0 || !had_manifest) {
+        char* tmp = (char*)malloc(strlen(man_path) + 5);
+        if (tmp) {
+            sprintf(tmp, "%s.tmp", man_path);
+            watch_mkdirs(man_path);
+            if (aes_sm3_manifest_save(fresh, tmp) == 0) {
+                rename(tmp, man_path);
+            } else {
+                unlink(tmp);
+            }
+            free(tmp);
+        }
+    }
+    __atomic_fetch_add(&w->files_retagged, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&w->pages_changed, pages, __ATOMIC_RELAXED);
+
+    if (w->fn) {
+        w->fn(w->ctx, path, ranges, count);
+    }
+    free(ranges);
+    aes_sm3_manifest_free(fresh);
+    free(man_path);
+}
+
+// 队列中第一个不在处理中的位置（相对队首），没有时返回-1；调用方持有锁
+static int watch_pick(const aes_sm3_watch_t* w) {
+    for (int k = 0; k < w->queued; k++) {
+        const char* path = w->queue[(w->head + k) % AES_SM3_WATCH_QUEUE];
+        int busy = 0;
+        for (int i = 0; i < AES_SM3_WATCH_MAX_WORKERS && !busy; i++) {
+            busy = w->active[i] && strcmp(w->active[i], path) == 0;
+        }
+        if (!busy) {
+            return k;
+        }
+    }
+    return -1;
+}
+
+static void* watch_worker(void* arg) {
+    aes_sm3_watch_t* w = (aes_sm3_watch_t*)arg;
+    for (;;) {
+        pthread_mutex_lock(&w->lock);
+        // 同一路径正在处理时留在队列中，等那次完成后再取，
+        // 避免两次重标记写同一个临时文件、旧结果后rename覆盖新结果
+        int k;
+        while ((k = watch_pick(w)) < 0 && !(w->queued == 0 && w->stop)) {
+            pthread_cond_wait(&w->not_empty, &w->lock);
+        }
+        if (k < 0) {
+            pthread_mutex_unlock(&w->lock);
+            break;
+        }
+        int pos = (w->head + k) % AES_SM3_WATCH_QUEUE;
+        char* path = w->queue[pos];
+        w->queue[pos] = w->queue[w->head];               // 队首补到取走的位置
+        w->head = (w->head + 1) % AES_SM3_WATCH_QUEUE;
+        w->queued--;
+        w->in_flight++;
+        int slot = 0;
+        while (w->active[slot]) {
+            slot++;
+        }
+        w->active[slot] = path;
+        pthread_cond_signal(&w->not_full);
+        pthread_mutex_unlock(&w->lock);
+
+        watch_retag(w, path);
+
+        pthread_mutex_lock(&w->lock);
+        w->active[slot] = NULL;
+        w->in_flight--;
+        if (w->queued > 0) {
+            pthread_cond_broadcast(&w->not_empty);       // 被推迟的同路径任务可以取了
+        }
+        if (w->queued == 0 && w->in_flight == 0) {
+            pthread_cond_broadcast(&w->idle);
+        }
+        pthread_mutex_unlock(&w->lock);
+        free(path);
+    }
+    return NULL;
+}
+
+// 提交到工作队列（队列满时阻塞，形成背压）；接管path所有权
+static void watch_submit(aes_sm3_watch_t* w, char* path) {
+    pthread_mutex_lock(&w->lock);
+    while (w->queued == AES_SM3_WATCH_QUEUE) {
+        pthread_cond_wait(&w->not_full, &w->lock);
+    }
+    w->queue[w->tail] = path;
+    w->tail = (w->tail + 1) % AES_SM3_WATCH_QUEUE;
+    w->queued++;
+    pthread_cond_signal(&w->not_empty);
+    pthread_mutex_unlock(&w->lock);
+}
+
+// 记录一次文件事件（去重 + 刷新去抖时间）；表满时标记溢出
+static void watch_touch(aes_sm3_watch_t* w, const char* path, uint64_t now) {
+    uint64_t h = 0xcbf29ce484222325ULL;                  // FNV-1a
+    for (const char* p = path; *p; p++) {
+        h = (h ^ (uint8_t)*p) * 0x100000001b3ULL;
+    }
+    for (uint32_t probe = 0; probe < AES_SM3_WATCH_PENDING; probe++) {
+        watch_pending_t* e = &w->pending[(h + probe) & (AES_SM3_WATCH_PENDING - 1)];
+        if (e->path && strcmp(e->path, path) == 0) {
+            e->last_ns = now;
+            return;
+        }
+        if (!e->path) {
+            if (w->pending_count >= AES_SM3_WATCH_PENDING / 2) {
+                w->overflow = 1;
+                return;
+            }
+            e->path = strdup(path);
+            e->last_ns = now;
+            w->pending_count += e->path != NULL;
+            return;
+        }
+    }
+}
+
+// 移除dirs[i]（与末项交换）
+static void watch_drop_dir(aes_sm3_watch_t* w, int i) {
+    free(w->dirs[i].path);
+    w->dirs[i] = w->dirs[--w->dir_count];
+}
+
+// 目录被移走：取消它及其子目录的订阅，避免之后的事件按旧路径解析
+static void watch_forget_dir(aes_sm3_watch_t* w, const char* dir) {
+    size_t n = strlen(dir);
+    for (int i = 0; i < w->dir_count;) {
+        const char* path = w->dirs[i].path;
+        if (strncmp(path, dir, n) == 0 && (path[n] == '\0' || path[n] == '/')) {
+            inotify_rm_watch(w->inotify_fd, w->dirs[i].wd);
+            watch_drop_dir(w, i);
+        } else {
+            i++;
+        }
+    }
+}
+
+// 清单目录man_dir下的每个清单把对应的数据文件（位于data_dir下）提交到工作队列：
+// 文件已不在原路径，工作线程按删除处理（删除清单并回调）；残留的临时文件直接删除
+static void watch_submit_removed(aes_sm3_watch_t* w, const char* man_dir, const char* data_dir) {
+    DIR* d = opendir(man_dir);
+    if (!d) {
+        return;
+    }
+    struct dirent* ent;
+    while ((ent = readdir(d)) != NULL) {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) {
+            continue;
+        }
+        char* man = watch_join(man_dir, ent->d_name, "");
+        char* data = watch_join(data_dir, ent->d_name, "");
+        struct stat st;
+        if (man && data && lstat(man, &st) == 0) {
+            size_t n = strlen(data);
+            if (S_ISDIR(st.st_mode)) {
+                watch_submit_removed(w, man, data);
+            } else if (n > 5 && strcmp(data + n - 5, ".sm3m") == 0) {
+                data[n - 5] = '\0';
+                watch_submit(w, data);               // 接管data
+                data = NULL;
+            } else {
+                unlink(man);
+            }
+        }
+        free(man);
+        free(data);
+    }
+    closedir(d);
+}
+
+// 未配对的目录移走（移出树外）：其下的清单按文件删除处理
+static void watch_flush_move(aes_sm3_watch_t* w) {
+    if (!w->move_from) {
+        return;
+    }
+    char* man_dir = watch_manifest_path(w, w->move_from, "");
+    if (man_dir) {
+        watch_submit_removed(w, man_dir, w->move_from);
+        free(man_dir);
+    }
+    free(w->move_from);
+    w->move_from = NULL;
+}
+
+// 目录在树内改名（与move_from配对）：清单子树随之改名，重标记时与原清单比较
+static void watch_move_manifests(aes_sm3_watch_t* w, const char* to) {
+    char* from_dir = watch_manifest_path(w, w->move_from, "");
+    char* to_dir = watch_manifest_path(w, to, "");
+    if (from_dir && to_dir) {
+        watch_mkdirs(to_dir);
+        if (rename(from_dir, to_dir) == 0) {
+            free(w->move_from);
+            w->move_from = NULL;
+        }
+    }
+    free(from_dir);
+    free(to_dir);
+    watch_flush_move(w);                             // 改名失败时按移出处理
+}
+
+// 递归订阅目录；mode为WATCH_DIR_*，决定其中的文件如何处理
+static int watch_add_dir(aes_sm3_watch_t* w, const char* dir, int mode) {
+    int wd = inotify_add_watch(w->inotify_fd, dir,
+                               IN_CLOSE_WRITE | IN_MODIFY | IN_CREATE | IN_DELETE |
+                               IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_ONLYDIR);
+    if (wd < 0) {
+        return -1;
+    }
+    int known = 0;
+    for (int i = 0; i < w->dir_count && !known; i++) {
+        if (w->dirs[i].wd == wd) {
+            known = 1;
+            // 同一inode的wd不变：目录被改名后路径要跟着更新
+            if (strcmp(w->dirs[i].path, dir) != 0) {
+                char* path = strdup(dir);
+                if (!path) {
+                    return -1;
+                }
+                free(w->dirs[i].path);
+                w->dirs[i].path = path;
+            }
+        }
+    }
+    if (!known) {
+        if (w->dir_count == w->dir_cap) {
+            int cap = w->dir_cap ? w->dir_cap * 2 : 64;
+            watch_dir_t* d = (watch_dir_t*)realloc(w->dirs, cap * sizeof(watch_dir_t));
+            if (!d) {
+                return -1;
+            }
+            w->dirs = d;
+            w->dir_cap = cap;
+        }
+        w->dirs[w->dir_count].wd = wd;
+        w->dirs[w->dir_count].path = strdup(dir);
+        w->dir_count++;
+    }
+
+    DIR* d = opendir(dir);
+    if (!d) {
+        return -1;
+    }
+    uint64_t now = watch_now_ns();
+    struct dirent* ent;
+    while ((ent = readdir(d)) != NULL) {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) {
+            continue;
+        }
+        char* child = watch_join(dir, ent->d_name, "");
+        if (!child) {
+            continue;
+        }
+        struct stat st;
+        if (lstat(child, &st) == 0) {
+            if (S_ISDIR(st.st_mode)) {
+                watch_add_dir(w, child, mode);
+            } else if (S_ISREG(st.st_mode) && mode == WATCH_DIR_TOUCH) {
+                watch_touch(w, child, now);
+            } else if (S_ISREG(st.st_mode) && mode == WATCH_DIR_SUBMIT) {
+                watch_submit(w, child);              // 接管child
+                continue;
+            }
+        }
+        free(child);
+    }
+    closedir(d);
+    return 0;
+}
+
+// 创建监视器：root为被监视目录，manifest_root为清单目录（不应位于root之内）
+// num_workers<=0时使用全部在线核心；初始时所有文件提交到工作队列（队列满时在此阻塞）
+aes_sm3_watch_t* aes_sm3_watch_create(const char* root, const char* manifest_root, int debounce_ms,
+                                      int num_workers, aes_sm3_watch_fn fn, void* ctx) {
+    aes_sm3_watch_t* w = (aes_sm3_watch_t*)calloc(1, sizeof(aes_sm3_watch_t));
+    if (!w) {
+        return NULL;
+    }
+    w->root = strdup(root);
+    w->manifest_root = strdup(manifest_root);
+    w->debounce_ms = debounce_ms;
+    w->fn = fn;
+    w->ctx = ctx;
+    w->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->not_empty, NULL);
+    pthread_cond_init(&w->not_full, NULL);
+    pthread_cond_init(&w->idle, NULL);
+
+    if (!w->root || !w->manifest_root || w->inotify_fd < 0 ||
+        watch_add_dir(w, root, WATCH_DIR_SUBSCRIBE) != 0) {
+        if (w->inotify_fd >= 0) {
+            close(w->inotify_fd);
+        }
+        for (int i = 0; i < w->dir_count; i++) {
+            free(w->dirs[i].path);
+        }
+        free(w->dirs);
+        free(w->root);
+        free(w->manifest_root);
+        free(w);
+        return NULL;
+    }
+
+    int available_cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_workers <= 0 || num_workers > available_cores) {
+        num_workers = available_cores;
+    }
+    if (num_workers > AES_SM3_WATCH_MAX_WORKERS) {
+        num_workers = AES_SM3_WATCH_MAX_WORKERS;
+    }
+    for (int i = 0; i < num_workers; i++) {
+        if (pthread_create(&w->workers[w->worker_count], NULL, watch_worker, w) == 0) {
+            w->worker_count++;
+        }
+    }
+    if (w->worker_count == 0) {
+        aes_sm3_watch_free(w);
+        return NULL;
+    }
+    // 工作线程就绪后再做初始全量扫描，提交时的背压才有人消化
+    w->overflow = watch_add_dir(w, root, WATCH_DIR_SUBMIT) != 0;
+    return w;
+}
+
+// 一轮事件循环：读取事件、去抖，把静默期满的文件提交到工作队列
+// 返回本轮提交的文件数
+int aes_sm3_watch_tick(aes_sm3_watch_t* w, int timeout_ms) {
+    struct pollfd pfd = {w->inotify_fd, POLLIN, 0};
+    int wait_ms = w->pending_count > 0 && (timeout_ms < 0 || w->debounce_ms < timeout_ms)
+                ? w->debounce_ms : timeout_ms;
+    uint64_t now;
+
+    if (poll(&pfd, 1, wait_ms) > 0) {
+        char events[16384] __attribute__((aligned(__alignof__(struct inotify_event))));
+        ssize_t len;
+        now = watch_now_ns();
+        while ((len = read(w->inotify_fd, events, sizeof(events))) > 0) {
+            for (char* p = events; p < events + len;) {
+                const struct inotify_event* ev = (const struct inotify_event*)p;
+                p += sizeof(struct inotify_event) + ev->len;
+
+                if (ev->mask & IN_Q_OVERFLOW) {
+                    w->overflow = 1;
+                    continue;
+                }
+                const char* dir = NULL;
+                for (int i = 0; i < w->dir_count; i++) {
+                    if (w->dirs[i].wd == ev->wd) {
+                        if (ev->mask & (IN_DELETE_SELF | IN_IGNORED)) {
+                            watch_drop_dir(w, i);        // 目录已删除或订阅已失效
+                        } else {
+                            dir = w->dirs[i].path;
+                        }
+                        break;
+                    }
+                }
+                if (!dir || ev->len == 0) {
+                    continue;
+                }
+                char* child = watch_join(dir, ev->name, "");
+                if (!child) {
+                    continue;
+                }
+                if (ev->mask & IN_ISDIR) {
+                    if (ev->mask & (IN_CREATE | IN_MOVED_TO)) {
+                        if ((ev->mask & IN_MOVED_TO) && w->move_from && ev->cookie == w->move_cookie) {
+                            watch_move_manifests(w, child);
+                        }
+                        watch_add_dir(w, child, WATCH_DIR_TOUCH);   // 新目录：订阅并处理其中已有文件
+                    } else if (ev->mask & IN_MOVED_FROM) {
+                        // 移入树内时随后的IN_MOVED_TO会按新路径重新订阅；清单等本批事件读完再处理
+                        watch_forget_dir(w, child);
+                        watch_flush_move(w);
+                        w->move_from = child;
+                        w->move_cookie = ev->cookie;
+                        child = NULL;
+                    }
+                } else {
+                    watch_touch(w, child, now);
+                }
+                free(child);
+            }
+        }
+        watch_flush_move(w);
+    }
+
+    if (w->overflow) {
+        // 溢出：全量扫描一次，文件直接提交到工作队列；待处理表保留，照常去抖。
+        // 扫描期间不会再写待处理表，扫描完成后才清除溢出标记
+        if (watch_add_dir(w, w->root, WATCH_DIR_SUBMIT) == 0) {
+            w->overflow = 0;
+        }
+    }
+
+    now = watch_now_ns();
+    uint64_t quiet_ns = (uint64_t)w->debounce_ms * 1000000ULL;
+    int submitted = 0;
+    for (int i = 0; i < AES_SM3_WATCH_PENDING && w->pending_count > 0; i++) {
+        watch_pending_t* e = &w->pending[i];
+        if (e->path && now - e->last_ns >= quiet_ns) {
+            watch_submit(w, e->path);
+            e->path = NULL;
+            w->pending_count--;
+            submitted++;
+        }
+    }
+    // 线性探测表：删除后重新插入剩余条目，保持探测链完整
+    if (submitted > 0 && w->pending_count > 0) {
+        watch_pending_t rest[AES_SM3_WATCH_PENDING / 2];
+        int n = 0;
+        for (int i = 0; i < AES_SM3_WATCH_PENDING; i++) {
+            if (w->pending[i].path) {
+                rest[n++] = w->pending[i];
+                w->pending[i].path = NULL;
+            }
+        }
+        w->pending_count = 0;
+        for (int i = 0; i < n; i++) {
+            watch_touch(w, rest[i].path, rest[i].last_ns);
+            free(rest[i].path);
+        }
+    }
+    return submitted;
+}
+
+// 等待待处理表与工作队列全部处理完（max_wait_ms内），返回0表示已空闲
+int aes_sm3_watch_drain(aes_sm3_watch_t* w, int max_wait_ms) {
+    uint64_t deadline = watch_now_ns() + (uint64_t)max_wait_ms * 1000000ULL;
+    while ((w->pending_count > 0 || w->overflow) && watch_now_ns() < deadline) {
+        aes_sm3_watch_tick(w, w->debounce_ms);
+    }
+
+    pthread_mutex_lock(&w->lock);
+    while ((w->queued > 0 || w->in_flight > 0) && watch_now_ns() < deadline) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += 10000000;
+        if (ts.tv_nsec >= 1000000000) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&w->idle, &w->lock, &ts);
+    }
+    int busy = w->queued > 0 || w->in_flight > 0 || w->pending_count > 0 || w->overflow;
+    pthread_mutex_unlock(&w->lock);
+    return busy ? -1 : 0;
+}
+
+void aes_sm3_watch_stats(const aes_sm3_watch_t* w, uint64_t* files_retagged, uint64_t* pages_changed) {
+    *files_retagged = __atomic_load_n(&w->files_retagged, __ATOMIC_RELAXED);
+    *pages_changed = __atomic_load_n(&w->pages_changed, __ATOMIC_RELAXED);
+}
+
+// 停止工作线程（已入队的任务会先处理完）并释放
+void aes_sm3_watch_free(aes_sm3_watch_t* w) {
+    if (!w) {
+        return;
+    }
+    pthread_mutex_lock(&w->lock);
+    w->stop = 1;
+    pthread_cond_broadcast(&w->not_empty);
+    pthread_mutex_unlock(&w->lock);
+    for (int i = 0; i < w->worker_count; i++) {
+        pthread_join(w->workers[i], NULL);
+    }
+
+    for (int i = 0; i < AES_SM3_WATCH_PENDING; i++) {
+        free(w->pending[i].path);
+    }
+    for (int i = 0; i < w->dir_count; i++) {
+        free(w->dirs[i].path);
+    }
+    free(w->move_from);
+    close(w->inotify_fd);
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->not_empty);
+    pthread_cond_destroy(&w->not_full);
+    pthread_cond_destroy(&w->idle);
+    free(w->dirs);
+    free(w->root);
+    free(w->manifest_root);
+    free(w);
+}
+
+#endif
+
+// ============================================================================
+// 内存区域脏页跟踪：只重标记上次刷新后被写过的页（Linux）
+// ============================================================================
+/*
+ * 常驻内存的大页池（数百GB）需要每隔几秒刷新标签，全量重算的代价与池大小成正比。
+ * 跟踪器让内核记录哪些页被写过，刷新时批量枚举脏页，只把它们送入批量内核：
+ *   - UFFD_WP：userfaultfd异步写保护（WP_ASYNC，6.7+）。写保护页的首次写入由内核
+ *     直接解除保护并标记为已写，无需处理缺页的线程；PAGEMAP_SCAN一次ioctl返回
+ *     已写区间并原子地重新写保护（PM_SCAN_WP_MATCHING），不会丢失并发写入
+ *   - SOFT_DIRTY：/proc/self/clear_refs 写 "4" 清除软脏位，/proc/self/pagemap 第55位
+ *     表示清除后写过。clear_refs作用于整个进程，清除前先把所有已登记区域的脏位
+ *     收割到各自的待处理位图中，多个区域互不干扰
+ *   - FULL：以上均不可用时每次全量重标记（结果相同，只是代价不随写入率缩放）
+ * 刷新顺序固定为"先取脏位并重新保护/清除，再计算标签"：计算期间的写入会在下一轮
+ * 被发现。标签LBA为区域内页号，区域基址与长度须按4KB对齐。
+ */
+
+#define AES_SM3_TRACK_AUTO          0
+#define AES_SM3_TRACK_UFFD_WP       1
+#define AES_SM3_TRACK_SOFT_DIRTY    2
+#define AES_SM3_TRACK_FULL          3
+
+#if defined(__linux__)
+
+// 旧内核头文件缺少的 PAGEMAP_SCAN / WP_ASYNC 定义（linux/fs.h、linux/userfaultfd.h，6.7+）
+#ifndef PAGEMAP_SCAN
+#define PAGE_IS_WRITTEN             (1 << 1)
+#define PAGE_IS_SOFT_DIRTY          (1 << 7)
+#define PM_SCAN_WP_MATCHING         (1 << 0)
+#define PM_SCAN_CHECK_WPASYNC       (1 << 1)
+struct page_region {
+    uint64_t start;
+    uint64_t end;
+    uint64_t categories;
+};
+struct pm_scan_arg {
+    uint64_t size;
+    uint64_t flags;
+    uint64_t start;
+    uint64_t end;
+    uint64_t walk_end;
+    uint64_t vec;
+    uint64_t vec_len;
+    uint64_t max_pages;
+    uint64_t category_inverted;
+    uint64_t category_mask;
+    uint64_t category_anyof_mask;
+    uint64_t return_mask;
+};
+#define PAGEMAP_SCAN                _IOWR('f', 16, struct pm_scan_arg)
+#endif
+#ifndef UFFD_FEATURE_WP_UNPOPULATED
+#define UFFD_FEATURE_WP_UNPOPULATED (1 << 13)
+#endif
+#ifndef UFFD_FEATURE_WP_ASYNC
+#define UFFD_FEATURE_WP_ASYNC       (1 << 15)
+#endif
+
+#define REGION_SCAN_VEC             512     // 每次PAGEMAP_SCAN返回的最大区间数
+#define REGION_PAGEMAP_CHUNK        8192    // 逐项读取pagemap时每次读取的页数
+
+struct aes_sm3_region {
+    uint8_t* base;
+    uint64_t page_count;
+    uint32_t midstate[8];
+    uint8_t* tags;                 // 调用方提供：page_count × 32字节
+    int backend;
+    int uffd;                      // UFFD_WP后端
+    int pagemap_fd;                // /proc/self/pagemap
+    int pm_scan;                   // 内核支持PAGEMAP_SCAN
+    uint64_t* pending;             // SOFT_DIRTY：已收割、尚未重标记的脏页位图
+    struct aes_sm3_region* next;   // 软脏区域登记表
+};
+
+typedef struct aes_sm3_region aes_sm3_region_t;
+
+static pthread_mutex_t region_registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static aes_sm3_region_t* region_registry = NULL;
+static int region_soft_dirty_ok = -1;   // -1未探测
+
+// 对区域执行PAGEMAP_SCAN，把带category的页置入bitmap；返回0成功，-1不支持或出错
+static int region_pm_scan(aes_sm3_region_t* r, uint64_t flags, uint64_t category, uint64_t* bitmap) {
+    struct page_region vec[REGION_SCAN_VEC];
+    uint64_t start = (uint64_t)(uintptr_t)r->base;
+    uint64_t end = start + r->page_count * 4096;
+
+    while (start < end) {
+        struct pm_scan_arg arg;
+        memset(&arg, 0, sizeof(arg));
+        arg.size = sizeof(arg);
+        arg.flags = flags;
+        arg.start = start;
+        arg.end = end;
+        arg.vec = (uint64_t)(uintptr_t)vec;
+        arg.vec_len = REGION_SCAN_VEC;
+        arg.category_mask = category;
+        arg.return_mask = category;
+
+        int n = ioctl(r->pagemap_fd, PAGEMAP_SCAN, &arg);
+        if (n < 0) {
+            return -1;
+        }
+        for (int i = 0; i < n; i++) {
+            uint64_t p = (vec[i].start - (uint64_t)(uintptr_t)r->base) / 4096;
+            uint64_t q = (vec[i].end - (uint64_t)(uintptr_t)r->base) / 4096;
+            for (; p < q; p++) {
+                bitmap[p >> 6] |= 1ULL << (p & 63);
+            }
+        }
+        start = arg.walk_end;
+    }
+    return 0;
+}
+
+// 读取区域的软脏位并入bitmap（优先PAGEMAP_SCAN，否则逐项读pagemap）
+static int region_harvest_soft_dirty(aes_sm3_region_t* r, uint64_t* bitmap) {
+    if (r->pm_scan) {
+        if (region_pm_scan(r, 0, PAGE_IS_SOFT_DIRTY, bitmap) == 0) {
+            return 0;
+        }
+        r->pm_scan = 0;
+    }
+
+    uint64_t* entries = (uint64_t*)malloc(REGION_PAGEMAP_CHUNK * sizeof(uint64_t));
+    uint64_t first_vpn = (uint64_t)(uintptr_t)r->base / 4096;
+    int ret = entries ? 0 : -1;
+    for (uint64_t p = 0; ret == 0 && p < r->page_count; p += REGION_PAGEMAP_CHUNK) {
+        uint64_t n = r->page_count - p;
+        if (n > REGION_PAGEMAP_CHUNK) {
+            n = REGION_PAGEMAP_CHUNK;
+        }
+        ssize_t want = (ssize_t)(n * sizeof(uint64_t));
+        if (pread(r->pagemap_fd, entries, want, (off_t)((first_vpn + p) * 8)) != want) {
+            ret = -1;
+            break;
+        }
+        for (uint64_t i = 0; i < n; i++) {
+            if ((entries[i] >> 55) & 1) {
+                bitmap[(p + i) >> 6] |= 1ULL << ((p + i) & 63);
+            }
+        }
+    }
+    free(entries);
+    return ret;
+}
+
+static int region_clear_refs(void) {
+    int fd = open("/proc/self/clear_refs", O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    int ok = write(fd, "4", 1) == 1;
+    close(fd);
+    return ok ? 0 : -1;
+}
+
+// 探测软脏位是否真正可用（未启用CONFIG_MEM_SOFT_DIRTY时第55位恒为0）
+// 只在登记表为空时调用：clear_refs会清除整个进程的软脏位
+static int region_probe_soft_dirty(void) {
+    uint8_t* page = (uint8_t*)mmap(NULL, 4096, PROT_READ | PROT_WRITE,
+                                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    int fd = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+    uint64_t entry = 0;
+    int ok = 0;
+    if (page != MAP_FAILED && fd >= 0) {
+        page[0] = 1;
+        if (region_clear_refs() == 0) {
+            __atomic_store_n(&page[0], 2, __ATOMIC_SEQ_CST);
+            ok = pread(fd, &entry, sizeof(entry), (off_t)((uintptr_t)page / 4096 * 8)) == 8 &&
+                 ((entry >> 55) & 1);
+        }
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (page != MAP_FAILED) {
+        munmap(page, 4096);
+    }
+    return ok;
+}
+
+// 建立异步写保护：注册区域并整体写保护；失败返回-1
+static int region_setup_uffd(aes_sm3_region_t* r) {
+    int fd = (int)syscall(SYS_userfaultfd, O_CLOEXEC | O_NONBLOCK | UFFD_USER_MODE_ONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct uffdio_api api;
+    memset(&api, 0, sizeof(api));
+    api.api = UFFD_API;
+    api.features = UFFD_FEATURE_WP_ASYNC | UFFD_FEATURE_WP_UNPOPULATED;
+
+    struct uffdio_register reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.range.start = (uint64_t)(uintptr_t)r->base;
+    reg.range.len = r->page_count * 4096;
+    reg.mode = UFFDIO_REGISTER_MODE_WP;
+
+    struct uffdio_writeprotect wp;
+    memset(&wp, 0, sizeof(wp));
+    wp.range = reg.range;
+    wp.mode = UFFDIO_WRITEPROTECT_MODE_WP;
+
+    if (ioctl(fd, UFFDIO_API, &api) != 0 || ioctl(fd, UFFDIO_REGISTER, &reg) != 0 ||
+        ioctl(fd, UFFDIO_WRITEPROTECT, &wp) != 0) {
+        close(fd);
+        return -1;
+    }
+    r->uffd = fd;
+    return 0;
+}
+
+// 按位图批量重标记，返回页数
+static int64_t region_tag_bitmap(aes_sm3_region_t* r, const uint64_t* bitmap) {
+    uint64_t lbas[64];
+    const uint8_t* inputs[64];
+    uint8_t* outputs[64];
+    int n = 0;
+    int64_t total = 0;
+
+    for (uint64_t w = 0; w < (r->page_count + 63) / 64; w++) {
+        uint64_t bits = bitmap[w];
+        while (bits) {
+            uint64_t p = w * 64 + (uint64_t)__builtin_ctzll(bits);
+            bits &= bits - 1;
+            lbas[n] = p;
+            inputs[n] = r->base + p * 4096;
+            outputs[n] = r->tags + p * 32;
+            if (++n == 64) {
+                aes_sm3_integrity_batch_domain(r->midstate, lbas, inputs, outputs, n);
+                total += n;
+                n = 0;
+            }
+        }
+    }
+    if (n > 0) {
+        aes_sm3_integrity_batch_domain(r->midstate, lbas, inputs, outputs, n);
+        total += n;
+    }
+    return total;
+}
+
+static void region_unregister(aes_sm3_region_t* r) {
+    pthread_mutex_lock(&region_registry_lock);
+    for (aes_sm3_region_t** pp = &region_registry; *pp; pp = &(*pp)->next) {
+        if (*pp == r) {
+            *pp = r->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&region_registry_lock);
+}
+
+void aes_sm3_region_untrack(aes_sm3_region_t* r) {
+    if (!r) {
+        return;
+    }
+    if (r->backend == AES_SM3_TRACK_SOFT_DIRTY) {
+        region_unregister(r);
+    }
+    if (r->uffd >= 0) {
+        close(r->uffd);   // 关闭即注销并解除写保护
+    }
+    if (r->pagemap_fd >= 0) {
+        close(r->pagemap_fd);
+    }
+    free(r->pending);
+    free(r);
+}
+
+// 开始跟踪 [base, base+size)，并全量计算一次标签写入tags（page_count × 32字节）
+// backend为AES_SM3_TRACK_AUTO时依次尝试UFFD_WP、SOFT_DIRTY、FULL；
+// 指定的后端不可用时返回NULL。midstate为NULL时使用默认域
+aes_sm3_region_t* aes_sm3_region_track(void* base, size_t size, const uint32_t* midstate,
+                                       uint8_t* tags, int backend) {
+    if (((uintptr_t)base & 4095) || (size & 4095) || size == 0 || !tags) {
+        return NULL;
+    }
+    aes_sm3_region_t* r = (aes_sm3_region_t*)calloc(1, sizeof(aes_sm3_region_t));
+    if (!r) {
+        return NULL;
+    }
+    r->base = (uint8_t*)base;
+    r->page_count = size / 4096;
+    r->tags = tags;
+    r->uffd = -1;
+    r->pagemap_fd = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+    r->pm_scan = r->pagemap_fd >= 0;
+    memcpy(r->midstate, midstate ? midstate : SM3_IV, sizeof(r->midstate));
+
+    // 1. 异步写保护（需要PAGEMAP_SCAN收割已写页）
+    if ((backend == AES_SM3_TRACK_AUTO || backend == AES_SM3_TRACK_UFFD_WP) && r->pm_scan &&
+        region_setup_uffd(r) == 0) {
+        r->backend = AES_SM3_TRACK_UFFD_WP;
+    }
+
+    // 2. 软脏位：登记后清除，全量标记之后的写入都会被看到
+    if (!r->backend && (backend == AES_SM3_TRACK_AUTO || backend == AES_SM3_TRACK_SOFT_DIRTY) &&
+        r->pagemap_fd >= 0) {
+        r->pending = (uint64_t*)calloc((r->page_count + 63) / 64, sizeof(uint64_t));
+        pthread_mutex_lock(&region_registry_lock);
+        if (region_soft_dirty_ok < 0) {
+            region_soft_dirty_ok = region_registry ? 1 : region_probe_soft_dirty();
+        }
+        int ok = r->pending && region_soft_dirty_ok;
+        for (aes_sm3_region_t* o = region_registry; ok && o; o = o->next) {
+            ok = region_harvest_soft_dirty(o, o->pending) == 0;
+        }
+        if (ok && region_clear_refs() == 0) {
+            r->backend = AES_SM3_TRACK_SOFT_DIRTY;
+            r->next = region_registry;
+            region_registry = r;
+        }
+        pthread_mutex_unlock(&region_registry_lock);
+    }
+
+    if (!r->backend && (backend == AES_SM3_TRACK_AUTO || backend == AES_SM3_TRACK_FULL)) {
+        r->backend = AES_SM3_TRACK_FULL;
+    }
+    if (!r->backend) {
+        aes_sm3_region_untrack(r);
+        return NULL;
+    }
+
+    sync_tag_pages(r->midstate, r->base, r->page_count * 4096, 0, r->tags);
+    return r;
+}
+
+int aes_sm3_region_backend(const aes_sm3_region_t* r) {
+    return r->backend;
+}
+
+// 重标记上次刷新（或开始跟踪）之后被写过的页，返回重标记的页数，出错返回-1
+int64_t aes_sm3_region_refresh(aes_sm3_region_t* r) {
+    if (r->backend == AES_SM3_TRACK_FULL) {
+        sync_tag_pages(r->midstate, r->base, r->page_count * 4096, 0, r->tags);
+        return (int64_t)r->page_count;
+    }
+
+    size_t words = (r->page_count + 63) / 64;
+    uint64_t* dirty = (uint64_t*)calloc(words, sizeof(uint64_t));
+    int ret = dirty ? 0 : -1;
+
+    if (ret == 0 && r->backend == AES_SM3_TRACK_UFFD_WP) {
+        ret = region_pm_scan(r, PM_SCAN_WP_MATCHING | PM_SCAN_CHECK_WPASYNC, PAGE_IS_WRITTEN, dirty);
+    } else if (ret == 0) {
+        pthread_mutex_lock(&region_registry_lock);
+        for (aes_sm3_region_t* o = region_registry; ret == 0 && o; o = o->next) {
+            ret = region_harvest_soft_dirty(o, o->pending);
+        }
+        if (ret == 0) {
+            ret = region_clear_refs();
+        }
+        if (ret == 0) {
+            memcpy(dirty, r->pending, words * sizeof(uint64_t));
+            memset(r->pending, 0, words * sizeof(uint64_t));
+        }
+        pthread_mutex_unlock(&region_registry_lock);
+    }
+
+    int64_t total = ret == 0 ? region_tag_bitmap(r, dirty) : -1;
+    free(dirty);
+    return total;
+}
+
+#endif  // __linux__
+
+// ============================================================================
+// 标签记忆缓存：按（页地址, 代号）复用已计算的标签
+// ============================================================================
+/*
+ * 缓冲池在两次修改之间会反复校验同一批热页。调用方为每页维护修改代号（每次写入递增），
+ * 代号未变时标签必然不变，可以直接复用上次的结果：
+ *   - 每个条目恰好一条64字节缓存行：序号 + 地址 + LBA + 代号 + 32字节标签
+ *   - 开放寻址，从哈希位置起最多探测4条相邻缓存行，不命中即放弃（这只是缓存）
+ *   - 无锁：写者用CAS把序号从偶数改为奇数占有条目，写完再+1发布；
+ *     读者前后两次读取序号，相同且为偶数才采信（seqlock），写者竞争失败直接跳过
+ *   - 发布时序号取自全局插入时钟（2×时钟值，单调递增，兼作seqlock版本），
+ *     窗口已满时替换序号最小即最早插入的条目
+ * 命中只需一次缓存行探测，替代4KB读取与一次SM3压缩。
+ * 缓存与域绑定：标签按创建时的midstate计算，LBA也是键的一部分。
+ */
+
+#define AES_SM3_MEMO_PROBE      4
+
+typedef struct {
+    uint64_t seq;            // 奇数：写入中；偶数：2×插入时钟
+    uint64_t addr;           // 0表示空
+    uint64_t lba;
+    uint64_t generation;
+    uint64_t tag[4];
+} __attribute__((aligned(64))) memo_entry_t;
+
+struct aes_sm3_memo {
+    uint32_t midstate[8];
+    uint64_t mask;           // 条目数 - 1
+    memo_entry_t* entries;
+    uint64_t clock __attribute__((aligned(64)));     // 插入时钟（原子递增，独占缓存行）
+};
+
+typedef struct aes_sm3_memo aes_sm3_memo_t;
+
+static inline uint64_t memo_home(const aes_sm3_memo_t* m, const void* page, uint64_t lba) {
+    return fuse_murmur64((uint64_t)(uintptr_t)page ^ (lba * 0x9E3779B97F4A7C15ULL)) & m->mask;
+}
+
+// 创建容量为lines条缓存行的缓存（向下取2的幂，至少64）；midstate为NULL时使用默认域
+aes_sm3_memo_t* aes_sm3_memo_create(const uint32_t* midstate, size_t lines) {
+    size_t n = 64;
+    while (n * 2 <= lines) {
+        n *= 2;
+    }
+    aes_sm3_memo_t* m = (aes_sm3_memo_t*)calloc(1, sizeof(aes_sm3_memo_t));
+    if (!m) {
+        return NULL;
+    }
+    m->entries = (memo_entry_t*)aligned_alloc(64, n * sizeof(memo_entry_t));
+    if (!m->entries) {
+        free(m);
+        return NULL;
+    }
+    memset(m->entries, 0, n * sizeof(memo_entry_t));
+    memcpy(m->midstate, midstate ? midstate : SM3_IV, sizeof(m->midstate));
+    m->mask = n - 1;
+    return m;
+}
+
+void aes_sm3_memo_free(aes_sm3_memo_t* m) {
+    if (m) {
+        free(m->entries);
+        free(m);
+    }
+}
+
+// 一致性读取一个条目；被并发写入时返回0
+static inline int memo_read(const memo_entry_t* e, memo_entry_t* out) {
+    uint64_t s1 = __atomic_load_n(&e->seq, __ATOMIC_ACQUIRE);
+    if (s1 & 1) {
+        return 0;
+    }
+    out->addr = __atomic_load_n(&e->addr, __ATOMIC_RELAXED);
+    out->lba = __atomic_load_n(&e->lba, __ATOMIC_RELAXED);
+    out->generation = __atomic_load_n(&e->generation, __ATOMIC_RELAXED);
+    for (int k = 0; k < 4; k++) {
+        out->tag[k] = __atomic_load_n(&e->tag[k], __ATOMIC_RELAXED);
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    out->seq = s1;
+    return __atomic_load_n(&e->seq, __ATOMIC_RELAXED) == s1;
+}
+
+// 查找（页地址, LBA, 代号）；命中时写出标签并返回1
+int aes_sm3_memo_lookup(const aes_sm3_memo_t* m, const void* page, uint64_t lba,
+                        uint64_t generation, uint8_t* tag) {
+    uint64_t home = memo_home(m, page, lba);
+    memo_entry_t snap;
+
+    for (int i = 0; i < AES_SM3_MEMO_PROBE; i++) {
+        const memo_entry_t* e = &m->entries[(home + i) & m->mask];
+        if (!memo_read(e, &snap) || snap.addr != (uint64_t)(uintptr_t)page || snap.lba != lba) {
+            continue;
+        }
+        if (snap.generation != generation) {
+            return 0;   // 页已修改
+        }
+        memcpy(tag, snap.tag, 32);
+        return 1;
+    }
+    return 0;
+}
+
+// 写入（页地址, LBA, 代号）→ 标签；条目被其他写者占用时放弃
+void aes_sm3_memo_insert(aes_sm3_memo_t* m, const void* page, uint64_t lba,
+                         uint64_t generation, const uint8_t* tag) {
+    uint64_t home = memo_home(m, page, lba);
+    memo_entry_t* victim = NULL;
+    uint64_t victim_seq = UINT64_MAX;
+
+    for (int i = 0; i < AES_SM3_MEMO_PROBE; i++) {
+        memo_entry_t* e = &m->entries[(home + i) & m->mask];
+        uint64_t seq = __atomic_load_n(&e->seq, __ATOMIC_RELAXED);
+        uint64_t addr = __atomic_load_n(&e->addr, __ATOMIC_RELAXED);
+        if ((addr == (uint64_t)(uintptr_t)page && __atomic_load_n(&e->lba, __ATOMIC_RELAXED) == lba) ||
+            addr == 0) {
+            victim = e;
+            break;
+        }
+        if (seq < victim_seq) {
+            victim = e;
+            victim_seq = seq;
+        }
+    }
+
+    uint64_t s = __atomic_load_n(&victim->seq, __ATOMIC_RELAXED);
+    if ((s & 1) || !__atomic_compare_exchange_n(&victim->seq, &s, s + 1, 0,
+                                                __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return;
+    }
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    uint64_t words[4];
+    memcpy(words, tag, 32);
+    __atomic_store_n(&victim->addr, (uint64_t)(uintptr_t)page, __ATOMIC_RELAXED);
+    __atomic_store_n(&victim->lba, lba, __ATOMIC_RELAXED);
+    __atomic_store_n(&victim->generation, generation, __ATOMIC_RELAXED);
+    for (int k = 0; k < 4; k++) {
+        __atomic_store_n(&victim->tag[k], words[k], __ATOMIC_RELAXED);
+    }
+    // 新序号大于此前发布过的任何序号，读者不会把两次写入误认为同一版本
+    uint64_t stamp = __atomic_add_fetch(&m->clock, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&victim->seq, stamp * 2, __ATOMIC_RELEASE);
+}
+
+// 批量查找：先预取全部首探测行，再逐个比较；hit_bitmap第i位表示第i页命中
+// 返回命中数
+int aes_sm3_memo_lookup_batch(const aes_sm3_memo_t* m, const uint8_t** pages, const uint64_t* lbas,
+                              const uint64_t* generations, uint8_t** outputs, int count,
+                              uint64_t* hit_bitmap) {
+    int hits = 0;
+    memset(hit_bitmap, 0, (size_t)((count + 63) / 64) * sizeof(uint64_t));
+
+    for (int base = 0; base < count; base += 16) {
+        int n = count - base < 16 ? count - base : 16;
+        for (int i = 0; i < n; i++) {
+            __builtin_prefetch(&m->entries[memo_home(m, pages[base + i], lbas[base + i])], 0, 3);
+        }
+        for (int i = base; i < base + n; i++) {
+            if (aes_sm3_memo_lookup(m, pages[i], lbas[i], generations[i], outputs[i])) {
+                hit_bitmap[i / 64] |= 1ULL << (i % 64);
+                hits++;
+            }
+        }
+    }
+    return hits;
+}
+
+void aes_sm3_memo_insert_batch(aes_sm3_memo_t* m, const uint8_t** pages, const uint64_t* lbas,
+                               const uint64_t* generations, uint8_t* const* tags, int count) {
+    for (int i = 0; i < count; i++) {
+        aes_sm3_memo_insert(m, pages[i], lbas[i], generations[i], tags[i]);
+    }
+}
+
+// 批量标签（带记忆）：命中的页直接取缓存，其余页送入批量内核后写回缓存
+// 返回命中数
+int aes_sm3_integrity_batch_memo(aes_sm3_memo_t* m, const uint64_t* lbas, const uint64_t* generations,
+                                 const uint8_t** inputs, uint8_t** outputs, int batch_size) {
+    uint64_t hit_bitmap[1];
+    const uint8_t* miss_in[64];
+    uint8_t* miss_out[64];
+    uint64_t miss_lba[64];
+    uint64_t miss_gen[64];
+    int hits = 0;
+
+    for (int base = 0; base < batch_size; base += 64) {
+        int n = batch_size - base < 64 ? batch_size - base : 64;
+        hits += aes_sm3_memo_lookup_batch(m, inputs + base, lbas + base, generations + base,
+                                          outputs + base, n, hit_bitmap);
+        int misses = 0;
+        for (int i = 0; i < n; i++) {
+            if (!((hit_bitmap[0] >> i) & 1)) {
+                miss_in[misses] = inputs[base + i];
+                miss_out[misses] = outputs[base + i];
+                miss_lba[misses] = lbas[base + i];
+                miss_gen[misses] = generations[base + i];
+                misses++;
+            }
+        }
+        if (misses > 0) {
+            aes_sm3_integrity_batch_domain(m->midstate, miss_lba, miss_in, miss_out, misses);
+            aes_sm3_memo_insert_batch(m, miss_in, miss_lba, miss_gen, miss_out, misses);
+        }
+    }
+    return hits;
+}
+
+// ============================================================================
+// 跨进程共享标签缓存：mmap文件上的无锁哈希表
+// ============================================================================
+/*
+ * 同一节点上多个进程经常标记相同的数据（相同的容器镜像层、相同的共享库），
+ * 各自独立计算是重复劳动。共享缓存把块标签发布到一个mmap(MAP_SHARED)文件中，
+ * 键为（设备, inode, 文件长度, 修改时间, 块号），任何进程命中即可跳过读取与计算：
+ *   - 8路组相联：每组8个128字节槽（1KB），组内探测不越界
+ *   - 发布无锁：写者先把序号置为奇数，写键、标签与校验和，再把序号置为偶数；
+ *     读者校验序号前后一致且校验和匹配。写者中途崩溃只会留下奇数序号或校验和
+ *     不匹配的槽，读者视为未命中，下一次发布直接覆盖；并发写同一槽交错时同样由
+ *     校验和识别。校验和以创建时的随机种子参与计算
+ *   - 淘汰：组满时替换时钟戳最小的槽（近似LRU）；命中只在时钟戳明显过期时
+ *     才回写，避免热槽在进程间来回失效
+ *   - 文件在创建时加flock初始化，之后只靠原子操作；缓存与域绑定（头部记录midstate）
+ * 可以写入缓存文件的进程都被信任：文件权限就是缓存的信任边界。
+ */
+
+#define AES_SM3_SHCACHE_MAGIC     0x3130434853334D53ULL  // "SM3SHC01"
+#define AES_SM3_SHCACHE_VERSION   1
+#define AES_SM3_SHCACHE_WAYS      8
+#define AES_SM3_SHCACHE_HEADER    4096                   // 槽区按页对齐
+
+typedef struct {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t slot_count;       // 2的幂，至少一组
+    uint64_t seed;             // 校验和种子
+    uint32_t midstate[8];
+    uint64_t clock;            // 发布时钟（原子递增）
+    uint64_t reserved[7];
+} aes_sm3_shcache_header_t;
+
+typedef struct {
+    uint64_t dev;
+    uint64_t ino;
+    uint64_t size;
+    uint64_t mtime_ns;
+    uint64_t block;
+} aes_sm3_block_key_t;
+
+typedef struct {
+    uint64_t seq;              // 奇数：写入中（或写者崩溃）
+    uint64_t check;            // 0表示空槽
+    uint64_t stamp;            // 最近使用时钟（不参与校验）
+    aes_sm3_block_key_t key;
+    uint64_t tag[4];
+    uint64_t reserved[4];
+} __attribute__((aligned(64))) shcache_slot_t;
+
+struct aes_sm3_shcache {
+    aes_sm3_shcache_header_t* hdr;
+    shcache_slot_t* slots;
+    uint64_t group_mask;
+    size_t map_size;
+};
+
+typedef struct aes_sm3_shcache aes_sm3_shcache_t;
+
+static uint64_t shcache_checksum(uint64_t seed, const aes_sm3_block_key_t* key, const uint64_t* tag) {
+    const uint64_t* k = (const uint64_t*)key;
+    uint64_t h = seed;
+    for (int i = 0; i < 5; i++) {
+        h = fuse_murmur64(h ^ k[i]);
+    }
+    for (int i = 0; i < 4; i++) {
+        h = fuse_murmur64(h ^ tag[i]);
+    }
+    return h | 1;
+}
+
+static inline shcache_slot_t* shcache_group(const aes_sm3_shcache_t* c, const aes_sm3_block_key_t* key) {
+    uint64_t h = fuse_murmur64(key->ino ^ fuse_murmur64(key->dev ^ (key->block * 0x9E3779B97F4A7C15ULL)));
+    return &c->slots[(h & c->group_mask) * AES_SM3_SHCACHE_WAYS];
+}
+
+// 打开（不存在时创建）共享缓存；slots仅在创建时使用，向上取2的幂
+// 已有文件的域与midstate不同时返回NULL；midstate为NULL时使用默认域
+aes_sm3_shcache_t* aes_sm3_shared_cache_open(const char* path, const uint32_t* midstate, uint64_t slots) {
+    const uint32_t* mid = midstate ? midstate : SM3_IV;
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return NULL;
+    }
+    flock(fd, LOCK_EX);
+
+    aes_sm3_shcache_header_t hdr;
+    struct stat st;
+    int ok = fstat(fd, &st) == 0;
+    if (ok && st.st_size == 0) {
+        uint64_t n = AES_SM3_SHCACHE_WAYS;
+        while (n < slots) {
+            n *= 2;
+        }
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.magic = AES_SM3_SHCACHE_MAGIC;
+        hdr.version = AES_SM3_SHCACHE_VERSION;
+        hdr.header_size = AES_SM3_SHCACHE_HEADER;
+        hdr.slot_count = n;
+        hdr.seed = fuse_murmur64((uint64_t)ts.tv_nsec ^ ((uint64_t)ts.tv_sec << 30) ^ (uint64_t)getpid());
+        memcpy(hdr.midstate, mid, sizeof(hdr.midstate));
+        // 先扩展为全零的槽区，再写头部：头部有效时槽区必然存在
+        ok = ftruncate(fd, (off_t)(AES_SM3_SHCACHE_HEADER + n * sizeof(shcache_slot_t))) == 0 &&
+             pwrite(fd, &hdr, sizeof(hdr), 0) == (ssize_t)sizeof(hdr);
+        st.st_size = (off_t)(AES_SM3_SHCACHE_HEADER + n * sizeof(shcache_slot_t));
+    } else if (ok) {
+        ok = pread(fd, &hdr, sizeof(hdr), 0) == (ssize_t)sizeof(hdr) &&
+             hdr.magic == AES_SM3_SHCACHE_MAGIC && hdr.version == AES_SM3_SHCACHE_VERSION &&
+             hdr.header_size == AES_SM3_SHCACHE_HEADER && hdr.slot_count >= AES_SM3_SHCACHE_WAYS &&
+             (hdr.slot_count & (hdr.slot_count - 1)) == 0 &&
+             (uint64_t)st.st_size == AES_SM3_SHCACHE_HEADER + hdr.slot_count * sizeof(shcache_slot_t) &&
+             memcmp(hdr.midstate, mid, sizeof(hdr.midstate)) == 0;
+    }
+    flock(fd, LOCK_UN);
+
+    void* map = ok ? mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+
+    aes_sm3_shcache_t* c = (aes_sm3_shcache_t*)calloc(1, sizeof(aes_sm3_shcache_t));
+    if (!c) {
+        munmap(map, (size_t)st.st_size);
+        return NULL;
+    }
+    c->hdr = (aes_sm3_shcache_header_t*)map;
+    c->slots = (shcache_slot_t*)((uint8_t*)map + AES_SM3_SHCACHE_HEADER);
+    c->group_mask = hdr.slot_count / AES_SM3_SHCACHE_WAYS - 1;
+    c->map_size = (size_t)st.st_size;
+    return c;
+}
+
+void aes_sm3_shared_cache_close(aes_sm3_shcache_t* c) {
+    if (c) {
+        munmap(c->hdr, c->map_size);
+        free(c);
+    }
+}
+
+// 由已打开文件的状态构造块键
+int aes_sm3_block_key_from_fd(int fd, uint64_t block, aes_sm3_block_key_t* key) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        return -1;
+    }
+    key->dev = (uint64_t)st.st_dev;
+    key->ino = (uint64_t)st.st_ino;
+    key->size = (uint64_t)st.st_size;
+    key->mtime_ns = (uint64_t)st.st_mtim.tv_sec * 1000000000ULL + (uint64_t)st.st_mtim.tv_nsec;
+    key->block = block;
+    return 0;
+}
+
+// 查找块标签，命中返回1
+int aes_sm3_shared_cache_lookup(aes_sm3_shcache_t* c, const aes_sm3_block_key_t* key, uint8_t* tag) {
+    shcache_slot_t* group = shcache_group(c, key);
+    for (int w = 0; w < AES_SM3_SHCACHE_WAYS; w++) {
+        shcache_slot_t* s = &group[w];
+        uint64_t s1 = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+        if (s1 & 1) {
+            continue;
+        }
+        aes_sm3_block_key_t k;
+        uint64_t t[4];
+        uint64_t* kw = (uint64_t*)&k;
+        const uint64_t* sw = (const uint64_t*)&s->key;
+        for (int i = 0; i < 5; i++) {
+            kw[i] = __atomic_load_n(&sw[i], __ATOMIC_RELAXED);
+        }
+        for (int i = 0; i < 4; i++) {
+            t[i] = __atomic_load_n(&s->tag[i], __ATOMIC_RELAXED);
+        }
+        uint64_t check = __atomic_load_n(&s->check, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&s->seq, __ATOMIC_RELAXED) != s1 || check == 0 ||
+            memcmp(&k, key, sizeof(k)) != 0 || check != shcache_checksum(c->hdr->seed, &k, t)) {
+            continue;
+        }
+
+        uint64_t now = __atomic_load_n(&c->hdr->clock, __ATOMIC_RELAXED);
+        if (now - __atomic_load_n(&s->stamp, __ATOMIC_RELAXED) > c->hdr->slot_count / 4) {
+            __atomic_store_n(&s->stamp, now, __ATOMIC_RELAXED);
+        }
+        memcpy(tag, t, 32);
+        return 1;
+    }
+    return 0;
+}
+
+// 发布块标签：同键槽 > 空槽 > 时钟戳最小的槽
+void aes_sm3_shared_cache_publish(aes_sm3_shcache_t* c, const aes_sm3_block_key_t* key, const uint8_t* tag) {
+    shcache_slot_t* group = shcache_group(c, key);
+    shcache_slot_t* victim = NULL;
+    uint64_t oldest = UINT64_MAX;
+
+    for (int w = 0; w < AES_SM3_SHCACHE_WAYS; w++) {
+        shcache_slot_t* s = &group[w];
+        if (__atomic_load_n(&s->check, __ATOMIC_RELAXED) == 0 ||
+            memcmp(&s->key, key, sizeof(*key)) == 0) {
+            victim = s;
+            break;
+        }
+        uint64_t stamp = __atomic_load_n(&s->stamp, __ATOMIC_RELAXED);
+        if (stamp < oldest) {
+            oldest = stamp;
+            victim = s;
+        }
+    }
+
+    uint64_t t[4];
+    memcpy(t, tag, 32);
+    uint64_t odd = __atomic_load_n(&victim->seq, __ATOMIC_RELAXED) | 1;
+    __atomic_store_n(&victim->seq, odd, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    uint64_t* dw = (uint64_t*)&victim->key;
+    const uint64_t* kw = (const uint64_t*)key;
+    for (int i = 0; i < 5; i++) {
+        __atomic_store_n(&dw[i], kw[i], __ATOMIC_RELAXED);
+    }
+    for (int i = 0; i < 4; i++) {
+        __atomic_store_n(&victim->tag[i], t[i], __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&victim->check, shcache_checksum(c->hdr->seed, key, t), __ATOMIC_RELAXED);
+    __atomic_store_n(&victim->stamp, __atomic_fetch_add(&c->hdr->clock, 1, __ATOMIC_RELAXED),
+                     __ATOMIC_RELAXED);
+    __atomic_store_n(&victim->seq, odd + 1, __ATOMIC_RELEASE);
+}
+
+#define AES_SM3_SHCACHE_RETRIES   3         // 读取期间文件被修改时的重试次数
+
+// 标记一遍：返回块数，出错返回-1，读取期间文件被修改返回-2（已计算的标签不可信）
+// 块数超过max_blocks（tags容量）时同样视为被修改
+static int64_t shcache_tag_file_once(aes_sm3_shcache_t* c, int fd, uint8_t* buf, uint64_t max_blocks,
+                                     uint8_t* tags, uint64_t* hits) {
+    aes_sm3_block_key_t key;
+    if (aes_sm3_block_key_from_fd(fd, 0, &key) != 0) {
+        return -1;
+    }
+    const uint32_t* mid = c->hdr->midstate;
+    uint64_t blocks = (key.size + 4095) / 4096;
+    *hits = 0;
+    if (blocks > max_blocks) {
+        return -2;
+    }
+
+    for (uint64_t b = 0; b < blocks; b += AES_SM3_SYNC_CHUNK_PAGES) {
+        int n = (int)(blocks - b < AES_SM3_SYNC_CHUNK_PAGES ? blocks - b : AES_SM3_SYNC_CHUNK_PAGES);
+        const uint8_t* inputs[AES_SM3_SYNC_CHUNK_PAGES];
+        uint8_t* outputs[AES_SM3_SYNC_CHUNK_PAGES];
+        uint64_t lbas[AES_SM3_SYNC_CHUNK_PAGES];
+        int misses = 0;
+
+        for (int i = 0; i < n; i++) {
+            key.block = b + i;
+            if (aes_sm3_shared_cache_lookup(c, &key, tags + (b + i) * 32)) {
+                (*hits)++;
+                continue;
+            }
+            inputs[misses] = buf + (size_t)i * 4096;
+            outputs[misses] = tags + (b + i) * 32;
+            lbas[misses] = b + i;
+            misses++;
+        }
+
+        // 只读取未命中块组成的连续区间
+        for (int k = 0; k < misses;) {
+            int run = 1;
+            while (k + run < misses && lbas[k + run] == lbas[k] + run) {
+                run++;
+            }
+            uint64_t off = lbas[k] * 4096;
+            size_t len = (size_t)(key.size - off < (uint64_t)run * 4096 ? key.size - off : (uint64_t)run * 4096);
+            uint8_t* dst = buf + (size_t)(lbas[k] - b) * 4096;
+            ssize_t got = pread(fd, dst, len, (off_t)off);
+            if (got < 0) {
+                return -1;
+            }
+            if ((size_t)got != len) {
+                return -2;                               // 读取期间被截断
+            }
+            memset(dst + len, 0, (size_t)run * 4096 - len);
+            k += run;
+        }
+        if (misses == 0) {
+            continue;
+        }
+        aes_sm3_integrity_batch_domain(mid, lbas, inputs, outputs, misses);
+
+        // 读取期间文件被修改：键中的修改时间已不代表读到的内容，既不发布也不返回
+        aes_sm3_block_key_t now;
+        if (aes_sm3_block_key_from_fd(fd, 0, &now) != 0) {
+            return -1;
+        }
+        if (now.size != key.size || now.mtime_ns != key.mtime_ns) {
+            return -2;
+        }
+        for (int i = 0; i < misses; i++) {
+            key.block = lbas[i];
+            aes_sm3_shared_cache_publish(c, &key, outputs[i]);
+        }
+    }
+    return (int64_t)blocks;
+}
+
+// 借助共享缓存标记整个文件：命中的块不读取，未命中的块按连续区间读取、计算并发布
+// tags需容纳 ceil(文件长度/4096) × 32字节（尾块补零，与清单一致）
+// 返回块数，出错返回-1；读取期间文件反复被修改时返回-1且errno = EAGAIN；hits可为NULL
+int64_t aes_sm3_shared_cache_tag_file(aes_sm3_shcache_t* c, const char* path, uint8_t* tags, uint64_t* hits) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    uint8_t* buf = (uint8_t*)aligned_alloc(64, AES_SM3_SYNC_CHUNK_PAGES * 4096);
+    uint64_t hit_count = 0;
+    int64_t ret = -1;
+
+    // 重试时文件可能变长：块数不超过首次打开时的块数，tags才不会写越界
+    struct stat st;
+    uint64_t max_blocks = fstat(fd, &st) == 0 ? ((uint64_t)st.st_size + 4095) / 4096 : 0;
+    for (int attempt = 0; buf && attempt < AES_SM3_SHCACHE_RETRIES; attempt++) {
+        ret = shcache_tag_file_once(c, fd, buf, max_blocks, tags, &hit_count);
+        if (ret != -2) {
+            break;
+        }
+    }
+    if (ret == -2) {
+        ret = -1;
+        errno = EAGAIN;
+    }
+
+    free(buf);
+    close(fd);
+    if (hits) {
+        *hits = hit_count;
+    }
+    return ret;
+}
+
+// ============================================================================
+// 后台限流：令牌桶（带宽/CPU份额）+ 空闲级I/O优先级 + PSI压力退避
+// ============================================================================
+/*
+ * 后台巡检与延迟敏感的前台业务共享磁盘和核心。限流器在每处理一组块之前调用：
+ *   - 带宽：令牌桶按 速率 × 退避系数 补充，突发上限为100毫秒的额度；
+ *     令牌不足时记账为欠额并睡眠到还清（多个工作线程共享同一个桶）
+ *   - CPU份额：以线程CPU时间计量，每消耗c秒CPU就睡眠 c × (1-份额)/份额，
+ *     份额同样乘以退避系数；基准按（限流器, 线程）记录，线程首次调用时只建立基准
+ *   - I/O优先级：工作线程把自己设为IOPRIO_CLASS_IDLE（仅对BFQ等支持优先级的
+ *     调度器生效），磁盘有其他请求时不发出I/O；在调用方线程上设置的扫描返回前恢复原值
+ *   - PSI：每秒读取 /proc/pressure/io 与 /proc/pressure/cpu 的 some avg10，
+ *     超过阈值时退避系数减半（最低1/64），低于阈值一半时每秒恢复1/16（AIMD）
+ * 后台工作随前台压力升高迅速让路，压力消失后逐步恢复到配置的预算。
+ */
+
+#define AES_SM3_THROTTLE_MIN_FACTOR   (1.0 / 64)
+#define AES_SM3_THROTTLE_THREADS      64          // 记录CPU基准的线程数，超出时轮换替换
+#define AES_SM3_THROTTLE_MAX_CPU_NS   100000000ULL // 单次调用最多计入的CPU时间
+
+typedef struct {
+    pthread_t thread;
+    uint64_t cpu_ns;           // 上次调用时的线程CPU时间
+    int used;
+} throttle_thread_t;
+
+struct aes_sm3_throttle {
+    pthread_mutex_t lock;
+    double bytes_per_sec;      // 0表示不限带宽
+    double cpu_share;          // (0,1]，1表示不限CPU
+    double psi_threshold;      // some avg10百分比阈值，<=0关闭PSI退避
+    double factor;             // 退避系数 (0,1]
+    double tokens;             // 可为负（欠额）
+    uint64_t last_refill_ns;
+    uint64_t last_psi_ns;
+    double last_pressure;
+    throttle_thread_t threads[AES_SM3_THROTTLE_THREADS];
+    int thread_next;           // 下一个替换位置
+};
+
+typedef struct aes_sm3_throttle aes_sm3_throttle_t;
+
+static uint64_t throttle_clock_ns(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void throttle_sleep_ns(uint64_t ns) {
+    struct timespec ts = {(time_t)(ns / 1000000000ULL), (long)(ns % 1000000000ULL)};
+    nanosleep(&ts, NULL);
+}
+
+// 读取PSI文件中 "some avg10=" 的值（百分比），不可用时返回-1
+static double throttle_read_psi(const char* path) {
+    double value = -1.0;
+#if defined(__linux__)
+    FILE* fp = fopen(path, "r");
+    if (fp) {
+        char line[256];
+        while (fgets(line, sizeof(line), fp)) {
+            if (strncmp(line, "some ", 5) == 0) {
+                const char* p = strstr(line, "avg10=");
+                if (p) {
+                    value = atof(p + 6);
+                }
+                break;
+            }
+        }
+        fclose(fp);
+    }
+#else
+    (void)path;
+#endif
+    return value;
+}
+
+// mb_per_sec<=0不限带宽；cpu_share不在(0,1)时不限CPU；psi_threshold<=0关闭PSI退避
+aes_sm3_throttle_t* aes_sm3_throttle_create(double mb_per_sec, double cpu_share, double psi_threshold) {
+    aes_sm3_throttle_t* t = (aes_sm3_throttle_t*)calloc(1, sizeof(aes_sm3_throttle_t));
+    if (!t) {
+        return NULL;
+    }
+    pthread_mutex_init(&t->lock, NULL);
+    t->bytes_per_sec = mb_per_sec > 0 ? mb_per_sec * 1024.0 * 1024.0 : 0;
+    t->cpu_share = cpu_share > 0 && cpu_share < 1 ? cpu_share : 1.0;
+    t->psi_threshold = psi_threshold;
+    t->factor = 1.0;
+    t->tokens = t->bytes_per_sec * 0.1;
+    t->last_refill_ns = throttle_clock_ns(CLOCK_MONOTONIC);
+    t->last_psi_ns = t->last_refill_ns;
+    return t;
+}
+
+void aes_sm3_throttle_free(aes_sm3_throttle_t* t) {
+    if (t) {
+        pthread_mutex_destroy(&t->lock);
+        free(t);
+    }
+}
+
+// 当前退避系数（1表示满速）
+double aes_sm3_throttle_factor(aes_sm3_throttle_t* t) {
+    pthread_mutex_lock(&t->lock);
+    double f = t->factor;
+    pthread_mutex_unlock(&t->lock);
+    return f;
+}
+
+// 按压力值（百分比）调整退避系数；PSI采样调用，也可传入外部的前台压力信号
+void aes_sm3_throttle_observe(aes_sm3_throttle_t* t, double pressure) {
+    pthread_mutex_lock(&t->lock);
+    t->last_pressure = pressure;
+    if (t->psi_threshold > 0 && pressure > t->psi_threshold) {
+        t->factor *= 0.5;
+        if (t->factor < AES_SM3_THROTTLE_MIN_FACTOR) {
+            t->factor = AES_SM3_THROTTLE_MIN_FACTOR;
+        }
+    } else if (pressure < t->psi_threshold * 0.5) {
+        t->factor += 1.0 / 16;
+        if (t->factor > 1.0) {
+            t->factor = 1.0;
+        }
+    }
+    pthread_mutex_unlock(&t->lock);
+}
+
+// 把调用线程设为空闲级I/O优先级；返回0成功
+int aes_sm3_throttle_idle_io(void) {
+#if defined(__linux__) && defined(SYS_ioprio_set)
+    const int who_process = 1, class_idle = 3, class_shift = 13;
+    return (int)syscall(SYS_ioprio_set, who_process, 0, class_idle << class_shift);
+#else
+    return -1;
+#endif
+}
+
+// 调用线程当前的I/O优先级；不可用时返回-1
+static int throttle_ioprio_get(void) {
+#if defined(__linux__) && defined(SYS_ioprio_get)
+    const int who_process = 1;
+    return (int)syscall(SYS_ioprio_get, who_process, 0);
+#else
+    return -1;
+#endif
+}
+
+// 恢复throttle_ioprio_get取得的I/O优先级
+static void throttle_ioprio_set(int ioprio) {
+#if defined(__linux__) && defined(SYS_ioprio_set)
+    const int who_process = 1;
+    if (ioprio >= 0) {
+        syscall(SYS_ioprio_set, who_process, 0, ioprio);
+    }
+#else
+    (void)ioprio;
+#endif
+}
+
+// 交换调用线程在t中的CPU基准；首次调用（或线程号被复用后时钟回退）返回0
+static uint64_t throttle_swap_thread_cpu(aes_sm3_throttle_t* t, uint64_t cpu_now) {
+    pthread_t self = pthread_self();
+    throttle_thread_t* e = NULL;
+    for (int i = 0; i < AES_SM3_THROTTLE_THREADS && !e; i++) {
+        if (t->threads[i].used && pthread_equal(t->threads[i].thread, self)) {
+            e = &t->threads[i];
+        }
+    }
+    uint64_t prev = 0;
+    if (e) {
+        prev = e->cpu_ns <= cpu_now ? e->cpu_ns : 0;
+    } else {
+        e = &t->threads[t->thread_next];
+        t->thread_next = (t->thread_next + 1) % AES_SM3_THROTTLE_THREADS;
+        e->thread = self;
+        e->used = 1;
+    }
+    e->cpu_ns = cpu_now;
+    return prev;
+}
+
+// 处理bytes字节之前调用：按带宽与CPU预算睡眠；t为NULL时立即返回
+void aes_sm3_throttle_acquire(aes_sm3_throttle_t* t, uint64_t bytes) {
+    if (!t) {
+        return;
+    }
+    uint64_t now = throttle_clock_ns(CLOCK_MONOTONIC);
+    uint64_t wait_ns = 0;
+
+    if (t->psi_threshold > 0) {
+        int sample = 0;
+        pthread_mutex_lock(&t->lock);
+        if (now - t->last_psi_ns >= 1000000000ULL) {
+            t->last_psi_ns = now;
+            sample = 1;
+        }
+        pthread_mutex_unlock(&t->lock);
+        if (sample) {
+            double io = throttle_read_psi("/proc/pressure/io");
+            double cpu = throttle_read_psi("/proc/pressure/cpu");
+            if (io >= 0 || cpu >= 0) {
+                aes_sm3_throttle_observe(t, io > cpu ? io : cpu);
+            }
+        }
+    }
+
+    pthread_mutex_lock(&t->lock);
+    double factor = t->factor;
+    if (t->bytes_per_sec > 0) {
+        double rate = t->bytes_per_sec * factor;
+        double burst = rate * 0.1;
+        t->tokens += (double)(now - t->last_refill_ns) * 1e-9 * rate;
+        if (t->tokens > burst) {
+            t->tokens = burst;
+        }
+        t->last_refill_ns = now;
+        t->tokens -= (double)bytes;
+        if (t->tokens < 0) {
+            wait_ns = (uint64_t)(-t->tokens / rate * 1e9);
+        }
+    }
+    // CPU份额：按本线程上次调用本限流器以来消耗的CPU时间补偿睡眠。
+    // 基准每次都更新（满速时也是），退避开始后不会把满速期间的CPU时间算进来
+    double share = t->cpu_share * factor;
+    uint64_t cpu_now = throttle_clock_ns(CLOCK_THREAD_CPUTIME_ID);
+    uint64_t cpu_prev = throttle_swap_thread_cpu(t, cpu_now);
+    pthread_mutex_unlock(&t->lock);
+
+    if (cpu_prev != 0 && share < 1.0) {
+        uint64_t used = cpu_now - cpu_prev;
+        if (used > AES_SM3_THROTTLE_MAX_CPU_NS) {
+            used = AES_SM3_THROTTLE_MAX_CPU_NS;
+        }
+        uint64_t cpu_wait = (uint64_t)((double)used * (1.0 - share) / share);
+        if (cpu_wait > wait_ns) {
+            wait_ns = cpu_wait;
+        }
+    }
+
+    if (wait_ns > 0) {
+        throttle_sleep_ns(wait_ns);
+    }
+}
+
+// ============================================================================
+// 可恢复扫描：检查点日志 + 部分清单，中断后从最近检查点继续（Linux）
+// ============================================================================
+/*
+ * 扫描数百TB的归档需要数天，任何中断（重启、OOM）都不应让进度归零。扫描器按
+ * 确定的顺序（目录内按名称排序）遍历目录树，为每个文件写 `清单目录/<相对路径>.sm3m`：
+ *   - 进行中的文件写入 .sm3m.part 部分清单（格式同清单，头部页数 = 已标记页数）
+ *   - 每隔checkpoint_ms：先fdatasync部分清单，再向日志追加检查点记录并fdatasync
+ *       C <偏移> <文件长度> <修改时间ns> <相对路径>
+ *   - 文件完成：fdatasync清单后重命名为 .sm3m，再追加 F <相对路径>
+ *     （F记录随下一个检查点落盘；丢失只会导致该文件被重扫）
+ *   - 重命名前再次检查文件长度与修改时间，扫描期间被修改的文件从头重扫
+ *   - 日志按行记录，名称含换行符的文件无法记录，计为失败并跳过
+ * 恢复时跳过日志中已完成的文件；对检查点所在文件，长度与修改时间不变时
+ * 重新计算检查点前最多64页并与部分清单中的标签比较，一致才从检查点继续，
+ * 否则该文件从头开始。日志末尾不完整的记录（写入中断电）被截掉。
+ * 扫描完成后日志保留，再次运行只会跳过全部文件；重新全量扫描时删除日志即可。
+ */
+
+#if defined(__linux__)
+
+#define AES_SM3_SCAN_VERIFY_PAGES   64
+#define AES_SM3_SCAN_RESTARTS       3       // 扫描期间被修改的文件最多重扫次数
+
+typedef struct {
+    const uint32_t* midstate;    // NULL使用默认域
+    int checkpoint_ms;           // 检查点间隔；<=0时每个块组（256KB）都写检查点
+    uint64_t max_bytes;          // 本次运行最多标记的字节数，0表示不限
+    volatile int* stop;          // 非NULL且被置1时写检查点后返回
+    aes_sm3_throttle_t* throttle;  // 非NULL时按预算限流并使用空闲级I/O优先级
+} aes_sm3_scan_opts_t;
+
+typedef struct {
+    uint64_t files_done;         // 本次完成的文件
+    uint64_t files_skipped;      // 日志中已完成而跳过的文件
+    uint64_t files_failed;       // 无法读取的文件
+    uint64_t bytes_hashed;       // 本次标记的字节数
+    uint64_t resumed_offset;     // 从检查点恢复时的文件内偏移
+} aes_sm3_scan_stats_t;
+
+typedef struct {
+    const char* root;
+    const char* manifest_root;
+    const aes_sm3_scan_opts_t* opts;
+    aes_sm3_scan_stats_t* stats;
+    uint32_t midstate[8];
+    int journal_fd;
+    char** done;                 // 已完成的相对路径（有序）
+    size_t done_count;
+    char* resume_rel;            // 检查点所在文件（NULL表示无）
+    uint64_t resume_offset;
+    uint64_t resume_size;
+    uint64_t resume_mtime;
+    uint64_t last_sync_ns;
+    uint8_t* buf;
+} scan_ctx_t;
+
+static int scan_cmp_str(const void* a, const void* b) {
+    return strcmp(*(const char* const*)a, *(const char* const*)b);
+}
+
+static int scan_is_done(const scan_ctx_t* s, const char* rel) {
+    return s->done_count > 0 &&
+           bsearch(&rel, s->done, s->done_count, sizeof(char*), scan_cmp_str) != NULL;
+}
+
+// 读取日志：收集F记录与最后一条C记录，截掉末尾不完整的记录
+static int scan_load_journal(scan_ctx_t* s) {
+    struct stat st;
+    if (fstat(s->journal_fd, &st) != 0) {
+        return -1;
+    }
+    char* text = (char*)malloc((size_t)st.st_size + 1);
+    if (!text || pread(s->journal_fd, text, (size_t)st.st_size, 0) != (ssize_t)st.st_size) {
+        free(text);
+        return -1;
+    }
+    text[st.st_size] = '\0';
+
+    size_t cap = 0;
+    char* line = text;
+    char* nl;
+    while ((nl = strchr(line, '\n')) != NULL) {
+        *nl = '\0';
+        unsigned long long off, size, mtime;
+        int consumed = 0;
+        if (line[0] == 'F' && line[1] == ' ') {
+            if (s->done_count == cap) {
+                char** grown = (char**)realloc(s->done, (cap ? cap * 2 : 1024) * sizeof(char*));
+                if (!grown) {
+                    free(text);
+                    return -1;
+                }
+                s->done = grown;
+                cap = cap ? cap * 2 : 1024;
+            }
+            if ((s->done[s->done_count] = strdup(line + 2)) == NULL) {
+                free(text);
+                return -1;
+            }
+            s->done_count++;
+        } else if (sscanf(line, "C %llu %llu %llu %n", &off, &size, &mtime, &consumed) == 3 && consumed > 0) {
+            free(s->resume_rel);
+            if ((s->resume_rel = strdup(line + consumed)) == NULL) {
+                free(text);
+                return -1;
+            }
+            s->resume_offset = off;
+            s->resume_size = size;
+            s->resume_mtime = mtime;
+        }
+        line = nl + 1;
+    }
+    int ret = ftruncate(s->journal_fd, (off_t)(line - text)) == 0 ? 0 : -1;
+    free(text);
+
+    if (s->done_count > 1) {
+        qsort(s->done, s->done_count, sizeof(char*), scan_cmp_str);
+    }
+    if (s->resume_rel && scan_is_done(s, s->resume_rel)) {
+        free(s->resume_rel);
+        s->resume_rel = NULL;
+    }
+    return ret;
+}
+
+static int scan_journal_append(scan_ctx_t* s, const char* record) {
+    size_t len = strlen(record);
+    return write(s->journal_fd, record, len) == (ssize_t)len ? 0 : -1;
+}
+
+static int scan_checkpoint(scan_ctx_t* s, int man_fd, const char* rel, uint64_t offset,
+                           uint64_t size, uint64_t mtime) {
+    char* record = (char*)malloc(strlen(rel) + 80);
+    int ret = record ? 0 : -1;
+    if (ret == 0) {
+        sprintf(record, "C %llu %llu %llu %s\n", (unsigned long long)offset,
+                (unsigned long long)size, (unsigned long long)mtime, rel);
+        ret = fdatasync(man_fd) == 0 && scan_journal_append(s, record) == 0 &&
+              fdatasync(s->journal_fd) == 0 ? 0 : -1;
+    }
+    free(record);
+    s->last_sync_ns = watch_now_ns();
+    return ret;
+}
+
+// 校验部分清单中检查点之前的尾部标签，返回可继续的页数（0表示从头开始）
+static uint64_t scan_validate_part(scan_ctx_t* s, int data_fd, int man_fd, uint64_t pages) {
+    aes_sm3_manifest_header_t hdr;
+    if (pages == 0 || pread(man_fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr) ||
+        hdr.magic != AES_SM3_MANIFEST_MAGIC || hdr.header_size != sizeof(hdr) ||
+        memcmp(hdr.midstate, s->midstate, sizeof(hdr.midstate)) != 0 || hdr.page_count < pages) {
+        return 0;
+    }
+    uint64_t first = pages > AES_SM3_SCAN_VERIFY_PAGES ? pages - AES_SM3_SCAN_VERIFY_PAGES : 0;
+    size_t n = (size_t)(pages - first);
+    uint8_t fresh[AES_SM3_SCAN_VERIFY_PAGES * 32];
+    uint8_t stored[AES_SM3_SCAN_VERIFY_PAGES * 32];
+
+    if (pread(data_fd, s->buf, n * 4096, (off_t)(first * 4096)) != (ssize_t)(n * 4096) ||
+        pread(man_fd, stored, n * 32, (off_t)(sizeof(hdr) + first * 32)) != (ssize_t)(n * 32)) {
+        return 0;
+    }
+    sync_tag_pages(s->midstate, s->buf, n * 4096, first, fresh);
+    return memcmp(fresh, stored, n * 32) == 0 ? pages : 0;
+}
+
+// 扫描单个文件：返回0完成（或跳过/失败计数），1被中断，-1日志写入失败
+static int scan_file(scan_ctx_t* s, const char* rel, const char* path) {
+    if (scan_is_done(s, rel)) {
+        s->stats->files_skipped++;
+        return 0;
+    }
+    char* man_path = watch_join(s->manifest_root, rel, ".sm3m");
+    char* part_path = watch_join(s->manifest_root, rel, ".sm3m.part");
+    int data_fd = open(path, O_RDONLY | O_CLOEXEC);
+    int man_fd = -1;
+    struct stat st;
+    int ret = 0;
+
+    if (!man_path || !part_path || data_fd < 0 || fstat(data_fd, &st) != 0) {
+        s->stats->files_failed++;
+        goto cleanup;
+    }
+    uint64_t size, mtime, page = 0;
+    int restarts = 0;
+restart:
+    size = (uint64_t)st.st_size;
+    mtime = (uint64_t)st.st_mtim.tv_sec * 1000000000ULL + (uint64_t)st.st_mtim.tv_nsec;
+
+    if (s->resume_rel && strcmp(s->resume_rel, rel) == 0) {
+        if (s->resume_size == size && s->resume_mtime == mtime &&
+            (man_fd = open(part_path, O_RDWR | O_CLOEXEC)) >= 0) {
+            page = scan_validate_part(s, data_fd, man_fd, s->resume_offset / 4096);
+            s->stats->resumed_offset = page * 4096;
+        }
+        free(s->resume_rel);
+        s->resume_rel = NULL;
+    }
+    if (man_fd < 0) {
+        watch_mkdirs(part_path);
+        man_fd = open(part_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    }
+    if (man_fd < 0 || ftruncate(man_fd, (off_t)(sizeof(aes_sm3_manifest_header_t) + page * 32)) != 0 ||
+        manifest_write_header(s->midstate, man_fd, page, page * 4096) != 0) {
+        s->stats->files_failed++;
+        goto cleanup;
+    }
+
+    uint8_t tags[AES_SM3_SYNC_CHUNK_PAGES * 32];
+    uint64_t full = size / 4096;
+    uint64_t interval_ns = s->opts->checkpoint_ms > 0 ? (uint64_t)s->opts->checkpoint_ms * 1000000ULL : 0;
+    while (page < full) {
+        uint64_t n = full - page < AES_SM3_SYNC_CHUNK_PAGES ? full - page : AES_SM3_SYNC_CHUNK_PAGES;
+        aes_sm3_throttle_acquire(s->opts->throttle, n * 4096);
+        if (pread(data_fd, s->buf, n * 4096, (off_t)(page * 4096)) != (ssize_t)(n * 4096)) {
+            s->stats->files_failed++;
+            goto cleanup;
+        }
+        sync_tag_pages(s->midstate, s->buf, n * 4096, page, tags);
+        if (pwrite(man_fd, tags, n * 32, (off_t)(sizeof(aes_sm3_manifest_header_t) + page * 32)) != (ssize_t)(n * 32) ||
+            manifest_write_header(s->midstate, man_fd, page + n, (page + n) * 4096) != 0) {
+            s->stats->files_failed++;
+            goto cleanup;
+        }
+        page += n;
+        s->stats->bytes_hashed += n * 4096;
+
+        int interrupted = (s->opts->stop && *s->opts->stop) ||
+                          (s->opts->max_bytes && s->stats->bytes_hashed >= s->opts->max_bytes);
+        if (interrupted || watch_now_ns() - s->last_sync_ns >= interval_ns) {
+            if (scan_checkpoint(s, man_fd, rel, page * 4096, size, mtime) != 0) {
+                ret = -1;
+                goto cleanup;
+            }
+        }
+        if (interrupted && page < full) {
+            ret = 1;
+            goto cleanup;
+        }
+    }
+
+    // 尾块补零，完成后原子替换清单
+    if (size % 4096) {
+        size_t tail = (size_t)(size % 4096);
+        if (pread(data_fd, s->buf, tail, (off_t)(full * 4096)) != (ssize_t)tail) {
+            s->stats->files_failed++;
+            goto cleanup;
+        }
+        sync_tag_pages(s->midstate, s->buf, tail, full, tags);
+        if (pwrite(man_fd, tags, 32, (off_t)(sizeof(aes_sm3_manifest_header_t) + full * 32)) != 32) {
+            s->stats->files_failed++;
+            goto cleanup;
+        }
+        s->stats->bytes_hashed += tail;
+    }
+    // 扫描期间文件被修改：清单与内容不一致，从头重扫
+    if (fstat(data_fd, &st) != 0) {
+        s->stats->files_failed++;
+        goto cleanup;
+    }
+    if ((uint64_t)st.st_size != size ||
+        (uint64_t)st.st_mtim.tv_sec * 1000000000ULL + (uint64_t)st.st_mtim.tv_nsec != mtime) {
+        if (++restarts > AES_SM3_SCAN_RESTARTS) {
+            s->stats->files_failed++;
+            goto cleanup;
+        }
+        page = 0;
+        goto restart;
+    }
+    if (manifest_write_header(s->midstate, man_fd, (size + 4095) / 4096, size) != 0 ||
+        fdatasync(man_fd) != 0 || rename(part_path, man_path) != 0) {
+        s->stats->files_failed++;
+        goto cleanup;
+    }
+    char* record = (char*)malloc(strlen(rel) + 4);
+    if (record) {
+        sprintf(record, "F %s\n", rel);
+    }
+    ret = record && scan_journal_append(s, record) == 0 ? 0 : -1;
+    free(record);
+    s->stats->files_done++;
+    if (ret == 0 && ((s->opts->stop && *s->opts->stop) ||
+                     (s->opts->max_bytes && s->stats->bytes_hashed >= s->opts->max_bytes))) {
+        ret = fdatasync(s->journal_fd) == 0 ? 1 : -1;
+    }
+
+cleanup:
+    if (man_fd >= 0) {
+        close(man_fd);
+    }
+    if (data_fd >= 0) {
+        close(data_fd);
+    }
+    free(man_path);
+    free(part_path);
+    return ret;
+}
+
+// 按名称顺序递归扫描 root/rel_dir
+static int scan_dir(scan_ctx_t* s, const char* rel_dir) {
+    char* dir = rel_dir ? watch_join(s->root, rel_dir, "") : strdup(s->root);
+    struct dirent** list = NULL;
+    int count = dir ? scandir(dir, &list, NULL, alphasort) : -1;
+    int ret = 0;
+
+    for (int i = 0; i < count; i++) {
+        const char* name = list[i]->d_name;
+        if (ret == 0 && strchr(name, '\n')) {
+            s->stats->files_failed++;                // 按行记录的日志无法表示该名称
+        } else if (ret == 0 && strcmp(name, ".") != 0 && strcmp(name, "..") != 0) {
+            char* rel = rel_dir ? watch_join(rel_dir, name, "") : strdup(name);
+            char* path = rel ? watch_join(s->root, rel, "") : NULL;
+            struct stat st;
+            if (path && lstat(path, &st) == 0) {
+                if (S_ISDIR(st.st_mode)) {
+                    ret = scan_dir(s, rel);
+                } else if (S_ISREG(st.st_mode)) {
+                    ret = scan_file(s, rel, path);
+                }
+            }
+            free(rel);
+            free(path);
+        }
+        free(list[i]);
+    }
+    free(list);
+    free(dir);
+    return ret;
+}
+
+// 扫描root下全部普通文件，进度记录在journal_path
+// 返回0扫描完成，1被中断（可再次调用继续），-1出错
+int aes_sm3_scan_run(const char* root, const char* manifest_root, const char* journal_path,
+                     const aes_sm3_scan_opts_t* opts, aes_sm3_scan_stats_t* stats) {
+    scan_ctx_t s;
+    memset(&s, 0, sizeof(s));
+    memset(stats, 0, sizeof(*stats));
+    s.root = root;
+    s.manifest_root = manifest_root;
+    s.opts = opts;
+    s.stats = stats;
+    memcpy(s.midstate, opts->midstate ? opts->midstate : SM3_IV, sizeof(s.midstate));
+    s.journal_fd = open(journal_path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    s.buf = (uint8_t*)aligned_alloc(64, AES_SM3_SYNC_CHUNK_PAGES * 4096);
+    s.last_sync_ns = watch_now_ns();
+    int saved_ioprio = -1;
+    if (opts->throttle) {
+        saved_ioprio = throttle_ioprio_get();        // 在调用方线程上设置，返回前恢复
+        aes_sm3_throttle_idle_io();
+    }
+
+    int ret = -1;
+    if (s.journal_fd >= 0 && s.buf && scan_load_journal(&s) == 0) {
+        ret = scan_dir(&s, NULL);
+        if (ret >= 0 && fdatasync(s.journal_fd) != 0) {
+            ret = -1;
+        }
+    }
+
+    if (s.journal_fd >= 0) {
+        close(s.journal_fd);
+    }
+    for (size_t i = 0; i < s.done_count; i++) {
+        free(s.done[i]);
+    }
+    free(s.done);
+    free(s.resume_rel);
+    free(s.buf);
+    throttle_ioprio_set(saved_ioprio);
+    return ret;
+}
+
+#endif  // __linux__
+
+// ============================================================================
+// 页缓存中立扫描：滑动窗口预读 + 已标记区间逐出
+// ============================================================================
+/*
+ * 普通扫描会把冷文件整个读进页缓存，挤掉数据库等邻居的热页。中立模式以256KB块为单位：
+ *   - 预读：保持 [当前块, 当前块 + 窗口) 已发出POSIX_FADV_WILLNEED
+ *   - 发出预读之前先用mincore记录该块中原本就驻留的页
+ *   - 块标记完成后对原本不驻留的页发出POSIX_FADV_DONTNEED，原本驻留的页保持不动
+ * 扫描引入的页缓存占用不超过窗口大小，扫描结束后文件的驻留状态与扫描前相同
+ * （其他进程并发读入的页被当作原本驻留，宁可少逐出也不逐出邻居的页）。
+ * 内核自带的顺序预读被关闭（POSIX_FADV_RANDOM），预读完全由窗口控制。
+ * 结果与 aes_sm3_manifest_build_file 完全一致。
+ */
+
+#define AES_SM3_NEUTRAL_CHUNK   (AES_SM3_SYNC_CHUNK_PAGES * 4096)
+
+// 文件[off, off+len)（off按页对齐，len不超过256KB）中已驻留页缓存的页，每页1位
+static uint64_t cache_chunk_resident(int fd, uint64_t off, size_t len) {
+    unsigned char vec[AES_SM3_SYNC_CHUNK_PAGES];
+    uint64_t bits = 0;
+    void* map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, (off_t)off);
+    if (map == MAP_FAILED) {
+        return 0;
+    }
+    if (mincore(map, len, vec) == 0) {
+        for (size_t p = 0; p < (len + 4095) / 4096; p++) {
+            bits |= (uint64_t)(vec[p] & 1) << p;
+        }
+    }
+    munmap(map, len);
+    return bits;
+}
+
+// 统计文件驻留页缓存的页数（类似fincore），失败返回-1
+int64_t aes_sm3_page_cache_resident(const char* path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    int64_t count = 0;
+    for (uint64_t off = 0; off < (uint64_t)st.st_size; off += AES_SM3_NEUTRAL_CHUNK) {
+        size_t len = (uint64_t)st.st_size - off < AES_SM3_NEUTRAL_CHUNK ?
+                     (size_t)((uint64_t)st.st_size - off) : AES_SM3_NEUTRAL_CHUNK;
+        count += __builtin_popcountll(cache_chunk_resident(fd, off, len));
+    }
+    close(fd);
+    return count;
+}
+
+// 页缓存中立地由文件生成清单；window_bytes为预读窗口（页缓存占用上限），至少512KB
+aes_sm3_manifest_t* aes_sm3_manifest_build_file_neutral(const uint32_t* midstate, const char* path,
+                                                        size_t window_bytes) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return NULL;
+    }
+    uint64_t size = (uint64_t)st.st_size;
+    uint64_t chunks = (size + AES_SM3_NEUTRAL_CHUNK - 1) / AES_SM3_NEUTRAL_CHUNK;
+    uint64_t window = window_bytes / AES_SM3_NEUTRAL_CHUNK < 2 ? 2 : window_bytes / AES_SM3_NEUTRAL_CHUNK;
+    aes_sm3_manifest_t* m = manifest_alloc(midstate, (size_t)size);
+    uint64_t* resident = (uint64_t*)calloc(window, sizeof(uint64_t));   // 按块号环形存放
+    uint8_t* buf = (uint8_t*)aligned_alloc(64, AES_SM3_NEUTRAL_CHUNK);
+    uint64_t advised = 0;
+    int ok = m && resident && buf;
+
+    // 关闭内核自带的预读：它会越过窗口读入后续块，使其被误判为原本驻留
+    posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
+    for (uint64_t c = 0; ok && c < chunks; c++) {
+        // 窗口内尚未预读的块：先记录原驻留页，再发出预读
+        for (; advised < chunks && advised < c + window; advised++) {
+            uint64_t off = advised * AES_SM3_NEUTRAL_CHUNK;
+            size_t len = size - off < AES_SM3_NEUTRAL_CHUNK ? (size_t)(size - off) : AES_SM3_NEUTRAL_CHUNK;
+            resident[advised % window] = cache_chunk_resident(fd, off, len);
+            posix_fadvise(fd, (off_t)off, (off_t)len, POSIX_FADV_WILLNEED);
+        }
+
+        uint64_t off = c * AES_SM3_NEUTRAL_CHUNK;
+        size_t len = size - off < AES_SM3_NEUTRAL_CHUNK ? (size_t)(size - off) : AES_SM3_NEUTRAL_CHUNK;
+        if (pread(fd, buf, len, (off_t)off) != (ssize_t)len) {
+            ok = 0;
+            break;
+        }
+        sync_tag_pages(m->hdr->midstate, buf, len, c * AES_SM3_SYNC_CHUNK_PAGES,
+                       (uint8_t*)m->tags + c * AES_SM3_SYNC_CHUNK_PAGES * 32);
+
+        // 逐出原本不驻留的连续页段
+        uint64_t keep = resident[c % window];
+        size_t pages = (len + 4095) / 4096;
+        for (size_t p = 0; p < pages;) {
+            if ((keep >> p) & 1) {
+                p++;
+                continue;
+            }
+            size_t q = p;
+            while (q < pages && !((keep >> q) & 1)) {
+                q++;
+            }
+            posix_fadvise(fd, (off_t)(off + p * 4096), (off_t)((q - p) * 4096), POSIX_FADV_DONTNEED);
+            p = q;
+        }
+    }
+
+    close(fd);
+    free(resident);
+    free(buf);
+    if (!ok) {
+        aes_sm3_manifest_free(m);
+        return NULL;
+    }
+    return m;
+}
+
+// 页缓存占用基准：后台线程每2毫秒用mincore采样文件驻留页，记录峰值
+typedef struct {
+    const char* path;
+    volatile int stop;
+    int64_t peak;
+} cache_sampler_t;
+
+static void* cache_sampler(void* arg) {
+    cache_sampler_t* s = (cache_sampler_t*)arg;
+    while (!s->stop) {
+        int64_t n = aes_sm3_page_cache_resident(s->path);
+        if (n > s->peak) {
+            s->peak = n;
+        }
+        usleep(2000);
+    }
+    return NULL;
+}
+
+// 先逐出文件（模拟冷数据），再分别用普通模式与中立模式扫描，报告耗时与驻留页峰值
+void page_cache_benchmark(const char* path, size_t window_bytes) {
+    printf("\n>>> 页缓存占用对比 (%s, 窗口 %.1f MB)\n", path, window_bytes / (1024.0 * 1024.0));
+    for (int neutral = 0; neutral <= 1; neutral++) {
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            printf("  无法打开文件\n");
+            return;
+        }
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+
+        cache_sampler_t sampler = {path, 0, 0};
+        int64_t before = aes_sm3_page_cache_resident(path);
+        pthread_t thread;
+        pthread_create(&thread, NULL, cache_sampler, &sampler);
+
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        aes_sm3_manifest_t* m = neutral ? aes_sm3_manifest_build_file_neutral(NULL, path, window_bytes)
+                                        : aes_sm3_manifest_build_file(NULL, path);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        sampler.stop = 1;
+        pthread_join(thread, NULL);
+
+        double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        double mb = m ? aes_sm3_manifest_file_size(m) / (1024.0 * 1024.0) : 0;
+        int64_t after = aes_sm3_page_cache_resident(path);
+        printf("  %s: %.2f MB/s, 驻留页 扫描前 %.1f MB / 峰值 %.1f MB / 扫描后 %.1f MB\n",
+               neutral ? "中立模式" : "普通模式", elapsed > 0 ? mb / elapsed : 0,
+               before * 4096 / (1024.0 * 1024.0), sampler.peak * 4096 / (1024.0 * 1024.0),
+               after * 4096 / (1024.0 * 1024.0));
+        aes_sm3_manifest_free(m);
+    }
+}
+
+// ============================================================================
+// 窗口化mmap引擎：超过内存的大文件按滑动窗口映射并行标记
+// ============================================================================
+/*
+ * 整个映射数TB的文件、靠缺页驱动I/O会造成停顿，RSS也不可预测。窗口引擎同时只映射
+ * 两个窗口：
+ *   - 处理当前窗口时，下一个窗口已经映射并发出MADV_WILLNEED，读盘与计算重叠
+ *   - 当前窗口按页均分给工作线程并行标记（LBA为文件内页号，与清单一致）
+ *   - 处理完的窗口MADV_DONTNEED后解除映射，映射占用固定为两个窗口
+ * 配置的窗口大小是映射预算：两个窗口合计不超过预算（预算至少2MB），单个窗口不超过预算的一半。
+ * 窗口大小按缺页停顿时间自适应：每个工作线程记录处理切片的墙钟时间与线程CPU时间，
+ * 差值即等待缺页读盘的时间。停顿超过窗口处理时间的5%，说明预读没有跟上，
+ * 窗口加倍以拉长预读提前量（不超过预算）；连续4个窗口停顿低于1%则减半
+ * （下限为上限的1/4，至少1MB），在稳定吞吐与内存占用之间取平衡。
+ */
+
+#define AES_SM3_MMAP_MIN_WINDOW   (1u << 20)
+#define AES_SM3_MMAP_STALL_GROW   0.05      // 停顿占比超过此值时加倍
+#define AES_SM3_MMAP_STALL_CALM   0.01      // 停顿占比低于此值视为平稳
+
+typedef struct {
+    uint64_t windows;              // 处理的窗口数
+    uint64_t major_faults;         // 处理窗口期间的主缺页总数
+    uint64_t stall_ns;             // 处理窗口期间工作线程的停顿总和（墙钟 - 线程CPU）
+    size_t window_bytes;           // 结束时的窗口大小
+    size_t max_window_bytes;       // 过程中的最大窗口
+} aes_sm3_mmap_stats_t;
+
+typedef struct {
+    const uint32_t* midstate;
+    const uint8_t* data;
+    size_t size;
+    uint64_t first_page;
+    uint8_t* tags;
+    uint64_t wall_ns;              // 输出：处理切片的墙钟时间
+    uint64_t cpu_ns;               // 输出：处理切片的线程CPU时间
+} mmap_slice_t;
+
+static uint64_t mmap_clock_ns(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void* mmap_slice_worker(void* arg) {
+    mmap_slice_t* s = (mmap_slice_t*)arg;
+    uint64_t wall0 = mmap_clock_ns(CLOCK_MONOTONIC);
+    uint64_t cpu0 = mmap_clock_ns(CLOCK_THREAD_CPUTIME_ID);
+    sync_tag_pages(s->midstate, s->data, s->size, s->first_page, s->tags);
+    s->cpu_ns = mmap_clock_ns(CLOCK_THREAD_CPUTIME_ID) - cpu0;
+    s->wall_ns = mmap_clock_ns(CLOCK_MONOTONIC) - wall0;
+    return NULL;
+}
+
+// 按页把窗口均分给num_threads个线程（最后一段含不满页的文件尾）
+// 返回各线程墙钟时间之和，*stall_ns为其中未在CPU上运行（主要是缺页等待）的部分
+static uint64_t mmap_tag_window(const uint32_t* midstate, const uint8_t* data, size_t len,
+                                uint64_t first_page, uint8_t* tags, int num_threads, uint64_t* stall_ns) {
+    uint64_t pages = (len + 4095) / 4096;
+    if (num_threads > (int)pages) {
+        num_threads = (int)pages;
+    }
+    mmap_slice_t slices[64];
+    pthread_t threads[64];
+    uint64_t per = pages / num_threads;
+
+    for (int i = 0; i < num_threads; i++) {
+        uint64_t p = per * i;
+        slices[i].midstate = midstate;
+        slices[i].data = data + p * 4096;
+        slices[i].size = i == num_threads - 1 ? len - p * 4096 : per * 4096;
+        slices[i].first_page = first_page + p;
+        slices[i].tags = tags + (first_page + p) * 32;
+    }
+    // 创建失败的切片在调用线程中执行，保证每页都被标记
+    int started[64] = {0};
+    for (int i = 1; i < num_threads; i++) {
+        started[i] = pthread_create(&threads[i], NULL, mmap_slice_worker, &slices[i]) == 0;
+    }
+    for (int i = 0; i < num_threads; i++) {
+        if (!started[i]) {
+            mmap_slice_worker(&slices[i]);
+        }
+    }
+    for (int i = 1; i < num_threads; i++) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+
+    uint64_t wall = 0, stall = 0;
+    for (int i = 0; i < num_threads; i++) {
+        wall += slices[i].wall_ns;
+        stall += slices[i].wall_ns > slices[i].cpu_ns ? slices[i].wall_ns - slices[i].cpu_ns : 0;
+    }
+    if (stall_ns) {
+        *stall_ns = stall;
+    }
+    return wall;
+}
+
+static uint8_t* mmap_window(int fd, uint64_t off, size_t len) {
+    void* map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, (off_t)off);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+    madvise(map, len, MADV_WILLNEED);
+    return (uint8_t*)map;
+}
+
+// 以窗口化mmap生成清单；window_bytes为映射预算（两个窗口合计），num_threads<=0时使用全部在线核心
+// stats可为NULL
+aes_sm3_manifest_t* aes_sm3_manifest_build_file_windowed(const uint32_t* midstate, const char* path,
+                                                         size_t window_bytes, int num_threads,
+                                                         aes_sm3_mmap_stats_t* stats) {
+    int available_cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_threads <= 0 || num_threads > available_cores) {
+        num_threads = available_cores;
+    }
+    if (num_threads > 64) {
+        num_threads = 64;
+    }
+    // 单个窗口上限为预算的一半（按块向下取整），从上限开始
+    size_t chunk = AES_SM3_SYNC_CHUNK_PAGES * 4096;
+    size_t max_window = window_bytes / 2 < AES_SM3_MMAP_MIN_WINDOW ? AES_SM3_MMAP_MIN_WINDOW : window_bytes / 2;
+    max_window = max_window / chunk * chunk;
+    size_t min_window = max_window / 4 < AES_SM3_MMAP_MIN_WINDOW ? AES_SM3_MMAP_MIN_WINDOW : max_window / 4 / chunk * chunk;
+    size_t window = max_window;
+
+    aes_sm3_mmap_stats_t local;
+    if (!stats) {
+        stats = &local;
+    }
+    memset(stats, 0, sizeof(*stats));
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return NULL;
+    }
+    uint64_t size = (uint64_t)st.st_size;
+    aes_sm3_manifest_t* m = manifest_alloc(midstate, (size_t)size);
+    int ok = m != NULL;
+
+    uint64_t off = 0;
+    size_t len = size < window ? (size_t)size : window;
+    uint8_t* cur = ok && len ? mmap_window(fd, 0, len) : NULL;
+    int calm = 0;
+    ok = ok && (len == 0 || cur);
+
+    while (ok && off < size) {
+        // 映射下一个窗口并提前预读
+        uint64_t next_off = off + len;
+        size_t next_len = size - next_off < window ? (size_t)(size - next_off) : window;
+        uint8_t* next = next_len ? mmap_window(fd, next_off, next_len) : NULL;
+        if (next_len && !next) {
+            ok = 0;
+        }
+
+        struct rusage r0, r1;
+        uint64_t wall = 0, stall = 0;
+        getrusage(RUSAGE_SELF, &r0);
+        if (ok) {
+            wall = mmap_tag_window(m->hdr->midstate, cur, len, off / 4096, (uint8_t*)m->tags,
+                                   num_threads, &stall);
+        }
+        getrusage(RUSAGE_SELF, &r1);
+
+        madvise(cur, len, MADV_DONTNEED);
+        munmap(cur, len);
+        stats->windows++;
+        stats->major_faults += (uint64_t)(r1.ru_majflt - r0.ru_majflt);
+        stats->stall_ns += stall;
+        if (len > stats->max_window_bytes) {
+            stats->max_window_bytes = len;
+        }
+
+        // 自适应：停顿占比高则加倍，连续4个窗口平稳则减半
+        double stall_ratio = wall ? (double)stall / (double)wall : 0;
+        if (stall_ratio > AES_SM3_MMAP_STALL_GROW) {
+            window = window * 2 > max_window ? max_window : window * 2;
+            calm = 0;
+        } else if (stall_ratio < AES_SM3_MMAP_STALL_CALM && ++calm >= 4) {
+            window = window / 2 < min_window ? min_window : window / 2;
+            calm = 0;
+        }
+
+        off = next_off;
+        cur = next;
+        len = next_len;
+    }
+    if (cur) {
+        munmap(cur, len);
+    }
+    close(fd);
+    stats->window_bytes = window;
+
+    if (!ok) {
+        aes_sm3_manifest_free(m);
+        return NULL;
+    }
+    return m;
+}
+
+// ============================================================================
+// 合成数据生成器：可配置比例的零页/单值页/文本页/随机页/重复页
+// ============================================================================
+/*
+ * i % 256 之类的填充让每页都高度规则，测不出零页、去重索引与分支预测的真实表现。
+ * 生成器按 (种子, 页号) 确定每页的类型与内容，可随机访问任意页、结果可复现：
+ *   - 零页：全0
+ *   - 单值页：整页同一个非零字节
+ *   - 文本页：从小词表取词、空格与换行分隔，可压缩（约3:1）
+ *   - 随机页：xorshift64*
+ *   - 重复页：与之前某一页（按哈希选取）内容完全相同；第0页不会是重复页
+ * 比例之和不足1的部分为随机页。重复页的来源若本身也是重复页则继续向前追溯，
+ * 因此来源链严格递减、必然终止于一个非重复页。
+ */
+
+#define AES_SM3_PAGE_ZERO       0
+#define AES_SM3_PAGE_UNIFORM    1
+#define AES_SM3_PAGE_TEXT       2
+#define AES_SM3_PAGE_RANDOM     3
+#define AES_SM3_PAGE_DUP        4
+
+typedef struct {
+    double zero;
+    double uniform;
+    double text;
+    double dup;
+} aes_sm3_datagen_mix_t;
+
+// 接近虚拟机镜像/文件系统的默认混合
+const aes_sm3_datagen_mix_t aes_sm3_datagen_mixed = {0.10, 0.05, 0.30, 0.15};
+
+static const char* const DATAGEN_WORDS[32] = {
+    "the", "of", "and", "to", "in", "is", "block", "data", "page", "write",
+    "read", "volume", "tag", "error", "request", "server", "user", "time", "file", "value",
+    "integrity", "check", "node", "index", "log", "status", "ok", "record", "key", "offset",
+    "2024-01-01", "INFO",
+};
+
+static uint64_t datagen_hash(uint64_t seed, uint64_t page, uint64_t salt) {
+    uint64_t z = seed ^ (page * 0x9E3779B97F4A7C15ULL) ^ (salt * 0xD1B54A32D192ED03ULL);   // splitmix64
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// 该页的类型（重复页返回AES_SM3_PAGE_DUP）
+int aes_sm3_datagen_kind(const aes_sm3_datagen_mix_t* mix, uint64_t seed, uint64_t page) {
+    double u = (double)(datagen_hash(seed, page, 1) >> 11) * (1.0 / 9007199254740992.0);
+    if ((u -= mix->dup) < 0) {
+        return page == 0 ? AES_SM3_PAGE_RANDOM : AES_SM3_PAGE_DUP;
+    }
+    if ((u -= mix->zero) < 0) {
+        return AES_SM3_PAGE_ZERO;
+    }
+    if ((u -= mix->uniform) < 0) {
+        return AES_SM3_PAGE_UNIFORM;
+    }
+    if ((u -= mix->text) < 0) {
+        return AES_SM3_PAGE_TEXT;
+    }
+    return AES_SM3_PAGE_RANDOM;
+}
+
+// 重复页的最终来源页（非重复页返回自身）
+static uint64_t datagen_source(const aes_sm3_datagen_mix_t* mix, uint64_t seed, uint64_t page) {
+    while (aes_sm3_datagen_kind(mix, seed, page) == AES_SM3_PAGE_DUP) {
+        page = datagen_hash(seed, page, 2) % page;
+    }
+    return page;
+}
+
+static void datagen_base_page(const aes_sm3_datagen_mix_t* mix, uint64_t seed, uint64_t page, uint8_t* out) {
+    uint64_t x = datagen_hash(seed, page, 3) | 1;
+    switch (aes_sm3_datagen_kind(mix, seed, page)) {
+    case AES_SM3_PAGE_ZERO:
+        memset(out, 0, 4096);
+        break;
+    case AES_SM3_PAGE_UNIFORM:
+        memset(out, (int)(1 + x % 255), 4096);
+        break;
+    case AES_SM3_PAGE_TEXT: {
+        size_t pos = 0;
+        int words = 0;
+        while (pos < 4096) {
+            x ^= x >> 12; x ^= x << 25; x ^= x >> 27;
+            const char* w = DATAGEN_WORDS[(x * 0x2545F4914F6CDD1DULL) >> 59];
+            while (*w && pos < 4096) {
+                out[pos++] = (uint8_t)*w++;
+            }
+            if (pos < 4096) {
+                out[pos++] = ++words % 12 == 0 ? '\n' : ' ';
+            }
+        }
+        break;
+    }
+    default:
+        for (int i = 0; i < 512; i++) {
+            x ^= x >> 12; x ^= x << 25; x ^= x >> 27;
+            uint64_t v = x * 0x2545F4914F6CDD1DULL;
+            memcpy(out + i * 8, &v, 8);
+        }
+        break;
+    }
+}
+
+// 生成第page页（4KB）
+void aes_sm3_datagen_page(const aes_sm3_datagen_mix_t* mix, uint64_t seed, uint64_t page, uint8_t* out) {
+    datagen_base_page(mix, seed, datagen_source(mix, seed, page), out);
+}
+
+// 生成[first_page, first_page + pages)到data；来源页在本次范围内时直接拷贝
+void aes_sm3_datagen_fill(const aes_sm3_datagen_mix_t* mix, uint64_t seed, uint8_t* data,
+                          uint64_t first_page, size_t pages) {
+    for (size_t i = 0; i < pages; i++) {
+        uint64_t src = datagen_source(mix, seed, first_page + i);
+        if (src != first_page + i && src >= first_page) {
+            memcpy(data + i * 4096, data + (src - first_page) * 4096, 4096);
+        } else {
+            datagen_base_page(mix, seed, src, data + i * 4096);
+        }
+    }
+}
+
+// 各类数据的批量标签吞吐，以及按无LBA标签统计的可去重页比例（标签相同的页再按内容确认）
+void data_mix_benchmark(void) {
+    const struct {
+        const char* name;
+        aes_sm3_datagen_mix_t mix;
+    } mixes[] = {
+        {"零页", {1, 0, 0, 0}},
+        {"单值页", {0, 1, 0, 0}},
+        {"文本页", {0, 0, 1, 0}},
+        {"随机页", {0, 0, 0, 0}},
+        {"默认混合", aes_sm3_datagen_mixed},
+    };
+    const size_t pages = 16384;
+    uint8_t* data = (uint8_t*)aligned_alloc(64, pages * 4096);
+    uint8_t* tags = (uint8_t*)aligned_alloc(64, pages * 32);
+    uint64_t* locations = (uint64_t*)malloc(pages * sizeof(uint64_t));
+    uint64_t* reps = (uint64_t*)malloc(pages * sizeof(uint64_t));
+    const uint8_t* inputs[64];
+    uint8_t* outputs[64];
+    if (!data || !tags || !locations || !reps) {
+        free(data);
+        free(tags);
+        free(locations);
+        free(reps);
+        return;
+    }
+    for (size_t p = 0; p < pages; p++) {
+        locations[p] = p;
+    }
+
+    printf(">>> 不同数据类型 (%zu页, 批量域分离标签)\n", pages);
+    for (size_t m = 0; m < sizeof(mixes) / sizeof(mixes[0]); m++) {
+        aes_sm3_datagen_fill(&mixes[m].mix, 42, data, 0, pages);
+
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (size_t p = 0; p < pages; p += 64) {
+            for (int j = 0; j < 64; j++) {
+                inputs[j] = data + (p + j) * 4096;
+                outputs[j] = tags + (p + j) * 32;
+            }
+            aes_sm3_integrity_batch_domain(SM3_IV, NULL, inputs, outputs, 64);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+        // 排序后标签相同的一组页中，内容与组内已出现的某页相同的页可去重。
+        // 标签按XOR折叠，不同内容可能同标签（如单值页与零页），只比标签会高估
+        size_t dup = 0;
+        size_t rep_count = 0;
+        aes_sm3_tag_index_t* idx = aes_sm3_tag_index_build(tags, locations, pages);
+        for (size_t i = 0; idx && i < pages; i++) {
+            if (i == 0 || memcmp(aes_sm3_tag_index_tag(idx, i), aes_sm3_tag_index_tag(idx, i - 1), 32) != 0) {
+                rep_count = 0;                                  // 新的标签组
+            }
+            const uint8_t* page = data + aes_sm3_tag_index_location(idx, i) * 4096;
+            size_t r = 0;
+            while (r < rep_count && memcmp(page, data + reps[r] * 4096, 4096) != 0) {
+                r++;
+            }
+            if (r < rep_count) {
+                dup++;
+            } else {
+                reps[rep_count++] = aes_sm3_tag_index_location(idx, i);
+            }
+        }
+        aes_sm3_tag_index_free(idx);
+        printf("  %s: %.2f MB/s, 可去重页 %.1f%%\n", mixes[m].name,
+               pages * 4.0 / 1024.0 / elapsed, 100.0 * dup / pages);
+    }
+    printf("\n");
+    free(data);
+    free(tags);
+    free(locations);
+    free(reps);
+}
+
+// ============================================================================
+// 轨迹回放基准：按记录的块访问日志回放标记/校验请求
+// ============================================================================
+/*
+ * 合成基准（同一缓冲区反复计算）反映不了真实访问模式。回放器读入轨迹文件，
+ * 每行一条请求：
+ *     <时间戳微秒> <偏移字节> <长度字节> <操作>
+ * 操作首字母R为读（校验：重新计算标签并与标签表比较），W为写（标记：计算标签写回
+ * 标签表），其他操作（如D丢弃）与#开头的注释行忽略；blkparse输出经简单awk转换即可。
+ * 偏移按4KB对齐后对数据集页数取模，数据集可以是内存缓冲区或只读映射的文件。
+ *   - SINGLE：调用线程逐页 aes_sm3_integrity_256bit_domain（队列深度1）
+ *   - BATCH ：调用线程按64页一组 aes_sm3_integrity_batch_domain（队列深度1）
+ *   - ASYNC ：请求提交到有界队列，由threads个工作线程并发处理
+ * speed>0时按时间戳（除以speed）开环发出请求，延迟从计划发出时刻算起（包含排队）；
+ * 时间戳回退的记录（多CPU合并的blktrace常见）按此前最大时间戳立即发出，保持轨迹顺序；
+ * speed<=0时尽快发出，延迟从实际提交算起。报告吞吐与延迟分位数。
+ */
+
+#define AES_SM3_REPLAY_SINGLE   0
+#define AES_SM3_REPLAY_BATCH    1
+#define AES_SM3_REPLAY_ASYNC    2
+#define AES_SM3_REPLAY_QUEUE    256
+
+typedef struct {
+    uint64_t ts_us;
+    uint64_t offset;
+    uint32_t length;
+    char op;                       // 'R' 校验 / 'W' 标记
+} aes_sm3_trace_rec_t;
+
+typedef struct {
+    uint64_t requests;
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t pages;
+    uint64_t mismatches;           // 校验不符的页数（数据集不变，应为0）
+    double elapsed_sec;
+    double mb_per_sec;
+    double iops;
+    double lat_p50_us;
+    double lat_p90_us;
+    double lat_p99_us;
+    double lat_p999_us;
+    double lat_max_us;
+} aes_sm3_replay_report_t;
+
+// 读入轨迹文件，*out由调用方free；返回记录数，无法打开返回-1
+int64_t aes_sm3_trace_load(const char* path, aes_sm3_trace_rec_t** out) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) {
+        return -1;
+    }
+    aes_sm3_trace_rec_t* recs = NULL;
+    int64_t count = 0, cap = 0;
+    char line[512];
+    while (fgets(line, sizeof(line), fp)) {
+        unsigned long long ts, off;
+        unsigned int len;
+        char op[16];
+        if (line[0] == '#' || sscanf(line, "%llu %llu %u %15s", &ts, &off, &len, op) != 4 || len == 0) {
+            continue;
+        }
+        char c = (char)(op[0] & ~0x20);
+        if (c != 'R' && c != 'W') {
+            continue;
+        }
+        if (count == cap) {
+            cap = cap ? cap * 2 : 1024;
+            aes_sm3_trace_rec_t* grown = (aes_sm3_trace_rec_t*)realloc(recs, cap * sizeof(aes_sm3_trace_rec_t));
+            if (!grown) {
+                free(recs);
+                fclose(fp);
+                return -1;
+            }
+            recs = grown;
+        }
+        recs[count].ts_us = ts;
+        recs[count].offset = off;
+        recs[count].length = len;
+        recs[count].op = c;
+        count++;
+    }
+    fclose(fp);
+    *out = recs;
+    return count;
+}
+
+typedef struct {
+    const aes_sm3_trace_rec_t* recs;
+    const uint8_t* data;
+    uint64_t pages;
+    uint64_t* tags;                // 每页4个uint64，读写均为原子访问
+    uint64_t* issue_ns;
+    uint64_t* lat_ns;
+    int mode;
+    uint64_t mismatches;
+
+    // ASYNC模式的有界队列
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    int64_t queue[AES_SM3_REPLAY_QUEUE];
+    int head;
+    int tail;
+    int queued;
+    int stop;
+} replay_ctx_t;
+
+static uint64_t replay_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// 请求覆盖的页区间（对齐到4KB，超出数据集时取模回绕到能放下的位置）
+static void replay_span(const replay_ctx_t* c, const aes_sm3_trace_rec_t* r,
+                        uint64_t* first, uint64_t* count) {
+    uint64_t n = (r->offset % 4096 + r->length + 4095) / 4096;
+    if (n > c->pages) {
+        n = c->pages;
+    }
+    *first = (r->offset / 4096) % (c->pages - n + 1);
+    *count = n;
+}
+
+static void replay_request(replay_ctx_t* c, int64_t i) {
+    const aes_sm3_trace_rec_t* r = &c->recs[i];
+    uint8_t tag[64][32] __attribute__((aligned(64)));
+    const uint8_t* inputs[64];
+    uint8_t* outputs[64];
+    uint64_t lbas[64];
+    uint64_t first, n, bad = 0;
+    replay_span(c, r, &first, &n);
+
+    for (uint64_t p = 0; p < n; p += 64) {
+        int k = n - p < 64 ? (int)(n - p) : 64;
+        for (int j = 0; j < k; j++) {
+            lbas[j] = first + p + j;
+            inputs[j] = c->data + lbas[j] * 4096;
+            outputs[j] = tag[j];
+        }
+        if (c->mode == AES_SM3_REPLAY_SINGLE) {
+            for (int j = 0; j < k; j++) {
+                aes_sm3_integrity_256bit_domain(SM3_IV, lbas[j], inputs[j], outputs[j]);
+            }
+        } else {
+            aes_sm3_integrity_batch_domain(SM3_IV, lbas, inputs, outputs, k);
+        }
+        for (int j = 0; j < k; j++) {
+            uint64_t* ref = c->tags + lbas[j] * 4;
+            const uint64_t* t = (const uint64_t*)tag[j];
+            for (int w = 0; w < 4; w++) {
+                if (r->op == 'W') {
+                    __atomic_store_n(&ref[w], t[w], __ATOMIC_RELAXED);
+                } else if (__atomic_load_n(&ref[w], __ATOMIC_RELAXED) != t[w]) {
+                    bad++;
+                    break;
+                }
+            }
+        }
+    }
+    if (bad) {
+        __atomic_fetch_add(&c->mismatches, bad, __ATOMIC_RELAXED);
+    }
+}
+
+static void* replay_worker(void* arg) {
+    replay_ctx_t* c = (replay_ctx_t*)arg;
+    for (;;) {
+        pthread_mutex_lock(&c->lock);
+        while (c->queued == 0 && !c->stop) {
+            pthread_cond_wait(&c->not_empty, &c->lock);
+        }
+        if (c->queued == 0) {
+            pthread_mutex_unlock(&c->lock);
+            break;
+        }
+        int64_t i = c->queue[c->head];
+        c->head = (c->head + 1) % AES_SM3_REPLAY_QUEUE;
+        c->queued--;
+        pthread_cond_signal(&c->not_full);
+        pthread_mutex_unlock(&c->lock);
+
+        replay_request(c, i);
+        c->lat_ns[i] = replay_now_ns() - c->issue_ns[i];
+    }
+    return NULL;
+}
+
+static int replay_cmp_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+// 在data[0, size)上回放轨迹（size按4KB向下取整，至少1页）；返回0成功，参数或内存错误返回-1
+int aes_sm3_replay_run(const aes_sm3_trace_rec_t* recs, int64_t count, const uint8_t* data, size_t size,
+                       int mode, int threads, double speed, aes_sm3_replay_report_t* report) {
+    memset(report, 0, sizeof(*report));
+    int available_cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads <= 0 || threads > available_cores) {
+        threads = available_cores;
+    }
+    if (threads > 64) {
+        threads = 64;
+    }
+    if (count <= 0 || size < 4096 || mode < AES_SM3_REPLAY_SINGLE || mode > AES_SM3_REPLAY_ASYNC) {
+        return -1;
+    }
+
+    replay_ctx_t* c = (replay_ctx_t*)calloc(1, sizeof(replay_ctx_t));
+    if (!c) {
+        return -1;
+    }
+    c->recs = recs;
+    c->data = data;
+    c->pages = size / 4096;
+    c->mode = mode;
+    c->tags = (uint64_t*)aligned_alloc(64, (c->pages * 32 + 63) & ~(uint64_t)63);
+    c->issue_ns = (uint64_t*)malloc(count * sizeof(uint64_t));
+    c->lat_ns = (uint64_t*)malloc(count * sizeof(uint64_t));
+    if (!c->tags || !c->issue_ns || !c->lat_ns) {
+        free(c->tags);
+        free(c->issue_ns);
+        free(c->lat_ns);
+        free(c);
+        return -1;
+    }
+
+    // 回放前先标记整个数据集，读请求据此校验
+    mmap_tag_window(SM3_IV, data, c->pages * 4096, 0, (uint8_t*)c->tags, threads, NULL);
+
+    // ASYNC模式只计入实际创建的工作线程；一个都没创建时在本线程内逐个执行
+    pthread_t workers[64];
+    int worker_count = 0;
+    if (mode == AES_SM3_REPLAY_ASYNC) {
+        pthread_mutex_init(&c->lock, NULL);
+        pthread_cond_init(&c->not_empty, NULL);
+        pthread_cond_init(&c->not_full, NULL);
+        for (int w = 0; w < threads; w++) {
+            if (pthread_create(&workers[worker_count], NULL, replay_worker, c) == 0) {
+                worker_count++;
+            }
+        }
+    }
+    int async = worker_count > 0;
+
+    uint64_t start = replay_now_ns();
+    uint64_t ts_max = count > 0 ? recs[0].ts_us : 0;
+    for (int64_t i = 0; i < count; i++) {
+        uint64_t now = replay_now_ns();
+        if (speed > 0) {
+            if (recs[i].ts_us > ts_max) {
+                ts_max = recs[i].ts_us;                  // 时间戳回退时不做无符号减法下溢
+            }
+            uint64_t due = start + (uint64_t)((double)(ts_max - recs[0].ts_us) * 1000.0 / speed);
+            if (due > now) {
+                struct timespec ts = {(time_t)((due - now) / 1000000000ULL), (long)((due - now) % 1000000000ULL)};
+                nanosleep(&ts, NULL);
+            }
+            c->issue_ns[i] = due;
+        } else {
+            c->issue_ns[i] = now;
+        }
+
+        if (async) {
+            pthread_mutex_lock(&c->lock);
+            while (c->queued == AES_SM3_REPLAY_QUEUE) {
+                pthread_cond_wait(&c->not_full, &c->lock);
+            }
+            c->queue[c->tail] = i;
+            c->tail = (c->tail + 1) % AES_SM3_REPLAY_QUEUE;
+            c->queued++;
+            pthread_cond_signal(&c->not_empty);
+            pthread_mutex_unlock(&c->lock);
+        } else {
+            replay_request(c, i);
+            c->lat_ns[i] = replay_now_ns() - c->issue_ns[i];
+        }
+    }
+    if (mode == AES_SM3_REPLAY_ASYNC) {
+        pthread_mutex_lock(&c->lock);
+        c->stop = 1;
+        pthread_cond_broadcast(&c->not_empty);
+        pthread_mutex_unlock(&c->lock);
+        for (int w = 0; w < worker_count; w++) {
+            pthread_join(workers[w], NULL);
+        }
+        pthread_mutex_destroy(&c->lock);
+        pthread_cond_destroy(&c->not_empty);
+        pthread_cond_destroy(&c->not_full);
+    }
+    uint64_t end = replay_now_ns();
+
+    for (int64_t i = 0; i < count; i++) {
+        uint64_t first, n;
+        replay_span(c, &recs[i], &first, &n);
+        report->pages += n;
+        if (recs[i].op == 'W') {
+            report->writes++;
+        } else {
+            report->reads++;
+        }
+    }
+    qsort(c->lat_ns, count, sizeof(uint64_t), replay_cmp_u64);
+    report->requests = count;
+    report->mismatches = c->mismatches;
+    report->elapsed_sec = (end - start) / 1e9;
+    report->mb_per_sec = report->pages * 4096.0 / (1024.0 * 1024.0) / report->elapsed_sec;
+    report->iops = count / report->elapsed_sec;
+    report->lat_p50_us = c->lat_ns[(int64_t)(count * 0.50)] / 1e3;
+    report->lat_p90_us = c->lat_ns[(int64_t)(count * 0.90)] / 1e3;
+    report->lat_p99_us = c->lat_ns[(int64_t)(count * 0.99)] / 1e3;
+    report->lat_p999_us = c->lat_ns[(int64_t)(count * 0.999)] / 1e3;
+    report->lat_max_us = c->lat_ns[count - 1] / 1e3;
+
+    free(c->tags);
+    free(c->issue_ns);
+    free(c->lat_ns);
+    free(c);
+    return 0;
+}
+
+// 回放轨迹并打印报告；data_path为NULL时使用mem_bytes大小的内存数据集
+void trace_replay_benchmark(const char* trace_path, const char* data_path, size_t mem_bytes,
+                            int mode, int threads, double speed) {
+    static const char* mode_names[] = {"single", "batch", "async"};
+    aes_sm3_trace_rec_t* recs = NULL;
+    int64_t count = aes_sm3_trace_load(trace_path, &recs);
+    if (count <= 0) {
+        printf("  无法读取轨迹或轨迹为空: %s\n", trace_path);
+        free(recs);
+        return;
+    }
+
+    uint8_t* data = NULL;
+    size_t size = mem_bytes;
+    int fd = -1;
+    if (data_path) {
+        struct stat st;
+        fd = open(data_path, O_RDONLY | O_CLOEXEC);
+        if (fd >= 0 && fstat(fd, &st) == 0 && st.st_size >= 4096) {
+            size = (size_t)st.st_size;
+            void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            data = map == MAP_FAILED ? NULL : (uint8_t*)map;
+        }
+    } else if (size >= 4096) {
+        size &= ~(size_t)4095;
+        data = (uint8_t*)aligned_alloc(4096, size);
+        if (data) {
+            aes_sm3_datagen_fill(&aes_sm3_datagen_mixed, 1, data, 0, size / 4096);
+        }
+    }
+    if (!data) {
+        printf("  无法准备数据集\n");
+        if (fd >= 0) {
+            close(fd);
+        }
+        free(recs);
+        return;
+    }
+
+    if (threads <= 0) {
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    printf("\n>>> 轨迹回放 (%s, %lld条请求, 数据集 %.1f MB, %s, %d线程, %s)\n", trace_path,
+           (long long)count, size / (1024.0 * 1024.0), mode_names[mode], threads,
+           speed > 0 ? "按时间戳" : "尽快发出");
+    aes_sm3_replay_report_t rep;
+    if (aes_sm3_replay_run(recs, count, data, size, mode, threads, speed, &rep) == 0) {
+        printf("  读 %llu / 写 %llu, %llu页, 耗时 %.3f秒\n", (unsigned long long)rep.reads,
+               (unsigned long long)rep.writes, (unsigned long long)rep.pages, rep.elapsed_sec);
+        printf("  吞吐 %.2f MB/s, %.0f IOPS\n", rep.mb_per_sec, rep.iops);
+        printf("  延迟(us) p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+               rep.lat_p50_us, rep.lat_p90_us, rep.lat_p99_us, rep.lat_p999_us, rep.lat_max_us);
+        if (rep.mismatches) {
+            printf("  校验不符 %llu页\n", (unsigned long long)rep.mismatches);
+        }
+    } else {
+        printf("  回放失败\n");
+    }
+
+    if (data_path) {
+        munmap(data, size);
+        close(fd);
+    } else {
+        free(data);
+    }
+    free(recs);
+}
+
+// ============================================================================
+// SHA256实现（用于性能对比）
+// ============================================================================
+
+static const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline uint32_t rotr(uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+static inline uint32_t ch(uint32_t x, uint32_t y, uint32_t z) {
+    return (x & y) ^ (~x & z);
+}
+
+static inline uint32_t maj(uint32_t x, uint32_t y, uint32_t z) {
+    return (x & y) ^ (x & z) ^ (y & z);
+}
+
+static inline uint32_t sigma0(uint32_t x) {
+    return rotr(x, 2) ^ rotr(x, 13) ^ rotr(x, 22);
+}
+
+static inline uint32_t sigma1(uint32_t x) {
+    return rotr(x, 6) ^ rotr(x, 11) ^ rotr(x, 25);
+}
+
+static inline uint32_t gamma0(uint32_t x) {
+    return rotr(x, 7) ^ rotr(x, 18) ^ (x >> 3);
+}
+
+static inline uint32_t gamma1(uint32_t x) {
+    return rotr(x, 17) ^ rotr(x, 19) ^ (x >> 10);
+}
+
+// SHA256硬件加速版本（使用ARMv8 SHA2指令集）
+#if (defined(__ARM_FEATURE_SHA2) || defined(__aarch64__)) && defined(__aarch64__)
+static void sha256_compress(uint32_t* state, const uint8_t* block) {
+    // 使用ARMv8 SHA2硬件指令
+    uint32x4_t STATE0, STATE1, ABEF_SAVE, CDGH_SAVE;
+    uint32x4_t MSG0, MSG1, MSG2, MSG3;
+    uint32x4_t TMP0, TMP1, TMP2;
+    
+    // 加载状态
+    STATE0 = vld1q_u32(&state[0]);  // ABCD
+    STATE1 = vld1q_u32(&state[4]);  // EFGH
+    
+    ABEF_SAVE = STATE0;
+    CDGH_SAVE = STATE1;
+    
+    // 加载消息（大端序）
+    MSG0 = vld1q_u32((const uint32_t*)(block + 0));
+    MSG1 = vld1q_u32((const uint32_t*)(block + 16));
+    MSG2 = vld1q_u32((const uint32_t*)(block + 32));
+    MSG3 = vld1q_u32((const uint32_t*)(block + 48));
+    
+    MSG0 = vreinterpretq_u32_u8(vrev32q_u8(vreinterpretq_u8_u32(MSG0)));
+    MSG1 = vreinterpretq_u32_u8(vrev32q_u8(vreinterpretq_u8_u32(MSG1)));
+    MSG2 = vreinterpretq_u32_u8(vrev32q_u8(vreinterpretq_u8_u32(MSG2)));
+    MSG3 = vreinterpretq_u32_u8(vrev32q_u8(vreinterpretq_u8_u32(MSG3)));
+    
+    // 轮0-3
+    TMP0 = vaddq_u32(MSG0, vld1q_u32(&SHA256_K[0]));
+    TMP2 = STATE0;
+    TMP1 = vaddq_u32(STATE1, TMP0);
+    STATE0 = vsha256hq_u32(STATE0, STATE1, TMP1);
+    STATE1 = vsha256h2q_u32(STATE1, TMP2, TMP1);
+    MSG0 = vsha256su0q_u32(MSG0, MSG1);
+    MSG0 = vsha256su1q_u32(MSG0, MSG2, MSG3);
+    
+    // 轮4-7
+    TMP0 = vaddq_u32(MSG1, vld1q_u32(&SHA256_K[4]));
+    TMP2 = STATE0;
+    TMP1 = vaddq_u32(STATE1, TMP0);
+    STATE0 = vsha256hq_u32(STATE0, STATE1, TMP1);
+    STATE1 = vsha256h2q_u32(STATE1, TMP2, TMP1);
+    MSG1 = vsha256su0q_u32(MSG1, MSG2);
+    MSG1 = vsha256su1q_u32(MSG1, MSG3, MSG0);
+    
+    // 轮8-11
+    TMP0 = vaddq_u32(MSG2, vld1q_u32(&SHA256_K[8]));
+    TMP2 = STATE0;
+    TMP1 = vaddq_u32(STATE1, TMP0);
+    STATE0 = vsha256hq_u32(STATE0, STATE1, TMP1);
+    STATE1 = vsha256h2q_u32(STATE1, TMP2, TMP1);
+    MSG2 = vsha256su0q_u32(MSG2, MSG3);
+    MSG2 = vsha256su1q_u32(MSG2, MSG0, MSG1);
+    
+    // 轮12-15
+    TMP0 = vaddq_u32(MSG3, vld1q_u32(&SHA256_K[12]));
+    TMP2 = STATE0;
+    TMP1 = vaddq_u32(STATE1, TMP0);
+    STATE0 = vsha256hq_u32(STATE0, STATE1, TMP1);
+    STATE1 = vsha256h2q_u32(STATE1, TMP2, TMP1);
+    MSG3 = vsha256su0q_u32(MSG3, MSG0);
+    MSG3 = vsha256su1q_u32(MSG3, MSG1, MSG2);
+    
+    // 继续剩余轮次（16-63），展开4轮一组
+    for (int i = 16; i < 64; i += 16) {
+        // 4轮一组，共12组
+        TMP0 = vaddq_u32(MSG0, vld1q_u32(&SHA256_K[i]));
+        TMP2 = STATE0;
+        TMP1 = vaddq_u32(STATE1, TMP0);
+        STATE0 = vsha256hq_u32(STATE0, STATE1, TMP1);
+        STATE1 = vsha256h2q_u32(STATE1, TMP2, TMP1);
+        MSG0 = vsha256su0q_u32(MSG0, MSG1);
+        MSG0 = vsha256su1q_u32(MSG0, MSG2, MSG3);
+        
+        TMP0 = vaddq_u32(MSG1, vld1q_u32(&SHA256_K[i+4]));
+        TMP2 = STATE0;
+        TMP1 = vaddq_u32(STATE1, TMP0);
+        STATE0 = vsha256hq_u32(STATE0, STATE1, TMP1);
+        STATE1 = vsha256h2q_u32(STATE1, TMP2, TMP1);
+        MSG1 = vsha256su0q_u32(MSG1, MSG2);
+        MSG1 = vsha256su1q_u32(MSG1, MSG3, MSG0);
+        
+        TMP0 = vaddq_u32(MSG2, vld1q_u32(&SHA256_K[i+8]));
+        TMP2 = STATE0;
+        TMP1 = vaddq_u32(STATE1, TMP0);
+        STATE0 = vsha256hq_u32(STATE0, STATE1, TMP1);
+        STATE1 = vsha256h2q_u32(STATE1, TMP2, TMP1);
+        MSG2 = vsha256su0q_u32(MSG2, MSG3);
+        MSG2 = vsha256su1q_u32(MSG2, MSG0, MSG1);
+        
+        TMP0 = vaddq_u32(MSG3, vld1q_u32(&SHA256_K[i+12]));
+        TMP2 = STATE0;
+        TMP1 = vaddq_u32(STATE1, TMP0);
+        STATE0 = vsha256hq_u32(STATE0, STATE1, TMP1);
+        STATE1 = vsha256h2q_u32(STATE1, TMP2, TMP1);
+        MSG3 = vsha256su0q_u32(MSG3, MSG0);
+        MSG3 = vsha256su1q_u32(MSG3, MSG1, MSG2);
+    }
+    
+    // 累加到状态
+    STATE0 = vaddq_u32(STATE0, ABEF_SAVE);
+    STATE1 = vaddq_u32(STATE1, CDGH_SAVE);
+    
+    // 保存状态
+    vst1q_u32(&state[0], STATE0);
+    vst1q_u32(&state[4], STATE1);
+}
+#else
+// 如果不支持SHA2硬件指令，编译时报错
+#error "SHA2硬件加速不可用！请使用 -march=armv8.2-a+crypto+sha2 编译选项，或在支持SHA2指令的ARM平台上编译。"
+#endif
+
+void sha256_4kb(const uint8_t* input, uint8_t* output) {
+    uint32_t state[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    
+    // 循环展开：每次处理4个块
+    for (int i = 0; i < 64; i += 4) {
+        sha256_compress(state, input + i * 64);
+        sha256_compress(state, input + (i+1) * 64);
+        sha256_compress(state, input + (i+2) * 64);
+        sha256_compress(state, input + (i+3) * 64);
+    }
+    
+    // 直接输出（减少循环）
+    uint32_t* out32 = (uint32_t*)output;
+    out32[0] = __builtin_bswap32(state[0]);
+    out32[1] = __builtin_bswap32(state[1]);
+    out32[2] = __builtin_bswap32(state[2]);
+    out32[3] = __builtin_bswap32(state[3]);
+    out32[4] = __builtin_bswap32(state[4]);
+    out32[5] = __builtin_bswap32(state[5]);
+    out32[6] = __builtin_bswap32(state[6]);
+    out32[7] = __builtin_bswap32(state[7]);
+}
+
+// ============================================================================
+// 纯SM3实现（用于对比）
+// ============================================================================
+
+void sm3_4kb(const uint8_t* input, uint8_t* output) {
+    uint32_t state[8];
+    memcpy(state, SM3_IV, sizeof(SM3_IV));
+    
+    // 循环展开：每次处理2个块
+    for (int i = 0; i < 64; i += 2) {
+        uint32_t block[16];
+        
+        // 第一个块
+        const uint32_t* src = (const uint32_t*)(input + i * 64);
+        for (int j = 0; j < 16; j++) {
+            block[j] = __builtin_bswap32(src[j]);
+        }
+        sm3_compress_hw(state, block);
+        
+        // 第二个块
+        src = (const uint32_t*)(input + (i+1) * 64);
+        for (int j = 0; j < 16; j++) {
+            block[j] = __builtin_bswap32(src[j]);
+        }
+        sm3_compress_hw(state, block);
+    }
+    
+    // 直接输出（减少循环）
+    uint32_t* out32 = (uint32_t*)output;
+    out32[0] = __builtin_bswap32(state[0]);
+    out32[1] = __builtin_bswap32(state[1]);
+    out32[2] = __builtin_bswap32(state[2]);
+    out32[3] = __builtin_bswap32(state[3]);
+    out32[4] = __builtin_bswap32(state[4]);
+    out32[5] = __builtin_bswap32(state[5]);
+    out32[6] = __builtin_bswap32(state[6]);
+    out32[7] = __builtin_bswap32(state[7]);
+}
+
+// ============================================================================
+// 多线程并行处理
+// ============================================================================
+
+typedef struct {
+    const uint8_t* input;
+    uint8_t* output;
+    int thread_id;
+    int num_threads;
+    int block_count;
+    int output_size;  // 128 or 256
+    pthread_barrier_t* barrier;
+    aes_sm3_throttle_t* throttle;  // 后台限流（NULL表示不限）
+} thread_data_t;
+
+void* thread_worker(void* arg) {
+    thread_data_t* data = (thread_data_t*)arg;
+    
+    // 设置线程亲和性
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(data->thread_id % CPU_SETSIZE, &cpuset);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+    if (data->throttle) {
+        aes_sm3_throttle_idle_io();
+    }
+    
+    int blocks_per_thread = data->block_count / data->num_threads;
+    int start_block = data->thread_id * blocks_per_thread;
+    int end_block = (data->thread_id == data->num_threads - 1) ? 
+                   data->block_count : start_block + blocks_per_thread;
+    
+    for (int i = start_block; i < end_block; i++) {
+        if (data->throttle && (i - start_block) % 64 == 0) {
+            int n = end_block - i < 64 ? end_block - i : 64;
+            aes_sm3_throttle_acquire(data->throttle, (uint64_t)n * 4096);
+        }
+        const uint8_t* block_start = data->input + i * 4096;
+        uint8_t* output_start = data->output + i * (data->output_size / 8);
+        
+        if (data->output_size == 256) {
+            aes_sm3_integrity_256bit(block_start, output_start);
+        } else {
+            aes_sm3_integrity_128bit(block_start, output_start);
+        }
+    }
+    
+    pthread_barrier_wait(data->barrier);
+    return NULL;
+}
+
+// 后台版本：所有工作线程共享throttle的带宽/CPU预算
+void aes_sm3_parallel_throttled(const uint8_t* input, uint8_t* output, int block_count,
+                                int num_threads, int output_size, aes_sm3_throttle_t* throttle) {
+    int available_cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_threads > available_cores) {
+        num_threads = available_cores;
+    }
+    
+    pthread_t* threads = malloc(num_threads * sizeof(pthread_t));
+    thread_data_t* thread_data = malloc(num_threads * sizeof(thread_data_t));
+    pthread_barrier_t barrier;
+    pthread_barrier_init(&barrier, NULL, num_threads);
+    
+    for (int i = 0; i < num_threads; i++) {
+        thread_data[i].input = input;
+        thread_data[i].output = output;
+        thread_data[i].thread_id = i;
+        thread_data[i].num_threads = num_threads;
+        thread_data[i].block_count = block_count;
+        thread_data[i].output_size = output_size;
+        thread_data[i].barrier = &barrier;
+        thread_data[i].throttle = throttle;
+        
+        pthread_create(&threads[i], NULL, thread_worker, &thread_data[i]);
+    }
+    
+    for (int i = 0; i < num_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    
+    pthread_barrier_destroy(&barrier);
+    free(threads);
+    free(thread_data);
+}
+
+void aes_sm3_parallel(const uint8_t* input, uint8_t* output, int block_count, 
+                      int num_threads, int output_size) {
+    aes_sm3_parallel_throttled(input, output, block_count, num_threads, output_size, NULL);
+}
+
+// ============================================================================
+// 基准环境检查与降噪模式：绑核、调频/睿频、SMT兄弟负载、计时开销、波动估计
+// ============================================================================
+/*
+ * 同一台机器上基准结果来回波动±20%，主要来自调频、SMT兄弟线程的负载和未绑核的线程迁移。
+ * 环境检查在给定核心（默认优先选 /sys/devices/system/cpu/isolated 中的隔离核，
+ * 否则选可用核中编号最大的）上进行：
+ *   - 调频策略：scaling_governor 不是 performance 时告警（升频过程计入测量）
+ *   - 睿频：intel_pstate/no_turbo 或 cpufreq/boost 显示开启时告警（频率随温度/负载变化）
+ *   - SMT兄弟：读取 thread_siblings_list，用 /proc/stat 采样兄弟核100毫秒内的忙碌比例，
+ *     超过10%时告警（共享执行单元与L1/L2）
+ *   - 计时开销：连续调用 clock_gettime(CLOCK_MONOTONIC) 的平均开销与最小可分辨间隔
+ *   - 波动：绑核后重复10次固定负载（64页批量标签 × 16），变异系数CV超过3%时告警
+ * 检查结束后恢复调用线程原来的CPU亲和性。降噪基准在检查通过（或非严格模式）后绑核运行，
+ * 报告多次重复的中位数与CV；严格模式下环境不合格则拒绝运行。
+ */
+
+#define AES_SM3_ENV_RUNS          10
+#define AES_SM3_ENV_MAX_CV        0.03
+#define AES_SM3_ENV_MAX_SIBLING   0.10
+
+typedef struct {
+    int cpu;                       // 检查所用核心
+    int isolated;                  // 该核心在isolcpus中
+    char governor[32];             // 空串表示无法读取
+    int turbo;                     // 1开启，0关闭，-1未知
+    int sibling_count;             // 同一物理核上的其他逻辑核数
+    double sibling_busy;           // 兄弟核最大忙碌比例 [0,1]，无兄弟时为0
+    double timer_overhead_ns;
+    double timer_resolution_ns;
+    double noise_cv;               // 重复测量的变异系数
+    int warnings;                  // 不合格项数，0表示适合做基准
+} aes_sm3_bench_env_t;
+
+static int bench_read_line(const char* path, char* buf, size_t len) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) {
+        return -1;
+    }
+    int ok = fgets(buf, (int)len, fp) != NULL;
+    fclose(fp);
+    if (!ok) {
+        return -1;
+    }
+    buf[strcspn(buf, "\n")] = '\0';
+    return 0;
+}
+
+// 解析 "0-3,8,10-11" 形式的CPU列表，返回cpu是否在列表中；max_out非NULL时写入列表最大值
+static int bench_cpu_list_has(const char* list, int cpu, int* max_out) {
+    int found = 0, max = -1;
+    const char* p = list;
+    while (*p) {
+        char* end;
+        long lo = strtol(p, &end, 10);
+        if (end == p) {
+            break;
+        }
+        long hi = lo;
+        if (*end == '-') {
+            p = end + 1;
+            hi = strtol(p, &end, 10);
+        }
+        found |= cpu >= lo && cpu <= hi;
+        max = (int)hi > max ? (int)hi : max;
+        p = *end == ',' ? end + 1 : end;
+        if (end == p && *p) {
+            break;
+        }
+    }
+    if (max_out) {
+        *max_out = max;
+    }
+    return found;
+}
+
+// 读取 /proc/stat 中某个核的（忙碌, 总计）时钟滴答
+static int bench_cpu_ticks(int cpu, uint64_t* busy, uint64_t* total) {
+    FILE* fp = fopen("/proc/stat", "r");
+    if (!fp) {
+        return -1;
+    }
+    char line[512], name[16];
+    snprintf(name, sizeof(name), "cpu%d ", cpu);
+    int ret = -1;
+    while (fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, name, strlen(name)) == 0) {
+            unsigned long long v[8] = {0};
+            sscanf(line + strlen(name), "%llu %llu %llu %llu %llu %llu %llu %llu",
+                   &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7]);
+            *total = v[0] + v[1] + v[2] + v[3] + v[4] + v[5] + v[6] + v[7];
+            *busy = *total - v[3] - v[4];     // 去掉idle与iowait
+            ret = 0;
+            break;
+        }
+    }
+    fclose(fp);
+    return ret;
+}
+
+static int bench_pin_cpu(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+// 选择检查所用的核心：优先隔离核，其次可用核中编号最大的
+static int bench_pick_cpu(void) {
+    cpu_set_t set;
+    char isolated[256];
+    int max;
+    if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        return 0;
+    }
+    if (bench_read_line("/sys/devices/system/cpu/isolated", isolated, sizeof(isolated)) == 0 &&
+        bench_cpu_list_has(isolated, -1, &max) == 0 && max >= 0) {
+        for (int cpu = max; cpu >= 0; cpu--) {
+            if (bench_cpu_list_has(isolated, cpu, NULL) && CPU_ISSET(cpu, &set)) {
+                return cpu;
+            }
+        }
+    }
+    for (int cpu = CPU_SETSIZE - 1; cpu >= 0; cpu--) {
+        if (CPU_ISSET(cpu, &set)) {
+            return cpu;
+        }
+    }
+    return 0;
+}
+
+// 固定负载：64页批量标签重复16次，返回耗时（秒）
+static double bench_fixed_workload(const uint8_t* data, uint8_t* tags) {
+    const uint8_t* inputs[64];
+    uint8_t* outputs[64];
+    for (int j = 0; j < 64; j++) {
+        inputs[j] = data + j * 4096;
+        outputs[j] = tags + j * 32;
+    }
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int r = 0; r < 16; r++) {
+        aes_sm3_integrity_batch_domain(SM3_IV, NULL, inputs, outputs, 64);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+static double bench_cv(const double* v, int n, double* median) {
+    double sorted[AES_SM3_ENV_RUNS];
+    double mean = 0, var = 0;
+    for (int i = 0; i < n; i++) {
+        sorted[i] = v[i];
+        mean += v[i];
+    }
+    mean /= n;
+    for (int i = 0; i < n; i++) {
+        var += (v[i] - mean) * (v[i] - mean);
+    }
+    for (int i = 1; i < n; i++) {
+        for (int j = i; j > 0 && sorted[j - 1] > sorted[j]; j--) {
+            double t = sorted[j];
+            sorted[j] = sorted[j - 1];
+            sorted[j - 1] = t;
+        }
+    }
+    if (median) {
+        *median = n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+    }
+    return mean > 0 ? sqrt(var / n) / mean : 0;
+}
+
+// 在cpu（<0时自动选择）上检查基准环境，返回不合格项数，出错返回-1
+int aes_sm3_bench_env_check(int cpu, aes_sm3_bench_env_t* env) {
+    char path[128], buf[256];
+    memset(env, 0, sizeof(*env));
+    env->cpu = cpu >= 0 ? cpu : bench_pick_cpu();
+    env->turbo = -1;
+
+    if (bench_read_line("/sys/devices/system/cpu/isolated", buf, sizeof(buf)) == 0) {
+        env->isolated = bench_cpu_list_has(buf, env->cpu, NULL);
+    }
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_governor", env->cpu);
+    if (bench_read_line(path, buf, sizeof(buf)) == 0) {
+        snprintf(env->governor, sizeof(env->governor), "%.31s", buf);
+    }
+    if (bench_read_line("/sys/devices/system/cpu/intel_pstate/no_turbo", buf, sizeof(buf)) == 0) {
+        env->turbo = atoi(buf) == 0;
+    } else if (bench_read_line("/sys/devices/system/cpu/cpufreq/boost", buf, sizeof(buf)) == 0) {
+        env->turbo = atoi(buf) != 0;
+    }
+
+    // SMT兄弟核负载
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", env->cpu);
+    int siblings[8], sibling_count = 0, max = -1;
+    if (bench_read_line(path, buf, sizeof(buf)) == 0) {
+        bench_cpu_list_has(buf, -1, &max);
+        for (int c = 0; c <= max && sibling_count < 8; c++) {
+            if (c != env->cpu && bench_cpu_list_has(buf, c, NULL)) {
+                siblings[sibling_count++] = c;
+            }
+        }
+    }
+    env->sibling_count = sibling_count;
+    if (sibling_count > 0) {
+        uint64_t busy0[8], total0[8], busy1, total1;
+        for (int i = 0; i < sibling_count; i++) {
+            if (bench_cpu_ticks(siblings[i], &busy0[i], &total0[i]) != 0) {
+                total0[i] = UINT64_MAX;       // 读取失败，不参与比较
+            }
+        }
+        usleep(100000);
+        for (int i = 0; i < sibling_count; i++) {
+            if (bench_cpu_ticks(siblings[i], &busy1, &total1) == 0 && total1 > total0[i]) {
+                double b = (double)(busy1 - busy0[i]) / (double)(total1 - total0[i]);
+                env->sibling_busy = b > env->sibling_busy ? b : env->sibling_busy;
+            }
+        }
+    }
+
+    // 绑核后测计时开销与重复测量波动，结束时恢复原亲和性
+    cpu_set_t saved;
+    int have_saved = pthread_getaffinity_np(pthread_self(), sizeof(saved), &saved) == 0;
+    if (bench_pin_cpu(env->cpu) != 0) {
+        return -1;
+    }
+
+    struct timespec a, b;
+    const int timer_calls = 100000;
+    double min_step = 1e9;
+    clock_gettime(CLOCK_MONOTONIC, &a);
+    struct timespec prev = a;
+    for (int i = 0; i < timer_calls; i++) {
+        clock_gettime(CLOCK_MONOTONIC, &b);
+        double step = (b.tv_sec - prev.tv_sec) * 1e9 + (b.tv_nsec - prev.tv_nsec);
+        if (step > 0 && step < min_step) {
+            min_step = step;
+        }
+        prev = b;
+    }
+    env->timer_overhead_ns = ((b.tv_sec - a.tv_sec) * 1e9 + (b.tv_nsec - a.tv_nsec)) / timer_calls;
+    env->timer_resolution_ns = min_step;
+
+    uint8_t* data = (uint8_t*)aligned_alloc(64, 64 * 4096);
+    uint8_t tags[64 * 32];
+    double runs[AES_SM3_ENV_RUNS];
+    if (data) {
+        aes_sm3_datagen_fill(&aes_sm3_datagen_mixed, 1, data, 0, 64);
+        bench_fixed_workload(data, tags);           // 预热
+        for (int r = 0; r < AES_SM3_ENV_RUNS; r++) {
+            runs[r] = bench_fixed_workload(data, tags);
+        }
+        env->noise_cv = bench_cv(runs, AES_SM3_ENV_RUNS, NULL);
+        free(data);
+    }
+    if (have_saved) {
+        pthread_setaffinity_np(pthread_self(), sizeof(saved), &saved);
+    }
+
+    env->warnings = (env->governor[0] && strcmp(env->governor, "performance") != 0) +
+                    (env->turbo == 1) +
+                    (env->sibling_busy > AES_SM3_ENV_MAX_SIBLING) +
+                    (env->noise_cv > AES_SM3_ENV_MAX_CV) +
+                    (env->timer_overhead_ns > 1000);
+    return env->warnings;
+}
+
+void aes_sm3_bench_env_print(const aes_sm3_bench_env_t* env) {
+    printf(">>> 基准环境 (CPU %d%s)\n", env->cpu, env->isolated ? ", 隔离核" : "");
+    printf("  调频策略: %s%s\n", env->governor[0] ? env->governor : "未知",
+           env->governor[0] && strcmp(env->governor, "performance") != 0 ? "  [警告] 建议设为performance" : "");
+    printf("  睿频: %s%s\n", env->turbo < 0 ? "未知" : env->turbo ? "开启" : "关闭",
+           env->turbo == 1 ? "  [警告] 频率随温度与负载变化，建议关闭" : "");
+    if (env->sibling_count > 0) {
+        printf("  SMT兄弟核: %d个, 最大忙碌 %.1f%%%s\n", env->sibling_count, env->sibling_busy * 100,
+               env->sibling_busy > AES_SM3_ENV_MAX_SIBLING ? "  [警告] 兄弟核繁忙，共享执行单元" : "");
+    } else {
+        printf("  SMT兄弟核: 无\n");
+    }
+    printf("  计时开销: %.1f ns/次, 最小间隔 %.1f ns%s\n", env->timer_overhead_ns, env->timer_resolution_ns,
+           env->timer_overhead_ns > 1000 ? "  [警告] 时钟源开销过大" : "");
+    printf("  重复测量CV: %.2f%%%s\n", env->noise_cv * 100,
+           env->noise_cv > AES_SM3_ENV_MAX_CV ? "  [警告] 波动过大" : "");
+    if (!env->isolated) {
+        printf("  提示: 该核未隔离（isolcpus/cpuset），其他任务可能被调度到此核\n");
+    }
+    printf("  结论: %s\n", env->warnings ? "环境不适合做可比较的基准" : "环境合格");
+}
+
+// 降噪基准：检查环境后绑核，单块与批量各重复10次，报告中位数与CV
+// strict为真且环境不合格时拒绝运行；返回0完成，1被拒绝，-1出错
+int stable_benchmark(int cpu, int strict) {
+    aes_sm3_bench_env_t env;
+    if (aes_sm3_bench_env_check(cpu, &env) < 0) {
+        printf("无法绑定到CPU %d\n", cpu);
+        return -1;
+    }
+    aes_sm3_bench_env_print(&env);
+    if (env.warnings && strict) {
+        printf("严格模式: 环境不合格，拒绝运行\n");
+        return 1;
+    }
+
+    const int pages = 256, reps = 20;
+    uint8_t* data = (uint8_t*)aligned_alloc(64, pages * 4096);
+    uint8_t* tags = (uint8_t*)aligned_alloc(64, pages * 32);
+    if (!data || !tags) {
+        free(data);
+        free(tags);
+        return -1;
+    }
+    aes_sm3_datagen_fill(&aes_sm3_datagen_mixed, 1, data, 0, pages);
+    cpu_set_t saved;
+    int have_saved = pthread_getaffinity_np(pthread_self(), sizeof(saved), &saved) == 0;
+    bench_pin_cpu(env.cpu);
+
+    printf("\n>>> 降噪基准 (CPU %d, %d页 × %d遍, 重复%d次)\n", env.cpu, pages, reps, AES_SM3_ENV_RUNS);
+    for (int batch = 0; batch <= 1; batch++) {
+        double mbps[AES_SM3_ENV_RUNS];
+        for (int r = -1; r < AES_SM3_ENV_RUNS; r++) {      // r = -1 为预热
+            struct timespec start, end;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            for (int k = 0; k < reps; k++) {
+                if (batch) {
+                    const uint8_t* inputs[8];
+                    uint8_t* outputs[8];
+                    for (int p = 0; p < pages; p += 8) {
+                        for (int j = 0; j < 8; j++) {
+                            inputs[j] = data + (p + j) * 4096;
+                            outputs[j] = tags + (p + j) * 32;
+                        }
+                        aes_sm3_integrity_batch(inputs, outputs, 8);
+                    }
+                } else {
+                    for (int p = 0; p < pages; p++) {
+                        aes_sm3_integrity_256bit(data + p * 4096, tags + p * 32);
+                    }
+                }
+            }
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+            if (r >= 0) {
+                mbps[r] = pages * reps * 4.0 / 1024.0 / elapsed;
+            }
+        }
+        double median;
+        double cv = bench_cv(mbps, AES_SM3_ENV_RUNS, &median);
+        printf("  %s: 中位数 %.2f MB/s, CV %.2f%%%s\n", batch ? "批量(8页)" : "单块", median, cv * 100,
+               cv > AES_SM3_ENV_MAX_CV ? "  [警告] 本次测量波动过大" : "");
+    }
+
+    if (have_saved) {
+        pthread_setaffinity_np(pthread_self(), sizeof(saved), &saved);
+    }
+    free(data);
+    free(tags);
+    return 0;
+}
+
+// ============================================================================
+// 多租户并发基准：多个独立调用线程同时调用批量/单块/并行接口
+// ============================================================================
+/*
+ * 生产环境中是许多线程同时调用标签接口，每次调用内部的aligned_alloc/free、
+ * 线程创建与CPU绑定等共享资源会在这里互相争用，单线程基准测不出来。
+ * 每个租户线程持有各自的数据（合成数据生成器，每租户不同种子），在相同的起跑屏障后
+ * 轮流调用所选接口，直到时长结束：
+ *   - 批量：aes_sm3_integrity_batch，每次8页
+ *   - 单块：aes_sm3_integrity_256bit，每次8页逐页调用
+ *   - 并行：aes_sm3_parallel，每次64页、2个工作线程
+ * 每次调用的结果与开始前单独算出的参考标签比较，共享状态被破坏时计入不符。
+ * 报告总吞吐、各租户吞吐的最小/最大值与Jain公平性指数 (Σx)²/(n·Σx²)，
+ * 扩展效率 = N租户总吞吐 / (N × 1租户总吞吐)。
+ */
+
+#define AES_SM3_TENANT_BATCH      1
+#define AES_SM3_TENANT_SINGLE     2
+#define AES_SM3_TENANT_PARALLEL   4
+#define AES_SM3_TENANT_PAGES      64
+
+typedef struct {
+    int tenants;
+    uint64_t pages;                // 各租户处理页数之和
+    uint64_t mismatches;
+    double elapsed_sec;
+    double mb_per_sec;             // 总吞吐
+    double min_tenant_mb_per_sec;
+    double max_tenant_mb_per_sec;
+    double fairness;               // Jain指数，1表示完全公平
+} aes_sm3_tenant_report_t;
+
+typedef struct {
+    int id;
+    int ops;
+    pthread_mutex_t* gate;         // 创建线程期间由调用方持有，放行后屏障才已初始化
+    pthread_barrier_t* start;
+    volatile int* stop;
+    uint64_t pages;
+    uint64_t mismatches;
+} tenant_ctx_t;
+
+static void* tenant_worker(void* arg) {
+    tenant_ctx_t* t = (tenant_ctx_t*)arg;
+    uint8_t* data = (uint8_t*)aligned_alloc(64, AES_SM3_TENANT_PAGES * 4096);
+    uint8_t ref[AES_SM3_TENANT_PAGES][32], out[AES_SM3_TENANT_PAGES][32];
+    const uint8_t* inputs[8];
+    uint8_t* outputs[8];
+
+    pthread_mutex_lock(t->gate);
+    pthread_mutex_unlock(t->gate);
+    if (!data) {
+        pthread_barrier_wait(t->start);
+        return NULL;
+    }
+    aes_sm3_datagen_fill(&aes_sm3_datagen_mixed, 1000 + t->id, data, 0, AES_SM3_TENANT_PAGES);
+    for (int p = 0; p < AES_SM3_TENANT_PAGES; p++) {
+        aes_sm3_integrity_256bit(data + p * 4096, ref[p]);
+    }
+    pthread_barrier_wait(t->start);
+
+    for (uint64_t round = 0; !*t->stop; round++) {
+        int base = (int)(round * 8 % AES_SM3_TENANT_PAGES);
+        if (t->ops & AES_SM3_TENANT_BATCH) {
+            for (int j = 0; j < 8; j++) {
+                inputs[j] = data + (base + j) * 4096;
+                outputs[j] = out[base + j];
+            }
+            aes_sm3_integrity_batch(inputs, outputs, 8);
+            t->mismatches += memcmp(out[base], ref[base], 8 * 32) != 0;
+            t->pages += 8;
+        }
+        if (t->ops & AES_SM3_TENANT_SINGLE) {
+            for (int j = 0; j < 8; j++) {
+                aes_sm3_integrity_256bit(data + (base + j) * 4096, out[base + j]);
+            }
+            t->mismatches += memcmp(out[base], ref[base], 8 * 32) != 0;
+            t->pages += 8;
+        }
+        if ((t->ops & AES_SM3_TENANT_PARALLEL) && round % 8 == 0) {
+            aes_sm3_parallel(data, out[0], AES_SM3_TENANT_PAGES, 2, 256);
+            t->mismatches += memcmp(out, ref, sizeof(ref)) != 0;
+            t->pages += AES_SM3_TENANT_PAGES;
+        }
+    }
+    free(data);
+    return NULL;
+}
+
+// tenants个租户并发运行seconds秒；ops为AES_SM3_TENANT_*的组合；返回0成功
+int aes_sm3_tenant_run(int tenants, double seconds, int ops, aes_sm3_tenant_report_t* report) {
+    memset(report, 0, sizeof(*report));
+    if (tenants < 1 || tenants > 256 || seconds <= 0 || (ops & 7) == 0) {
+        return -1;
+    }
+    tenant_ctx_t* ctx = (tenant_ctx_t*)calloc(tenants, sizeof(tenant_ctx_t));
+    pthread_t* threads = (pthread_t*)malloc(tenants * sizeof(pthread_t));
+    if (!ctx || !threads) {
+        free(ctx);
+        free(threads);
+        return -1;
+    }
+
+    // 屏障按实际创建的线程数初始化；创建失败的租户不参加本轮
+    pthread_mutex_t gate = PTHREAD_MUTEX_INITIALIZER;
+    pthread_barrier_t start;
+    volatile int stop = 0;
+    int created = 0;
+    pthread_mutex_lock(&gate);
+    for (int i = 0; i < tenants; i++) {
+        tenant_ctx_t* c = &ctx[created];
+        c->id = created;
+        c->ops = ops;
+        c->gate = &gate;
+        c->start = &start;
+        c->stop = &stop;
+        if (pthread_create(&threads[created], NULL, tenant_worker, c) == 0) {
+            created++;
+        }
+    }
+    if (created == 0) {
+        pthread_mutex_unlock(&gate);
+        free(ctx);
+        free(threads);
+        return -1;
+    }
+    tenants = created;
+    pthread_barrier_init(&start, NULL, tenants + 1);
+    pthread_mutex_unlock(&gate);
+
+    struct timespec t0, t1;
+    pthread_barrier_wait(&start);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    struct timespec duration = {(time_t)seconds, (long)((seconds - (time_t)seconds) * 1e9)};
+    nanosleep(&duration, NULL);
+    stop = 1;
+    for (int i = 0; i < tenants; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    pthread_barrier_destroy(&start);
+    pthread_mutex_destroy(&gate);
+
+    double elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    double sum = 0, sum_sq = 0;
+    report->tenants = tenants;
+    report->elapsed_sec = elapsed;
+    report->min_tenant_mb_per_sec = -1;
+    for (int i = 0; i < tenants; i++) {
+        double mbps = ctx[i].pages * 4096.0 / (1024.0 * 1024.0) / elapsed;
+        report->pages += ctx[i].pages;
+        report->mismatches += ctx[i].mismatches;
+        if (report->min_tenant_mb_per_sec < 0 || mbps < report->min_tenant_mb_per_sec) {
+            report->min_tenant_mb_per_sec = mbps;
+        }
+        if (mbps > report->max_tenant_mb_per_sec) {
+            report->max_tenant_mb_per_sec = mbps;
+        }
+        sum += mbps;
+        sum_sq += mbps * mbps;
+    }
+    report->mb_per_sec = sum;
+    report->fairness = sum_sq > 0 ? sum * sum / (tenants * sum_sq) : 0;
+
+    free(ctx);
+    free(threads);
+    return 0;
+}
+
+// 租户数从1倍增到max_tenants（<=0时为在线核心数），每级运行seconds秒
+void multi_tenant_benchmark(int max_tenants, double seconds) {
+    static const struct {
+        const char* name;
+        int ops;
+    } mixes[] = {
+        {"批量", AES_SM3_TENANT_BATCH},
+        {"单块", AES_SM3_TENANT_SINGLE},
+        {"并行", AES_SM3_TENANT_PARALLEL},
+        {"混合", AES_SM3_TENANT_BATCH | AES_SM3_TENANT_SINGLE | AES_SM3_TENANT_PARALLEL},
+    };
+    if (max_tenants <= 0) {
+        max_tenants = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+
+    printf("\n>>> 多租户并发 (最多%d个租户, 每级%.1f秒)\n", max_tenants, seconds);
+    for (size_t m = 0; m < sizeof(mixes) / sizeof(mixes[0]); m++) {
+        printf("  [%s]\n", mixes[m].name);
+        printf("  租户    总吞吐(MB/s)   每租户最小/最大(MB/s)   公平性   扩展效率\n");
+        double single = 0;
+        for (int n = 1; n <= max_tenants; n = n * 2 > max_tenants && n < max_tenants ? max_tenants : n * 2) {
+            aes_sm3_tenant_report_t rep;
+            if (aes_sm3_tenant_run(n, seconds, mixes[m].ops, &rep) != 0) {
+                break;
+            }
+            if (n == 1) {
+                single = rep.mb_per_sec;
+            }
+            printf("  %4d  %14.2f   %10.2f / %-10.2f   %6.3f   %6.1f%%%s\n", n, rep.mb_per_sec,
+                   rep.min_tenant_mb_per_sec, rep.max_tenant_mb_per_sec, rep.fairness,
+                   single > 0 ? 100.0 * rep.mb_per_sec / (n * single) : 0,
+                   rep.mismatches ? "  结果不符!" : "");
+        }
+    }
+}
+
+// ============================================================================
+// 基准JSON输出与性能报告生成
+// ============================================================================
+/*
+ * 手工填写的测试报告难以跨版本比较。benchjson按 版本 × 工作集（缓存层级）× 线程数
+ * 运行矩阵并写出JSON：
+ *   - 工作集为每线程大小：L1 16KB、L2 256KB、LLC 4MB、DRAM 64MB（总量超过1GB时按线程均分1GB）
+ *   - 每项测量各线程在同一屏障后起跑，在各自的工作集上反复计算seconds秒
+ *   - read 伪版本只顺序读取并累加，给出该层级、该线程数下的读带宽
+ *   - 屋顶线：计算上限 = 所有版本、层级中单线程的最高吞吐 × 线程数，带宽上限 = 同层级同线程数的read带宽，
+ *     roofline_pct = 吞吐 / min(两者)
+ * report读取JSON生成Markdown（外加每个层级一张SVG扩展曲线）或HTML（SVG内联），
+ * 给出上次结果时附加逐项对比，变化超过±5%标出提升/回退。JSON中每条结果是不含嵌套的对象，
+ * 解析器只处理本工具写出的格式。
+ */
+
+#define AES_SM3_BENCH_SCHEMA      "aes-sm3-bench/1"
+#define AES_SM3_BENCH_MAX_TOTAL   (1ULL << 30)
+#define AES_SM3_BENCH_MAX_RECORDS 1024
+
+typedef struct {
+    const char* name;
+    size_t working_set;
+} bench_tier_t;
+
+static const bench_tier_t BENCH_TIERS[] = {
+    {"L1", 16 * 1024},
+    {"L2", 256 * 1024},
+    {"LLC", 4 * 1024 * 1024},
+    {"DRAM", 64 * 1024 * 1024},
+};
+
+static const char* const BENCH_VARIANTS[] = {"read", "256bit", "extreme", "ultra", "batch8", "domain64"};
+
+#define BENCH_TIER_COUNT     (int)(sizeof(BENCH_TIERS) / sizeof(BENCH_TIERS[0]))
+#define BENCH_VARIANT_COUNT  (int)(sizeof(BENCH_VARIANTS) / sizeof(BENCH_VARIANTS[0]))
+
+typedef struct {
+    int variant;
+    const uint8_t* data;
+    size_t size;
+    double seconds;
+    pthread_mutex_t* gate;         // 创建线程期间由调用方持有，放行后屏障才已初始化
+    pthread_barrier_t* start;
+    uint64_t bytes;
+    double elapsed;
+    uint64_t sink;
+} bench_job_t;
+
+// 对工作集做一遍指定版本的计算
+static void bench_pass(bench_job_t* j, uint8_t* tags) {
+    size_t pages = j->size / 4096;
+    const uint8_t* inputs[64];
+    uint8_t* outputs[64];
+    switch (j->variant) {
+    case 0: {
+        const uint64_t* w = (const uint64_t*)j->data;
+        uint64_t sum = 0;
+        for (size_t i = 0; i < j->size / 8; i++) {
+            sum += w[i];
+        }
+        j->sink += sum;
+        break;
+    }
+    case 1:
+    case 2:
+    case 3:
+        for (size_t p = 0; p < pages; p++) {
+            uint8_t* out = tags + (p % 64) * 32;
+            if (j->variant == 1) {
+                aes_sm3_integrity_256bit(j->data + p * 4096, out);
+            } else if (j->variant == 2) {
+                aes_sm3_integrity_256bit_extreme(j->data + p * 4096, out);
+            } else {
+                aes_sm3_integrity_256bit_ultra(j->data + p * 4096, out);
+            }
+        }
+        break;
+    default: {
+        int group = j->variant == 4 ? 8 : 64;
+        for (size_t p = 0; p < pages; p += group) {
+            int k = pages - p < (size_t)group ? (int)(pages - p) : group;
+            for (int i = 0; i < k; i++) {
+                inputs[i] = j->data + (p + i) * 4096;
+                outputs[i] = tags + i * 32;
+            }
+            if (j->variant == 4) {
+                aes_sm3_integrity_batch(inputs, outputs, k);
+            } else {
+                aes_sm3_integrity_batch_domain(SM3_IV, NULL, inputs, outputs, k);
+            }
+        }
+        break;
+    }
+    }
+    j->bytes += pages * 4096;
+}
+
+static void* bench_job_worker(void* arg) {
+    bench_job_t* j = (bench_job_t*)arg;
+    uint8_t tags[64 * 32];
+    struct timespec start, now;
+    pthread_mutex_lock(j->gate);
+    pthread_mutex_unlock(j->gate);
+    pthread_barrier_wait(j->start);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    do {
+        bench_pass(j, tags);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        j->elapsed = (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+    } while (j->elapsed < j->seconds);
+    return NULL;
+}
+
+// threads个线程各自在data中自己的一段上运行variant，返回总吞吐（MB/s）
+// 第0段在调用线程中运行；创建失败的线程不计入吞吐，屏障按实际参与的线程数初始化
+static double bench_measure(int variant, const uint8_t* data, size_t slice, int threads, double seconds) {
+    bench_job_t jobs[256];
+    pthread_t tids[256];
+    int started[256] = {0};
+    int participants = 1;
+    pthread_mutex_t gate = PTHREAD_MUTEX_INITIALIZER;
+    pthread_barrier_t start;
+    pthread_mutex_lock(&gate);
+    for (int t = 0; t < threads; t++) {
+        memset(&jobs[t], 0, sizeof(jobs[t]));
+        jobs[t].variant = variant;
+        jobs[t].data = data + t * slice;
+        jobs[t].size = slice;
+        jobs[t].seconds = seconds;
+        jobs[t].gate = &gate;
+        jobs[t].start = &start;
+        if (t > 0) {
+            started[t] = pthread_create(&tids[t], NULL, bench_job_worker, &jobs[t]) == 0;
+            participants += started[t];
+        }
+    }
+    started[0] = 1;
+    pthread_barrier_init(&start, NULL, participants);
+    pthread_mutex_unlock(&gate);
+    bench_job_worker(&jobs[0]);
+    double mbps = 0;
+    for (int t = 0; t < threads; t++) {
+        if (!started[t]) {
+            continue;
+        }
+        if (t > 0) {
+            pthread_join(tids[t], NULL);
+        }
+        mbps += jobs[t].bytes / (1024.0 * 1024.0) / jobs[t].elapsed;
+    }
+    pthread_barrier_destroy(&start);
+    pthread_mutex_destroy(&gate);
+    return mbps;
+}
+
+static void bench_cpu_model(char* buf, size_t len) {
+    snprintf(buf, len, "unknown");
+    FILE* fp = fopen("/proc/cpuinfo", "r");
+    if (!fp) {
+        return;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, "model name", 10) == 0 || strncmp(line, "CPU part", 8) == 0) {
+            char* v = strchr(line, ':');
+            if (v) {
+                v += strspn(v + 1, " \t") + 1;
+                v[strcspn(v, "\n")] = '\0';
+                snprintf(buf, len, "%s", v);
+            }
+            if (line[0] == 'm') {
+                break;
+            }
+        }
+    }
+    fclose(fp);
+}
+
+// 运行基准矩阵并写出JSON；max_threads<=0时为在线核心数；返回0成功
+int aes_sm3_bench_json(const char* path, double seconds, int max_threads) {
+    int cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (max_threads <= 0 || max_threads > cores) {
+        max_threads = cores;
+    }
+    if (max_threads > 256) {
+        max_threads = 256;
+    }
+    int levels[16], level_count = 0;
+    for (int n = 1; n <= max_threads && level_count < 16; n = n * 2 > max_threads && n < max_threads ? max_threads : n * 2) {
+        levels[level_count++] = n;
+    }
+
+    // [层级][线程级][版本]
+    static double mbps[BENCH_TIER_COUNT][16][BENCH_VARIANT_COUNT];
+    for (int t = 0; t < BENCH_TIER_COUNT; t++) {
+        for (int l = 0; l < level_count; l++) {
+            int threads = levels[l];
+            size_t slice = BENCH_TIERS[t].working_set;
+            if ((uint64_t)slice * threads > AES_SM3_BENCH_MAX_TOTAL) {
+                slice = (size_t)(AES_SM3_BENCH_MAX_TOTAL / threads) & ~(size_t)4095;
+            }
+            uint8_t* data = (uint8_t*)aligned_alloc(4096, slice * threads);
+            if (!data) {
+                return -1;
+            }
+            aes_sm3_datagen_fill(&aes_sm3_datagen_mixed, 1, data, 0, slice * threads / 4096);
+            for (int v = 0; v < BENCH_VARIANT_COUNT; v++) {
+                mbps[t][l][v] = bench_measure(v, data, slice, threads, seconds);
+            }
+            free(data);
+        }
+    }
+
+    double peak = 0;
+    for (int t = 0; t < BENCH_TIER_COUNT; t++) {
+        for (int v = 1; v < BENCH_VARIANT_COUNT; v++) {
+            peak = mbps[t][0][v] > peak ? mbps[t][0][v] : peak;
+        }
+    }
+
+    FILE* fp = fopen(path, "w");
+    if (!fp) {
+        return -1;
+    }
+    char cpu[128], stamp[32];
+    time_t now = time(NULL);
+    struct tm tm_utc;
+    gmtime_r(&now, &tm_utc);
+    strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", &tm_utc);
+    bench_cpu_model(cpu, sizeof(cpu));
+    for (char* c = cpu; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            *c = ' ';
+        }
+    }
+
+    fprintf(fp, "{\n  \"schema\": \"%s\",\n  \"timestamp\": \"%s\",\n  \"cpu\": \"%s\",\n"
+                "  \"cores\": %d,\n  \"seconds\": %.3f,\n  \"compute_peak_mb_per_sec\": %.2f,\n  \"results\": [\n",
+            AES_SM3_BENCH_SCHEMA, stamp, cpu, cores, seconds, peak);
+    int first = 1;
+    for (int t = 0; t < BENCH_TIER_COUNT; t++) {
+        for (int l = 0; l < level_count; l++) {
+            for (int v = 0; v < BENCH_VARIANT_COUNT; v++) {
+                double roof = peak * levels[l];
+                if (mbps[t][l][0] < roof) {
+                    roof = mbps[t][l][0];
+                }
+                fprintf(fp, "%s    {\"variant\": \"%s\", \"tier\": \"%s\", \"working_set\": %zu, \"threads\": %d, "
+                            "\"mb_per_sec\": %.2f, \"roofline_pct\": %.1f}",
+                        first ? "" : ",\n", BENCH_VARIANTS[v], BENCH_TIERS[t].name, BENCH_TIERS[t].working_set,
+                        levels[l], mbps[t][l][v], v > 0 && roof > 0 ? 100.0 * mbps[t][l][v] / roof : 100.0);
+                first = 0;
+            }
+        }
+    }
+    fprintf(fp, "\n  ]\n}\n");
+    return fclose(fp) == 0 ? 0 : -1;
+}
+
+// ---- 报告生成 ----
+
+typedef struct {
+    char variant[32];
+    char tier[16];
+    uint64_t working_set;
+    int threads;
+    double mb_per_sec;
+    double roofline_pct;
+} bench_record_t;
+
+typedef struct {
+    char timestamp[32];
+    char cpu[128];
+    int cores;
+    double peak;
+    int count;
+    bench_record_t rec[AES_SM3_BENCH_MAX_RECORDS];
+} bench_doc_t;
+
+// 在[p, end)中查找 "key": 并返回值的起始位置
+static const char* bench_json_value(const char* p, const char* end, const char* key) {
+    char pattern[48];
+    snprintf(pattern, sizeof(pattern), "\"%s\"", key);
+    size_t n = strlen(pattern);
+    for (; p + n <= end; p++) {
+        if (memcmp(p, pattern, n) == 0) {
+            p += n;
+            while (p < end && (*p == ' ' || *p == ':')) {
+                p++;
+            }
+            return p;
+        }
+    }
+    return NULL;
+}
+
+static void bench_json_str(const char* p, const char* end, const char* key, char* out, size_t len) {
+    out[0] = '\0';
+    const char* v = bench_json_value(p, end, key);
+    if (v && *v == '"') {
+        const char* q = memchr(v + 1, '"', end - v - 1);
+        size_t n = q ? (size_t)(q - v - 1) : 0;
+        n = n < len - 1 ? n : len - 1;
+        memcpy(out, v + 1, n);
+        out[n] = '\0';
+    }
+}
+
+static double bench_json_num(const char* p, const char* end, const char* key) {
+    const char* v = bench_json_value(p, end, key);
+    return v ? strtod(v, NULL) : 0;
+}
+
+static int bench_doc_load(const char* path, bench_doc_t* doc) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) {
+        return -1;
+    }
+    long size = fseek(fp, 0, SEEK_END) == 0 ? ftell(fp) : -1;
+    char* text = size >= 0 && fseek(fp, 0, SEEK_SET) == 0 ? (char*)malloc((size_t)size + 1) : NULL;
+    if (!text || fread(text, 1, size, fp) != (size_t)size) {
+        free(text);
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+    text[size] = '\0';
+
+    memset(doc, 0, sizeof(*doc));
+    char schema[32];
+    const char* end = text + size;
+    const char* results = bench_json_value(text, end, "results");
+    const char* head_end = results ? results : end;
+    bench_json_str(text, head_end, "schema", schema, sizeof(schema));
+    if (strcmp(schema, AES_SM3_BENCH_SCHEMA) != 0 || !results) {
+        free(text);
+        return -1;
+    }
+    bench_json_str(text, head_end, "timestamp", doc->timestamp, sizeof(doc->timestamp));
+    bench_json_str(text, head_end, "cpu", doc->cpu, sizeof(doc->cpu));
+    doc->cores = (int)bench_json_num(text, head_end, "cores");
+    doc->peak = bench_json_num(text, head_end, "compute_peak_mb_per_sec");
+
+    for (const char* p = results; (p = memchr(p, '{', end - p)) && doc->count < AES_SM3_BENCH_MAX_RECORDS;) {
+        const char* q = memchr(p, '}', end - p);
+        if (!q) {
+            break;
+        }
+        bench_record_t* r = &doc->rec[doc->count++];
+        bench_json_str(p, q, "variant", r->variant, sizeof(r->variant));
+        bench_json_str(p, q, "tier", r->tier, sizeof(r->tier));
+        r->working_set = (uint64_t)bench_json_num(p, q, "working_set");
+        r->threads = (int)bench_json_num(p, q, "threads");
+        r->mb_per_sec = bench_json_num(p, q, "mb_per_sec");
+        r->roofline_pct = bench_json_num(p, q, "roofline_pct");
+        p = q + 1;
+    }
+    free(text);
+    return 0;
+}
+
+static const bench_record_t* bench_doc_find(const bench_doc_t* doc, const char* variant,
+                                            const char* tier, int threads) {
+    for (int i = 0; i < doc->count; i++) {
+        const bench_record_t* r = &doc->rec[i];
+        if (r->threads == threads && strcmp(r->variant, variant) == 0 && strcmp(r->tier, tier) == 0) {
+            return r;
+        }
+    }
+    return NULL;
+}
+
+// 按出现顺序收集不重复的版本/层级/线程数
+static int bench_doc_axes(const bench_doc_t* doc, const char* variants[], const char* tiers[], int threads[],
+                          int* vn, int* tn) {
+    int n = 0;
+    *vn = *tn = 0;
+    for (int i = 0; i < doc->count; i++) {
+        const bench_record_t* r = &doc->rec[i];
+        int k;
+        for (k = 0; k < *vn && strcmp(variants[k], r->variant) != 0; k++) {
+        }
+        if (k == *vn && *vn < 16) {
+            variants[(*vn)++] = r->variant;
+        }
+        for (k = 0; k < *tn && strcmp(tiers[k], r->tier) != 0; k++) {
+        }
+        if (k == *tn && *tn < 16) {
+            tiers[(*tn)++] = r->tier;
+        }
+        for (k = 0; k < n && threads[k] != r->threads; k++) {
+        }
+        if (k == n && n < 16) {
+            threads[n++] = r->threads;
+        }
+    }
+    return n;
+}
+
+// 一个层级的扩展曲线：横轴为线程级（等距），纵轴为吞吐
+static void bench_write_svg(FILE* fp, const bench_doc_t* doc, const char* tier, const char* variants[], int vn,
+                            const int threads[], int ln) {
+    static const char* const colors[] = {"#888888", "#1f77b4", "#ff7f0e", "#2ca02c", "#d62728",
+                                         "#9467bd", "#8c564b", "#e377c2"};
+    const int w = 640, h = 360, left = 70, right = 130, top = 30, bottom = 50;
+    double ymax = 0;
+    for (int i = 0; i < doc->count; i++) {
+        if (strcmp(doc->rec[i].tier, tier) == 0 && doc->rec[i].mb_per_sec > ymax) {
+            ymax = doc->rec[i].mb_per_sec;
+        }
+    }
+    ymax = ymax > 0 ? ymax * 1.1 : 1;
+    double pw = w - left - right, ph = h - top - bottom;
+
+    fprintf(fp, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%d\" height=\"%d\" font-family=\"sans-serif\" "
+                "font-size=\"12\">\n", w, h);
+    fprintf(fp, "<text x=\"%d\" y=\"18\" font-size=\"14\">%s 扩展曲线 (MB/s)</text>\n", left, tier);
+    fprintf(fp, "<line x1=\"%d\" y1=\"%d\" x2=\"%d\" y2=\"%d\" stroke=\"black\"/>\n", left, top, left, h - bottom);
+    fprintf(fp, "<line x1=\"%d\" y1=\"%d\" x2=\"%d\" y2=\"%d\" stroke=\"black\"/>\n",
+            left, h - bottom, w - right, h - bottom);
+    for (int g = 0; g <= 4; g++) {
+        double y = top + ph - ph * g / 4;
+        fprintf(fp, "<line x1=\"%d\" y1=\"%.1f\" x2=\"%d\" y2=\"%.1f\" stroke=\"#dddddd\"/>"
+                    "<text x=\"%d\" y=\"%.1f\" text-anchor=\"end\">%.0f</text>\n",
+                left, y, w - right, y, left - 6, y + 4, ymax * g / 4);
+    }
+    for (int l = 0; l < ln; l++) {
+        double x = left + (ln > 1 ? pw * l / (ln - 1) : pw / 2);
+        fprintf(fp, "<text x=\"%.1f\" y=\"%d\" text-anchor=\"middle\">%d</text>\n", x, h - bottom + 18, threads[l]);
+    }
+    fprintf(fp, "<text x=\"%.1f\" y=\"%d\" text-anchor=\"middle\">线程数</text>\n", left + pw / 2, h - 10);
+
+    for (int v = 0; v < vn; v++) {
+        const char* color = colors[v % 8];
+        fprintf(fp, "<polyline fill=\"none\" stroke=\"%s\" stroke-width=\"2\"%s points=\"", color,
+                strcmp(variants[v], "read") == 0 ? " stroke-dasharray=\"6,4\"" : "");
+        for (int l = 0; l < ln; l++) {
+            const bench_record_t* r = bench_doc_find(doc, variants[v], tier, threads[l]);
+            if (r) {
+                double x = left + (ln > 1 ? pw * l / (ln - 1) : pw / 2);
+                fprintf(fp, "%.1f,%.1f ", x, top + ph - ph * r->mb_per_sec / ymax);
+            }
+        }
+        fprintf(fp, "\"/>\n<text x=\"%d\" y=\"%d\" fill=\"%s\">%s</text>\n",
+                w - right + 10, top + 16 * v + 10, color, variants[v]);
+    }
+    fprintf(fp, "</svg>\n");
+}
+
+// 由JSON生成报告；out以.html结尾时生成HTML，否则生成Markdown并在同目录写出SVG
+// prev_path可为NULL；返回0成功
+int aes_sm3_bench_report(const char* json_path, const char* out_path, const char* prev_path) {
+    bench_doc_t* doc = (bench_doc_t*)malloc(sizeof(bench_doc_t));
+    bench_doc_t* prev = prev_path ? (bench_doc_t*)malloc(sizeof(bench_doc_t)) : NULL;
+    FILE* fp = NULL;
+    int ret = -1;
+    if (!doc || bench_doc_load(json_path, doc) != 0 || (prev_path && (!prev || bench_doc_load(prev_path, prev) != 0))) {
+        goto out;
+    }
+    size_t out_len = strlen(out_path);
+    int html = out_len > 5 && strcmp(out_path + out_len - 5, ".html") == 0;
+    fp = fopen(out_path, "w");
+    if (!fp) {
+        goto out;
+    }
+
+    const char* variants[16];
+    const char* tiers[16];
+    int threads[16], vn, tn;
+    int ln = bench_doc_axes(doc, variants, tiers, threads, &vn, &tn);
+
+    if (html) {
+        fprintf(fp, "<!DOCTYPE html>\n<html><head><meta charset=\"utf-8\"><title>AES-SM3 性能报告</title>\n"
+                    "<style>body{font-family:sans-serif}table{border-collapse:collapse}"
+                    "td,th{border:1px solid #ccc;padding:4px 8px;text-align:right}</style></head><body>\n"
+                    "<h1>AES-SM3 性能报告</h1>\n<ul><li>测试时间: %s</li><li>CPU: %s（%d核）</li>"
+                    "<li>计算上限: %.2f MB/s/线程</li></ul>\n", doc->timestamp, doc->cpu, doc->cores, doc->peak);
+    } else {
+        fprintf(fp, "# AES-SM3 性能报告\n\n- 测试时间: %s\n- CPU: %s（%d核）\n- 计算上限: %.2f MB/s/线程\n\n"
+                    "单元格为 吞吐MB/s（屋顶线百分比）；read为同层级读带宽。\n\n",
+                doc->timestamp, doc->cpu, doc->cores, doc->peak);
+    }
+
+    for (int t = 0; t < tn; t++) {
+        const bench_record_t* any = NULL;
+        for (int i = 0; i < doc->count && !any; i++) {
+            any = strcmp(doc->rec[i].tier, tiers[t]) == 0 ? &doc->rec[i] : NULL;
+        }
+        double ws_kb = any ? any->working_set / 1024.0 : 0;
+        if (html) {
+            fprintf(fp, "<h2>%s（每线程工作集 %.0f KB）</h2>\n<table><tr><th>版本</th>", tiers[t], ws_kb);
+            for (int l = 0; l < ln; l++) {
+                fprintf(fp, "<th>%d线程</th>", threads[l]);
+            }
+            fprintf(fp, "</tr>\n");
+        } else {
+            fprintf(fp, "## %s（每线程工作集 %.0f KB）\n\n| 版本 |", tiers[t], ws_kb);
+            for (int l = 0; l < ln; l++) {
+                fprintf(fp, " %d线程 |", threads[l]);
+            }
+            fprintf(fp, "\n|------|");
+            for (int l = 0; l < ln; l++) {
+                fprintf(fp, "------:|");
+            }
+            fprintf(fp, "\n");
+        }
+        for (int v = 0; v < vn; v++) {
+            fprintf(fp, html ? "<tr><th>%s</th>" : "| %s |", variants[v]);
+            for (int l = 0; l < ln; l++) {
+                const bench_record_t* r = bench_doc_find(doc, variants[v], tiers[t], threads[l]);
+                if (!r) {
+                    fprintf(fp, html ? "<td>-</td>" : " - |");
+                } else if (strcmp(variants[v], "read") == 0) {
+                    fprintf(fp, html ? "<td>%.0f</td>" : " %.0f |", r->mb_per_sec);
+                } else {
+                    fprintf(fp, html ? "<td>%.0f (%.0f%%)</td>" : " %.0f (%.0f%%) |", r->mb_per_sec, r->roofline_pct);
+                }
+            }
+            fprintf(fp, html ? "</tr>\n" : "\n");
+        }
+
+        if (html) {
+            fprintf(fp, "</table>\n");
+            bench_write_svg(fp, doc, tiers[t], variants, vn, threads, ln);
+        } else {
+            // SVG写到报告旁边：<报告名去掉扩展名>_<层级>.svg
+            char svg_path[4096];
+            const char* dot = strrchr(out_path, '.');
+            const char* slash = strrchr(out_path, '/');
+            int stem = dot && (!slash || dot > slash) ? (int)(dot - out_path) : (int)out_len;
+            snprintf(svg_path, sizeof(svg_path), "%.*s_%s.svg", stem, out_path, tiers[t]);
+            FILE* svg = fopen(svg_path, "w");
+            if (!svg) {
+                goto out;
+            }
+            bench_write_svg(svg, doc, tiers[t], variants, vn, threads, ln);
+            fclose(svg);
+            const char* name = strrchr(svg_path, '/');
+            fprintf(fp, "\n![%s 扩展曲线](%s)\n\n", tiers[t], name ? name + 1 : svg_path);
+        }
+    }
+
+    if (prev) {
+        int regressions = 0;
+        if (html) {
+            fprintf(fp, "<h2>与上次对比（%s）</h2>\n<table><tr><th>版本</th><th>层级</th><th>线程</th>"
+                        "<th>上次</th><th>本次</th><th>变化</th></tr>\n", prev->timestamp);
+        } else {
+            fprintf(fp, "## 与上次对比（%s）\n\n| 版本 | 层级 | 线程 | 上次 | 本次 | 变化 |\n"
+                        "|------|------|-----:|-----:|-----:|-----:|\n", prev->timestamp);
+        }
+        for (int i = 0; i < doc->count; i++) {
+            const bench_record_t* r = &doc->rec[i];
+            const bench_record_t* p = bench_doc_find(prev, r->variant, r->tier, r->threads);
+            if (!p || p->mb_per_sec <= 0) {
+                continue;
+            }
+            double delta = 100.0 * (r->mb_per_sec - p->mb_per_sec) / p->mb_per_sec;
+            const char* mark = delta < -5 ? " 回退" : delta > 5 ? " 提升" : "";
+            regressions += delta < -5;
+            fprintf(fp, html ? "<tr><th>%s</th><td>%s</td><td>%d</td><td>%.0f</td><td>%.0f</td><td>%+.1f%%%s</td></tr>\n"
+                             : "| %s | %s | %d | %.0f | %.0f | %+.1f%%%s |\n",
+                    r->variant, r->tier, r->threads, p->mb_per_sec, r->mb_per_sec, delta, mark);
+        }
+        fprintf(fp, html ? "</table>\n<p>回退（低于-5%%）: %d项</p>\n" : "\n回退（低于-5%%）: %d项\n", regressions);
+    }
+    if (html) {
+        fprintf(fp, "</body></html>\n");
+    }
+    ret = 0;
+
+out:
+    if (fp && fclose(fp) != 0) {
+        ret = -1;
+    }
+    free(doc);
+    free(prev);
+    return ret;
+}
+
+// ============================================================================
+// 标签文本编码（hex/base64）与缓冲输出
+// ============================================================================
+/*
+ * 逐字节printf("%02x")时每个标签要调用32次libc，扫描输出数百万个标签时文本格式化成为瓶颈。
+ *   - hex：一次处理16字节（SSSE3/NEON）或32字节（AVX2）。拆出高低半字节后查表，再交错存储
+ *   - base64（标准字母表，带=填充）：SSSE3一次处理12字节（Muła算法），NEON一次处理24字节（vld3/vqtbl4/vst4）
+ *   - 解码逐块校验字符，非法时返回-1；hex大小写均可
+ *   - 不足一块的尾部、未启用相应指令集的平台走标量实现，与SIMD结果逐字节一致
+ * 缓冲输出器把文本攒到大缓冲区后一次write。编码直接写进缓冲区，不经过stdio。
+ * 写错误会被记住，由close返回。
+ */
+
+#define AES_SM3_TEXT_HEX          0
+#define AES_SM3_TEXT_BASE64       1
+#define AES_SM3_WRITER_DEFAULT    (1 << 20)
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+static const char B64_CHARS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    c |= 0x20;
+    return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+static int b64_value(char c) {
+    if (c >= 'A' && c <= 'Z') {
+        return c - 'A';
+    }
+    if (c >= 'a' && c <= 'z') {
+        return c - 'a' + 26;
+    }
+    if (c >= '0' && c <= '9') {
+        return c - '0' + 52;
+    }
+    return c == '+' ? 62 : c == '/' ? 63 : -1;
+}
+
+#if defined(__SSSE3__)
+// 16字节 -> 32个hex字符
+static inline void hex_encode16_ssse3(const uint8_t* in, char* out) {
+    const __m128i lut = _mm_loadu_si128((const __m128i*)HEX_DIGITS);
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    __m128i v = _mm_loadu_si128((const __m128i*)in);
+    __m128i hi = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+    __m128i lo = _mm_shuffle_epi8(lut, _mm_and_si128(v, mask));
+    _mm_storeu_si128((__m128i*)out, _mm_unpacklo_epi8(hi, lo));
+    _mm_storeu_si128((__m128i*)(out + 16), _mm_unpackhi_epi8(hi, lo));
+}
+
+// 字符 -> 半字节值；非法字符在bad中置位
+static inline __m128i hex_values_ssse3(__m128i c, __m128i* bad) {
+    __m128i digit = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+    __m128i letter = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+    __m128i is_letter = _mm_cmpeq_epi8(_mm_min_epu8(letter, _mm_set1_epi8(5)), letter);
+    *bad = _mm_or_si128(*bad, _mm_andnot_si128(_mm_or_si128(is_digit, is_letter), _mm_set1_epi8(-1)));
+    return _mm_or_si128(_mm_and_si128(is_digit, digit),
+                        _mm_and_si128(is_letter, _mm_add_epi8(letter, _mm_set1_epi8(10))));
+}
+
+// 32个hex字符 -> 16字节；返回0成功
+static inline int hex_decode16_ssse3(const char* in, uint8_t* out) {
+    __m128i bad = _mm_setzero_si128();
+    __m128i a = hex_values_ssse3(_mm_loadu_si128((const __m128i*)in), &bad);
+    __m128i b = hex_values_ssse3(_mm_loadu_si128((const __m128i*)(in + 16)), &bad);
+    // 相邻两个半字节合并：高 × 16 + 低
+    const __m128i weights = _mm_set1_epi16(0x0110);
+    _mm_storeu_si128((__m128i*)out, _mm_packus_epi16(_mm_maddubs_epi16(a, weights), _mm_maddubs_epi16(b, weights)));
+    return _mm_movemask_epi8(bad) ? -1 : 0;
+}
+
+// 12字节（读取16字节）-> 16个base64字符
+static inline void b64_encode12_ssse3(const uint8_t* in, char* out) {
+    __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)in),
+                                 _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    __m128i t0 = _mm_mulhi_epu16(_mm_and_si128(v, _mm_set1_epi32(0x0FC0FC00)), _mm_set1_epi32(0x04000040));
+    __m128i t1 = _mm_mullo_epi16(_mm_and_si128(v, _mm_set1_epi32(0x003F03F0)), _mm_set1_epi32(0x01000010));
+    __m128i idx = _mm_or_si128(t0, t1);
+    // 按区间平移：A-Z / a-z / 0-9 / + / /
+    const __m128i shift = _mm_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+    __m128i sel = _mm_sub_epi8(_mm_subs_epu8(idx, _mm_set1_epi8(51)), _mm_cmpgt_epi8(idx, _mm_set1_epi8(25)));
+    _mm_storeu_si128((__m128i*)out, _mm_add_epi8(idx, _mm_shuffle_epi8(shift, sel)));
+}
+
+// 16个base64字符 -> 12字节（写出16字节）；含非base64字符（包括=）时返回-1
+static inline int b64_decode16_ssse3(const char* in, uint8_t* out) {
+    const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                         0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                         0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask_2f = _mm_set1_epi8(0x2F);
+    __m128i v = _mm_loadu_si128((const __m128i*)in);
+    __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(v, 4), mask_2f);
+    __m128i lo_nibbles = _mm_and_si128(v, mask_2f);
+    __m128i check = _mm_and_si128(_mm_shuffle_epi8(lut_lo, lo_nibbles), _mm_shuffle_epi8(lut_hi, hi_nibbles));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(check, _mm_setzero_si128())) != 0xFFFF) {
+        return -1;
+    }
+    __m128i roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(_mm_cmpeq_epi8(v, mask_2f), hi_nibbles));
+    v = _mm_add_epi8(v, roll);
+    // 4个6位值合并为3字节
+    v = _mm_madd_epi16(_mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140)), _mm_set1_epi32(0x00011000));
+    v = _mm_shuffle_epi8(v, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+    _mm_storeu_si128((__m128i*)out, v);
+    return 0;
+}
+#endif
+
+#if defined(__AVX2__)
+// 32字节 -> 64个hex字符
+static inline void hex_encode32_avx2(const uint8_t* in, char* out) {
+    const __m256i lut = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)HEX_DIGITS));
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+    __m256i v = _mm256_loadu_si256((const __m256i*)in);
+    __m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), mask));
+    __m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, mask));
+    // unpack在各128位通道内交错：a = 字节0-7|16-23，b = 字节8-15|24-31
+    __m256i a = _mm256_unpacklo_epi8(hi, lo);
+    __m256i b = _mm256_unpackhi_epi8(hi, lo);
+    _mm256_storeu_si256((__m256i*)out, _mm256_permute2x128_si256(a, b, 0x20));
+    _mm256_storeu_si256((__m256i*)(out + 32), _mm256_permute2x128_si256(a, b, 0x31));
+}
+
+static inline __m256i hex_values_avx2(__m256i c, __m256i* bad) {
+    __m256i digit = _mm256_sub_epi8(c, _mm256_set1_epi8('0'));
+    __m256i letter = _mm256_sub_epi8(_mm256_or_si256(c, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+    __m256i is_digit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit);
+    __m256i is_letter = _mm256_cmpeq_epi8(_mm256_min_epu8(letter, _mm256_set1_epi8(5)), letter);
+    *bad = _mm256_or_si256(*bad, _mm256_andnot_si256(_mm256_or_si256(is_digit, is_letter), _mm256_set1_epi8(-1)));
+    return _mm256_or_si256(_mm256_and_si256(is_digit, digit),
+                           _mm256_and_si256(is_letter, _mm256_add_epi8(letter, _mm256_set1_epi8(10))));
+}
+
+// 64个hex字符 -> 32字节
+static inline int hex_decode32_avx2(const char* in, uint8_t* out) {
+    __m256i bad = _mm256_setzero_si256();
+    __m256i a = hex_values_avx2(_mm256_loadu_si256((const __m256i*)in), &bad);
+    __m256i b = hex_values_avx2(_mm256_loadu_si256((const __m256i*)(in + 32)), &bad);
+    const __m256i weights = _mm256_set1_epi16(0x0110);
+    // packus按通道交错，再把64位块排回顺序
+    __m256i v = _mm256_packus_epi16(_mm256_maddubs_epi16(a, weights), _mm256_maddubs_epi16(b, weights));
+    _mm256_storeu_si256((__m256i*)out, _mm256_permute4x64_epi64(v, _MM_SHUFFLE(3, 1, 2, 0)));
+    return _mm256_movemask_epi8(bad) ? -1 : 0;
+}
+#endif
+
+#if defined(__aarch64__)
+static inline void hex_encode16_neon(const uint8_t* in, char* out) {
+    const uint8x16_t lut = vld1q_u8((const uint8_t*)HEX_DIGITS);
+    uint8x16_t v = vld1q_u8(in);
+    uint8x16x2_t o;
+    o.val[0] = vqtbl1q_u8(lut, vshrq_n_u8(v, 4));
+    o.val[1] = vqtbl1q_u8(lut, vandq_u8(v, vdupq_n_u8(0x0f)));
+    vst2q_u8((uint8_t*)out, o);
+}
+
+static inline uint8x16_t hex_values_neon(uint8x16_t c, uint8x16_t* bad) {
+    uint8x16_t digit = vsubq_u8(c, vdupq_n_u8('0'));
+    uint8x16_t letter = vsubq_u8(vorrq_u8(c, vdupq_n_u8(0x20)), vdupq_n_u8('a'));
+    uint8x16_t is_digit = vcleq_u8(digit, vdupq_n_u8(9));
+    uint8x16_t is_letter = vcleq_u8(letter, vdupq_n_u8(5));
+    *bad = vorrq_u8(*bad, vmvnq_u8(vorrq_u8(is_digit, is_letter)));
+    return vbslq_u8(is_digit, digit, vaddq_u8(letter, vdupq_n_u8(10)));
+}
+
+// vld2按奇偶位置拆开：偶数位是高半字节
+static inline int hex_decode16_neon(const char* in, uint8_t* out) {
+    uint8x16x2_t c = vld2q_u8((const uint8_t*)in);
+    uint8x16_t bad = vdupq_n_u8(0);
+    uint8x16_t hi = hex_values_neon(c.val[0], &bad);
+    uint8x16_t lo = hex_values_neon(c.val[1], &bad);
+    vst1q_u8(out, vorrq_u8(vshlq_n_u8(hi, 4), lo));
+    return vmaxvq_u8(bad) ? -1 : 0;
+}
+
+// 24字节 -> 32个base64字符
+static inline void b64_encode24_neon(const uint8_t* in, char* out) {
+    uint8x16x4_t tbl;
+    for (int i = 0; i < 4; i++) {
+        tbl.val[i] = vld1q_u8((const uint8_t*)B64_CHARS + 16 * i);
+    }
+    const uint8x8_t mask = vdup_n_u8(0x3f);
+    uint8x8x3_t v = vld3_u8(in);
+    uint8x8x4_t o;
+    o.val[0] = vqtbl4_u8(tbl, vshr_n_u8(v.val[0], 2));
+    o.val[1] = vqtbl4_u8(tbl, vand_u8(vorr_u8(vshl_n_u8(v.val[0], 4), vshr_n_u8(v.val[1], 4)), mask));
+    o.val[2] = vqtbl4_u8(tbl, vand_u8(vorr_u8(vshl_n_u8(v.val[1], 2), vshr_n_u8(v.val[2], 6)), mask));
+    o.val[3] = vqtbl4_u8(tbl, vand_u8(v.val[2], mask));
+    vst4_u8((uint8_t*)out, o);
+}
 
-typedef struct {
-    const uint8_t* input;
-    uint8_t* output;
-    int thread_id;
-    int num_threads;
-    int block_count;
-    int output_size;  // 128 or 256
-    pthread_barrier_t* barrier;
-} thread_data_t;
+static inline uint8x8_t b64_values_neon(uint8x8_t c, uint8x8_t* bad) {
+    uint8x8_t upper = vsub_u8(c, vdup_n_u8('A'));
+    uint8x8_t lower = vsub_u8(c, vdup_n_u8('a'));
+    uint8x8_t digit = vsub_u8(c, vdup_n_u8('0'));
+    uint8x8_t is_upper = vcle_u8(upper, vdup_n_u8(25));
+    uint8x8_t is_lower = vcle_u8(lower, vdup_n_u8(25));
+    uint8x8_t is_digit = vcle_u8(digit, vdup_n_u8(9));
+    uint8x8_t is_plus = vceq_u8(c, vdup_n_u8('+'));
+    uint8x8_t is_slash = vceq_u8(c, vdup_n_u8('/'));
+    uint8x8_t v = vand_u8(is_upper, upper);
+    v = vorr_u8(v, vand_u8(is_lower, vadd_u8(lower, vdup_n_u8(26))));
+    v = vorr_u8(v, vand_u8(is_digit, vadd_u8(digit, vdup_n_u8(52))));
+    v = vorr_u8(v, vand_u8(is_plus, vdup_n_u8(62)));
+    v = vorr_u8(v, vand_u8(is_slash, vdup_n_u8(63)));
+    uint8x8_t ok = vorr_u8(vorr_u8(is_upper, is_lower), vorr_u8(is_digit, vorr_u8(is_plus, is_slash)));
+    *bad = vorr_u8(*bad, vmvn_u8(ok));
+    return v;
+}
 
-void* thread_worker(void* arg) {
-    thread_data_t* data = (thread_data_t*)arg;
-    
-    // 设置线程亲和性
-    cpu_set_t cpuset;
-    CPU_ZERO(&cpuset);
-    CPU_SET(data->thread_id % CPU_SETSIZE, &cpuset);
-    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
-    
-    int blocks_per_thread = data->block_count / data->num_threads;
-    int start_block = data->thread_id * blocks_per_thread;
-    int end_block = (data->thread_id == data->num_threads - 1) ? 
-                   data->block_count : start_block + blocks_per_thread;
-    
-    for (int i = start_block; i < end_block; i++) {
-        const uint8_t* block_start = data->input + i * 4096;
-        uint8_t* output_start = data->output + i * (data->output_size / 8);
-        
-        if (data->output_size == 256) {
-            aes_sm3_integrity_256bit(block_start, output_start);
-        } else {
-            aes_sm3_integrity_128bit(block_start, output_start);
+// 32个base64字符 -> 24字节
+static inline int b64_decode32_neon(const char* in, uint8_t* out) {
+    uint8x8x4_t c = vld4_u8((const uint8_t*)in);
+    uint8x8_t bad = vdup_n_u8(0);
+    uint8x8_t d0 = b64_values_neon(c.val[0], &bad);
+    uint8x8_t d1 = b64_values_neon(c.val[1], &bad);
+    uint8x8_t d2 = b64_values_neon(c.val[2], &bad);
+    uint8x8_t d3 = b64_values_neon(c.val[3], &bad);
+    if (vmaxv_u8(bad)) {
+        return -1;
+    }
+    uint8x8x3_t o;
+    o.val[0] = vorr_u8(vshl_n_u8(d0, 2), vshr_n_u8(d1, 4));
+    o.val[1] = vorr_u8(vshl_n_u8(d1, 4), vshr_n_u8(d2, 2));
+    o.val[2] = vorr_u8(vshl_n_u8(d2, 6), d3);
+    vst3_u8(out, o);
+    return 0;
+}
+#endif
+
+// len字节 -> 2*len个小写hex字符，另写结尾'\0'；返回字符数
+size_t aes_sm3_hex_encode(const uint8_t* in, size_t len, char* out) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 32 <= len; i += 32) {
+        hex_encode32_avx2(in + i, out + 2 * i);
+    }
+#endif
+#if defined(__SSSE3__)
+    for (; i + 16 <= len; i += 16) {
+        hex_encode16_ssse3(in + i, out + 2 * i);
+    }
+#elif defined(__aarch64__)
+    for (; i + 16 <= len; i += 16) {
+        hex_encode16_neon(in + i, out + 2 * i);
+    }
+#endif
+    for (; i < len; i++) {
+        out[2 * i] = HEX_DIGITS[in[i] >> 4];
+        out[2 * i + 1] = HEX_DIGITS[in[i] & 0x0f];
+    }
+    out[2 * len] = '\0';
+    return 2 * len;
+}
+
+// len个hex字符 -> len/2字节；长度为奇数或含非hex字符时返回-1
+int64_t aes_sm3_hex_decode(const char* in, size_t len, uint8_t* out) {
+    if (len % 2) {
+        return -1;
+    }
+    size_t n = len / 2, i = 0;
+#if defined(__AVX2__)
+    for (; i + 32 <= n; i += 32) {
+        if (hex_decode32_avx2(in + 2 * i, out + i) != 0) {
+            return -1;
         }
     }
-    
-    pthread_barrier_wait(data->barrier);
-    return NULL;
+#endif
+#if defined(__SSSE3__)
+    for (; i + 16 <= n; i += 16) {
+        if (hex_decode16_ssse3(in + 2 * i, out + i) != 0) {
+            return -1;
+        }
+    }
+#elif defined(__aarch64__)
+    for (; i + 16 <= n; i += 16) {
+        if (hex_decode16_neon(in + 2 * i, out + i) != 0) {
+            return -1;
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        int hi = hex_value(in[2 * i]), lo = hex_value(in[2 * i + 1]);
+        if (hi < 0 || lo < 0) {
+            return -1;
+        }
+        out[i] = (uint8_t)(hi << 4 | lo);
+    }
+    return (int64_t)n;
 }
 
-void aes_sm3_parallel(const uint8_t* input, uint8_t* output, int block_count, 
-                      int num_threads, int output_size) {
-    int available_cores = sysconf(_SC_NPROCESSORS_ONLN);
-    if (num_threads > available_cores) {
-        num_threads = available_cores;
+// len字节 -> 4*ceil(len/3)个base64字符（带=填充），另写结尾'\0'；返回字符数
+size_t aes_sm3_base64_encode(const uint8_t* in, size_t len, char* out) {
+    size_t i = 0, o = 0;
+#if defined(__SSSE3__)
+    for (; i + 16 <= len; i += 12, o += 16) {
+        b64_encode12_ssse3(in + i, out + o);
     }
-    
-    pthread_t* threads = malloc(num_threads * sizeof(pthread_t));
-    thread_data_t* thread_data = malloc(num_threads * sizeof(thread_data_t));
-    pthread_barrier_t barrier;
-    pthread_barrier_init(&barrier, NULL, num_threads);
-    
-    for (int i = 0; i < num_threads; i++) {
-        thread_data[i].input = input;
-        thread_data[i].output = output;
-        thread_data[i].thread_id = i;
-        thread_data[i].num_threads = num_threads;
-        thread_data[i].block_count = block_count;
-        thread_data[i].output_size = output_size;
-        thread_data[i].barrier = &barrier;
-        
-        pthread_create(&threads[i], NULL, thread_worker, &thread_data[i]);
+#elif defined(__aarch64__)
+    for (; i + 24 <= len; i += 24, o += 32) {
+        b64_encode24_neon(in + i, out + o);
     }
-    
-    for (int i = 0; i < num_threads; i++) {
-        pthread_join(threads[i], NULL);
+#endif
+    for (; i + 3 <= len; i += 3, o += 4) {
+        uint32_t v = (uint32_t)in[i] << 16 | (uint32_t)in[i + 1] << 8 | in[i + 2];
+        out[o] = B64_CHARS[v >> 18];
+        out[o + 1] = B64_CHARS[(v >> 12) & 63];
+        out[o + 2] = B64_CHARS[(v >> 6) & 63];
+        out[o + 3] = B64_CHARS[v & 63];
     }
-    
-    pthread_barrier_destroy(&barrier);
-    free(threads);
-    free(thread_data);
+    if (i < len) {
+        uint32_t v = (uint32_t)in[i] << 16 | (i + 1 < len ? (uint32_t)in[i + 1] << 8 : 0);
+        out[o] = B64_CHARS[v >> 18];
+        out[o + 1] = B64_CHARS[(v >> 12) & 63];
+        out[o + 2] = i + 1 < len ? B64_CHARS[(v >> 6) & 63] : '=';
+        out[o + 3] = '=';
+        o += 4;
+    }
+    out[o] = '\0';
+    return o;
+}
+
+// len个base64字符（len为4的倍数，=只能出现在末尾）-> 字节；格式错误返回-1
+int64_t aes_sm3_base64_decode(const char* in, size_t len, uint8_t* out) {
+    if (len % 4) {
+        return -1;
+    }
+    size_t i = 0, o = 0;
+#if defined(__SSSE3__)
+    uint8_t block[16];
+    // 最后一组可能带=，留给标量部分
+    for (; i + 20 <= len && b64_decode16_ssse3(in + i, block) == 0; i += 16, o += 12) {
+        memcpy(out + o, block, 12);
+    }
+#elif defined(__aarch64__)
+    for (; i + 36 <= len && b64_decode32_neon(in + i, out + o) == 0; i += 32, o += 24) {
+    }
+#endif
+    // SIMD块校验失败时从该块起由标量部分给出结果
+    for (; i < len; i += 4) {
+        int pad = i + 4 == len ? (in[i + 3] == '=') + (in[i + 2] == '=' && in[i + 3] == '=') : 0;
+        int a = b64_value(in[i]), b = b64_value(in[i + 1]);
+        int c = pad >= 2 ? 0 : b64_value(in[i + 2]);
+        int d = pad >= 1 ? 0 : b64_value(in[i + 3]);
+        if (a < 0 || b < 0 || c < 0 || d < 0) {
+            return -1;
+        }
+        uint32_t v = (uint32_t)a << 18 | (uint32_t)b << 12 | (uint32_t)c << 6 | (uint32_t)d;
+        out[o++] = (uint8_t)(v >> 16);
+        if (pad < 2) {
+            out[o++] = (uint8_t)(v >> 8);
+        }
+        if (pad < 1) {
+            out[o++] = (uint8_t)v;
+        }
+    }
+    return (int64_t)o;
+}
+
+// ---- 缓冲输出 ----
+
+struct aes_sm3_writer {
+    int fd;
+    int error;               // 曾有write失败
+    size_t len;
+    size_t cap;
+    char* buf;
+};
+
+typedef struct aes_sm3_writer aes_sm3_writer_t;
+
+// cap为0时使用AES_SM3_WRITER_DEFAULT（1MB）
+aes_sm3_writer_t* aes_sm3_writer_open(int fd, size_t cap) {
+    aes_sm3_writer_t* w = (aes_sm3_writer_t*)calloc(1, sizeof(aes_sm3_writer_t));
+    if (!w) {
+        return NULL;
+    }
+    w->fd = fd;
+    w->cap = cap >= 256 ? cap : cap ? 256 : AES_SM3_WRITER_DEFAULT;
+    w->buf = (char*)malloc(w->cap);
+    if (!w->buf) {
+        free(w);
+        return NULL;
+    }
+    return w;
+}
+
+static void writer_write_all(aes_sm3_writer_t* w, const char* p, size_t n) {
+    while (n > 0 && !w->error) {
+        ssize_t r = write(w->fd, p, n);
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        if (r <= 0) {
+            w->error = 1;
+            break;
+        }
+        p += r;
+        n -= (size_t)r;
+    }
+}
+
+int aes_sm3_writer_flush(aes_sm3_writer_t* w) {
+    writer_write_all(w, w->buf, w->len);
+    w->len = 0;
+    return w->error ? -1 : 0;
+}
+
+// 保证缓冲区尾部至少有n字节空闲（n不超过cap）
+static char* writer_reserve(aes_sm3_writer_t* w, size_t n) {
+    if (w->cap - w->len < n) {
+        aes_sm3_writer_flush(w);
+    }
+    return w->buf + w->len;
+}
+
+void aes_sm3_writer_put(aes_sm3_writer_t* w, const void* data, size_t n) {
+    if (n >= w->cap) {
+        aes_sm3_writer_flush(w);
+        writer_write_all(w, (const char*)data, n);
+        return;
+    }
+    memcpy(writer_reserve(w, n), data, n);
+    w->len += n;
+}
+
+void aes_sm3_writer_u64(aes_sm3_writer_t* w, uint64_t v) {
+    char tmp[20];
+    int n = 0;
+    do {
+        tmp[19 - n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    memcpy(writer_reserve(w, n), tmp + 20 - n, n);
+    w->len += n;
+}
+
+// 标签（不超过64字节）按format编码后直接写入缓冲区
+void aes_sm3_writer_tag(aes_sm3_writer_t* w, const uint8_t* tag, size_t len, int format) {
+    // 按96字节分段（3的倍数，base64分段结果与整体编码相同），每段编码后不超过192字节，
+    // 小于最小缓冲区；base64需要4*ceil(n/3)字节，1字节输入也要4字节，不能按2n预留
+    while (len > 0) {
+        size_t n = len < 96 ? len : 96;
+        size_t need = format == AES_SM3_TEXT_BASE64 ? 4 * ((n + 2) / 3) : 2 * n;
+        char* p = writer_reserve(w, need + 1);
+        w->len += format == AES_SM3_TEXT_BASE64 ? aes_sm3_base64_encode(tag, n, p) : aes_sm3_hex_encode(tag, n, p);
+        tag += n;
+        len -= n;
+    }
+}
+
+// 写出剩余内容并释放；任何一次写失败都返回-1
+int aes_sm3_writer_close(aes_sm3_writer_t* w) {
+    if (!w) {
+        return -1;
+    }
+    int ret = aes_sm3_writer_flush(w);
+    free(w->buf);
+    free(w);
+    return ret;
+}
+
+// 每个标签一行"页号\t标签"写入/dev/null：逐字节printf与编码器 + 缓冲输出对比
+void text_output_benchmark(void) {
+    const size_t count = 262144;
+    const aes_sm3_datagen_mix_t random_mix = {0, 0, 0, 0};
+    uint8_t* tags = (uint8_t*)aligned_alloc(64, count * 32);
+    FILE* fp = fopen("/dev/null", "w");
+    int fd = open("/dev/null", O_WRONLY);
+    if (!tags || !fp || fd < 0) {
+        free(tags);
+        if (fp) {
+            fclose(fp);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        return;
+    }
+    aes_sm3_datagen_fill(&random_mix, 7, tags, 0, count * 32 / 4096);
+
+    printf(">>> 标签文本输出 (%zu个标签)\n", count);
+    printf("  方式                 标签/秒      可支撑扫描速率\n");
+    for (int m = 0; m < 3; m++) {
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (m == 0) {
+            for (size_t i = 0; i < count; i++) {
+                fprintf(fp, "%zu\t", i);
+                for (int j = 0; j < 32; j++) {
+                    fprintf(fp, "%02x", tags[i * 32 + j]);
+                }
+                fputc('\n', fp);
+            }
+            fflush(fp);
+        } else {
+            aes_sm3_writer_t* w = aes_sm3_writer_open(fd, 0);
+            for (size_t i = 0; w && i < count; i++) {
+                aes_sm3_writer_u64(w, i);
+                aes_sm3_writer_put(w, "\t", 1);
+                aes_sm3_writer_tag(w, tags + i * 32, 32, m == 1 ? AES_SM3_TEXT_HEX : AES_SM3_TEXT_BASE64);
+                aes_sm3_writer_put(w, "\n", 1);
+            }
+            aes_sm3_writer_close(w);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        static const char* const names[] = {"逐字节printf (hex)", "缓冲输出 (hex)", "缓冲输出 (base64)"};
+        // 每个标签对应一个4KB页
+        printf("  %-20s %12.0f   %8.2f GB/s\n", names[m], count / elapsed,
+               count * 4096.0 / (1024.0 * 1024.0 * 1024.0) / elapsed);
+    }
+    printf("\n");
+    fclose(fp);
+    close(fd);
+    free(tags);
 }
 
 // ============================================================================
@@ -2152,12 +9546,13 @@ void performance_benchmark() {
     printf("   平台: ARMv8.2 (支持AES/SHA2/SM3/NEON指令集)\n");
     printf("==========================================================\n\n");
     
+    // 单块测试使用一页随机数据
+    const aes_sm3_datagen_mix_t random_mix = {0, 0, 0, 0};
     uint8_t* test_data = malloc(4096);
-    for (int i = 0; i < 4096; i++) {
-        test_data[i] = i % 256;
-    }
+    aes_sm3_datagen_page(&random_mix, 1, 0, test_data);
     
     uint8_t output[32];
+    char hex[65];
     struct timespec start, end;
     const int iterations = 100000;
     
@@ -2174,7 +9569,8 @@ void performance_benchmark() {
     printf("  处理%d次耗时: %.6f秒\n", iterations, aes_sm3_time);
     printf("  吞吐量: %.2f MB/s\n", aes_sm3_throughput);
     printf("  哈希值: ");
-    for (int i = 0; i < 32; i++) printf("%02x", output[i]);
+    aes_sm3_hex_encode(output, 32, hex);
+    printf("%s", hex);
     printf("\n\n");
     
     // 测试AES-SM3混合算法（128位）
@@ -2191,7 +9587,8 @@ void performance_benchmark() {
     printf("  处理%d次耗时: %.6f秒\n", iterations, aes_sm3_128_time);
     printf("  吞吐量: %.2f MB/s\n", aes_sm3_128_throughput);
     printf("  哈希值: ");
-    for (int i = 0; i < 16; i++) printf("%02x", output_128[i]);
+    aes_sm3_hex_encode(output_128, 16, hex);
+    printf("%s", hex);
     printf("\n\n");
     
     // 测试极限优化版本 v3.0（单SM3块）
@@ -2207,7 +9604,8 @@ void performance_benchmark() {
     printf("  处理%d次耗时: %.6f秒\n", iterations, extreme_time);
     printf("  吞吐量: %.2f MB/s\n", extreme_throughput);
     printf("  哈希值: ");
-    for (int i = 0; i < 32; i++) printf("%02x", output[i]);
+    aes_sm3_hex_encode(output, 32, hex);
+    printf("%s", hex);
     printf("\n\n");
     
     // 测试超极限优化版本 v3.1（寄存器累积）
@@ -2223,7 +9621,8 @@ void performance_benchmark() {
     printf("  处理%d次耗时: %.6f秒\n", iterations, ultra_time);
     printf("  吞吐量: %.2f MB/s\n", ultra_throughput);
     printf("  哈希值: ");
-    for (int i = 0; i < 32; i++) printf("%02x", output[i]);
+    aes_sm3_hex_encode(output, 32, hex);
+    printf("%s", hex);
     printf("\n\n");
     
     // 测试SHA256
@@ -2248,7 +9647,8 @@ void performance_benchmark() {
     printf("  [软件实现] 预期: 700-900 MB/s\n");
 #endif
     printf("  哈希值: ");
-    for (int i = 0; i < 32; i++) printf("%02x", output[i]);
+    aes_sm3_hex_encode(output, 32, hex);
+    printf("%s", hex);
     printf("\n\n");
     
     // 测试纯SM3
@@ -2264,7 +9664,8 @@ void performance_benchmark() {
     printf("  处理%d次耗时: %.6f秒\n", iterations, sm3_time);
     printf("  吞吐量: %.2f MB/s\n", sm3_throughput);
     printf("  哈希值: ");
-    for (int i = 0; i < 32; i++) printf("%02x", output[i]);
+    aes_sm3_hex_encode(output, 32, hex);
+    printf("%s", hex);
     printf("\n\n");
     
     // 测试批处理+流水线优化版本
@@ -2278,15 +9679,11 @@ void performance_benchmark() {
     uint8_t batch_test_data[batch_size * 4096];
     uint8_t batch_output_data[batch_size * 32];
     
-    // 初始化批处理数据
+    // 初始化批处理数据（默认混合）
+    aes_sm3_datagen_fill(&aes_sm3_datagen_mixed, 1, batch_test_data, 0, batch_size);
     for (int i = 0; i < batch_size; i++) {
         batch_inputs[i] = batch_test_data + i * 4096;
         batch_outputs[i] = batch_output_data + i * 32;
-        
-        // 为每个块准备不同的测试数据
-        for (int j = 0; j < 4096; j++) {
-            batch_test_data[i * 4096 + j] = (i + j) % 256;
-        }
     }
     
     clock_gettime(CLOCK_MONOTONIC, &start);
@@ -2301,7 +9698,8 @@ void performance_benchmark() {
     printf("  处理%d批次(总计%d个4KB块)耗时: %.6f秒\n", batch_iterations, batch_iterations * batch_size, batch_time);
     printf("  吞吐量: %.2f MB/s\n", batch_throughput);
     printf("  第一个块哈希值: ");
-    for (int i = 0; i < 32; i++) printf("%02x", batch_output_data[i]);
+    aes_sm3_hex_encode(batch_output_data, 32, hex);
+    printf("%s", hex);
     printf("\n\n");
     
     // 计算批处理版本相对于单块版本的加速比
@@ -2469,6 +9867,11 @@ void performance_benchmark() {
     }
 #endif
     
+    // 不同数据类型
+    printf("\n");
+    data_mix_benchmark();
+    text_output_benchmark();
+    
     // 多线程性能测试
     printf("\n==========================================================\n");
     printf("   多线程并行性能测试\n");
@@ -2479,9 +9882,7 @@ void performance_benchmark() {
     uint8_t* multi_input = malloc(num_blocks * 4096);
     uint8_t* multi_output = malloc(num_blocks * 32);
     
-    for (int i = 0; i < num_blocks * 4096; i++) {
-        multi_input[i] = i % 256;
-    }
+    aes_sm3_datagen_fill(&aes_sm3_datagen_mixed, 1, multi_input, 0, num_blocks);
     
     printf("测试配置: %d个4KB块, %d个线程\n\n", num_blocks, num_threads);
     
@@ -2528,10 +9929,8 @@ void test_memory_access_optimization() {
     uint8_t* test_data = aligned_alloc(64, batch_size * 4096);
     uint8_t* output_data = aligned_alloc(64, batch_size * 32);
     
-    // 初始化测试数据
-    for (int i = 0; i < batch_size * 4096; i++) {
-        test_data[i] = i % 256;
-    }
+    // 初始化测试数据（默认混合）
+    aes_sm3_datagen_fill(&aes_sm3_datagen_mixed, 1, test_data, 0, batch_size);
     
     // 准备批处理输入和输出
     const uint8_t* batch_inputs[batch_size];
@@ -2593,10 +9992,8 @@ void test_memory_access_optimization() {
     uint8_t* unaligned_test_data = malloc(batch_size * 4096);
     uint8_t* unaligned_output_data = malloc(batch_size * 32);
     
-    // 初始化非对齐测试数据
-    for (int i = 0; i < batch_size * 4096; i++) {
-        unaligned_test_data[i] = i % 256;
-    }
+    // 初始化非对齐测试数据（与对齐测试相同）
+    aes_sm3_datagen_fill(&aes_sm3_datagen_mixed, 1, unaligned_test_data, 0, batch_size);
     
     const uint8_t* unaligned_batch_inputs[batch_size];
     uint8_t* unaligned_batch_outputs[batch_size];
@@ -3411,7 +10808,374 @@ void batch_sm3_hash_pipeline_prefetch(const uint8_t** compressed_inputs, uint8_t
     }
 }
 
-int main() {
+// ============================================================================
+// 命令行子命令（无参数时运行性能测试）
+// ============================================================================
+
+static int cli_manifest(int argc, char** argv) {
+    if (argc != 4 && argc != 5) {
+        return -1;
+    }
+    // 给出缓存窗口时使用页缓存中立模式
+    aes_sm3_manifest_t* m = argc == 5 ?
+        aes_sm3_manifest_build_file_neutral(NULL, argv[2], (size_t)(atof(argv[4]) * 1024 * 1024)) :
+        aes_sm3_manifest_build_file(NULL, argv[2]);
+    if (!m) {
+        fprintf(stderr, "无法读取文件: %s\n", argv[2]);
+        return 1;
+    }
+    int ret = aes_sm3_manifest_save(m, argv[3]);
+    printf("清单: %llu页, %llu字节 -> %s\n", (unsigned long long)aes_sm3_manifest_page_count(m),
+           (unsigned long long)aes_sm3_manifest_file_size(m), argv[3]);
+    aes_sm3_manifest_free(m);
+    return ret == 0 ? 0 : 1;
+}
+
+static int cli_diff(int argc, char** argv) {
+    if (argc != 4) {
+        return -1;
+    }
+    aes_sm3_manifest_t* src = aes_sm3_manifest_open(argv[2]);
+    aes_sm3_manifest_t* dst = aes_sm3_manifest_open(argv[3]);
+    int ret = 1;
+    if (src && dst) {
+        int64_t count = aes_sm3_manifest_diff(src, dst, NULL, 0);
+        aes_sm3_page_range_t* ranges = (aes_sm3_page_range_t*)malloc(
+            ((size_t)(count > 0 ? count : 0) + 1) * sizeof(aes_sm3_page_range_t));
+        if (count >= 0 && ranges) {
+            aes_sm3_manifest_diff(src, dst, ranges, (size_t)count);
+            uint64_t pages = 0;
+            fflush(stdout);
+            aes_sm3_writer_t* w = aes_sm3_writer_open(STDOUT_FILENO, 0);
+            for (int64_t i = 0; w && i < count; i++) {
+                aes_sm3_writer_u64(w, ranges[i].first_page);
+                aes_sm3_writer_put(w, "\t", 1);
+                aes_sm3_writer_u64(w, ranges[i].page_count);
+                aes_sm3_writer_put(w, "\n", 1);
+                pages += ranges[i].page_count;
+            }
+            if (aes_sm3_writer_close(w) == 0) {
+                fprintf(stderr, "差异: %lld个区间, %llu页\n", (long long)count, (unsigned long long)pages);
+                ret = 0;
+            } else {
+                fprintf(stderr, "输出失败\n");
+            }
+        } else if (count < 0) {
+            fprintf(stderr, "两个清单的域不同，无法比较\n");
+        }
+        free(ranges);
+    } else {
+        fprintf(stderr, "无法打开清单\n");
+    }
+    aes_sm3_manifest_free(src);
+    aes_sm3_manifest_free(dst);
+    return ret;
+}
+
+static int cli_delta(int argc, char** argv) {
+    if (argc != 6) {
+        return -1;
+    }
+    aes_sm3_manifest_t* src = aes_sm3_manifest_open(argv[3]);
+    aes_sm3_manifest_t* dst = aes_sm3_manifest_open(argv[4]);
+    int64_t pages = (src && dst) ? aes_sm3_delta_emit(argv[2], src, dst, argv[5]) : -1;
+    aes_sm3_manifest_free(src);
+    aes_sm3_manifest_free(dst);
+    if (pages < 0) {
+        fprintf(stderr, "增量生成失败\n");
+        return 1;
+    }
+    printf("增量: %lld页 -> %s\n", (long long)pages, argv[5]);
+    return 0;
+}
+
+static int cli_patch(int argc, char** argv) {
+    if (argc != 4) {
+        return -1;
+    }
+    int64_t pages = aes_sm3_delta_apply(argv[2], argv[3]);
+    if (pages < 0) {
+        fprintf(stderr, "增量应用失败（格式错误、标签不符或IO错误）\n");
+        return 1;
+    }
+    printf("已写入: %lld页 -> %s\n", (long long)pages, argv[3]);
+    return 0;
+}
+
+static int cli_compare(int argc, char** argv) {
+    if (argc < 4 || (argc - 2) % 2 != 0) {
+        return -1;
+    }
+    int job_count = (argc - 2) / 2;
+    aes_sm3_compare_job_t* jobs = (aes_sm3_compare_job_t*)calloc(job_count, sizeof(aes_sm3_compare_job_t));
+    if (!jobs) {
+        return 1;
+    }
+    for (int i = 0; i < job_count; i++) {
+        jobs[i].old_path = argv[2 + 2 * i];
+        jobs[i].new_path = argv[3 + 2 * i];
+    }
+
+    int failed = aes_sm3_manifest_compare_parallel(jobs, job_count, 0);
+    uint64_t total_pages = 0;
+    for (int i = 0; i < job_count; i++) {
+        if (jobs[i].range_count < 0) {
+            fprintf(stderr, "比较失败: %s %s\n", jobs[i].old_path, jobs[i].new_path);
+            continue;
+        }
+        for (int64_t r = 0; r < jobs[i].range_count; r++) {
+            printf("%s\t%llu\t%llu\n", jobs[i].new_path,
+                   (unsigned long long)jobs[i].ranges[r].first_page,
+                   (unsigned long long)jobs[i].ranges[r].page_count);
+        }
+        total_pages += jobs[i].changed_pages;
+        free(jobs[i].ranges);
+    }
+    fprintf(stderr, "比较: %d个文件, %llu页变化, %d个失败\n", job_count,
+            (unsigned long long)total_pages, failed);
+    free(jobs);
+    return failed ? 1 : 0;
+}
+
+static int cli_cachebench(int argc, char** argv) {
+    if (argc != 3 && argc != 4) {
+        return -1;
+    }
+    page_cache_benchmark(argv[2], (size_t)((argc == 4 ? atof(argv[3]) : 8.0) * 1024 * 1024));
+    return 0;
+}
+
+static int cli_replay(int argc, char** argv) {
+    if (argc < 4 || argc > 7) {
+        return -1;
+    }
+    int mode = AES_SM3_REPLAY_BATCH;
+    if (argc >= 5) {
+        if (strcmp(argv[4], "single") == 0) {
+            mode = AES_SM3_REPLAY_SINGLE;
+        } else if (strcmp(argv[4], "async") == 0) {
+            mode = AES_SM3_REPLAY_ASYNC;
+        } else if (strcmp(argv[4], "batch") != 0) {
+            return -1;
+        }
+    }
+    // 第二个参数是纯数字时作为内存数据集大小（MB），否则为数据文件
+    char* end;
+    double mb = strtod(argv[3], &end);
+    int in_memory = *end == '\0' && mb > 0;
+    trace_replay_benchmark(argv[2], in_memory ? NULL : argv[3], in_memory ? (size_t)(mb * 1024 * 1024) : 0,
+                           mode, argc >= 6 ? atoi(argv[5]) : 0, argc == 7 ? atof(argv[6]) : 0);
+    return 0;
+}
+
+static int cli_tenants(int argc, char** argv) {
+    if (argc > 4) {
+        return -1;
+    }
+    multi_tenant_benchmark(argc >= 3 ? atoi(argv[2]) : 0, argc == 4 ? atof(argv[3]) : 1.0);
+    return 0;
+}
+
+static int cli_stable(int argc, char** argv) {
+    if (argc > 4 || (argc == 4 && strcmp(argv[3], "strict") != 0)) {
+        return -1;
+    }
+    int ret = stable_benchmark(argc >= 3 ? atoi(argv[2]) : -1, argc == 4);
+    return ret < 0 ? 1 : ret;
+}
+
+static int cli_benchjson(int argc, char** argv) {
+    if (argc < 3 || argc > 5) {
+        return -1;
+    }
+    if (aes_sm3_bench_json(argv[2], argc >= 4 ? atof(argv[3]) : 0.2, argc == 5 ? atoi(argv[4]) : 0) != 0) {
+        fprintf(stderr, "无法写出基准结果: %s\n", argv[2]);
+        return 1;
+    }
+    printf("基准结果已写入 %s\n", argv[2]);
+    return 0;
+}
+
+static int cli_report(int argc, char** argv) {
+    if (argc != 4 && argc != 5) {
+        return -1;
+    }
+    if (aes_sm3_bench_report(argv[2], argv[3], argc == 5 ? argv[4] : NULL) != 0) {
+        fprintf(stderr, "报告生成失败（结果文件无法读取或格式不符）\n");
+        return 1;
+    }
+    printf("报告已写入 %s\n", argv[3]);
+    return 0;
+}
+
+// 每页一行"页号\t标签"
+static int cli_tags(int argc, char** argv) {
+    if ((argc != 3 && argc != 4) || (argc == 4 && strcmp(argv[3], "hex") != 0 && strcmp(argv[3], "base64") != 0)) {
+        return -1;
+    }
+    int format = argc == 4 && strcmp(argv[3], "base64") == 0 ? AES_SM3_TEXT_BASE64 : AES_SM3_TEXT_HEX;
+    aes_sm3_manifest_t* m = aes_sm3_manifest_open(argv[2]);
+    if (!m) {
+        fprintf(stderr, "无法打开清单: %s\n", argv[2]);
+        return 1;
+    }
+    fflush(stdout);
+    aes_sm3_writer_t* w = aes_sm3_writer_open(STDOUT_FILENO, 0);
+    uint64_t pages = aes_sm3_manifest_page_count(m);
+    for (uint64_t p = 0; w && p < pages; p++) {
+        aes_sm3_writer_u64(w, p);
+        aes_sm3_writer_put(w, "\t", 1);
+        aes_sm3_writer_tag(w, aes_sm3_manifest_tag(m, p), 32, format);
+        aes_sm3_writer_put(w, "\n", 1);
+    }
+    int ret = aes_sm3_writer_close(w);
+    aes_sm3_manifest_free(m);
+    if (ret != 0) {
+        fprintf(stderr, "输出失败\n");
+        return 1;
+    }
+    return 0;
+}
+
+static int cli_tail(int argc, char** argv) {
+    if (argc != 4 && argc != 5) {
+        return -1;
+    }
+    int poll_ms = argc == 5 ? atoi(argv[4]) : 0;
+    aes_sm3_tail_t* t = aes_sm3_tail_create(NULL, poll_ms <= 0);
+    if (!t || aes_sm3_tail_add(t, argv[2], argv[3]) < 0) {
+        fprintf(stderr, "无法跟踪: %s -> %s\n", argv[2], argv[3]);
+        aes_sm3_tail_free(t);
+        return 1;
+    }
+    printf("跟踪 %s（%s），高水位 %llu页\n", argv[2], poll_ms > 0 ? "轮询" : "inotify",
+           (unsigned long long)aes_sm3_tail_high_water(t, 0));
+
+    for (;;) {
+        int64_t n = aes_sm3_tail_tick(t, poll_ms > 0 ? poll_ms : 1000);
+        if (n < 0) {
+            fprintf(stderr, "跟踪出错\n");
+            aes_sm3_tail_free(t);
+            return 1;
+        }
+        if (n > 0) {
+            printf("+%lld页，高水位 %llu页\n", (long long)n,
+                   (unsigned long long)aes_sm3_tail_high_water(t, 0));
+            fflush(stdout);
+        }
+    }
+}
+
+#if defined(__linux__)
+static void cli_watch_report(void* ctx, const char* path,
+                             const aes_sm3_page_range_t* ranges, int64_t range_count) {
+    (void)ctx;
+    if (range_count < 0) {
+        printf("%s\t删除\n", path);
+    }
+    for (int64_t i = 0; i < range_count; i++) {
+        printf("%s\t%llu\t%llu\n", path, (unsigned long long)ranges[i].first_page,
+               (unsigned long long)ranges[i].page_count);
+    }
+    fflush(stdout);
+}
+
+static int cli_watch(int argc, char** argv) {
+    if (argc != 4 && argc != 5) {
+        return -1;
+    }
+    int debounce_ms = argc == 5 ? atoi(argv[4]) : 200;
+    aes_sm3_watch_t* w = aes_sm3_watch_create(argv[2], argv[3], debounce_ms, 0, cli_watch_report, NULL);
+    if (!w) {
+        fprintf(stderr, "无法监视目录: %s\n", argv[2]);
+        return 1;
+    }
+    fprintf(stderr, "监视 %s，清单目录 %s，去抖 %d毫秒\n", argv[2], argv[3], debounce_ms);
+    for (;;) {
+        aes_sm3_watch_tick(w, 1000);
+    }
+}
+
+static int cli_scan(int argc, char** argv) {
+    if (argc < 5 || argc > 7) {
+        return -1;
+    }
+    aes_sm3_scan_opts_t opts;
+    memset(&opts, 0, sizeof(opts));
+    opts.checkpoint_ms = argc >= 6 ? atoi(argv[5]) : 30000;
+    if (argc == 7) {
+        opts.throttle = aes_sm3_throttle_create(atof(argv[6]), 0, 10.0);   // 前台压力>10%时退避
+    }
+    aes_sm3_scan_stats_t stats;
+    int ret = aes_sm3_scan_run(argv[2], argv[3], argv[4], &opts, &stats);
+    aes_sm3_throttle_free(opts.throttle);
+    if (stats.resumed_offset) {
+        printf("从检查点恢复: 文件内偏移 %llu\n", (unsigned long long)stats.resumed_offset);
+    }
+    printf("完成 %llu个文件，跳过 %llu个，失败 %llu个，标记 %.2f MB\n",
+           (unsigned long long)stats.files_done, (unsigned long long)stats.files_skipped,
+           (unsigned long long)stats.files_failed, stats.bytes_hashed / (1024.0 * 1024.0));
+    if (ret < 0) {
+        fprintf(stderr, "扫描出错（日志无法写入）\n");
+        return 1;
+    }
+    return 0;
+}
+#endif
+
+typedef struct {
+    const char* name;
+    const char* usage;
+    int (*run)(int argc, char** argv);
+} cli_command_t;
+
+static const cli_command_t CLI_COMMANDS[] = {
+    {"manifest", "manifest <文件> <清单输出> [缓存窗口MB]",     cli_manifest},
+    {"diff",     "diff <源清单> <目标清单>",                   cli_diff},
+    {"delta",    "delta <源文件> <源清单> <目标清单> <增量输出>", cli_delta},
+    {"patch",    "patch <增量> <目标文件>",                    cli_patch},
+    {"compare",  "compare <旧清单> <新清单> [<旧清单> <新清单> ...]", cli_compare},
+    {"tail",     "tail <文件> <清单> [轮询毫秒]",               cli_tail},
+    {"cachebench", "cachebench <文件> [缓存窗口MB]",            cli_cachebench},
+    {"replay",   "replay <轨迹> <数据文件|内存MB> [single|batch|async] [线程数] [倍速]", cli_replay},
+    {"tenants",  "tenants [最大租户数] [每级秒数]",             cli_tenants},
+    {"stable",   "stable [CPU编号|-1] [strict]",               cli_stable},
+    {"benchjson", "benchjson <结果.json> [每项秒数] [最大线程数]", cli_benchjson},
+    {"report",   "report <结果.json> <报告.md|.html> [上次结果.json]", cli_report},
+    {"tags",     "tags <清单> [hex|base64]",                   cli_tags},
+#if defined(__linux__)
+    {"watch",    "watch <目录> <清单目录> [去抖毫秒]",          cli_watch},
+    {"scan",     "scan <目录> <清单目录> <日志> [检查点毫秒] [MB/s]", cli_scan},
+#endif
+};
+
+static void cli_usage(const char* prog) {
+    fprintf(stderr, "用法: %s                  （运行性能测试）\n", prog);
+    for (size_t i = 0; i < sizeof(CLI_COMMANDS) / sizeof(CLI_COMMANDS[0]); i++) {
+        fprintf(stderr, "      %s %s\n", prog, CLI_COMMANDS[i].usage);
+    }
+}
+
+static int cli_run(int argc, char** argv) {
+    for (size_t i = 0; i < sizeof(CLI_COMMANDS) / sizeof(CLI_COMMANDS[0]); i++) {
+        if (strcmp(argv[1], CLI_COMMANDS[i].name) == 0) {
+            int ret = CLI_COMMANDS[i].run(argc, argv);
+            if (ret < 0) {
+                cli_usage(argv[0]);
+                return 2;
+            }
+            return ret;
+        }
+    }
+    cli_usage(argv[0]);
+    return 2;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        return cli_run(argc, argv);
+    }
+
     printf("\n");
     printf("╔══════════════════════════════════════════════════════════╗\n");
     printf("║   4KB消息完整性校验算法 - AES+SM3混合优化方案 v2.3       ║\n");
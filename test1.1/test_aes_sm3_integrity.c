@@ -36,6 +36,7 @@
  *     -o test_aes_sm3 aes_sm3_integrity.c test_aes_sm3_integrity.c -lm
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -47,6 +48,12 @@
 
 #if defined(__unix__) || defined(__APPLE__) || defined(__linux__)
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
+#if defined(__linux__)
+#include <sched.h>
 #endif
 
 // 引用主文件中的函数声明
@@ -60,6 +67,247 @@ extern void aes_sm3_integrity_256bit_hyper(const uint8_t* input, uint8_t* output
 extern void aes_sm3_integrity_batch(const uint8_t** inputs, uint8_t** outputs, int batch_size);
 extern void sha256_4kb(const uint8_t* input, uint8_t* output);
 extern void sm3_4kb(const uint8_t* input, uint8_t* output);
+extern void aes_sm3_domain_init(uint32_t* midstate, uint64_t volume_id, uint64_t file_id,
+                                const char* purpose);
+extern void aes_sm3_integrity_256bit_domain(const uint32_t* midstate, uint64_t lba,
+                                            const uint8_t* input, uint8_t* output);
+extern void aes_sm3_integrity_batch_domain(const uint32_t* midstate, const uint64_t* lbas,
+                                           const uint8_t** inputs, uint8_t** outputs, int batch_size);
+
+typedef struct aes_sm3_fold_acc aes_sm3_fold_acc_t;
+extern aes_sm3_fold_acc_t* aes_sm3_fold_acc_create(void);
+extern void aes_sm3_fold_acc_free(aes_sm3_fold_acc_t* acc);
+extern int aes_sm3_fold_acc_add(aes_sm3_fold_acc_t* acc, size_t offset, const uint8_t* data, size_t len);
+extern int aes_sm3_fold_acc_merge(aes_sm3_fold_acc_t* dst, const aes_sm3_fold_acc_t* src);
+extern int aes_sm3_fold_acc_complete(const aes_sm3_fold_acc_t* acc);
+extern int aes_sm3_fold_acc_finalize(const aes_sm3_fold_acc_t* acc, const uint32_t* midstate,
+                                     uint64_t lba, uint8_t* output);
+extern void aes_sm3_fold_4kb(const uint8_t* input, uint8_t* folded);
+extern void aes_sm3_tag_from_fold(const uint32_t* midstate, const uint8_t* folded,
+                                  uint64_t lba, uint8_t* output);
+extern void aes_sm3_extent_tag_from_folds(const uint32_t* midstate, uint64_t start_lba,
+                                          const uint8_t* folds, int page_count, uint8_t* output);
+extern void aes_sm3_extent_tag(const uint32_t* midstate, uint64_t start_lba,
+                               const uint8_t* data, int page_count, uint8_t* output);
+extern int aes_sm3_integrity_batch_parity(const uint32_t* midstate, const uint64_t* lbas,
+                                          const uint8_t** inputs, uint8_t** outputs, int batch_size,
+                                          uint8_t* parity_p, uint8_t* parity_q,
+                                          const uint64_t* parity_lbas, uint8_t* parity_tags);
+extern int aes_sm3_integrity_masked(const uint32_t* midstate, uint64_t lba,
+                                    const uint8_t* input, size_t page_size,
+                                    const uint32_t* ranges, int range_count, uint8_t* output);
+extern void aes_sm3_integrity_8kb_pg(const uint32_t* midstate, uint64_t lba,
+                                     const uint8_t* input, uint8_t* output);
+extern void aes_sm3_integrity_16kb_innodb(const uint32_t* midstate, uint64_t lba,
+                                          const uint8_t* input, uint8_t* output);
+typedef struct aes_sm3_tag_filter aes_sm3_tag_filter_t;
+extern aes_sm3_tag_filter_t* aes_sm3_tag_filter_build(const uint8_t* tags, size_t count);
+extern int aes_sm3_tag_filter_save(const aes_sm3_tag_filter_t* f, const char* path);
+extern aes_sm3_tag_filter_t* aes_sm3_tag_filter_open(const char* path);
+extern void aes_sm3_tag_filter_free(aes_sm3_tag_filter_t* f);
+extern double aes_sm3_tag_filter_bits_per_entry(const aes_sm3_tag_filter_t* f);
+extern int aes_sm3_tag_filter_contains(const aes_sm3_tag_filter_t* f, const uint8_t* tag);
+extern void aes_sm3_tag_filter_query_batch(const aes_sm3_tag_filter_t* f, const uint8_t** tags,
+                                           int count, uint64_t* known_bitmap);
+extern void aes_sm3_integrity_batch_known(const uint32_t* midstate, const uint64_t* lbas,
+                                          const uint8_t** inputs, uint8_t** outputs, int batch_size,
+                                          const aes_sm3_tag_filter_t* f, uint64_t* known_bitmap);
+typedef struct aes_sm3_tag_index aes_sm3_tag_index_t;
+typedef void (*aes_sm3_tag_join_fn)(void* ctx, size_t a_first, size_t a_count,
+                                    size_t b_first, size_t b_count);
+extern aes_sm3_tag_index_t* aes_sm3_tag_index_build(const uint8_t* tags, const uint64_t* locations,
+                                                    size_t count);
+extern int aes_sm3_tag_index_save(const aes_sm3_tag_index_t* idx, const char* path);
+extern aes_sm3_tag_index_t* aes_sm3_tag_index_open(const char* path);
+extern void aes_sm3_tag_index_free(aes_sm3_tag_index_t* idx);
+extern size_t aes_sm3_tag_index_count(const aes_sm3_tag_index_t* idx);
+extern const uint8_t* aes_sm3_tag_index_tag(const aes_sm3_tag_index_t* idx, size_t i);
+extern uint64_t aes_sm3_tag_index_location(const aes_sm3_tag_index_t* idx, size_t i);
+extern size_t aes_sm3_tag_index_lookup(const aes_sm3_tag_index_t* idx, const uint8_t* tag, size_t* first);
+extern void aes_sm3_tag_index_lookup_batch(const aes_sm3_tag_index_t* idx, const uint8_t** tags,
+                                           int count, size_t* firsts, size_t* counts);
+extern size_t aes_sm3_tag_index_merge_join(const aes_sm3_tag_index_t* a, const aes_sm3_tag_index_t* b,
+                                           aes_sm3_tag_join_fn fn, void* ctx);
+typedef struct aes_sm3_manifest aes_sm3_manifest_t;
+typedef struct {
+    uint64_t first_page;
+    uint64_t page_count;
+} aes_sm3_page_range_t;
+extern aes_sm3_manifest_t* aes_sm3_manifest_build(const uint32_t* midstate, const uint8_t* data, size_t size);
+extern aes_sm3_manifest_t* aes_sm3_manifest_build_file(const uint32_t* midstate, const char* path);
+extern int aes_sm3_manifest_save(const aes_sm3_manifest_t* m, const char* path);
+extern aes_sm3_manifest_t* aes_sm3_manifest_open(const char* path);
+extern void aes_sm3_manifest_free(aes_sm3_manifest_t* m);
+extern uint64_t aes_sm3_manifest_page_count(const aes_sm3_manifest_t* m);
+extern uint64_t aes_sm3_manifest_file_size(const aes_sm3_manifest_t* m);
+extern const uint8_t* aes_sm3_manifest_tag(const aes_sm3_manifest_t* m, uint64_t page);
+extern int64_t aes_sm3_manifest_diff(const aes_sm3_manifest_t* src, const aes_sm3_manifest_t* dst,
+                                     aes_sm3_page_range_t* ranges, size_t max_ranges);
+extern int64_t aes_sm3_delta_emit(const char* src_path, const aes_sm3_manifest_t* src_m,
+                                  const aes_sm3_manifest_t* dst_m, const char* delta_path);
+extern int64_t aes_sm3_delta_apply(const char* delta_path, const char* target_path);
+typedef struct {
+    const char* old_path;
+    const char* new_path;
+    aes_sm3_page_range_t* ranges;
+    int64_t range_count;
+    uint64_t changed_pages;
+} aes_sm3_compare_job_t;
+extern int aes_sm3_manifest_compare_parallel(aes_sm3_compare_job_t* jobs, int job_count, int num_threads);
+typedef struct aes_sm3_tail aes_sm3_tail_t;
+extern aes_sm3_tail_t* aes_sm3_tail_create(const uint32_t* midstate, int use_inotify);
+extern void aes_sm3_tail_free(aes_sm3_tail_t* t);
+extern int aes_sm3_tail_add(aes_sm3_tail_t* t, const char* data_path, const char* manifest_path);
+extern uint64_t aes_sm3_tail_high_water(const aes_sm3_tail_t* t, int index);
+extern int64_t aes_sm3_tail_tick(aes_sm3_tail_t* t, int timeout_ms);
+#if defined(__linux__)
+typedef struct aes_sm3_watch aes_sm3_watch_t;
+typedef void (*aes_sm3_watch_fn)(void* ctx, const char* path,
+                                 const aes_sm3_page_range_t* ranges, int64_t range_count);
+extern aes_sm3_watch_t* aes_sm3_watch_create(const char* root, const char* manifest_root, int debounce_ms,
+                                             int num_workers, aes_sm3_watch_fn fn, void* ctx);
+extern int aes_sm3_watch_tick(aes_sm3_watch_t* w, int timeout_ms);
+extern int aes_sm3_watch_drain(aes_sm3_watch_t* w, int max_wait_ms);
+extern void aes_sm3_watch_stats(const aes_sm3_watch_t* w, uint64_t* files_retagged, uint64_t* pages_changed);
+extern void aes_sm3_watch_free(aes_sm3_watch_t* w);
+#define AES_SM3_TRACK_AUTO          0
+#define AES_SM3_TRACK_UFFD_WP       1
+#define AES_SM3_TRACK_SOFT_DIRTY    2
+#define AES_SM3_TRACK_FULL          3
+typedef struct aes_sm3_region aes_sm3_region_t;
+extern aes_sm3_region_t* aes_sm3_region_track(void* base, size_t size, const uint32_t* midstate,
+                                              uint8_t* tags, int backend);
+extern int aes_sm3_region_backend(const aes_sm3_region_t* r);
+extern int64_t aes_sm3_region_refresh(aes_sm3_region_t* r);
+extern void aes_sm3_region_untrack(aes_sm3_region_t* r);
+#endif
+typedef struct aes_sm3_memo aes_sm3_memo_t;
+extern aes_sm3_memo_t* aes_sm3_memo_create(const uint32_t* midstate, size_t lines);
+extern void aes_sm3_memo_free(aes_sm3_memo_t* m);
+extern int aes_sm3_memo_lookup(const aes_sm3_memo_t* m, const void* page, uint64_t lba,
+                               uint64_t generation, uint8_t* tag);
+extern void aes_sm3_memo_insert(aes_sm3_memo_t* m, const void* page, uint64_t lba,
+                                uint64_t generation, const uint8_t* tag);
+extern int aes_sm3_integrity_batch_memo(aes_sm3_memo_t* m, const uint64_t* lbas, const uint64_t* generations,
+                                        const uint8_t** inputs, uint8_t** outputs, int batch_size);
+typedef struct aes_sm3_shcache aes_sm3_shcache_t;
+extern aes_sm3_shcache_t* aes_sm3_shared_cache_open(const char* path, const uint32_t* midstate, uint64_t slots);
+extern void aes_sm3_shared_cache_close(aes_sm3_shcache_t* c);
+extern int64_t aes_sm3_shared_cache_tag_file(aes_sm3_shcache_t* c, const char* path, uint8_t* tags, uint64_t* hits);
+typedef struct aes_sm3_throttle aes_sm3_throttle_t;
+extern aes_sm3_throttle_t* aes_sm3_throttle_create(double mb_per_sec, double cpu_share, double psi_threshold);
+extern void aes_sm3_throttle_free(aes_sm3_throttle_t* t);
+extern double aes_sm3_throttle_factor(aes_sm3_throttle_t* t);
+extern void aes_sm3_throttle_observe(aes_sm3_throttle_t* t, double pressure);
+extern void aes_sm3_throttle_acquire(aes_sm3_throttle_t* t, uint64_t bytes);
+extern void aes_sm3_parallel(const uint8_t* input, uint8_t* output, int block_count,
+                             int num_threads, int output_size);
+extern void aes_sm3_parallel_throttled(const uint8_t* input, uint8_t* output, int block_count,
+                                       int num_threads, int output_size, aes_sm3_throttle_t* throttle);
+extern int64_t aes_sm3_page_cache_resident(const char* path);
+extern aes_sm3_manifest_t* aes_sm3_manifest_build_file_neutral(const uint32_t* midstate, const char* path,
+                                                               size_t window_bytes);
+typedef struct {
+    uint64_t windows;
+    uint64_t major_faults;
+    uint64_t stall_ns;
+    size_t window_bytes;
+    size_t max_window_bytes;
+} aes_sm3_mmap_stats_t;
+extern aes_sm3_manifest_t* aes_sm3_manifest_build_file_windowed(const uint32_t* midstate, const char* path,
+                                                                size_t window_bytes, int num_threads,
+                                                                aes_sm3_mmap_stats_t* stats);
+typedef struct {
+    uint64_t ts_us;
+    uint64_t offset;
+    uint32_t length;
+    char op;
+} aes_sm3_trace_rec_t;
+typedef struct {
+    uint64_t requests;
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t pages;
+    uint64_t mismatches;
+    double elapsed_sec;
+    double mb_per_sec;
+    double iops;
+    double lat_p50_us;
+    double lat_p90_us;
+    double lat_p99_us;
+    double lat_p999_us;
+    double lat_max_us;
+} aes_sm3_replay_report_t;
+extern int64_t aes_sm3_trace_load(const char* path, aes_sm3_trace_rec_t** out);
+extern int aes_sm3_replay_run(const aes_sm3_trace_rec_t* recs, int64_t count, const uint8_t* data, size_t size,
+                              int mode, int threads, double speed, aes_sm3_replay_report_t* report);
+typedef struct {
+    double zero;
+    double uniform;
+    double text;
+    double dup;
+} aes_sm3_datagen_mix_t;
+extern const aes_sm3_datagen_mix_t aes_sm3_datagen_mixed;
+extern int aes_sm3_datagen_kind(const aes_sm3_datagen_mix_t* mix, uint64_t seed, uint64_t page);
+extern void aes_sm3_datagen_page(const aes_sm3_datagen_mix_t* mix, uint64_t seed, uint64_t page, uint8_t* out);
+extern void aes_sm3_datagen_fill(const aes_sm3_datagen_mix_t* mix, uint64_t seed, uint8_t* data,
+                                 uint64_t first_page, size_t pages);
+typedef struct {
+    int tenants;
+    uint64_t pages;
+    uint64_t mismatches;
+    double elapsed_sec;
+    double mb_per_sec;
+    double min_tenant_mb_per_sec;
+    double max_tenant_mb_per_sec;
+    double fairness;
+} aes_sm3_tenant_report_t;
+extern int aes_sm3_tenant_run(int tenants, double seconds, int ops, aes_sm3_tenant_report_t* report);
+typedef struct {
+    int cpu;
+    int isolated;
+    char governor[32];
+    int turbo;
+    int sibling_count;
+    double sibling_busy;
+    double timer_overhead_ns;
+    double timer_resolution_ns;
+    double noise_cv;
+    int warnings;
+} aes_sm3_bench_env_t;
+extern int aes_sm3_bench_env_check(int cpu, aes_sm3_bench_env_t* env);
+extern int aes_sm3_bench_json(const char* path, double seconds, int max_threads);
+extern int aes_sm3_bench_report(const char* json_path, const char* out_path, const char* prev_path);
+#define AES_SM3_TEXT_HEX          0
+#define AES_SM3_TEXT_BASE64       1
+typedef struct aes_sm3_writer aes_sm3_writer_t;
+extern size_t aes_sm3_hex_encode(const uint8_t* in, size_t len, char* out);
+extern int64_t aes_sm3_hex_decode(const char* in, size_t len, uint8_t* out);
+extern size_t aes_sm3_base64_encode(const uint8_t* in, size_t len, char* out);
+extern int64_t aes_sm3_base64_decode(const char* in, size_t len, uint8_t* out);
+extern aes_sm3_writer_t* aes_sm3_writer_open(int fd, size_t cap);
+extern void aes_sm3_writer_put(aes_sm3_writer_t* w, const void* data, size_t n);
+extern void aes_sm3_writer_u64(aes_sm3_writer_t* w, uint64_t v);
+extern void aes_sm3_writer_tag(aes_sm3_writer_t* w, const uint8_t* tag, size_t len, int format);
+extern int aes_sm3_writer_close(aes_sm3_writer_t* w);
+#if defined(__linux__)
+typedef struct {
+    const uint32_t* midstate;
+    int checkpoint_ms;
+    uint64_t max_bytes;
+    volatile int* stop;
+    aes_sm3_throttle_t* throttle;
+} aes_sm3_scan_opts_t;
+typedef struct {
+    uint64_t files_done;
+    uint64_t files_skipped;
+    uint64_t files_failed;
+    uint64_t bytes_hashed;
+    uint64_t resumed_offset;
+} aes_sm3_scan_stats_t;
+extern int aes_sm3_scan_run(const char* root, const char* manifest_root, const char* journal_path,
+                            const aes_sm3_scan_opts_t* opts, aes_sm3_scan_stats_t* stats);
+#endif
 
 // 测试统计结构
 typedef struct {
@@ -545,9 +793,8 @@ void test_vs_baseline_performance() {
     uint8_t input[4096];
     uint8_t output[32];
     
-    for (int i = 0; i < 4096; i++) {
-        input[i] = i % 256;
-    }
+    const aes_sm3_datagen_mix_t random_mix = {0, 0, 0, 0};
+    aes_sm3_datagen_page(&random_mix, 1, 0, input);
     
     const int iterations = 50000;
     struct timespec start, end;
@@ -625,13 +872,10 @@ void test_batch_performance() {
     const uint8_t* batch_inputs[batch_size];
     uint8_t* batch_outputs[batch_size];
     
+    aes_sm3_datagen_fill(&aes_sm3_datagen_mixed, 1, batch_input_data, 0, batch_size);
     for (int i = 0; i < batch_size; i++) {
         batch_inputs[i] = batch_input_data + i * 4096;
         batch_outputs[i] = batch_output_data + i * 32;
-        
-        for (int j = 0; j < 4096; j++) {
-            batch_input_data[i * 4096 + j] = (i + j) % 256;
-        }
     }
     
     struct timespec start, end;
@@ -773,6 +1017,1942 @@ void test_random_input_stress() {
     TEST_END();
 }
 
+// ============================================================================
+// 第六部分：扩展接口测试
+// ============================================================================
+
+// 测试16：域分离 - 上下文中间状态与LBA调整
+void test_domain_separation() {
+    TEST_START("域分离 - 上下文中间状态与LBA调整");
+    
+    uint8_t input[4096];
+    uint8_t tag_a[32], tag_b[32], tag_c[32];
+    uint32_t vol1[8], vol2[8];
+    
+    for (int i = 0; i < 4096; i++) {
+        input[i] = (i * 131 + 17) % 256;
+    }
+    
+    aes_sm3_domain_init(vol1, 1, 100, "data");
+    aes_sm3_domain_init(vol2, 2, 100, "data");
+    
+    // 相同上下文+相同LBA：输出确定
+    aes_sm3_integrity_256bit_domain(vol1, 4096, input, tag_a);
+    aes_sm3_integrity_256bit_domain(vol1, 4096, input, tag_b);
+    ASSERT_TRUE(compare_hash(tag_a, tag_b, 32), "相同上下文和LBA应产生相同标签");
+    
+    // 误写到其他LBA：标签必须不同
+    aes_sm3_integrity_256bit_domain(vol1, 4097, input, tag_c);
+    ASSERT_TRUE(!compare_hash(tag_a, tag_c, 32), "不同LBA应产生不同标签");
+    
+    // 不同卷：标签必须不同
+    aes_sm3_integrity_256bit_domain(vol2, 4096, input, tag_c);
+    ASSERT_TRUE(!compare_hash(tag_a, tag_c, 32), "不同上下文应产生不同标签");
+    
+    // 默认上下文（SM3_IV）与任意域上下文不同
+    aes_sm3_integrity_256bit_domain(NULL, 4096, input, tag_c);
+    ASSERT_TRUE(!compare_hash(tag_a, tag_c, 32), "域上下文应与默认IV不同");
+    
+    // 批处理版本与单块版本一致
+    uint8_t batch_tags[4][32];
+    const uint8_t* inputs[4];
+    uint8_t* outputs[4];
+    uint64_t lbas[4] = {4096, 4097, 7, 0};
+    for (int i = 0; i < 4; i++) {
+        inputs[i] = input;
+        outputs[i] = batch_tags[i];
+    }
+    aes_sm3_integrity_batch_domain(vol1, lbas, inputs, outputs, 4);
+    for (int i = 0; i < 4; i++) {
+        aes_sm3_integrity_256bit_domain(vol1, lbas[i], input, tag_c);
+        ASSERT_TRUE(compare_hash(batch_tags[i], tag_c, 32), "批处理域标签应与单块一致");
+    }
+    
+    print_hash("卷1/LBA4096", tag_a, 32);
+    
+    TEST_END();
+}
+
+// 测试17：乱序分段累加 - 多线程添加+合并
+typedef struct {
+    aes_sm3_fold_acc_t* acc;
+    const uint8_t* page;
+    int thread_id;
+    int failures;
+} fold_acc_worker_t;
+
+static void* fold_acc_worker(void* arg) {
+    fold_acc_worker_t* w = (fold_acc_worker_t*)arg;
+    // 每个线程倒序添加自己负责的片段（长度不对齐行边界）
+    for (int seg = 15; seg >= 0; seg--) {
+        if (seg % 2 != w->thread_id % 2) {
+            continue;
+        }
+        size_t offset = (size_t)seg * 256 + (w->thread_id / 2) * 128;
+        if (aes_sm3_fold_acc_add(w->acc, offset, w->page + offset, 128) != 0) {
+            w->failures++;
+        }
+    }
+    return NULL;
+}
+
+void test_fold_accumulator() {
+    TEST_START("乱序分段累加 - 多线程添加与合并");
+    
+    uint8_t page[4096];
+    uint8_t expected[32], tag[32];
+    uint32_t midstate[8];
+    
+    for (int i = 0; i < 4096; i++) {
+        page[i] = (i * 73 + 5) % 256;
+    }
+    aes_sm3_domain_init(midstate, 9, 3, "rdma");
+    aes_sm3_integrity_256bit_domain(midstate, 42, page, expected);
+    
+    // 场景1：4个线程并发写同一个累加器
+    aes_sm3_fold_acc_t* shared = aes_sm3_fold_acc_create();
+    ASSERT_TRUE(shared != NULL, "累加器分配失败");
+    
+    pthread_t threads[4];
+    fold_acc_worker_t workers[4];
+    for (int t = 0; t < 4; t++) {
+        workers[t].acc = shared;
+        workers[t].page = page;
+        workers[t].thread_id = t;
+        workers[t].failures = 0;
+        pthread_create(&threads[t], NULL, fold_acc_worker, &workers[t]);
+    }
+    for (int t = 0; t < 4; t++) {
+        pthread_join(threads[t], NULL);
+        ASSERT_TRUE(workers[t].failures == 0, "并发添加不应失败");
+    }
+    
+    ASSERT_TRUE(aes_sm3_fold_acc_complete(shared), "全部片段添加后应完整覆盖");
+    ASSERT_TRUE(aes_sm3_fold_acc_finalize(shared, midstate, 42, tag) == 0, "完成失败");
+    ASSERT_TRUE(compare_hash(tag, expected, 32), "累加结果应与整页标签一致");
+    
+    // 重叠片段必须被拒绝
+    ASSERT_TRUE(aes_sm3_fold_acc_add(shared, 100, page + 100, 10) != 0, "重叠片段应被拒绝");
+    
+    // 场景2：两个私有累加器（奇数字节片段+任意顺序）合并
+    aes_sm3_fold_acc_t* a = aes_sm3_fold_acc_create();
+    aes_sm3_fold_acc_t* b = aes_sm3_fold_acc_create();
+    ASSERT_TRUE(aes_sm3_fold_acc_add(a, 3000, page + 3000, 1096) == 0, "添加失败");
+    ASSERT_TRUE(aes_sm3_fold_acc_add(b, 1, page + 1, 2999) == 0, "添加失败");
+    ASSERT_TRUE(aes_sm3_fold_acc_finalize(a, midstate, 42, tag) != 0, "未完整覆盖时不应完成");
+    ASSERT_TRUE(aes_sm3_fold_acc_add(a, 0, page, 1) == 0, "添加失败");
+    ASSERT_TRUE(aes_sm3_fold_acc_merge(a, b) == 0, "合并失败");
+    ASSERT_TRUE(aes_sm3_fold_acc_merge(a, b) != 0, "重复合并应被拒绝");
+    ASSERT_TRUE(aes_sm3_fold_acc_finalize(a, midstate, 42, tag) == 0, "完成失败");
+    ASSERT_TRUE(compare_hash(tag, expected, 32), "合并结果应与整页标签一致");
+    
+    aes_sm3_fold_acc_free(shared);
+    aes_sm3_fold_acc_free(a);
+    aes_sm3_fold_acc_free(b);
+    
+    TEST_END();
+}
+
+// 测试18：区段标签 - 由保存的页折叠结果组合
+void test_extent_tags() {
+    TEST_START("区段标签 - 由页折叠结果组合（64KB对象）");
+    
+    const int pages = 16;
+    uint8_t* data = malloc(pages * 4096);
+    uint8_t* folds = malloc((pages + 1) * 64);
+    uint8_t tag_data[32], tag_folds[32], tag_other[32], page_tag[32];
+    
+    // 规律数据（如i%256）各页折叠结果可能相同，这里用xorshift生成
+    uint32_t x = 0x12345678;
+    for (int i = 0; i < pages * 4096; i++) {
+        x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+        data[i] = (uint8_t)x;
+    }
+    
+    // 每页保存64字节折叠结果作为元数据
+    for (int p = 0; p < pages; p++) {
+        aes_sm3_fold_4kb(data + p * 4096, folds + p * 64);
+    }
+    
+    // 保存的折叠结果可重新得到页标签
+    aes_sm3_tag_from_fold(NULL, folds + 64, 1001, tag_other);
+    aes_sm3_integrity_256bit_domain(NULL, 1001, data + 4096, page_tag);
+    ASSERT_TRUE(compare_hash(tag_other, page_tag, 32), "折叠结果应能重算页标签");
+    
+    // 组合结果与直接读数据一致
+    aes_sm3_extent_tag(NULL, 1000, data, pages, tag_data);
+    aes_sm3_extent_tag_from_folds(NULL, 1000, folds, pages, tag_folds);
+    ASSERT_TRUE(compare_hash(tag_data, tag_folds, 32), "组合标签应与读数据计算一致");
+    
+    // 交换两页：位置绑定，标签必须变化
+    uint8_t tmp[64];
+    memcpy(tmp, folds + 2 * 64, 64);
+    memcpy(folds + 2 * 64, folds + 9 * 64, 64);
+    memcpy(folds + 9 * 64, tmp, 64);
+    aes_sm3_extent_tag_from_folds(NULL, 1000, folds, pages, tag_other);
+    ASSERT_TRUE(memcmp(folds + 2 * 64, folds + 9 * 64, 64) != 0, "测试数据两页折叠结果应不同");
+    ASSERT_TRUE(!compare_hash(tag_other, tag_folds, 32), "交换页顺序应改变标签");
+    memcpy(folds + 9 * 64, folds + 2 * 64, 64);
+    memcpy(folds + 2 * 64, tmp, 64);
+    
+    // 前缀补零页：页数不同，标签必须变化
+    memmove(folds + 64, folds, pages * 64);
+    memset(folds, 0, 64);
+    aes_sm3_extent_tag_from_folds(NULL, 1000, folds, pages + 1, tag_other);
+    ASSERT_TRUE(!compare_hash(tag_other, tag_folds, 32), "不同页数应产生不同标签");
+    
+    // 不同起始LBA：标签必须变化
+    aes_sm3_extent_tag_from_folds(NULL, 2000, folds + 64, pages, tag_other);
+    ASSERT_TRUE(!compare_hash(tag_other, tag_folds, 32), "不同起始LBA应产生不同标签");
+    
+    // 单页区段与页标签域分离：即使把区段魔数与页数异或进折叠结果也不会与页标签相同
+    uint8_t forged[64];
+    const uint8_t ext1[4] = {'E', 'X', 'T', '1'};
+    memcpy(forged, folds + 64, 64);
+    for (int i = 0; i < 4; i++) {
+        forged[48 + i] ^= ext1[i];
+    }
+    forged[55] ^= 1;
+    aes_sm3_extent_tag_from_folds(NULL, 1000, folds + 64, 1, tag_other);
+    aes_sm3_tag_from_fold(NULL, forged, 1000, page_tag);
+    ASSERT_TRUE(!compare_hash(tag_other, page_tag, 32), "区段标签不应与页标签混淆");
+    
+    print_hash("64KB区段标签", tag_folds, 32);
+    
+    free(data);
+    free(folds);
+    
+    TEST_END();
+}
+
+// 辅助函数：GF(2^8)乘法（模多项式0x11D，测试参考实现）
+static uint8_t gf8_mul_ref(uint8_t a, uint8_t b) {
+    uint8_t r = 0;
+    while (b) {
+        if (b & 1) r ^= a;
+        a = (a & 0x80) ? (uint8_t)((a << 1) ^ 0x1d) : (uint8_t)(a << 1);
+        b >>= 1;
+    }
+    return r;
+}
+
+// 测试19：融合RAID校验 - P/Q校验页与标签一次生成
+void test_fused_parity() {
+    TEST_START("融合RAID校验 - P/Q校验页与每页标签");
+    
+    const int stripe = 6;
+    uint8_t* data = malloc(stripe * 4096);
+    uint8_t tags[stripe][32];
+    uint8_t p[4096] __attribute__((aligned(64)));
+    uint8_t q[4096] __attribute__((aligned(64)));
+    uint8_t parity_tags[64], expected[32];
+    const uint8_t* inputs[stripe];
+    uint8_t* outputs[stripe];
+    uint64_t lbas[stripe];
+    uint64_t parity_lbas[2] = {900, 901};
+    
+    uint32_t x = 0x9e3779b9;
+    for (int i = 0; i < stripe * 4096; i++) {
+        x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+        data[i] = (uint8_t)x;
+    }
+    for (int i = 0; i < stripe; i++) {
+        inputs[i] = data + i * 4096;
+        outputs[i] = tags[i];
+        lbas[i] = 100 + i;
+    }
+    
+    int ret = aes_sm3_integrity_batch_parity(NULL, lbas, inputs, outputs, stripe,
+                                             p, q, parity_lbas, parity_tags);
+    ASSERT_TRUE(ret == 0, "融合批处理失败");
+    
+    // 每页标签与域分离单块版本一致
+    for (int i = 0; i < stripe; i++) {
+        aes_sm3_integrity_256bit_domain(NULL, lbas[i], inputs[i], expected);
+        ASSERT_TRUE(compare_hash(tags[i], expected, 32), "页标签应与单块版本一致");
+    }
+    
+    // 校验页内容与参考实现一致
+    for (int b = 0; b < 4096; b++) {
+        uint8_t rp = 0, rq = 0, g = 1;
+        for (int i = 0; i < stripe; i++) {
+            rp ^= inputs[i][b];
+            rq ^= gf8_mul_ref(g, inputs[i][b]);
+            g = gf8_mul_ref(g, 2);
+        }
+        ASSERT_TRUE(p[b] == rp, "P校验页错误");
+        ASSERT_TRUE(q[b] == rq, "Q校验页错误");
+    }
+    
+    // 校验页标签（由折叠结果推导）与直接计算一致
+    aes_sm3_integrity_256bit_domain(NULL, 900, p, expected);
+    ASSERT_TRUE(compare_hash(parity_tags, expected, 32), "P校验页标签错误");
+    aes_sm3_integrity_256bit_domain(NULL, 901, q, expected);
+    ASSERT_TRUE(compare_hash(parity_tags + 32, expected, 32), "Q校验页标签错误");
+    
+    // 仅P模式
+    ret = aes_sm3_integrity_batch_parity(NULL, lbas, inputs, outputs, stripe,
+                                         p, NULL, parity_lbas, parity_tags);
+    ASSERT_TRUE(ret == 0, "仅P模式失败");
+    aes_sm3_integrity_256bit_domain(NULL, 900, p, expected);
+    ASSERT_TRUE(compare_hash(parity_tags, expected, 32), "仅P模式校验页标签错误");
+    
+    print_hash("P校验页标签", parity_tags, 32);
+    
+    free(data);
+    
+    TEST_END();
+}
+
+// 测试20：掩码区域标签 - 排除页内校验和/LSN字段
+void test_masked_tags() {
+    TEST_START("掩码区域标签 - 排除页内校验和/LSN字段");
+    
+    uint8_t* page = malloc(16384);
+    uint8_t* copy = malloc(16384);
+    uint8_t tag[32], expected[32];
+    
+    uint32_t x = 0x2545f491;
+    for (int i = 0; i < 16384; i++) {
+        x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+        page[i] = (uint8_t)x;
+    }
+    
+    // 4KB运行期掩码：跨行区间 + 整行区间，结果等于清零拷贝的标签
+    const uint32_t ranges[] = {10, 4, 60, 8, 128, 192, 4090, 6};
+    int ret = aes_sm3_integrity_masked(NULL, 7, page, 4096, ranges, 4, tag);
+    ASSERT_TRUE(ret == 0, "4KB掩码标签失败");
+    memcpy(copy, page, 4096);
+    for (int i = 0; i < 4; i++) {
+        memset(copy + ranges[2 * i], 0, ranges[2 * i + 1]);
+    }
+    aes_sm3_integrity_256bit_domain(NULL, 7, copy, expected);
+    ASSERT_TRUE(compare_hash(tag, expected, 32), "掩码标签应等于清零拷贝的标签");
+    
+    // 修改排除字节不影响标签，修改其他字节改变标签
+    page[200] ^= 0xFF;
+    aes_sm3_integrity_masked(NULL, 7, page, 4096, ranges, 4, expected);
+    ASSERT_TRUE(compare_hash(tag, expected, 32), "排除字节不应影响标签");
+    page[400] ^= 0xFF;
+    aes_sm3_integrity_masked(NULL, 7, page, 4096, ranges, 4, expected);
+    ASSERT_TRUE(!compare_hash(tag, expected, 32), "非排除字节应影响标签");
+    
+    // PostgreSQL 8KB特化 = 运行期掩码 = 清零拷贝
+    const uint32_t pg_ranges[] = {0, 8, 8, 2};
+    aes_sm3_integrity_8kb_pg(NULL, 11, page, tag);
+    aes_sm3_integrity_masked(NULL, 11, page, 8192, pg_ranges, 2, expected);
+    ASSERT_TRUE(compare_hash(tag, expected, 32), "PG特化应与运行期掩码一致");
+    memcpy(copy, page, 8192);
+    memset(copy, 0, 10);
+    aes_sm3_integrity_masked(NULL, 11, copy, 8192, NULL, 0, expected);
+    ASSERT_TRUE(compare_hash(tag, expected, 32), "PG特化应等于清零拷贝的标签");
+    
+    // InnoDB 16KB特化 = 运行期掩码 = 清零拷贝
+    const uint32_t innodb_ranges[] = {0, 4, 16, 8, 16376, 8};
+    aes_sm3_integrity_16kb_innodb(NULL, 13, page, tag);
+    aes_sm3_integrity_masked(NULL, 13, page, 16384, innodb_ranges, 3, expected);
+    ASSERT_TRUE(compare_hash(tag, expected, 32), "InnoDB特化应与运行期掩码一致");
+    memcpy(copy, page, 16384);
+    memset(copy, 0, 4);
+    memset(copy + 16, 0, 8);
+    memset(copy + 16376, 0, 8);
+    aes_sm3_integrity_masked(NULL, 13, copy, 16384, NULL, 0, expected);
+    ASSERT_TRUE(compare_hash(tag, expected, 32), "InnoDB特化应等于清零拷贝的标签");
+    page[16380] ^= 0x5A;
+    page[20] ^= 0x5A;
+    aes_sm3_integrity_16kb_innodb(NULL, 13, page, expected);
+    ASSERT_TRUE(compare_hash(tag, expected, 32), "InnoDB排除字段不应影响标签");
+    
+    // 参数校验
+    ASSERT_TRUE(aes_sm3_integrity_masked(NULL, 0, page, 4000, NULL, 0, tag) == -1,
+                "非64整数倍页大小应被拒绝");
+    const uint32_t bad_range[] = {4090, 10};
+    ASSERT_TRUE(aes_sm3_integrity_masked(NULL, 0, page, 4096, bad_range, 1, tag) == -1,
+                "越界区间应被拒绝");
+    
+    print_hash("InnoDB 16KB标签", tag, 32);
+    
+    free(page);
+    free(copy);
+    
+    TEST_END();
+}
+
+// 测试21：已知标签过滤器 - 无假阴性、低假阳性、mmap往返与批量判定
+void test_tag_filter() {
+    TEST_START("已知标签过滤器 - 二元熔断过滤器");
+    
+    const size_t n = 100000;
+    uint8_t* tags = malloc(n * 32);
+    uint8_t* others = malloc(n * 32);
+    const uint8_t** ptrs = malloc(n * sizeof(uint8_t*));
+    uint64_t* bitmap = malloc((n + 63) / 64 * sizeof(uint64_t));
+    
+    uint64_t x = 0x9e3779b97f4a7c15ULL;
+    for (size_t i = 0; i < n * 32; i++) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        tags[i] = (uint8_t)x;
+        others[i] = (uint8_t)(x >> 8);
+    }
+    
+    aes_sm3_tag_filter_t* f = aes_sm3_tag_filter_build(tags, n);
+    ASSERT_TRUE(f != NULL, "过滤器构建失败");
+    double bits = aes_sm3_tag_filter_bits_per_entry(f);
+    printf("  每条目位数: %.2f\n", bits);
+    ASSERT_TRUE(bits < 10.5, "每条目位数过高");
+    
+    // 无假阴性（单个 + 批量）
+    for (size_t i = 0; i < n; i++) {
+        ASSERT_TRUE(aes_sm3_tag_filter_contains(f, tags + i * 32), "已知标签被判为未知");
+        ptrs[i] = tags + i * 32;
+    }
+    aes_sm3_tag_filter_query_batch(f, ptrs, (int)n, bitmap);
+    for (size_t i = 0; i < n; i++) {
+        ASSERT_TRUE((bitmap[i / 64] >> (i % 64)) & 1, "批量查询出现假阴性");
+    }
+    
+    // 假阳性率约1/256
+    for (size_t i = 0; i < n; i++) {
+        ptrs[i] = others + i * 32;
+    }
+    aes_sm3_tag_filter_query_batch(f, ptrs, (int)n, bitmap);
+    size_t fp = 0;
+    for (size_t i = 0; i < (n + 63) / 64; i++) {
+        fp += __builtin_popcountll(bitmap[i]);
+    }
+    printf("  假阳性率: %.3f%%\n", 100.0 * fp / n);
+    ASSERT_TRUE(fp < n / 100, "假阳性率过高");
+    
+    // 保存后mmap打开，结果一致
+    const char* path = "/tmp/test_aes_sm3_filter.bin";
+    ASSERT_TRUE(aes_sm3_tag_filter_save(f, path) == 0, "过滤器保存失败");
+    aes_sm3_tag_filter_t* g = aes_sm3_tag_filter_open(path);
+    ASSERT_TRUE(g != NULL, "过滤器mmap打开失败");
+    for (size_t i = 0; i < 1000; i++) {
+        ASSERT_TRUE(aes_sm3_tag_filter_contains(g, tags + i * 32), "mmap过滤器出现假阴性");
+        ASSERT_TRUE(aes_sm3_tag_filter_contains(g, others + i * 32) ==
+                    aes_sm3_tag_filter_contains(f, others + i * 32), "mmap过滤器结果不一致");
+    }
+    aes_sm3_tag_filter_free(g);
+    aes_sm3_tag_filter_free(f);
+    
+    // 头中段长掩码被篡改：打开时拒绝，不会越界访问指纹数组
+    uint32_t bad_mask = 0xFFFFFFFFu;
+    FILE* fp_filter = fopen(path, "r+b");
+    fseek(fp_filter, 36, SEEK_SET);
+    fwrite(&bad_mask, sizeof(bad_mask), 1, fp_filter);
+    fclose(fp_filter);
+    ASSERT_TRUE(aes_sm3_tag_filter_open(path) == NULL, "损坏的过滤器头应被拒绝");
+    unlink(path);
+    
+    // 批量标签 + 已知判定：仅偶数页的标签入库
+    const int pages = 40;
+    uint8_t* data = malloc(pages * 4096);
+    uint8_t page_tags[40][32];
+    uint8_t known_tags[20 * 32];
+    const uint8_t* inputs[40];
+    uint8_t* outputs[40];
+    uint64_t lbas[40];
+    uint64_t known[1];
+    for (int i = 0; i < pages * 4096; i++) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        data[i] = (uint8_t)x;
+    }
+    for (int i = 0; i < pages; i++) {
+        inputs[i] = data + i * 4096;
+        outputs[i] = page_tags[i];
+        lbas[i] = i;
+        if (i % 2 == 0) {
+            aes_sm3_integrity_256bit_domain(NULL, lbas[i], inputs[i], known_tags + (i / 2) * 32);
+        }
+    }
+    f = aes_sm3_tag_filter_build(known_tags, 20);
+    ASSERT_TRUE(f != NULL, "小过滤器构建失败");
+    aes_sm3_integrity_batch_known(NULL, lbas, inputs, outputs, pages, f, known);
+    for (int i = 0; i < pages; i += 2) {
+        ASSERT_TRUE((known[0] >> i) & 1, "已知页应被标记");
+        ASSERT_TRUE(compare_hash(page_tags[i], known_tags + (i / 2) * 32, 32), "批量标签错误");
+    }
+    aes_sm3_tag_filter_free(f);
+    
+    free(data);
+    free(tags);
+    free(others);
+    free(ptrs);
+    free(bitmap);
+    
+    TEST_END();
+}
+
+// 辅助结构：归并连接回调统计
+typedef struct {
+    size_t groups;
+    size_t pairs;
+} join_stats_t;
+
+static void join_count_cb(void* ctx, size_t a_first, size_t a_count, size_t b_first, size_t b_count) {
+    join_stats_t* s = (join_stats_t*)ctx;
+    (void)a_first;
+    (void)b_first;
+    s->groups++;
+    s->pairs += a_count * b_count;
+}
+
+// 测试22：精确标签索引 - 隐式B+树查找、重复位置区间、mmap与归并连接
+void test_tag_index() {
+    TEST_START("精确标签索引 - 隐式B+树与批量查找");
+    
+    const size_t n = 20000;
+    uint8_t* tags = malloc(n * 32);
+    uint64_t* locs = malloc(n * sizeof(uint64_t));
+    const uint8_t** ptrs = malloc(n * sizeof(uint8_t*));
+    size_t* firsts = malloc(n * sizeof(size_t));
+    size_t* counts = malloc(n * sizeof(size_t));
+    
+    uint64_t x = 0x2545f4914f6cdd1dULL;
+    for (size_t i = 0; i < n; i++) {
+        for (int b = 0; b < 32; b++) {
+            x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+            tags[i * 32 + b] = (uint8_t)x;
+        }
+        if (i % 10 == 9) {
+            memcpy(tags + i * 32, tags + (i - 1) * 32, 32);       // 重复标签：两个位置
+        } else if (i % 10 == 5) {
+            memcpy(tags + i * 32, tags + (i - 1) * 32, 8);        // 截断键冲突、完整标签不同
+        }
+        locs[i] = i * 4096;
+    }
+    
+    aes_sm3_tag_index_t* idx = aes_sm3_tag_index_build(tags, locs, n);
+    ASSERT_TRUE(idx != NULL, "索引构建失败");
+    ASSERT_TRUE(aes_sm3_tag_index_count(idx) == n, "索引条目数错误");
+    
+    // 每个标签都能找到，且位置区间包含原位置
+    for (size_t i = 0; i < n; i++) {
+        size_t first;
+        size_t cnt = aes_sm3_tag_index_lookup(idx, tags + i * 32, &first);
+        ASSERT_TRUE(cnt == ((i % 10 == 8 || i % 10 == 9) ? 2u : 1u), "匹配条目数错误");
+        int found = 0;
+        for (size_t k = 0; k < cnt; k++) {
+            ASSERT_TRUE(compare_hash(aes_sm3_tag_index_tag(idx, first + k), tags + i * 32, 32),
+                        "区间内标签不一致");
+            found |= aes_sm3_tag_index_location(idx, first + k) == locs[i];
+        }
+        ASSERT_TRUE(found, "位置区间缺少原位置");
+        ptrs[i] = tags + i * 32;
+    }
+    
+    // 批量查找与单个查找一致
+    aes_sm3_tag_index_lookup_batch(idx, ptrs, (int)n, firsts, counts);
+    for (size_t i = 0; i < n; i++) {
+        size_t first;
+        size_t cnt = aes_sm3_tag_index_lookup(idx, ptrs[i], &first);
+        ASSERT_TRUE(counts[i] == cnt && firsts[i] == first, "批量查找结果不一致");
+    }
+    
+    // 不存在的标签（含截断键相同的情况）
+    uint8_t probe[32];
+    memcpy(probe, tags, 32);
+    probe[31] ^= 1;
+    size_t first;
+    ASSERT_TRUE(aes_sm3_tag_index_lookup(idx, probe, &first) == 0, "截断键冲突应被完整标签排除");
+    memset(probe, 0xFF, 32);
+    ASSERT_TRUE(aes_sm3_tag_index_lookup(idx, probe, &first) == 0, "大于全部键的标签应不存在");
+    
+    // 保存后mmap打开，结果一致
+    const char* path = "/tmp/test_aes_sm3_index.bin";
+    ASSERT_TRUE(aes_sm3_tag_index_save(idx, path) == 0, "索引保存失败");
+    aes_sm3_tag_index_t* mapped = aes_sm3_tag_index_open(path);
+    ASSERT_TRUE(mapped != NULL, "索引mmap打开失败");
+    for (size_t i = 0; i < n; i += 97) {
+        size_t f1, f2;
+        ASSERT_TRUE(aes_sm3_tag_index_lookup(mapped, tags + i * 32, &f1) ==
+                    aes_sm3_tag_index_lookup(idx, tags + i * 32, &f2) && f1 == f2,
+                    "mmap索引结果不一致");
+    }
+    
+    // 归并连接：后一半条目建第二个索引
+    aes_sm3_tag_index_t* half = aes_sm3_tag_index_build(tags + (n / 2) * 32, locs + n / 2, n / 2);
+    join_stats_t stats = {0, 0};
+    size_t groups = aes_sm3_tag_index_merge_join(idx, half, join_count_cb, &stats);
+    size_t expected_groups = 0, expected_pairs = 0;
+    for (size_t i = n / 2; i < n; i++) {
+        if (i % 10 == 9) {
+            continue;                       // 与前一条目同一标签
+        }
+        expected_groups++;
+        expected_pairs += (i % 10 == 8) ? 4 : 1;
+    }
+    ASSERT_TRUE(groups == expected_groups && stats.groups == groups, "归并连接共同标签数错误");
+    ASSERT_TRUE(stats.pairs == expected_pairs, "归并连接条目对数错误");
+    printf("  共同标签: %zu, 条目对: %zu\n", groups, stats.pairs);
+    
+    aes_sm3_tag_index_free(half);
+    aes_sm3_tag_index_free(mapped);
+    aes_sm3_tag_index_free(idx);
+    
+    // 头中层偏移被篡改：打开时拒绝
+    uint64_t bad_offset = UINT64_MAX / 8;
+    FILE* fp_index = fopen(path, "r+b");
+    fseek(fp_index, 40, SEEK_SET);
+    fwrite(&bad_offset, sizeof(bad_offset), 1, fp_index);
+    fclose(fp_index);
+    ASSERT_TRUE(aes_sm3_tag_index_open(path) == NULL, "损坏的索引头应被拒绝");
+    unlink(path);
+    free(tags);
+    free(locs);
+    free(ptrs);
+    free(firsts);
+    free(counts);
+    
+    TEST_END();
+}
+
+// 辅助函数：写文件
+static int write_file(const char* path, const uint8_t* data, size_t size) {
+    FILE* fp = fopen(path, "wb");
+    if (!fp) return -1;
+    size_t n = fwrite(data, 1, size, fp);
+    fclose(fp);
+    return n == size ? 0 : -1;
+}
+
+// 辅助函数：读文件（返回malloc缓冲区）
+static uint8_t* read_file(const char* path, size_t* size) {
+    FILE* fp = fopen(path, "rb");
+    if (!fp) return NULL;
+    fseek(fp, 0, SEEK_END);
+    *size = (size_t)ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    uint8_t* data = malloc(*size + 1);
+    if (fread(data, 1, *size, fp) != *size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(fp);
+    return data;
+}
+
+// 测试23：清单差异与增量同步 - diff/delta/patch往返
+void test_manifest_delta() {
+    TEST_START("清单差异与增量同步 - diff/delta/patch");
+    
+    const size_t src_size = 40 * 4096 + 1000;      // 末页不足4KB
+    const size_t dst_size = 48 * 4096;             // 目标更长，需要截断
+    uint8_t* src = malloc(src_size);
+    uint8_t* dst = malloc(dst_size);
+    uint64_t x = 0x853c49e6748fea9bULL;
+    for (size_t i = 0; i < dst_size; i++) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        dst[i] = (uint8_t)x;
+    }
+    memcpy(src, dst, src_size);
+    src[3 * 4096 + 17] ^= 1;                       // 第3页
+    memset(src + 10 * 4096, 0xAB, 3 * 4096);       // 第10..12页
+    src[src_size - 1] ^= 0xFF;                     // 末页（第40页）
+    
+    const char* src_path = "/tmp/test_aes_sm3_src.img";
+    const char* dst_path = "/tmp/test_aes_sm3_dst.img";
+    const char* man_path = "/tmp/test_aes_sm3_src.sm3m";
+    const char* delta_path = "/tmp/test_aes_sm3.delta";
+    ASSERT_TRUE(write_file(src_path, src, src_size) == 0, "写源文件失败");
+    ASSERT_TRUE(write_file(dst_path, dst, dst_size) == 0, "写目标文件失败");
+    
+    aes_sm3_manifest_t* ms = aes_sm3_manifest_build_file(NULL, src_path);
+    aes_sm3_manifest_t* md = aes_sm3_manifest_build_file(NULL, dst_path);
+    ASSERT_TRUE(ms && md, "清单生成失败");
+    ASSERT_TRUE(aes_sm3_manifest_page_count(ms) == 41, "源清单页数错误");
+    
+    // 文件清单与内存清单一致，保存后mmap打开一致
+    aes_sm3_manifest_t* mem = aes_sm3_manifest_build(NULL, src, src_size);
+    ASSERT_TRUE(compare_hash(aes_sm3_manifest_tag(mem, 40), aes_sm3_manifest_tag(ms, 40), 32),
+                "文件清单与内存清单不一致");
+    aes_sm3_manifest_free(mem);
+    ASSERT_TRUE(aes_sm3_manifest_save(ms, man_path) == 0, "清单保存失败");
+    aes_sm3_manifest_t* mo = aes_sm3_manifest_open(man_path);
+    ASSERT_TRUE(mo != NULL, "清单mmap打开失败");
+    ASSERT_TRUE(compare_hash(aes_sm3_manifest_tag(mo, 3), aes_sm3_manifest_tag(ms, 3), 32),
+                "mmap清单内容不一致");
+    
+    aes_sm3_page_range_t ranges[8];
+    int64_t count = aes_sm3_manifest_diff(mo, md, ranges, 8);
+    ASSERT_TRUE(count == 3, "差异区间数错误");
+    ASSERT_TRUE(ranges[0].first_page == 3 && ranges[0].page_count == 1, "区间0错误");
+    ASSERT_TRUE(ranges[1].first_page == 10 && ranges[1].page_count == 3, "区间1错误");
+    ASSERT_TRUE(ranges[2].first_page == 40 && ranges[2].page_count == 1, "区间2错误");
+    
+    // 增量只包含5个差异页，应用后目标与源完全一致
+    int64_t pages = aes_sm3_delta_emit(src_path, mo, md, delta_path);
+    ASSERT_TRUE(pages == 5, "增量页数错误");
+    ASSERT_TRUE(aes_sm3_delta_apply(delta_path, dst_path) == 5, "增量应用失败");
+    size_t patched_size = 0;
+    uint8_t* patched = read_file(dst_path, &patched_size);
+    ASSERT_TRUE(patched && patched_size == src_size && memcmp(patched, src, src_size) == 0,
+                "应用增量后目标与源不一致");
+    free(patched);
+    
+    // 同步后两侧无差异
+    aes_sm3_manifest_t* md2 = aes_sm3_manifest_build_file(NULL, dst_path);
+    ASSERT_TRUE(aes_sm3_manifest_diff(mo, md2, NULL, 0) == 0, "同步后仍有差异");
+    aes_sm3_manifest_free(md2);
+    
+    // 不同域的清单拒绝比较
+    uint32_t mid[8];
+    aes_sm3_domain_init(mid, 1, 2, "sync");
+    aes_sm3_manifest_t* other = aes_sm3_manifest_build(mid, src, src_size);
+    ASSERT_TRUE(aes_sm3_manifest_diff(other, md, NULL, 0) == -1, "不同域清单应拒绝比较");
+    aes_sm3_manifest_free(other);
+    
+    // 损坏的增量不会被应用：最后一个区间损坏时前面的区间也不写入，目标保持原样
+    ASSERT_TRUE(write_file(dst_path, dst, dst_size) == 0, "写目标文件失败");
+    FILE* fp = fopen(delta_path, "r+b");
+    fseek(fp, -100, SEEK_END);
+    fputc(0x5A, fp);
+    fclose(fp);
+    ASSERT_TRUE(aes_sm3_delta_apply(delta_path, dst_path) == -1, "损坏的增量应被拒绝");
+    patched = read_file(dst_path, &patched_size);
+    ASSERT_TRUE(patched && patched_size == dst_size && memcmp(patched, dst, dst_size) == 0,
+                "校验失败时目标不应被部分修改");
+    free(patched);
+    
+    // 源文件比清单短：读不满的页不补零输出
+    truncate(src_path, 20 * 4096);
+    ASSERT_TRUE(aes_sm3_delta_emit(src_path, mo, md, delta_path) == -1, "源文件变短时生成增量应失败");
+    
+    aes_sm3_manifest_free(ms);
+    aes_sm3_manifest_free(md);
+    aes_sm3_manifest_free(mo);
+    unlink(src_path);
+    unlink(dst_path);
+    unlink(man_path);
+    unlink(delta_path);
+    free(src);
+    free(dst);
+    
+    TEST_END();
+}
+
+// 测试24：清单比较引擎 - 跳过相同区域、多文件并行
+void test_manifest_compare() {
+    TEST_START("清单比较引擎 - 多文件并行比较");
+    
+    const int files = 6;
+    const size_t size = 300 * 4096;
+    uint8_t* base = malloc(size);
+    uint8_t* changed = malloc(size + 2 * 4096);
+    char old_paths[6][64], new_paths[6][64];
+    aes_sm3_compare_job_t jobs[6];
+    uint64_t x = 0xda942042e4dd58b5ULL;
+    for (size_t i = 0; i < size; i++) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        base[i] = (uint8_t)x;
+    }
+    
+    for (int f = 0; f < files; f++) {
+        size_t new_size = size + (f == 5 ? 2 * 4096 : 0);     // 最后一个文件变长
+        memcpy(changed, base, size);
+        memset(changed + size, 0x11, new_size - size);
+        changed[(size_t)f * 4096 + 7] ^= 1;                   // 第f页
+        if (f % 2 == 0) {
+            changed[(size_t)(100 + f) * 4096] ^= 1;           // 第100+f页
+        }
+        for (size_t p = 200; p < 209 && f == 3; p++) {
+            changed[p * 4096 + 4095] ^= 1;                    // 第200..208页
+        }
+        
+        aes_sm3_manifest_t* mo = aes_sm3_manifest_build(NULL, base, size);
+        aes_sm3_manifest_t* mn = aes_sm3_manifest_build(NULL, changed, new_size);
+        snprintf(old_paths[f], sizeof(old_paths[f]), "/tmp/test_aes_sm3_cmp_old%d.sm3m", f);
+        snprintf(new_paths[f], sizeof(new_paths[f]), "/tmp/test_aes_sm3_cmp_new%d.sm3m", f);
+        ASSERT_TRUE(aes_sm3_manifest_save(mo, old_paths[f]) == 0 &&
+                    aes_sm3_manifest_save(mn, new_paths[f]) == 0, "清单保存失败");
+        aes_sm3_manifest_free(mo);
+        aes_sm3_manifest_free(mn);
+        
+        jobs[f].old_path = old_paths[f];
+        jobs[f].new_path = new_paths[f];
+    }
+    
+    ASSERT_TRUE(aes_sm3_manifest_compare_parallel(jobs, files, 4) == 0, "并行比较失败");
+    for (int f = 0; f < files; f++) {
+        uint64_t expected = 1 + (f % 2 == 0) + (f == 3 ? 9 : 0) + (f == 5 ? 2 : 0);
+        ASSERT_TRUE(jobs[f].changed_pages == expected, "变化页数错误");
+        ASSERT_TRUE(jobs[f].ranges[0].first_page == (uint64_t)f, "首个变化区间错误");
+    }
+    ASSERT_TRUE(jobs[3].range_count == 2 && jobs[3].ranges[1].first_page == 200 &&
+                jobs[3].ranges[1].page_count == 9, "连续变化区间错误");
+    ASSERT_TRUE(jobs[5].range_count == 2 && jobs[5].ranges[1].first_page == 300 &&
+                jobs[5].ranges[1].page_count == 2, "尾部新增页区间错误");
+    
+    for (int f = 0; f < files; f++) {
+        free(jobs[f].ranges);
+        unlink(old_paths[f]);
+        unlink(new_paths[f]);
+    }
+    
+    // 文件被截短：旧清单多出的页作为变化区间报告
+    aes_sm3_manifest_t* mo = aes_sm3_manifest_build(NULL, base, size);
+    aes_sm3_manifest_t* mn = aes_sm3_manifest_build(NULL, base, 290 * 4096);
+    aes_sm3_manifest_save(mo, old_paths[0]);
+    aes_sm3_manifest_save(mn, new_paths[0]);
+    aes_sm3_manifest_free(mo);
+    aes_sm3_manifest_free(mn);
+    aes_sm3_compare_job_t shrunk = {old_paths[0], new_paths[0], NULL, 0, 0};
+    ASSERT_TRUE(aes_sm3_manifest_compare_parallel(&shrunk, 1, 1) == 0 && shrunk.range_count == 1 &&
+                shrunk.ranges[0].first_page == 290 && shrunk.changed_pages == 10, "截短的文件应报告被截掉的页");
+    free(shrunk.ranges);
+    unlink(old_paths[0]);
+    unlink(new_paths[0]);
+    
+    // 不存在的清单计为失败
+    aes_sm3_compare_job_t missing = {"/tmp/test_aes_sm3_none.sm3m", "/tmp/test_aes_sm3_none.sm3m", NULL, 0, 0};
+    ASSERT_TRUE(aes_sm3_manifest_compare_parallel(&missing, 1, 1) == 1 && missing.range_count == -1,
+                "不存在的清单应计为失败");
+    
+    free(base);
+    free(changed);
+    
+    TEST_END();
+}
+
+// 辅助函数：追加写文件
+static void append_bytes(const char* path, const uint8_t* data, size_t size) {
+    FILE* fp = fopen(path, "ab");
+    if (fp) {
+        fwrite(data, 1, size, fp);
+        fclose(fp);
+    }
+}
+
+// 测试25：追加跟踪模式 - 只标记新完成的块
+void test_tail_mode() {
+    TEST_START("追加跟踪模式 - 高水位与只追加清单");
+    
+    const char* log_path = "/tmp/test_aes_sm3_wal.log";
+    const char* man_path = "/tmp/test_aes_sm3_wal.sm3m";
+    unlink(log_path);
+    unlink(man_path);
+    
+    uint8_t* data = malloc(20 * 4096);
+    uint64_t x = 0x9e3779b97f4a7c15ULL;
+    for (size_t i = 0; i < 20 * 4096; i++) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        data[i] = (uint8_t)x;
+    }
+    append_bytes(log_path, data, 3 * 4096 + 100);           // 3个完整块 + 部分尾块
+    
+    for (int use_inotify = 1; use_inotify >= 0; use_inotify--) {
+        unlink(man_path);
+        truncate(log_path, 3 * 4096 + 100);
+        
+        aes_sm3_tail_t* t = aes_sm3_tail_create(NULL, use_inotify);
+        ASSERT_TRUE(t != NULL && aes_sm3_tail_add(t, log_path, man_path) == 0, "跟踪器创建失败");
+        ASSERT_TRUE(aes_sm3_tail_tick(t, 0) == 3, "首轮应标记3个完整块");
+        ASSERT_TRUE(aes_sm3_tail_tick(t, 0) == 0, "无写入时不应标记");
+        
+        append_bytes(log_path, data + 3 * 4096 + 100, 4096 - 100);   // 尾块写满
+        ASSERT_TRUE(aes_sm3_tail_tick(t, 100) == 1, "尾块写满后应被标记");
+        append_bytes(log_path, data + 4 * 4096, 6 * 4096 + 10);
+        ASSERT_TRUE(aes_sm3_tail_tick(t, 100) == 6, "应只标记新完成的6个块");
+        ASSERT_TRUE(aes_sm3_tail_high_water(t, 0) == 10, "高水位错误");
+        aes_sm3_tail_free(t);
+        
+        // 只追加清单与一次性生成的清单一致
+        aes_sm3_manifest_t* tail_m = aes_sm3_manifest_open(man_path);
+        aes_sm3_manifest_t* full_m = aes_sm3_manifest_build(NULL, data, 10 * 4096);
+        ASSERT_TRUE(tail_m != NULL && aes_sm3_manifest_page_count(tail_m) == 10, "跟踪清单页数错误");
+        ASSERT_TRUE(aes_sm3_manifest_diff(full_m, tail_m, NULL, 0) == 0, "跟踪清单与完整清单不一致");
+        aes_sm3_manifest_free(tail_m);
+        aes_sm3_manifest_free(full_m);
+        
+        // 重启后从清单高水位继续
+        t = aes_sm3_tail_create(NULL, use_inotify);
+        aes_sm3_tail_add(t, log_path, man_path);
+        ASSERT_TRUE(aes_sm3_tail_high_water(t, 0) == 10, "重启后高水位应恢复");
+        ASSERT_TRUE(aes_sm3_tail_tick(t, 0) == 0, "重启后不应重复标记");
+        
+        // 截断（日志轮转）后从头开始
+        truncate(log_path, 4096);
+        ASSERT_TRUE(aes_sm3_tail_tick(t, 100) == 1, "截断后应从头标记");
+        
+        // 改名轮转：按路径跟踪新文件，清单从头开始
+        rename(log_path, "/tmp/test_aes_sm3_wal.log.1");
+        append_bytes(log_path, data, 2 * 4096);
+        ASSERT_TRUE(aes_sm3_tail_tick(t, 100) == 2, "轮转后应从头标记新文件");
+        append_bytes(log_path, data + 2 * 4096, 4096);
+        ASSERT_TRUE(aes_sm3_tail_tick(t, 100) == 1, "轮转后新文件的写入应被跟踪");
+        ASSERT_TRUE(aes_sm3_tail_high_water(t, 0) == 3, "轮转后高水位错误");
+        unlink("/tmp/test_aes_sm3_wal.log.1");
+        truncate(log_path, 4096);
+        aes_sm3_tail_free(t);
+        append_bytes(log_path, data + 4096, 10 * 4096 + 10 - 4096);
+    }
+    
+    unlink(log_path);
+    unlink(man_path);
+    free(data);
+    
+    TEST_END();
+}
+
+#if defined(__linux__)
+// 辅助结构：监视回调记录
+typedef struct {
+    pthread_mutex_t lock;
+    int calls;
+    int deletes;
+    uint64_t last_first;
+    uint64_t last_count;
+    int64_t last_ranges;
+} watch_record_t;
+
+static void watch_record_cb(void* ctx, const char* path,
+                            const aes_sm3_page_range_t* ranges, int64_t range_count) {
+    watch_record_t* r = (watch_record_t*)ctx;
+    (void)path;
+    pthread_mutex_lock(&r->lock);
+    r->calls++;
+    r->deletes += range_count < 0;
+    r->last_ranges = range_count;
+    if (range_count > 0) {
+        r->last_first = ranges[0].first_page;
+        r->last_count = ranges[0].page_count;
+    }
+    pthread_mutex_unlock(&r->lock);
+}
+
+// 测试26：目录监视模式 - 去抖合并、脏块区间、新目录与删除
+void test_watch_mode() {
+    TEST_START("目录监视模式 - inotify事件驱动增量重标记");
+    
+    const char* root = "/tmp/test_aes_sm3_watch_data";
+    const char* mroot = "/tmp/test_aes_sm3_watch_man";
+    system("rm -rf /tmp/test_aes_sm3_watch_data /tmp/test_aes_sm3_watch_man");
+    mkdir(root, 0755);
+    mkdir(mroot, 0755);
+    
+    uint8_t* data = malloc(8 * 4096);
+    uint64_t x = 0x1234567887654321ULL;
+    for (size_t i = 0; i < 8 * 4096; i++) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        data[i] = (uint8_t)x;
+    }
+    write_file("/tmp/test_aes_sm3_watch_data/a.bin", data, 8 * 4096);
+    
+    watch_record_t rec;
+    memset(&rec, 0, sizeof(rec));
+    pthread_mutex_init(&rec.lock, NULL);
+    
+    aes_sm3_watch_t* w = aes_sm3_watch_create(root, mroot, 30, 2, watch_record_cb, &rec);
+    ASSERT_TRUE(w != NULL, "监视器创建失败");
+    ASSERT_TRUE(aes_sm3_watch_drain(w, 2000) == 0, "初始扫描未完成");
+    ASSERT_TRUE(access("/tmp/test_aes_sm3_watch_man/a.bin.sm3m", F_OK) == 0, "初始清单未生成");
+    ASSERT_TRUE(rec.calls == 1 && rec.last_count == 8, "初始扫描应标记全部8页");
+    
+    // 事件风暴：同一页反复改写，去抖后只重标记一次，脏块区间为第5页
+    for (int i = 0; i < 50; i++) {
+        FILE* fp = fopen("/tmp/test_aes_sm3_watch_data/a.bin", "r+b");
+        fseek(fp, 5 * 4096 + i, SEEK_SET);
+        fputc(i + 1, fp);
+        fclose(fp);
+    }
+    aes_sm3_watch_tick(w, 100);
+    ASSERT_TRUE(aes_sm3_watch_drain(w, 2000) == 0, "变更处理未完成");
+    ASSERT_TRUE(rec.calls == 2, "连续事件应合并为一次重标记");
+    ASSERT_TRUE(rec.last_ranges == 1 && rec.last_first == 5 && rec.last_count == 1, "脏块区间错误");
+    
+    // 按页对齐截短：被截掉的页作为区间报告，清单头随之更新
+    truncate("/tmp/test_aes_sm3_watch_data/a.bin", 6 * 4096);
+    aes_sm3_watch_tick(w, 100);
+    ASSERT_TRUE(aes_sm3_watch_drain(w, 2000) == 0, "截短处理未完成");
+    ASSERT_TRUE(rec.last_ranges == 1 && rec.last_first == 6 && rec.last_count == 2, "截短应报告被截掉的页");
+    aes_sm3_manifest_t* am = aes_sm3_manifest_open("/tmp/test_aes_sm3_watch_man/a.bin.sm3m");
+    ASSERT_TRUE(am && aes_sm3_manifest_page_count(am) == 6 &&
+                aes_sm3_manifest_file_size(am) == 6 * 4096, "截短后清单应被重写");
+    aes_sm3_manifest_free(am);
+    
+    // 新建子目录中的文件
+    mkdir("/tmp/test_aes_sm3_watch_data/sub", 0755);
+    aes_sm3_watch_tick(w, 100);
+    write_file("/tmp/test_aes_sm3_watch_data/sub/b.bin", data, 2 * 4096);
+    aes_sm3_watch_tick(w, 100);
+    ASSERT_TRUE(aes_sm3_watch_drain(w, 2000) == 0, "新目录处理未完成");
+    ASSERT_TRUE(access("/tmp/test_aes_sm3_watch_man/sub/b.bin.sm3m", F_OK) == 0, "新目录文件清单未生成");
+    
+    // 删除文件后清单也被删除
+    unlink("/tmp/test_aes_sm3_watch_data/a.bin");
+    aes_sm3_watch_tick(w, 100);
+    ASSERT_TRUE(aes_sm3_watch_drain(w, 2000) == 0, "删除处理未完成");
+    ASSERT_TRUE(rec.deletes == 1, "删除应回调一次");
+    ASSERT_TRUE(access("/tmp/test_aes_sm3_watch_man/a.bin.sm3m", F_OK) != 0, "删除后清单应被移除");
+    
+    // 子目录改名：之后的事件按新路径处理，不会误判为删除
+    rename("/tmp/test_aes_sm3_watch_data/sub", "/tmp/test_aes_sm3_watch_data/sub2");
+    aes_sm3_watch_tick(w, 100);
+    ASSERT_TRUE(aes_sm3_watch_drain(w, 2000) == 0, "目录改名处理未完成");
+    write_file("/tmp/test_aes_sm3_watch_data/sub2/b.bin", data, 3 * 4096);
+    aes_sm3_watch_tick(w, 100);
+    ASSERT_TRUE(aes_sm3_watch_drain(w, 2000) == 0, "改名后的变更处理未完成");
+    ASSERT_TRUE(rec.deletes == 1, "改名后的写入不应回调删除");
+    ASSERT_TRUE(access("/tmp/test_aes_sm3_watch_man/sub2/b.bin.sm3m", F_OK) == 0, "改名后的文件清单未生成");
+    ASSERT_TRUE(access("/tmp/test_aes_sm3_watch_man/sub/b.bin.sm3m", F_OK) != 0, "改名前路径的清单应随目录移走");
+    
+    // 目录移出监视树：其下的清单按文件删除处理
+    system("rm -rf /tmp/test_aes_sm3_watch_out");
+    rename("/tmp/test_aes_sm3_watch_data/sub2", "/tmp/test_aes_sm3_watch_out");
+    aes_sm3_watch_tick(w, 100);
+    ASSERT_TRUE(aes_sm3_watch_drain(w, 2000) == 0, "目录移出处理未完成");
+    ASSERT_TRUE(rec.deletes == 2, "移出的文件应回调删除");
+    ASSERT_TRUE(access("/tmp/test_aes_sm3_watch_man/sub2/b.bin.sm3m", F_OK) != 0, "移出目录的清单应被删除");
+    system("rm -rf /tmp/test_aes_sm3_watch_out");
+    
+    // 文件数超过待处理表容量：溢出后全量扫描直接提交，完成后不再反复扫描
+    mkdir("/tmp/test_aes_sm3_watch_data/many", 0755);
+    aes_sm3_watch_tick(w, 100);
+    char name[128];
+    for (int i = 0; i < 5000; i++) {
+        snprintf(name, sizeof(name), "/tmp/test_aes_sm3_watch_data/many/f%d", i);
+        write_file(name, data, 16);
+    }
+    aes_sm3_watch_tick(w, 100);
+    ASSERT_TRUE(aes_sm3_watch_drain(w, 30000) == 0, "溢出后的全量扫描未完成");
+    ASSERT_TRUE(access("/tmp/test_aes_sm3_watch_man/many/f0.sm3m", F_OK) == 0 &&
+                access("/tmp/test_aes_sm3_watch_man/many/f4999.sm3m", F_OK) == 0, "溢出后的文件清单未生成");
+    uint64_t files, pages, files_after;
+    aes_sm3_watch_stats(w, &files, &pages);
+    aes_sm3_watch_tick(w, 100);
+    aes_sm3_watch_tick(w, 100);
+    ASSERT_TRUE(aes_sm3_watch_drain(w, 2000) == 0, "全量扫描后应恢复空闲");
+    aes_sm3_watch_stats(w, &files_after, &pages);
+    ASSERT_TRUE(files_after == files, "全量扫描完成后不应再次扫描");
+    
+    aes_sm3_watch_stats(w, &files, &pages);
+    printf("  重标记文件: %llu, 变化页: %llu\n", (unsigned long long)files, (unsigned long long)pages);
+    
+    aes_sm3_watch_free(w);
+    pthread_mutex_destroy(&rec.lock);
+    system("rm -rf /tmp/test_aes_sm3_watch_data /tmp/test_aes_sm3_watch_man");
+    free(data);
+    
+    TEST_END();
+}
+#endif
+
+#if defined(__linux__)
+// 测试27：内存区域脏页跟踪 - 只重标记被写过的页
+void test_region_tracker() {
+    TEST_START("区域脏页跟踪 - 增量重标记");
+    
+    const size_t pages = 64;
+    uint8_t* arena = (uint8_t*)mmap(NULL, pages * 4096, PROT_READ | PROT_WRITE,
+                                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ASSERT_TRUE(arena != MAP_FAILED, "区域分配失败");
+    for (size_t i = 0; i < pages * 4096; i++) {
+        arena[i] = (uint8_t)(i * 31 + (i >> 12));
+    }
+    uint8_t* tags = malloc(pages * 32);
+    uint8_t expect[32];
+    
+    aes_sm3_region_t* r = aes_sm3_region_track(arena, pages * 4096, NULL, tags, AES_SM3_TRACK_AUTO);
+    ASSERT_TRUE(r != NULL, "跟踪器创建失败");
+    int backend = aes_sm3_region_backend(r);
+    printf("  后端: %s\n", backend == AES_SM3_TRACK_UFFD_WP ? "userfaultfd写保护" :
+                           backend == AES_SM3_TRACK_SOFT_DIRTY ? "软脏位" : "全量");
+    aes_sm3_integrity_256bit_domain(NULL, 17, arena + 17 * 4096, expect);
+    ASSERT_TRUE(memcmp(tags + 17 * 32, expect, 32) == 0, "初始全量标签错误");
+    
+    // 写两页后刷新：增量后端只重标记这两页
+    arena[3 * 4096 + 100] ^= 0xFF;
+    arena[40 * 4096] ^= 0x01;
+    int64_t n = aes_sm3_region_refresh(r);
+    ASSERT_TRUE(n == (backend == AES_SM3_TRACK_FULL ? (int64_t)pages : 2), "重标记页数错误");
+    aes_sm3_integrity_256bit_domain(NULL, 3, arena + 3 * 4096, expect);
+    ASSERT_TRUE(memcmp(tags + 3 * 32, expect, 32) == 0, "第3页标签未更新");
+    aes_sm3_integrity_256bit_domain(NULL, 40, arena + 40 * 4096, expect);
+    ASSERT_TRUE(memcmp(tags + 40 * 32, expect, 32) == 0, "第40页标签未更新");
+    
+    // 无写入时增量后端不重标记
+    n = aes_sm3_region_refresh(r);
+    ASSERT_TRUE(n == (backend == AES_SM3_TRACK_FULL ? (int64_t)pages : 0), "无写入时不应重标记");
+    
+    // 刷新之后的写入在下一轮被发现
+    memset(arena + 63 * 4096, 0x5A, 4096);
+    n = aes_sm3_region_refresh(r);
+    aes_sm3_integrity_256bit_domain(NULL, 63, arena + 63 * 4096, expect);
+    ASSERT_TRUE(n >= 1 && memcmp(tags + 63 * 32, expect, 32) == 0, "末页写入未被发现");
+    aes_sm3_region_untrack(r);
+    
+    // 非对齐区域被拒绝
+    ASSERT_TRUE(aes_sm3_region_track(arena + 1, 4096, NULL, tags, AES_SM3_TRACK_AUTO) == NULL,
+                "非对齐区域应被拒绝");
+    
+    munmap(arena, pages * 4096);
+    free(tags);
+    
+    TEST_END();
+}
+#endif
+
+typedef struct {
+    aes_sm3_memo_t* memo;
+    const uint8_t* pages;
+    const uint8_t* expect;     // 每页正确标签
+    int seed;
+    int bad;
+    int hits;
+} memo_worker_t;
+
+static void* memo_worker(void* arg) {
+    memo_worker_t* w = (memo_worker_t*)arg;
+    uint32_t x = (uint32_t)w->seed * 2654435761u + 1;
+    uint8_t tag[32];
+    for (int i = 0; i < 20000; i++) {
+        x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+        int p = (int)(x % 256);
+        const uint8_t* page = w->pages + (size_t)p * 4096;
+        if (aes_sm3_memo_lookup(w->memo, page, p, 1, tag)) {
+            w->hits++;
+            w->bad += memcmp(tag, w->expect + p * 32, 32) != 0;
+        } else {
+            aes_sm3_memo_insert(w->memo, page, p, 1, w->expect + p * 32);
+        }
+    }
+    return NULL;
+}
+
+// 测试28：标签记忆缓存 - 代号校验、批量路径与并发一致性
+void test_memo_cache() {
+    TEST_START("标签记忆缓存 - 按代号复用标签");
+    
+    const int pages = 256;
+    uint8_t* data = aligned_alloc(64, (size_t)pages * 4096);
+    uint8_t* expect = malloc((size_t)pages * 32);
+    uint8_t* out = malloc((size_t)pages * 32);
+    const uint8_t* inputs[256];
+    uint8_t* outputs[256];
+    uint64_t lbas[256], gens[256];
+    for (size_t i = 0; i < (size_t)pages * 4096; i++) {
+        data[i] = (uint8_t)(i * 7 + (i >> 12) * 13);
+    }
+    for (int i = 0; i < pages; i++) {
+        inputs[i] = data + (size_t)i * 4096;
+        outputs[i] = out + i * 32;
+        lbas[i] = i;
+        gens[i] = 1;
+        aes_sm3_integrity_256bit_domain(NULL, i, inputs[i], expect + i * 32);
+    }
+    
+    aes_sm3_memo_t* m = aes_sm3_memo_create(NULL, 4096);
+    ASSERT_TRUE(m != NULL, "缓存创建失败");
+    
+    // 首轮全部未命中，第二轮几乎全部命中（探测窗口满时允许个别替换），结果与直接计算一致
+    ASSERT_TRUE(aes_sm3_integrity_batch_memo(m, lbas, gens, inputs, outputs, pages) == 0, "首轮不应命中");
+    ASSERT_TRUE(memcmp(out, expect, (size_t)pages * 32) == 0, "首轮标签错误");
+    memset(out, 0, (size_t)pages * 32);
+    int hit = aes_sm3_integrity_batch_memo(m, lbas, gens, inputs, outputs, pages);
+    printf("  次轮命中: %d/%d\n", hit, pages);
+    ASSERT_TRUE(hit >= pages * 15 / 16, "次轮应基本命中");
+    ASSERT_TRUE(memcmp(out, expect, (size_t)pages * 32) == 0, "命中标签错误");
+    
+    // 修改一页并递增代号：该页重新计算
+    data[9 * 4096] ^= 0xFF;
+    gens[9] = 2;
+    aes_sm3_integrity_256bit_domain(NULL, 9, inputs[9], expect + 9 * 32);
+    aes_sm3_integrity_batch_memo(m, lbas, gens, inputs, outputs, pages);
+    ASSERT_TRUE(memcmp(out + 9 * 32, expect + 9 * 32, 32) == 0, "代号变化后标签未更新");
+    
+    // 同一地址、不同LBA不混淆
+    uint8_t tag[32];
+    ASSERT_TRUE(!aes_sm3_memo_lookup(m, inputs[3], 999, 1, tag), "不同LBA不应命中");
+    aes_sm3_memo_free(m);
+    
+    // 并发：小缓存上4线程竞争插入/查找，命中的标签必须正确
+    data[9 * 4096] ^= 0xFF;
+    aes_sm3_integrity_256bit_domain(NULL, 9, inputs[9], expect + 9 * 32);
+    m = aes_sm3_memo_create(NULL, 64);
+    memo_worker_t workers[4];
+    pthread_t threads[4];
+    for (int t = 0; t < 4; t++) {
+        workers[t] = (memo_worker_t){m, data, expect, t, 0, 0};
+        pthread_create(&threads[t], NULL, memo_worker, &workers[t]);
+    }
+    int bad = 0, hits = 0;
+    for (int t = 0; t < 4; t++) {
+        pthread_join(threads[t], NULL);
+        bad += workers[t].bad;
+        hits += workers[t].hits;
+    }
+    printf("  并发命中: %d/80000, 错误: %d\n", hits, bad);
+    ASSERT_TRUE(bad == 0, "并发读到不一致的条目");
+    aes_sm3_memo_free(m);
+    
+    free(data);
+    free(expect);
+    free(out);
+    
+    TEST_END();
+}
+
+// 测试29：跨进程共享标签缓存 - 复用、失效、损坏槽与域校验
+void test_shared_cache() {
+    TEST_START("共享标签缓存 - mmap文件跨进程复用");
+    
+    const char* cache_path = "/tmp/test_aes_sm3_shcache.bin";
+    const char* data_path = "/tmp/test_aes_sm3_shcache_data.bin";
+    const size_t size = 100 * 4096 + 123;   // 101块，尾块不满
+    unlink(cache_path);
+    
+    uint8_t* data = malloc(size);
+    uint64_t x = 0xDEADBEEF12345678ULL;
+    for (size_t i = 0; i < size; i++) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        data[i] = (uint8_t)x;
+    }
+    write_file(data_path, data, size);
+    
+    aes_sm3_manifest_t* m = aes_sm3_manifest_build(NULL, data, size);
+    uint8_t* tags = malloc(101 * 32);
+    uint64_t hits = 0;
+    
+    // 第一个"进程"：全部未命中，结果与清单一致
+    aes_sm3_shcache_t* a = aes_sm3_shared_cache_open(cache_path, NULL, 4096);
+    ASSERT_TRUE(a != NULL, "共享缓存创建失败");
+    ASSERT_TRUE(aes_sm3_shared_cache_tag_file(a, data_path, tags, &hits) == 101, "块数错误");
+    ASSERT_TRUE(hits == 0, "首次标记不应命中");
+    ASSERT_TRUE(memcmp(tags, aes_sm3_manifest_tag(m, 0), 101 * 32) == 0, "标签与清单不一致");
+    
+    // 第二个"进程"（独立映射）：全部命中
+    aes_sm3_shcache_t* b = aes_sm3_shared_cache_open(cache_path, NULL, 0);
+    ASSERT_TRUE(b != NULL, "共享缓存打开失败");
+    memset(tags, 0, 101 * 32);
+    aes_sm3_shared_cache_tag_file(b, data_path, tags, &hits);
+    ASSERT_TRUE(hits == 101, "第二个进程应全部命中");
+    ASSERT_TRUE(memcmp(tags, aes_sm3_manifest_tag(m, 0), 101 * 32) == 0, "命中标签与清单不一致");
+    
+    // 文件改写后（修改时间/长度变化）旧条目不再命中
+    usleep(10000);
+    data[50 * 4096] ^= 1;
+    write_file(data_path, data, size);
+    aes_sm3_manifest_free(m);
+    m = aes_sm3_manifest_build(NULL, data, size);
+    aes_sm3_shared_cache_tag_file(b, data_path, tags, &hits);
+    ASSERT_TRUE(hits == 0, "修改后的文件不应命中旧条目");
+    ASSERT_TRUE(memcmp(tags, aes_sm3_manifest_tag(m, 0), 101 * 32) == 0, "修改后标签错误");
+    aes_sm3_shared_cache_close(a);
+    aes_sm3_shared_cache_close(b);
+    
+    // 模拟写者崩溃：破坏每个槽的标签字节，校验和使其全部失效
+    FILE* fp = fopen(cache_path, "r+b");
+    for (long off = 4096 + 64; off < 4096 + 4096L * 128; off += 128) {
+        fseek(fp, off, SEEK_SET);
+        int c = fgetc(fp);
+        fseek(fp, off, SEEK_SET);
+        fputc(c ^ 0x5A, fp);
+    }
+    fclose(fp);
+    a = aes_sm3_shared_cache_open(cache_path, NULL, 0);
+    aes_sm3_shared_cache_tag_file(a, data_path, tags, &hits);
+    ASSERT_TRUE(hits == 0, "损坏槽不应命中");
+    ASSERT_TRUE(memcmp(tags, aes_sm3_manifest_tag(m, 0), 101 * 32) == 0, "损坏后标签错误");
+    aes_sm3_shared_cache_tag_file(a, data_path, tags, &hits);
+    ASSERT_TRUE(hits == 101, "重新发布后应命中");
+    aes_sm3_shared_cache_close(a);
+    
+    // 隔组破坏：命中与未命中交错，只读取未命中的连续区间，标签仍与清单一致
+    fp = fopen(cache_path, "r+b");
+    for (long off = 4096 + 64; off < 4096 + 4096L * 128; off += 128) {
+        if (((off - 4096) / (128 * 8)) % 2 == 0) {
+            fseek(fp, off, SEEK_SET);
+            int c = fgetc(fp);
+            fseek(fp, off, SEEK_SET);
+            fputc(c ^ 0x5A, fp);
+        }
+    }
+    fclose(fp);
+    a = aes_sm3_shared_cache_open(cache_path, NULL, 0);
+    memset(tags, 0, 101 * 32);
+    aes_sm3_shared_cache_tag_file(a, data_path, tags, &hits);
+    ASSERT_TRUE(hits > 0 && hits < 101, "隔组破坏后应部分命中");
+    ASSERT_TRUE(memcmp(tags, aes_sm3_manifest_tag(m, 0), 101 * 32) == 0, "部分命中时标签错误");
+    aes_sm3_shared_cache_close(a);
+    
+    // 域不同的进程不能打开
+    uint32_t mid[8];
+    aes_sm3_domain_init(mid, 1, 2, "cache");
+    ASSERT_TRUE(aes_sm3_shared_cache_open(cache_path, mid, 0) == NULL, "域不同应拒绝打开");
+    
+    aes_sm3_manifest_free(m);
+    unlink(cache_path);
+    unlink(data_path);
+    free(data);
+    free(tags);
+    
+    TEST_END();
+}
+
+#if defined(__linux__)
+static int manifest_matches(const char* man_path, const uint8_t* data, size_t size) {
+    aes_sm3_manifest_t* got = aes_sm3_manifest_open(man_path);
+    aes_sm3_manifest_t* want = aes_sm3_manifest_build(NULL, data, size);
+    int ok = got && want && aes_sm3_manifest_page_count(got) == aes_sm3_manifest_page_count(want) &&
+             aes_sm3_manifest_file_size(got) == size &&
+             memcmp(aes_sm3_manifest_tag(got, 0), aes_sm3_manifest_tag(want, 0),
+                    aes_sm3_manifest_page_count(want) * 32) == 0;
+    aes_sm3_manifest_free(got);
+    aes_sm3_manifest_free(want);
+    return ok;
+}
+
+// 测试30：可恢复扫描 - 中断、从检查点继续、尾部校验与不完整日志记录
+void test_resumable_scan() {
+    TEST_START("可恢复扫描 - 检查点日志");
+    
+    system("rm -rf /tmp/test_aes_sm3_scan_data /tmp/test_aes_sm3_scan_man /tmp/test_aes_sm3_scan.journal");
+    mkdir("/tmp/test_aes_sm3_scan_data", 0755);
+    mkdir("/tmp/test_aes_sm3_scan_data/sub", 0755);
+    
+    const size_t a_size = 300 * 4096 + 77;
+    uint8_t* data = malloc(a_size);
+    uint64_t x = 0x0123456789ABCDEFULL;
+    for (size_t i = 0; i < a_size; i++) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        data[i] = (uint8_t)x;
+    }
+    write_file("/tmp/test_aes_sm3_scan_data/a.bin", data, a_size);
+    write_file("/tmp/test_aes_sm3_scan_data/sub/b.bin", data + 4096, 10 * 4096);
+    write_file("/tmp/test_aes_sm3_scan_data/c.bin", data + 8192, 4096);
+    
+    aes_sm3_scan_opts_t opts;
+    aes_sm3_scan_stats_t stats;
+    memset(&opts, 0, sizeof(opts));
+    opts.checkpoint_ms = 0;
+    opts.max_bytes = 100 * 4096;
+    
+    // 第一次运行在a.bin中途被打断（每256KB一个检查点，128页处停止）
+    int ret = aes_sm3_scan_run("/tmp/test_aes_sm3_scan_data", "/tmp/test_aes_sm3_scan_man",
+                               "/tmp/test_aes_sm3_scan.journal", &opts, &stats);
+    ASSERT_TRUE(ret == 1 && stats.files_done == 0, "应在第一个文件中途中断");
+    ASSERT_TRUE(access("/tmp/test_aes_sm3_scan_man/a.bin.sm3m.part", F_OK) == 0, "部分清单未生成");
+    
+    // 模拟断电：日志末尾留下半条记录
+    FILE* fp = fopen("/tmp/test_aes_sm3_scan.journal", "ab");
+    fputs("C 99", fp);
+    fclose(fp);
+    
+    // 第二次运行从检查点继续，不重复标记已完成部分
+    opts.max_bytes = 0;
+    ret = aes_sm3_scan_run("/tmp/test_aes_sm3_scan_data", "/tmp/test_aes_sm3_scan_man",
+                           "/tmp/test_aes_sm3_scan.journal", &opts, &stats);
+    printf("  恢复偏移: %llu, 本次标记: %llu字节\n", (unsigned long long)stats.resumed_offset,
+           (unsigned long long)stats.bytes_hashed);
+    ASSERT_TRUE(ret == 0 && stats.files_done == 3, "恢复后应完成全部文件");
+    ASSERT_TRUE(stats.resumed_offset == 128 * 4096, "应从检查点偏移继续");
+    ASSERT_TRUE(stats.bytes_hashed == a_size - 128 * 4096 + 11 * 4096, "已完成部分不应重复标记");
+    ASSERT_TRUE(manifest_matches("/tmp/test_aes_sm3_scan_man/a.bin.sm3m", data, a_size), "a.bin清单错误");
+    ASSERT_TRUE(manifest_matches("/tmp/test_aes_sm3_scan_man/sub/b.bin.sm3m", data + 4096, 10 * 4096),
+                "sub/b.bin清单错误");
+    ASSERT_TRUE(access("/tmp/test_aes_sm3_scan_man/a.bin.sm3m.part", F_OK) != 0, "部分清单应已重命名");
+    
+    // 第三次运行全部跳过
+    ret = aes_sm3_scan_run("/tmp/test_aes_sm3_scan_data", "/tmp/test_aes_sm3_scan_man",
+                           "/tmp/test_aes_sm3_scan.journal", &opts, &stats);
+    ASSERT_TRUE(ret == 0 && stats.files_skipped == 3 && stats.bytes_hashed == 0, "已完成的文件应跳过");
+    
+    // 部分清单尾部损坏：尾部校验失败，该文件从头开始
+    unlink("/tmp/test_aes_sm3_scan.journal");
+    opts.max_bytes = 100 * 4096;
+    aes_sm3_scan_run("/tmp/test_aes_sm3_scan_data", "/tmp/test_aes_sm3_scan_man",
+                     "/tmp/test_aes_sm3_scan.journal", &opts, &stats);
+    fp = fopen("/tmp/test_aes_sm3_scan_man/a.bin.sm3m.part", "r+b");
+    fseek(fp, 128 + 127 * 32, SEEK_SET);
+    fputc(0xEE, fp);
+    fclose(fp);
+    opts.max_bytes = 0;
+    ret = aes_sm3_scan_run("/tmp/test_aes_sm3_scan_data", "/tmp/test_aes_sm3_scan_man",
+                           "/tmp/test_aes_sm3_scan.journal", &opts, &stats);
+    ASSERT_TRUE(ret == 0 && stats.resumed_offset == 0, "尾部损坏时应从头开始");
+    ASSERT_TRUE(manifest_matches("/tmp/test_aes_sm3_scan_man/a.bin.sm3m", data, a_size), "重扫后清单错误");
+    
+    // 名称含换行符的文件不写入日志，不会破坏按行记录的日志
+    write_file("/tmp/test_aes_sm3_scan_data/x\ny.bin", data, 4096);
+    unlink("/tmp/test_aes_sm3_scan.journal");
+    ret = aes_sm3_scan_run("/tmp/test_aes_sm3_scan_data", "/tmp/test_aes_sm3_scan_man",
+                           "/tmp/test_aes_sm3_scan.journal", &opts, &stats);
+    ASSERT_TRUE(ret == 0 && stats.files_done == 3 && stats.files_failed == 1, "含换行符的名称应计为失败");
+    ret = aes_sm3_scan_run("/tmp/test_aes_sm3_scan_data", "/tmp/test_aes_sm3_scan_man",
+                           "/tmp/test_aes_sm3_scan.journal", &opts, &stats);
+    ASSERT_TRUE(ret == 0 && stats.files_skipped == 3 && stats.files_done == 0, "日志应保持完整");
+    
+    system("rm -rf /tmp/test_aes_sm3_scan_data /tmp/test_aes_sm3_scan_man /tmp/test_aes_sm3_scan.journal");
+    free(data);
+    
+    TEST_END();
+}
+#endif
+
+static double monotonic_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 测试31：后台限流 - 带宽预算、CPU份额与PSI退避
+void test_throttle() {
+    TEST_START("后台限流 - 令牌桶与压力退避");
+    
+    // 带宽：20MB/s预算下处理8MB至少需要约0.3秒（扣除100毫秒突发额度），结果不变
+    const int blocks = 2048;
+    uint8_t* input = malloc((size_t)blocks * 4096);
+    uint8_t* out_fast = malloc((size_t)blocks * 32);
+    uint8_t* out_slow = malloc((size_t)blocks * 32);
+    for (size_t i = 0; i < (size_t)blocks * 4096; i++) {
+        input[i] = (uint8_t)(i * 13 + (i >> 12));
+    }
+    aes_sm3_parallel(input, out_fast, blocks, 2, 256);
+    
+    aes_sm3_throttle_t* t = aes_sm3_throttle_create(20.0, 1.0, 0);
+    double start = monotonic_sec();
+    aes_sm3_parallel_throttled(input, out_slow, blocks, 2, 256, t);
+    double elapsed = monotonic_sec() - start;
+    printf("  8MB @ 20MB/s: %.3f秒\n", elapsed);
+    ASSERT_TRUE(elapsed >= 0.25, "带宽预算未生效");
+    ASSERT_TRUE(memcmp(out_fast, out_slow, (size_t)blocks * 32) == 0, "限流改变了结果");
+    aes_sm3_throttle_free(t);
+    
+    // CPU份额25%：每消耗10毫秒CPU补偿睡眠约30毫秒
+    t = aes_sm3_throttle_create(0, 0.25, 0);
+    uint8_t tag[32];
+    struct timespec c0, c1;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &c0);
+    start = monotonic_sec();
+    for (int round = 0; round < 4; round++) {
+        aes_sm3_throttle_acquire(t, 0);
+        struct timespec r0, r1;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &r0);
+        do {
+            aes_sm3_integrity_256bit(input, tag);
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &r1);
+        } while ((r1.tv_sec - r0.tv_sec) * 1e3 + (r1.tv_nsec - r0.tv_nsec) / 1e6 < 10.0);
+    }
+    aes_sm3_throttle_acquire(t, 0);
+    elapsed = monotonic_sec() - start;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &c1);
+    double cpu = (c1.tv_sec - c0.tv_sec) + (c1.tv_nsec - c0.tv_nsec) / 1e9;
+    printf("  CPU %.3f秒 / 墙钟 %.3f秒\n", cpu, elapsed);
+    ASSERT_TRUE(elapsed >= cpu * 3.0, "CPU份额未生效");
+    
+    // CPU基准按限流器记录：同一线程首次调用另一个限流器只建立基准，不补偿睡眠
+    aes_sm3_throttle_t* other = aes_sm3_throttle_create(0, 0.25, 0);
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &c0);
+    do {
+        aes_sm3_integrity_256bit(input, tag);
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &c1);
+    } while ((c1.tv_sec - c0.tv_sec) * 1e3 + (c1.tv_nsec - c0.tv_nsec) / 1e6 < 20.0);
+    start = monotonic_sec();
+    aes_sm3_throttle_acquire(other, 0);
+    ASSERT_TRUE(monotonic_sec() - start < 0.03, "首次调用不应按其他限流器的基准睡眠");
+    aes_sm3_throttle_free(other);
+    aes_sm3_throttle_free(t);
+    
+    // 满速期间基准照常更新：退避后的首次调用不补偿满速期间消耗的CPU
+    t = aes_sm3_throttle_create(0, 1.0, 50.0);
+    aes_sm3_throttle_observe(t, 100.0);
+    aes_sm3_throttle_acquire(t, 0);
+    for (int i = 0; i < 8; i++) {
+        aes_sm3_throttle_observe(t, 0.0);
+    }
+    ASSERT_TRUE(aes_sm3_throttle_factor(t) == 1.0, "压力消失后应恢复满速");
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &c0);
+    do {
+        aes_sm3_integrity_256bit(input, tag);
+        aes_sm3_throttle_acquire(t, 0);
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &c1);
+    } while ((c1.tv_sec - c0.tv_sec) * 1e3 + (c1.tv_nsec - c0.tv_nsec) / 1e6 < 50.0);
+    aes_sm3_throttle_observe(t, 100.0);
+    start = monotonic_sec();
+    aes_sm3_throttle_acquire(t, 0);
+    ASSERT_TRUE(monotonic_sec() - start < 0.03, "退避后不应补偿满速期间的CPU时间");
+    aes_sm3_throttle_free(t);
+    
+    // PSI退避：超过阈值减半，低于阈值一半时逐步恢复，介于两者之间保持
+    t = aes_sm3_throttle_create(100.0, 1.0, 10.0);
+    aes_sm3_throttle_observe(t, 50.0);
+    aes_sm3_throttle_observe(t, 50.0);
+    aes_sm3_throttle_observe(t, 50.0);
+    ASSERT_TRUE(aes_sm3_throttle_factor(t) == 0.125, "压力升高时应乘性退避");
+    aes_sm3_throttle_observe(t, 8.0);
+    ASSERT_TRUE(aes_sm3_throttle_factor(t) == 0.125, "阈值附近应保持");
+    aes_sm3_throttle_observe(t, 1.0);
+    ASSERT_TRUE(aes_sm3_throttle_factor(t) == 0.1875, "压力消失时应加性恢复");
+    for (int i = 0; i < 20; i++) {
+        aes_sm3_throttle_observe(t, 90.0);
+    }
+    ASSERT_TRUE(aes_sm3_throttle_factor(t) == 1.0 / 64, "退避系数应有下限");
+    aes_sm3_throttle_free(t);
+    
+    free(input);
+    free(out_fast);
+    free(out_slow);
+    
+    TEST_END();
+}
+
+// 测试32：页缓存中立扫描 - 结果一致、驻留页不增长、原驻留页保留
+void test_cache_neutral_scan() {
+    TEST_START("页缓存中立扫描 - 滑动窗口逐出");
+    
+    const char* path = "/tmp/test_aes_sm3_neutral.bin";
+    const size_t size = 8 * 1024 * 1024 + 100;
+    uint8_t* data = malloc(size);
+    uint64_t x = 0x5555AAAA1234ULL;
+    for (size_t i = 0; i < size; i++) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        data[i] = (uint8_t)x;
+    }
+    write_file(path, data, size);
+    
+    // 写回并逐出，再读入前1MB作为"邻居的热页"
+    int fd = open(path, O_RDONLY);
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);   // 只读入这1MB，不触发内核预读
+    uint8_t* hot = malloc(1024 * 1024);
+    ssize_t got = pread(fd, hot, 1024 * 1024, 0);
+    close(fd);
+    int64_t before = aes_sm3_page_cache_resident(path);
+    
+    aes_sm3_manifest_t* m = aes_sm3_manifest_build_file_neutral(NULL, path, 1024 * 1024);
+    int64_t after = aes_sm3_page_cache_resident(path);
+    printf("  驻留页: 扫描前 %lld, 扫描后 %lld（共%zu页）\n", (long long)before, (long long)after, size / 4096 + 1);
+    ASSERT_TRUE(got == 1024 * 1024 && m != NULL, "中立扫描失败");
+    aes_sm3_manifest_t* want = aes_sm3_manifest_build(NULL, data, size);
+    ASSERT_TRUE(aes_sm3_manifest_page_count(m) == aes_sm3_manifest_page_count(want) &&
+                memcmp(aes_sm3_manifest_tag(m, 0), aes_sm3_manifest_tag(want, 0),
+                       aes_sm3_manifest_page_count(want) * 32) == 0, "中立扫描结果与内存构建不一致");
+    aes_sm3_manifest_free(want);
+    ASSERT_TRUE(after <= before + 16, "扫描后驻留页不应增长");
+    ASSERT_TRUE(after >= 256 || before < 256, "扫描前已驻留的页应保留");
+    
+    aes_sm3_manifest_free(m);
+    unlink(path);
+    free(hot);
+    free(data);
+    
+    TEST_END();
+}
+
+// 测试33：窗口化mmap引擎 - 多窗口/多线程结果与内存构建一致，窗口大小有界
+void test_windowed_mmap() {
+    TEST_START("窗口化mmap引擎 - 滑动窗口并行标记");
+    
+    const char* path = "/tmp/test_aes_sm3_windowed.bin";
+    const size_t size = 9 * 1024 * 1024 + 100;
+    uint8_t* data = malloc(size);
+    uint64_t x = 0x9E3779B97F4A7C15ULL;
+    for (size_t i = 0; i < size; i++) {
+        x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+        data[i] = (uint8_t)x;
+    }
+    write_file(path, data, size);
+    aes_sm3_manifest_t* want = aes_sm3_manifest_build(NULL, data, size);
+    
+    // 4MB预算（单窗口2MB）、3线程：跨多个窗口，线程切分不按块对齐，文件尾不满页
+    aes_sm3_mmap_stats_t stats;
+    aes_sm3_manifest_t* m = aes_sm3_manifest_build_file_windowed(NULL, path, 4 * 1024 * 1024, 3, &stats);
+    printf("  窗口数 %llu, 主缺页 %llu, 停顿 %.2f ms, 最终窗口 %zu KB, 最大窗口 %zu KB\n",
+           (unsigned long long)stats.windows, (unsigned long long)stats.major_faults, stats.stall_ns / 1e6,
+           stats.window_bytes / 1024, stats.max_window_bytes / 1024);
+    ASSERT_TRUE(m != NULL, "窗口化构建失败");
+    ASSERT_TRUE(aes_sm3_manifest_page_count(m) == aes_sm3_manifest_page_count(want) &&
+                memcmp(aes_sm3_manifest_tag(m, 0), aes_sm3_manifest_tag(want, 0),
+                       aes_sm3_manifest_page_count(want) * 32) == 0, "窗口化结果与内存构建不一致");
+    ASSERT_TRUE(stats.windows >= 5, "2MB窗口应分多个窗口处理");
+    ASSERT_TRUE(stats.max_window_bytes * 2 <= 4 * 1024 * 1024, "两个窗口合计不应超过预算");
+    aes_sm3_manifest_free(m);
+    
+    // 窗口（预算的一半）大于文件、单线程
+    m = aes_sm3_manifest_build_file_windowed(NULL, path, 64 * 1024 * 1024, 1, &stats);
+    ASSERT_TRUE(m != NULL && stats.windows == 1 &&
+                memcmp(aes_sm3_manifest_tag(m, 0), aes_sm3_manifest_tag(want, 0),
+                       aes_sm3_manifest_page_count(want) * 32) == 0, "单窗口结果不一致");
+    aes_sm3_manifest_free(m);
+    
+    ASSERT_TRUE(aes_sm3_manifest_build_file_windowed(NULL, "/nonexistent/aes_sm3", 0, 0, NULL) == NULL,
+                "不存在的文件应返回NULL");
+    
+    aes_sm3_manifest_free(want);
+    unlink(path);
+    free(data);
+    
+    TEST_END();
+}
+
+// 测试34：轨迹回放 - 轨迹解析、三种API模式、按时间戳发出
+void test_trace_replay() {
+    TEST_START("轨迹回放 - 单块/批量/异步模式");
+    
+    // 轨迹：注释、格式错误与丢弃请求应被忽略；偏移超出数据集时回绕
+    const char* path = "/tmp/test_aes_sm3_trace.txt";
+    FILE* fp = fopen(path, "w");
+    fprintf(fp, "# ts_us offset length op\n");
+    fprintf(fp, "garbage line\n");
+    fprintf(fp, "0 0 4096 D\n");
+    for (int i = 0; i < 2000; i++) {
+        uint64_t off = (uint64_t)(i * 7919 % 4096) * 4096 + (i % 3) * 512;
+        fprintf(fp, "%d %llu %d %s\n", i * 10, (unsigned long long)off,
+                4096 * (1 + i % 16), i % 4 == 0 ? "WS" : "R");
+    }
+    fprintf(fp, "20000 %llu 8192 R\n", 1ULL << 40);
+    fclose(fp);
+    
+    aes_sm3_trace_rec_t* recs = NULL;
+    int64_t count = aes_sm3_trace_load(path, &recs);
+    ASSERT_TRUE(count == 2001, "应解析出2001条读写请求");
+    ASSERT_TRUE(recs[0].op == 'W' && recs[1].op == 'R' && recs[1].ts_us == 10, "请求字段解析错误");
+    
+    const size_t size = 4 * 1024 * 1024;
+    uint8_t* data = aligned_alloc(4096, size);
+    for (size_t i = 0; i < size; i++) {
+        data[i] = (uint8_t)((i * 2654435761ULL) >> 13);
+    }
+    
+    const char* names[] = {"单块", "批量", "异步"};
+    for (int mode = 0; mode < 3; mode++) {
+        aes_sm3_replay_report_t rep;
+        int ret = aes_sm3_replay_run(recs, count, data, size, mode, 4, 0, &rep);
+        printf("  %s: %.2f MB/s, p50 %.1fus, p99 %.1fus, max %.1fus\n", names[mode],
+               rep.mb_per_sec, rep.lat_p50_us, rep.lat_p99_us, rep.lat_max_us);
+        ASSERT_TRUE(ret == 0 && rep.requests == 2001 && rep.writes == 500 && rep.reads == 1501,
+                    "请求统计错误");
+        ASSERT_TRUE(rep.mismatches == 0, "数据集未变化，校验不应失败");
+        ASSERT_TRUE(rep.lat_p50_us <= rep.lat_p90_us && rep.lat_p90_us <= rep.lat_p99_us &&
+                    rep.lat_p99_us <= rep.lat_max_us && rep.lat_max_us > 0, "延迟分位数应单调");
+    }
+    
+    // 按时间戳发出：前200条跨越1990微秒，2倍速回放至少约1毫秒
+    aes_sm3_replay_report_t rep;
+    ASSERT_TRUE(aes_sm3_replay_run(recs, 200, data, size, 2, 2, 2.0, &rep) == 0 &&
+                rep.elapsed_sec >= 0.0009, "按时间戳回放应遵守请求间隔");
+    // 时间戳回退（首条晚于其后的记录）：按已到达的最大时间戳发出，不会因下溢而长时间睡眠
+    recs[0].ts_us = 1000;
+    ASSERT_TRUE(aes_sm3_replay_run(recs, 200, data, size, 2, 2, 2.0, &rep) == 0 &&
+                rep.elapsed_sec < 1.0, "时间戳回退的轨迹应正常回放");
+    ASSERT_TRUE(aes_sm3_replay_run(recs, count, data, 1000, 1, 1, 0, &rep) == -1, "数据集不足一页应失败");
+    aes_sm3_trace_rec_t* none = NULL;
+    ASSERT_TRUE(aes_sm3_trace_load("/nonexistent/aes_sm3.trace", &none) == -1, "不存在的轨迹应返回-1");
+    
+    unlink(path);
+    free(recs);
+    free(data);
+    
+    TEST_END();
+}
+
+// 测试35：合成数据生成器 - 可复现、可随机访问、比例与各类页内容正确
+void test_data_generator() {
+    TEST_START("合成数据生成器 - 零页/单值/文本/随机/重复");
+    
+    const aes_sm3_datagen_mix_t mix = {0.2, 0.1, 0.3, 0.2};
+    const size_t pages = 4096;
+    uint8_t* a = malloc(pages * 4096);
+    uint8_t* b = malloc(pages * 4096);
+    uint8_t page[4096];
+    
+    aes_sm3_datagen_fill(&mix, 7, a, 0, pages);
+    aes_sm3_datagen_fill(&mix, 7, b, 0, pages);
+    ASSERT_TRUE(memcmp(a, b, pages * 4096) == 0, "相同种子应生成相同数据");
+    aes_sm3_datagen_fill(&mix, 8, b, 0, pages);
+    ASSERT_TRUE(memcmp(a, b, pages * 4096) != 0, "不同种子应生成不同数据");
+    
+    // 随机访问单页、从中间开始填充，都与整体填充一致（含来源在范围之外的重复页）
+    aes_sm3_datagen_page(&mix, 7, 3000, page);
+    ASSERT_TRUE(memcmp(page, a + 3000 * 4096, 4096) == 0, "随机访问的页应与整体填充一致");
+    aes_sm3_datagen_fill(&mix, 7, b, 1000, 100);
+    ASSERT_TRUE(memcmp(b, a + 1000 * 4096, 100 * 4096) == 0, "部分填充应与整体填充一致");
+    
+    int counts[5] = {0};
+    int content_ok = 1;
+    for (size_t p = 0; p < pages; p++) {
+        int kind = aes_sm3_datagen_kind(&mix, 7, p);
+        const uint8_t* d = a + p * 4096;
+        counts[kind]++;
+        if (kind == 0) {
+            content_ok &= d[0] == 0 && memcmp(d, d + 1, 4095) == 0;
+        } else if (kind == 1) {
+            content_ok &= d[0] != 0 && memcmp(d, d + 1, 4095) == 0;
+        } else if (kind == 2) {
+            for (int i = 0; i < 4096; i++) {
+                content_ok &= d[i] == ' ' || d[i] == '\n' || (d[i] >= 0x20 && d[i] < 0x7F);
+            }
+        } else if (kind == 4) {
+            // 重复页必与之前某一页相同
+            int found = 0;
+            for (size_t q = 0; q < p && !found; q++) {
+                found = memcmp(d, a + q * 4096, 4096) == 0;
+            }
+            content_ok &= found;
+        }
+    }
+    printf("  零页 %d, 单值 %d, 文本 %d, 随机 %d, 重复 %d\n",
+           counts[0], counts[1], counts[2], counts[3], counts[4]);
+    ASSERT_TRUE(content_ok, "各类页内容不符合类型");
+    ASSERT_TRUE(abs(counts[0] - 819) < 120 && abs(counts[1] - 410) < 90 && abs(counts[2] - 1229) < 140 &&
+                abs(counts[3] - 819) < 120 && abs(counts[4] - 819) < 120, "各类页比例偏离配置");
+    ASSERT_TRUE(aes_sm3_datagen_kind(&mix, 7, 0) != 4, "第0页不应是重复页");
+    
+    // 随机页不应有重复，标签互不相同
+    const aes_sm3_datagen_mix_t random_mix = {0, 0, 0, 0};
+    uint8_t tag0[32], tag1[32];
+    aes_sm3_datagen_page(&random_mix, 7, 0, page);
+    aes_sm3_integrity_256bit(page, tag0);
+    aes_sm3_datagen_page(&random_mix, 7, 1, page);
+    aes_sm3_integrity_256bit(page, tag1);
+    ASSERT_TRUE(memcmp(tag0, tag1, 32) != 0, "不同随机页的标签应不同");
+    
+    free(a);
+    free(b);
+    
+    TEST_END();
+}
+
+// 测试36：多租户并发 - 多个调用线程同时使用批量/单块/并行接口，结果正确、统计合理
+void test_multi_tenant() {
+    TEST_START("多租户并发 - 批量/单块/并行接口同时调用");
+    
+    aes_sm3_tenant_report_t one, many;
+    ASSERT_TRUE(aes_sm3_tenant_run(1, 0.2, 7, &one) == 0, "单租户运行失败");
+    ASSERT_TRUE(aes_sm3_tenant_run(4, 0.2, 7, &many) == 0, "多租户运行失败");
+    printf("  1租户 %.2f MB/s; 4租户 %.2f MB/s（每租户 %.2f~%.2f），公平性 %.3f，扩展效率 %.1f%%\n",
+           one.mb_per_sec, many.mb_per_sec, many.min_tenant_mb_per_sec, many.max_tenant_mb_per_sec,
+           many.fairness, 100.0 * many.mb_per_sec / (4 * one.mb_per_sec));
+    ASSERT_TRUE(one.pages > 0 && many.pages > 0 && many.tenants == 4, "租户应处理了数据");
+    ASSERT_TRUE(one.mismatches == 0 && many.mismatches == 0, "并发调用结果应与参考标签一致");
+    ASSERT_TRUE(one.fairness > 0.999 && many.fairness > 0 && many.fairness <= 1.000001, "公平性指数应在(0,1]");
+    ASSERT_TRUE(many.min_tenant_mb_per_sec <= many.max_tenant_mb_per_sec, "最小吞吐不应大于最大吞吐");
+    ASSERT_TRUE(aes_sm3_tenant_run(0, 0.1, 7, &one) == -1 && aes_sm3_tenant_run(1, 0.1, 0, &one) == -1,
+                "非法参数应返回-1");
+    
+    TEST_END();
+}
+
+// 测试37：基准JSON与报告 - 矩阵完整、报告含表格/曲线/对比
+static int file_contains(const char* path, const char* needle) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) {
+        return 0;
+    }
+    static char buf[1 << 20];
+    size_t n = fread(buf, 1, sizeof(buf) - 1, fp);
+    fclose(fp);
+    buf[n] = '\0';
+    return strstr(buf, needle) != NULL;
+}
+
+void test_bench_report() {
+    TEST_START("基准JSON与报告 - 表格/SVG曲线/屋顶线/版本对比");
+    
+    const char* json = "/tmp/test_aes_sm3_bench.json";
+    const char* prev = "/tmp/test_aes_sm3_bench_prev.json";
+    const char* md = "/tmp/test_aes_sm3_report.md";
+    const char* svg = "/tmp/test_aes_sm3_report_L1.svg";
+    const char* html = "/tmp/test_aes_sm3_report.html";
+    
+    ASSERT_TRUE(aes_sm3_bench_json(json, 0.01, 1) == 0, "基准JSON写出失败");
+    ASSERT_TRUE(file_contains(json, "\"variant\": \"domain64\", \"tier\": \"DRAM\""), "矩阵应覆盖所有版本与层级");
+    
+    // 上次结果中batch8快得不可能，本次应标为回退
+    FILE* fp = fopen(prev, "w");
+    fprintf(fp, "{\"schema\": \"aes-sm3-bench/1\", \"timestamp\": \"2000-01-01T00:00:00Z\", \"results\": [\n"
+                "{\"variant\": \"batch8\", \"tier\": \"L1\", \"working_set\": 16384, \"threads\": 1, "
+                "\"mb_per_sec\": 1e12, \"roofline_pct\": 100}]}\n");
+    fclose(fp);
+    
+    ASSERT_TRUE(aes_sm3_bench_report(json, md, prev) == 0, "Markdown报告生成失败");
+    ASSERT_TRUE(file_contains(md, "| batch8 |") && file_contains(md, "(test_aes_sm3_report_L1.svg)"),
+                "报告应含吞吐表与曲线引用");
+    ASSERT_TRUE(file_contains(md, "| batch8 | L1 | 1 |") && file_contains(md, "回退（低于-5%）: 1项"),
+                "报告应对比上次结果并标出回退");
+    ASSERT_TRUE(file_contains(svg, "<polyline"), "应写出SVG扩展曲线");
+    ASSERT_TRUE(aes_sm3_bench_report(json, html, NULL) == 0 && file_contains(html, "<svg") &&
+                !file_contains(html, "与上次对比"), "HTML报告应内联SVG");
+    ASSERT_TRUE(aes_sm3_bench_report(md, html, NULL) == -1, "非基准JSON应拒绝");
+    
+    unlink(json);
+    unlink(prev);
+    unlink(md);
+    unlink(html);
+    unlink(svg);
+    unlink("/tmp/test_aes_sm3_report_L2.svg");
+    unlink("/tmp/test_aes_sm3_report_LLC.svg");
+    unlink("/tmp/test_aes_sm3_report_DRAM.svg");
+    
+    TEST_END();
+}
+
+// 测试38：标签文本编码 - SIMD与标量路径结果一致，解码可逆、拒绝非法输入；缓冲输出内容完整
+static size_t ref_base64(const uint8_t* in, size_t len, char* out) {
+    static const char chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t o = 0;
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t v = (uint32_t)in[i] << 16 | (i + 1 < len ? (uint32_t)in[i + 1] << 8 : 0) |
+                     (i + 2 < len ? in[i + 2] : 0);
+        out[o++] = chars[v >> 18];
+        out[o++] = chars[(v >> 12) & 63];
+        out[o++] = i + 1 < len ? chars[(v >> 6) & 63] : '=';
+        out[o++] = i + 2 < len ? chars[v & 63] : '=';
+    }
+    out[o] = '\0';
+    return o;
+}
+
+void test_text_encoding() {
+    TEST_START("标签文本编码 - hex/base64编解码与缓冲输出");
+    
+    uint8_t in[100], back[100];
+    char text[256], ref[256];
+    int encode_ok = 1, decode_ok = 1;
+    for (size_t len = 0; len <= sizeof(in); len++) {
+        for (size_t i = 0; i < len; i++) {
+            in[i] = (uint8_t)(rand() & 0xff);
+        }
+        for (size_t i = 0; i < len; i++) {
+            snprintf(ref + 2 * i, 3, "%02x", in[i]);
+        }
+        ref[2 * len] = '\0';
+        encode_ok &= aes_sm3_hex_encode(in, len, text) == 2 * len && strcmp(text, ref) == 0;
+        for (size_t i = 0; i < 2 * len; i += 3) {
+            text[i] = text[i] >= 'a' ? (char)(text[i] - 32) : text[i];   // 大小写混合
+        }
+        decode_ok &= aes_sm3_hex_decode(text, 2 * len, back) == (int64_t)len && memcmp(back, in, len) == 0;
+        
+        size_t n = ref_base64(in, len, ref);
+        encode_ok &= aes_sm3_base64_encode(in, len, text) == n && strcmp(text, ref) == 0;
+        decode_ok &= aes_sm3_base64_decode(text, n, back) == (int64_t)len && memcmp(back, in, len) == 0;
+    }
+    ASSERT_TRUE(encode_ok, "hex/base64编码应与参考实现一致（0~100字节）");
+    ASSERT_TRUE(decode_ok, "解码应还原原始字节");
+    
+    // 非法字符分别落在SIMD块内与标量尾部
+    aes_sm3_hex_encode(in, 40, text);
+    int reject_ok = aes_sm3_hex_decode(text, 79, back) == -1;
+    for (int pos = 0; pos < 80; pos += 13) {
+        char saved = text[pos];
+        text[pos] = 'g';
+        reject_ok &= aes_sm3_hex_decode(text, 80, back) == -1;
+        text[pos] = saved;
+    }
+    size_t n = aes_sm3_base64_encode(in, 32, text);
+    reject_ok &= aes_sm3_base64_decode(text, n - 1, back) == -1;
+    for (size_t pos = 0; pos < n - 1; pos += 5) {
+        char saved = text[pos];
+        text[pos] = pos % 2 ? '*' : '=';
+        reject_ok &= aes_sm3_base64_decode(text, n, back) == -1;
+        text[pos] = saved;
+    }
+    ASSERT_TRUE(reject_ok, "奇数长度、非法字符与中间的=应被拒绝");
+    
+    // 小缓冲区强制多次刷新，内容与逐行格式化一致
+    const char* path = "/tmp/test_aes_sm3_text.txt";
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    aes_sm3_writer_t* w = aes_sm3_writer_open(fd, 300);
+    size_t expect_len = 0;
+    static char expect[3000 * 80];
+    for (uint64_t i = 0; i < 3000; i++) {
+        uint8_t tag[32];
+        for (int j = 0; j < 32; j++) {
+            tag[j] = (uint8_t)(i * 31 + j * 7);
+        }
+        int format = i % 2 ? AES_SM3_TEXT_BASE64 : AES_SM3_TEXT_HEX;
+        aes_sm3_writer_u64(w, i * 1000003);
+        aes_sm3_writer_put(w, "\t", 1);
+        aes_sm3_writer_tag(w, tag, 32, format);
+        aes_sm3_writer_put(w, "\n", 1);
+        expect_len += sprintf(expect + expect_len, "%llu\t", (unsigned long long)(i * 1000003));
+        if (format == AES_SM3_TEXT_HEX) {
+            for (int j = 0; j < 32; j++) {
+                expect_len += sprintf(expect + expect_len, "%02x", tag[j]);
+            }
+        } else {
+            expect_len += ref_base64(tag, 32, expect + expect_len);
+        }
+        expect[expect_len++] = '\n';
+    }
+    ASSERT_TRUE(aes_sm3_writer_close(w) == 0, "缓冲输出关闭失败");
+    close(fd);
+    
+    FILE* fp = fopen(path, "r");
+    static char got[3000 * 80];
+    size_t got_len = fp ? fread(got, 1, sizeof(got), fp) : 0;
+    if (fp) {
+        fclose(fp);
+    }
+    ASSERT_TRUE(got_len == expect_len && memcmp(got, expect, expect_len) == 0, "输出内容应与逐行格式化一致");
+    
+    // 缓冲区将满时写1字节base64（编码4字节），以及超过缓冲区的长输入：分段编码结果不变
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    w = aes_sm3_writer_open(fd, 256);
+    uint8_t long_tag[200];
+    for (int j = 0; j < 200; j++) {
+        long_tag[j] = (uint8_t)(j * 37 + 11);
+    }
+    static char long_expect[1024];
+    memset(long_expect, 'x', 254);
+    aes_sm3_writer_put(w, long_expect, 254);
+    aes_sm3_writer_tag(w, long_tag, 1, AES_SM3_TEXT_BASE64);
+    aes_sm3_writer_tag(w, long_tag, 200, AES_SM3_TEXT_HEX);
+    aes_sm3_writer_tag(w, long_tag, 200, AES_SM3_TEXT_BASE64);
+    ASSERT_TRUE(aes_sm3_writer_close(w) == 0, "长标签输出关闭失败");
+    close(fd);
+    size_t long_len = 254;
+    long_len += ref_base64(long_tag, 1, long_expect + long_len);
+    for (int j = 0; j < 200; j++) {
+        long_len += sprintf(long_expect + long_len, "%02x", long_tag[j]);
+    }
+    long_len += ref_base64(long_tag, 200, long_expect + long_len);
+    fp = fopen(path, "r");
+    got_len = fp ? fread(got, 1, sizeof(got), fp) : 0;
+    if (fp) {
+        fclose(fp);
+    }
+    ASSERT_TRUE(got_len == long_len && memcmp(got, long_expect, long_len) == 0, "长标签分段编码结果错误");
+    
+    // 写入失败记录在close的返回值中
+    w = aes_sm3_writer_open(-1, 0);
+    aes_sm3_writer_put(w, "x", 1);
+    ASSERT_TRUE(aes_sm3_writer_close(w) == -1, "写入失败应由close报告");
+    unlink(path);
+    
+    TEST_END();
+}
+
+#if defined(__linux__)
+// 测试39：基准环境检查 - 各项指标可测，检查后恢复CPU亲和性
+void test_bench_env_check() {
+    TEST_START("基准环境检查 - 调频/SMT/计时/波动");
+    
+    cpu_set_t before, after;
+    CPU_ZERO(&before);
+    CPU_ZERO(&after);
+    pthread_getaffinity_np(pthread_self(), sizeof(before), &before);
+    
+    aes_sm3_bench_env_t env;
+    int warnings = aes_sm3_bench_env_check(-1, &env);
+    printf("  CPU %d, 调频 %s, 睿频 %d, SMT兄弟 %d(忙碌%.1f%%), 计时 %.1fns, CV %.2f%%, 不合格项 %d\n",
+           env.cpu, env.governor[0] ? env.governor : "未知", env.turbo, env.sibling_count,
+           env.sibling_busy * 100, env.timer_overhead_ns, env.noise_cv * 100, warnings);
+    ASSERT_TRUE(warnings >= 0 && warnings == env.warnings, "环境检查失败");
+    ASSERT_TRUE(CPU_ISSET(env.cpu, &before), "所选核心应在允许的CPU集合中");
+    ASSERT_TRUE(env.timer_overhead_ns > 0 && env.timer_overhead_ns < 100000, "计时开销应可测");
+    ASSERT_TRUE(env.noise_cv >= 0 && env.noise_cv < 10, "变异系数应可测");
+    ASSERT_TRUE(env.sibling_busy >= 0 && env.sibling_busy <= 1, "兄弟核忙碌比例应在[0,1]");
+    
+    pthread_getaffinity_np(pthread_self(), sizeof(after), &after);
+    ASSERT_TRUE(CPU_EQUAL(&before, &after), "检查后应恢复原CPU亲和性");
+    
+    TEST_END();
+}
+#endif
+
 // ============================================================================
 // 主测试运行器
 // ============================================================================
@@ -850,6 +3030,41 @@ int main() {
     test_long_running_stability();
     test_random_input_stress();
     
+    printf(COLOR_MAGENTA "\n═══════════════════════════════════════════════════════════\n");
+    printf("第六部分：扩展接口测试\n");
+    printf("═══════════════════════════════════════════════════════════\n" COLOR_RESET);
+    
+    test_domain_separation();
+    test_fold_accumulator();
+    test_extent_tags();
+    test_fused_parity();
+    test_masked_tags();
+    test_tag_filter();
+    test_tag_index();
+    test_manifest_delta();
+    test_manifest_compare();
+    test_tail_mode();
+#if defined(__linux__)
+    test_watch_mode();
+    test_region_tracker();
+#endif
+    test_memo_cache();
+    test_shared_cache();
+#if defined(__linux__)
+    test_resumable_scan();
+#endif
+    test_throttle();
+    test_cache_neutral_scan();
+    test_windowed_mmap();
+    test_trace_replay();
+    test_data_generator();
+    test_multi_tenant();
+    test_bench_report();
+    test_text_encoding();
+#if defined(__linux__)
+    test_bench_env_check();
+#endif
+    
     // 打印测试汇总
     print_test_summary();
     